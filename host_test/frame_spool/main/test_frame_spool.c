@@ -0,0 +1,324 @@
+// Frame spool on the linux target: the partition is a file-backed flash emulation, and a "reboot" is a
+// fresh frame_spool_init() over whatever the previous run left in it.
+
+#include "frame_spool.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_rom_crc.h"
+#include "unity.h"
+
+#define SECTOR 4096
+#define SPAN3_LEN 9000 // with header and metadata, three sectors; 16 is not a multiple, so records wrap
+
+// On-flash record header as frame_spool.c writes it; only used to fake a torn append.
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t len;
+    uint32_t frame_seq;
+    int64_t capture_us;
+    int64_t unix_us;
+    uint32_t boot;
+    uint16_t width;
+    uint16_t height;
+    uint32_t kind;
+    uint32_t meta_len;
+    uint32_t meta_crc;
+    uint32_t data_crc;
+    uint32_t hdr_crc;
+    uint32_t committed;
+    uint32_t drained;
+} test_hdr_t;
+
+// Metadata block as version 1 wrote it, before the burst tag.
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    uint32_t flags;
+    uint32_t regions_len;
+    uint8_t sha256[32];
+    char quality[72];
+    char window[12];
+    char event[24];
+} test_meta_v1_t;
+
+static frame_spool_t s_spool;
+
+static const esp_partition_t *spool_partition(void)
+{
+    const esp_partition_t *part =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, FRAME_SPOOL_PARTITION_LABEL);
+    TEST_ASSERT_NOT_NULL(part);
+    return part;
+}
+
+static void reboot(void)
+{
+    if (s_spool.lock) {
+        vSemaphoreDelete(s_spool.lock);
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_init(&s_spool, FRAME_SPOOL_PARTITION_LABEL));
+}
+
+static void start_empty(void)
+{
+    const esp_partition_t *part = spool_partition();
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_erase_range(part, 0, part->size));
+    reboot();
+    TEST_ASSERT_EQUAL(0, frame_spool_pending(&s_spool));
+}
+
+// Payload bytes derived from the sequence number, so every frame is told apart by its content.
+static void append(uint32_t seq, size_t len)
+{
+    cam_frame_t *frame = cam_frame_alloc(NULL, len);
+    TEST_ASSERT_NOT_NULL(frame);
+    frame->kind = seq % 3 == 0 ? CAM_FRAME_VEG_RECORD : CAM_FRAME_JPEG;
+    for (size_t i = 0; i < len; i++) {
+        frame->buf[i] = (uint8_t)(seq * 31 + i);
+    }
+    frame->seq = seq;
+    frame->capture_us = 1000000LL * seq;
+    frame->unix_us = seq % 2 ? 1700000000000000LL + seq : 0;
+    frame->boot = 7;
+    frame->width = 320;
+    frame->height = 240;
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_append(&s_spool, frame));
+    cam_frame_free(frame);
+}
+
+// The oldest pending frame must be `seq` with intact contents; it is acknowledged.
+static void expect_and_ack(uint32_t seq, size_t len)
+{
+    cam_frame_t *frame = NULL;
+    uint32_t id = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_peek(&s_spool, &frame, &id));
+    TEST_ASSERT_EQUAL_UINT32(seq, frame->seq);
+    TEST_ASSERT_EQUAL(len, frame->len);
+    TEST_ASSERT_EQUAL(seq % 3 == 0 ? CAM_FRAME_VEG_RECORD : CAM_FRAME_JPEG, frame->kind);
+    TEST_ASSERT_EQUAL(1000000LL * seq, frame->capture_us);
+    TEST_ASSERT_EQUAL(seq % 2 ? 1700000000000000LL + seq : 0, frame->unix_us);
+    TEST_ASSERT_EQUAL_UINT32(7, frame->boot);
+    for (size_t i = 0; i < len; i++) {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(seq * 31 + i), frame->buf[i]);
+    }
+    cam_frame_free(frame);
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_ack(&s_spool, id));
+}
+
+TEST_CASE("pending frames survive a reboot in order", "[frame_spool]")
+{
+    start_empty();
+    append(1, 1000);
+    append(2, 5000);
+    append(3, 200);
+    reboot();
+    TEST_ASSERT_EQUAL(3, frame_spool_pending(&s_spool));
+    TEST_ASSERT_EQUAL_UINT32(3, s_spool.stats.recovered);
+    expect_and_ack(1, 1000);
+
+    // An acknowledged frame stays uploaded across the next reboot.
+    reboot();
+    TEST_ASSERT_EQUAL(2, frame_spool_pending(&s_spool));
+    expect_and_ack(2, 5000);
+    append(4, 300);
+    reboot();
+    expect_and_ack(3, 200);
+    expect_and_ack(4, 300);
+    TEST_ASSERT_EQUAL(0, frame_spool_pending(&s_spool));
+    cam_frame_t *frame = NULL;
+    uint32_t id = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, frame_spool_peek(&s_spool, &frame, &id));
+}
+
+TEST_CASE("upload metadata comes back with the frame", "[frame_spool]")
+{
+    start_empty();
+    cam_frame_t *frame = cam_frame_alloc((const uint8_t *)"\xff\xd8jpeg", 6);
+    TEST_ASSERT_NOT_NULL(frame);
+    frame->seq = 5;
+    frame->hashed = true;
+    frame->duplicate = true;
+    memset(frame->sha256, 0xab, sizeof(frame->sha256));
+    frame->regions_json = strdup("{\"regions\":[{\"name\":\"bed\",\"r\":12}]}");
+    strcpy(frame->quality, "luma=120");
+    strcpy(frame->window, "center");
+    strcpy(frame->event, "3;-1500");
+    strcpy(frame->burst, "2;1;3;66000");
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_append(&s_spool, frame));
+    cam_frame_free(frame);
+    append(6, 100); // no metadata
+
+    reboot();
+    uint32_t id = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_peek(&s_spool, &frame, &id));
+    TEST_ASSERT_EQUAL_UINT32(5, frame->seq);
+    TEST_ASSERT_EQUAL(6, frame->len);
+    TEST_ASSERT_TRUE(frame->hashed);
+    TEST_ASSERT_TRUE(frame->duplicate);
+    TEST_ASSERT_EACH_EQUAL_UINT8(0xab, frame->sha256, sizeof(frame->sha256));
+    TEST_ASSERT_EQUAL_STRING("{\"regions\":[{\"name\":\"bed\",\"r\":12}]}", frame->regions_json);
+    TEST_ASSERT_EQUAL_STRING("luma=120", frame->quality);
+    TEST_ASSERT_EQUAL_STRING("center", frame->window);
+    TEST_ASSERT_EQUAL_STRING("3;-1500", frame->event);
+    TEST_ASSERT_EQUAL_STRING("2;1;3;66000", frame->burst);
+    cam_frame_free(frame);
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_ack(&s_spool, id));
+
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_peek(&s_spool, &frame, &id));
+    TEST_ASSERT_FALSE(frame->hashed);
+    TEST_ASSERT_NULL(frame->regions_json);
+    TEST_ASSERT_EQUAL_STRING("", frame->event);
+    cam_frame_free(frame);
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_ack(&s_spool, id));
+}
+
+TEST_CASE("metadata written by an older version reads with the newer fields empty", "[frame_spool]")
+{
+    start_empty();
+    const esp_partition_t *part = spool_partition();
+    uint8_t payload[100];
+    memset(payload, 0x33, sizeof(payload));
+    test_meta_v1_t meta = {.version = 1, .size = sizeof(meta)};
+    strcpy(meta.event, "9;250");
+    test_hdr_t h = {
+        .magic = 0x344c5053u,
+        .id = s_spool.next_id,
+        .len = sizeof(payload),
+        .frame_seq = 8,
+        .meta_len = sizeof(meta),
+        .meta_crc = esp_rom_crc32_le(0, (const uint8_t *)&meta, sizeof(meta)),
+        .data_crc = esp_rom_crc32_le(0, payload, sizeof(payload)),
+        .committed = 0,
+        .drained = 0xffffffffu,
+    };
+    h.hdr_crc = esp_rom_crc32_le(0, (const uint8_t *)&h, offsetof(test_hdr_t, hdr_crc));
+    size_t at = (size_t)s_spool.head_sector * SECTOR;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(part, at, &h, sizeof(h)));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(part, at + sizeof(h), &meta, sizeof(meta)));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(part, at + sizeof(h) + sizeof(meta), payload, sizeof(payload)));
+
+    reboot();
+    cam_frame_t *frame = NULL;
+    uint32_t id = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_peek(&s_spool, &frame, &id));
+    TEST_ASSERT_EQUAL_UINT32(8, frame->seq);
+    TEST_ASSERT_EQUAL_STRING("9;250", frame->event);
+    TEST_ASSERT_EQUAL_STRING("", frame->burst);
+    TEST_ASSERT_EQUAL_UINT8(0x33, frame->buf[0]);
+    cam_frame_free(frame);
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_ack(&s_spool, id));
+}
+
+TEST_CASE("a rejected record is released without counting as drained", "[frame_spool]")
+{
+    start_empty();
+    append(1, 1000);
+    append(2, 1000);
+    cam_frame_t *frame = NULL;
+    uint32_t id = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_peek(&s_spool, &frame, &id));
+    TEST_ASSERT_EQUAL_UINT32(1, frame->seq);
+    cam_frame_free(frame);
+    TEST_ASSERT_EQUAL(ESP_OK, frame_spool_reject(&s_spool, id));
+    TEST_ASSERT_EQUAL_UINT32(1, s_spool.stats.rejected);
+    TEST_ASSERT_EQUAL_UINT32(0, s_spool.stats.drained);
+
+    reboot();
+    TEST_ASSERT_EQUAL(1, frame_spool_pending(&s_spool));
+    expect_and_ack(2, 1000);
+}
+
+TEST_CASE("an uncommitted record is skipped after a reboot", "[frame_spool]")
+{
+    start_empty();
+    append(1, 1000);
+
+    // Power lost during the next append: header and payload written, `committed` never cleared.
+    const esp_partition_t *part = spool_partition();
+    uint32_t torn_sector = s_spool.head_sector;
+    uint8_t payload[2000];
+    memset(payload, 0x5A, sizeof(payload));
+    test_hdr_t h = {
+        .magic = 0x344c5053u,
+        .id = s_spool.next_id,
+        .len = sizeof(payload),
+        .frame_seq = 2,
+        .data_crc = esp_rom_crc32_le(0, payload, sizeof(payload)),
+        .committed = 0xffffffffu,
+        .drained = 0xffffffffu,
+    };
+    h.hdr_crc = esp_rom_crc32_le(0, (const uint8_t *)&h, offsetof(test_hdr_t, hdr_crc));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(part, (size_t)torn_sector * SECTOR, &h, sizeof(h)));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_write(part, (size_t)torn_sector * SECTOR + sizeof(h), payload,
+                                                  sizeof(payload)));
+
+    reboot();
+    TEST_ASSERT_EQUAL(1, frame_spool_pending(&s_spool));
+    // The torn record's sectors are not taken for free space.
+    TEST_ASSERT_NOT_EQUAL(torn_sector, s_spool.head_sector);
+    append(3, 1000);
+    reboot();
+    TEST_ASSERT_EQUAL(2, frame_spool_pending(&s_spool));
+    expect_and_ack(1, 1000);
+    expect_and_ack(3, 1000);
+    TEST_ASSERT_EQUAL(0, frame_spool_pending(&s_spool));
+}
+
+TEST_CASE("records wrap around the end of the partition", "[frame_spool]")
+{
+    start_empty();
+    uint32_t sectors = spool_partition()->size / SECTOR;
+    TEST_ASSERT_NOT_EQUAL(0, sectors % 3);
+
+    // Several laps with two frames pending at a time; some records straddle the end.
+    uint32_t seq = 1;
+    append(seq, SPAN3_LEN);
+    bool straddled = false;
+    for (int i = 0; i < 3 * (int)sectors; i++) {
+        straddled |= s_spool.head_sector + 3 > sectors;
+        append(seq + 1, SPAN3_LEN);
+        if (i % 5 == 4) {
+            reboot();
+            TEST_ASSERT_EQUAL(2, frame_spool_pending(&s_spool));
+        }
+        expect_and_ack(seq, SPAN3_LEN);
+        seq++;
+    }
+    TEST_ASSERT_TRUE(straddled);
+    TEST_ASSERT_EQUAL_UINT32(0, s_spool.stats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, s_spool.stats.corrupt);
+    expect_and_ack(seq, SPAN3_LEN);
+}
+
+TEST_CASE("the oldest record is dropped when the spool is full", "[frame_spool]")
+{
+    start_empty();
+    uint32_t sectors = spool_partition()->size / SECTOR;
+    uint32_t fit = sectors / 3;
+    for (uint32_t seq = 1; seq <= fit; seq++) {
+        append(seq, SPAN3_LEN);
+    }
+    TEST_ASSERT_EQUAL(fit, frame_spool_pending(&s_spool));
+    TEST_ASSERT_EQUAL_UINT32(0, s_spool.stats.dropped);
+
+    append(fit + 1, SPAN3_LEN);
+    TEST_ASSERT_EQUAL(fit, frame_spool_pending(&s_spool));
+    TEST_ASSERT_EQUAL_UINT32(1, s_spool.stats.dropped);
+
+    reboot();
+    TEST_ASSERT_EQUAL(fit, frame_spool_pending(&s_spool));
+    for (uint32_t seq = 2; seq <= fit + 1; seq++) {
+        expect_and_ack(seq, SPAN3_LEN);
+    }
+    TEST_ASSERT_EQUAL(0, frame_spool_pending(&s_spool));
+}
+
+void app_main(void)
+{
+    UNITY_BEGIN();
+    unity_run_all_tests();
+    UNITY_END();
+}
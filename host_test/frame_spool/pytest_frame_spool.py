@@ -0,0 +1,10 @@
+# SPDX-License-Identifier: CC0-1.0
+import pytest
+from pytest_embedded_idf.dut import IdfDut
+from pytest_embedded_idf.utils import idf_parametrize
+
+
+@pytest.mark.host_test
+@idf_parametrize('target', ['linux'], indirect=['target'])
+def test_frame_spool_linux(dut: IdfDut) -> None:
+    dut.expect_exact('Tests 0 Failures 0 Ignored', timeout=60)
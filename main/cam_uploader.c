@@ -1,15 +1,19 @@
 #include "cam_uploader.h"
 
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/time.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 
+#include "esp_attr.h"
 #include "esp_check.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
-#include "esp_http_client.h"
+#include "esp_mac.h"
 #include "esp_timer.h"
 #include "driver/gpio.h"
 #include "esp_adc/adc_oneshot.h"
@@ -19,11 +23,22 @@
 #include "nvs_flash.h"
 
 #include "esp_camera.h"
+#include "img_converters.h"
 #include "sdkconfig.h"
 
-#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-#include "esp_crt_bundle.h"
-#endif
+#include "capture_sched.h"
+#include "change_detect.h"
+#include "frame_dedup.h"
+#include "frame_queue.h"
+#include "frame_spool.h"
+#include "multipart.h"
+#include "preroll_ring.h"
+#include "quality_ctrl.h"
+#include "roi_stats.h"
+#include "tile_diff.h"
+#include "upload_client.h"
+#include "veg_index.h"
+#include "window_preset.h"
 
 // If the user doesn't select a camera model at build time,
 // pick a sensible default per target.
@@ -50,6 +65,162 @@ static const char *TAG = "cam_uploader";
 #define NVS_KEY_URL "url"
 #define NVS_KEY_VOLTAGE_URL "vurl"
 #define NVS_KEY_INTERVAL "interval"
+#define NVS_KEY_ALIGN "align"
+#define NVS_KEY_MISSED_SLOT "missed"
+#define NVS_KEY_PHASE "phase"
+#define NVS_KEY_PHASE_JITTER "phase_jit"
+#define NVS_KEY_FRAME_SIZE "fsize"
+#define NVS_KEY_JPEG_QUALITY "quality"
+#define NVS_KEY_ADAPT_MS "ad_ms"
+#define NVS_KEY_ADAPT_KB "ad_kb"
+#define NVS_KEY_ADAPT_QUALITY_WORST "ad_qworst"
+#define NVS_KEY_ADAPT_FRAME_SIZE_MIN "ad_fsmin"
+#define NVS_KEY_QUEUE_DROP "qdrop"
+#define NVS_KEY_CHUNKED "chunked"
+#define NVS_KEY_CHUNK_SIZE "chunk"
+#define NVS_KEY_COMBINED "combined"
+#define NVS_KEY_BATCH_FRAMES "batch_n"
+#define NVS_KEY_BATCH_WINDOW "batch_win"
+#define NVS_KEY_SPOOL_RATE "spool_rate"
+#define NVS_KEY_SPOOL_FAILED "spool_fail"
+#define NVS_KEY_RETRY_ATTEMPTS "retries"
+#define NVS_KEY_BREAKER_FAILURES "brk_fail"
+#define NVS_KEY_BREAKER_COOLDOWN "brk_cool"
+#define NVS_KEY_PRECONNECT_LEAD "pre_ms"
+#define NVS_KEY_CHANGE_THRESHOLD "chg_pm"
+#define NVS_KEY_CHANGE_HEARTBEAT "chg_beat"
+#define NVS_KEY_DEDUP_MODE "dedup"
+#define NVS_KEY_CAPTURE_MODE "mode"
+#define NVS_KEY_VEG_JPEG_EVERY "veg_every"
+#define NVS_KEY_REGIONS "regions"
+#define NVS_KEY_GATE_MIN_LUMA "qg_luma"
+#define NVS_KEY_GATE_MAX_CLIP "qg_clip"
+#define NVS_KEY_GATE_MIN_SHARPNESS "qg_sharp"
+#define NVS_KEY_GATE_RETRIES "qg_retries"
+#define NVS_KEY_FRESH_MAX_AGE "fresh_ms"
+#define NVS_KEY_SETTLE_FRAMES "ae_frames"
+#define NVS_KEY_SETTLE_MS "ae_ms"
+#define NVS_KEY_WINDOW_PRESETS "win_presets"
+#define NVS_KEY_WINDOW_CYCLE "win_cycle"
+#define NVS_KEY_TILE_KEYFRAME_EVERY "tile_key"
+#define NVS_KEY_PREROLL_INTERVAL "pr_ms"
+#define NVS_KEY_PREROLL_SEC "pr_sec"
+#define NVS_KEY_POSTROLL_SEC "po_sec"
+#define NVS_KEY_PREROLL_KB "pr_kb"
+#define NVS_KEY_EVENT_GPIO "ev_gpio"
+#define NVS_KEY_EVENT_CHANGE "ev_chg"
+#define NVS_KEY_BURST_FRAMES "burst"
+#define NVS_KEY_BOOT_COUNT "boots"
+
+// Upper bound for the configurable socket write size.
+#define UPLOADER_MAX_CHUNK_SIZE 65536
+
+// Frames held between the capture and upload stages.
+#define UPLOADER_QUEUE_DEPTH 4
+// Upper bound for frames shipped in one batched request.
+#define UPLOADER_MAX_BATCH_FRAMES 16
+// How often an idle uploader wakes to expire kept-alive connections.
+#define UPLOADER_IDLE_POLL_MS 5000
+// Retry backoff: first delay and cap (Retry-After waits longer than the cap open the circuit instead).
+#define UPLOADER_RETRY_BASE_MS 500
+#define UPLOADER_RETRY_MAX_MS 8000
+#define UPLOADER_MAX_RETRY_ATTEMPTS 5
+// Longest circuit cool-down after repeated failed probes.
+#define UPLOADER_BREAKER_MAX_OPEN_SEC 900
+
+// Upper bound for the per-capture random delay (the scheduler also caps it at half the interval).
+#define UPLOADER_MAX_PHASE_JITTER_MS 60000
+// A collector-assigned phase closer than this to the stored one is applied but not written to flash.
+#define UPLOADER_PHASE_SAVE_MIN_DELTA_MS 1000
+
+// Upper bound for the change detector's forced-upload period (frames).
+#define UPLOADER_MAX_CHANGE_HEARTBEAT 1000
+
+// Upper bound for the vegetation mode's audit JPEG period (cycles).
+#define UPLOADER_MAX_VEG_JPEG_EVERY 10000
+// Vegetation indices and region statistics are computed on the JPEG decoded at 1/2, 1/4 or 1/8 scale
+// down to this width.
+#define UPLOADER_ANALYSIS_MAX_WIDTH 160
+
+// Request header carrying a JPEG's region statistics (roi_stats_format_json()) on single-frame uploads.
+#define UPLOADER_REGIONS_HEADER "X-Region-Stats"
+
+// Request header carrying the quality gate's score (frame_quality_format()) on single-frame uploads.
+#define UPLOADER_QUALITY_HEADER "X-Frame-Quality"
+// Quality gate bounds: re-captures per slot, and the sharpness setting (Laplacian variance).
+#define UPLOADER_MAX_GATE_RETRIES 5
+#define UPLOADER_MAX_GATE_SHARPNESS 100000
+// Pause before re-capturing a rejected frame, so exposure and gain can take a step first.
+#define UPLOADER_GATE_RETRY_DELAY_MS 200
+
+// Longest keyframe period for differential uploads; a lost keyframe costs the collector every delta until the next.
+#define UPLOADER_MAX_TILE_KEYFRAME_EVERY 1000
+
+// Freshness mode: largest accepted age setting, and stale buffers handed back per capture before
+// the next one is used regardless (a threshold below the sensor's frame time could never be met).
+#define UPLOADER_MAX_FRESH_AGE_MS 60000
+#define UPLOADER_FRESH_MAX_DISCARDS 2
+
+static const int s_age_bounds_ms[CAM_UPLOADER_AGE_BUCKETS - 1] = {CAM_UPLOADER_AGE_BOUNDS_MS};
+
+// Bounds of the wait for auto exposure to settle.
+#define UPLOADER_MAX_SETTLE_FRAMES 30
+#define UPLOADER_MAX_SETTLE_MS 10000
+
+// Request header naming the sensor window preset a JPEG was taken with, on single-frame uploads.
+#define UPLOADER_WINDOW_HEADER "X-Sensor-Window"
+
+// Pre-event buffer bounds. Without PSRAM the buffer competes with the frame buffer and TLS for internal RAM.
+#define UPLOADER_MAX_PREROLL_INTERVAL_MS 60000
+#define UPLOADER_MAX_PREROLL_SEC 600
+#if CONFIG_SPIRAM
+#define UPLOADER_MAX_PREROLL_KB 4096
+#else
+#define UPLOADER_MAX_PREROLL_KB 160
+#endif
+// Request header tying a frame to an event: "<event>;<ms from the trigger>".
+#define UPLOADER_EVENT_HEADER "X-Frame-Event"
+
+// "<boot>;<seq>;<capture_us>;<unix_us>" of every frame; unix_us is empty while the clock is not set.
+// Frames re-sent from the spool after a reboot carry the boot they were captured in.
+#define UPLOADER_CAPTURE_HEADER "X-Frame-Capture"
+#define UPLOADER_CAPTURE_TEXT_MAX 72
+// How often event and burst frames waiting for room in the upload queue are offered again.
+#define UPLOADER_HELD_DRAIN_POLL_MS 200
+
+// Frame buffers for bursts: the sensor fills one while the previous frame is copied out. Each holds
+// a whole JPEG, so without PSRAM only two fit beside everything else.
+#if CONFIG_SPIRAM
+#define UPLOADER_BURST_FB_COUNT 3
+#else
+#define UPLOADER_BURST_FB_COUNT 2
+#endif
+// Request header placing a frame in its burst: "<burst>;<index>;<count>;<us from the first frame>".
+#define UPLOADER_BURST_HEADER "X-Frame-Burst"
+
+// Upper bound for the pre-connect lead time.
+#define UPLOADER_MAX_PRECONNECT_LEAD_MS 30000
+
+// Upper bound for the spool drain rate, so backlog never crowds out live frames.
+#define UPLOADER_MAX_SPOOL_DRAIN_PER_MIN 60
+// Answered failures after which a spooled frame is released anyway, so one bad frame cannot hold the backlog.
+#define UPLOADER_SPOOL_MAX_ATTEMPTS 8
+
+// jpeg_quality range accepted by the sensor drivers; very low numbers overflow the JPEG buffer.
+#define UPLOADER_MIN_JPEG_QUALITY 4
+#define UPLOADER_MAX_JPEG_QUALITY 63
+// Without PSRAM the frame buffer lives in internal RAM, which cannot hold large JPEGs.
+#if CONFIG_SPIRAM
+#define UPLOADER_MAX_FRAME_SIZE FRAMESIZE_UXGA
+#else
+#define UPLOADER_MAX_FRAME_SIZE FRAMESIZE_VGA
+#endif
+
+// Capture task notification bits.
+#define CAPTURE_NOTIFY_CONFIG (1u << 0)
+#define CAPTURE_NOTIFY_SLOT (1u << 1)
+#define CAPTURE_NOTIFY_EVENT (1u << 2)
+#define CAPTURE_NOTIFY_TRIGGER (1u << 3)
 
 #define VBAT_ADC_UNIT ADC_UNIT_1
 #define VBAT_ADC_CHANNEL ADC_CHANNEL_0
@@ -60,9 +231,54 @@ static const char *TAG = "cam_uploader";
 
 static SemaphoreHandle_t s_lock;
 static cam_uploader_config_t s_cfg;
-static TaskHandle_t s_task;
+static int s_phase_saved_ms; // phase_offset_ms as stored in NVS, under s_lock
+static uint32_t s_boot_count; // this run's number, counted up in NVS by cam_uploader_init()
+static TaskHandle_t s_capture_task;
+static TaskHandle_t s_upload_task;
+static frame_queue_t s_frame_queue;
+static frame_spool_t s_spool;
+// On-demand captures, under s_lock: the first request not captured yet (0 = none) and whether the
+// uploader is sending, in which case the capture waits for it to finish.
+static int64_t s_trigger_us;
+static bool s_upload_busy;
+static capture_sched_t s_sched;
+// DC-only decoder scratch for every analysis below; they all run one after another on the capture task.
+static jpeg_dc_decoder_t s_jpeg_dec;
+static change_detect_t s_change; // capture task only; stats are copied into s_stats
+static frame_dedup_t s_dedup;     // likewise
+static roi_stats_t s_roi;         // likewise
+static frame_quality_t s_gate;    // likewise
+static exposure_settle_t s_settle; // likewise
+static tile_diff_t s_tiles;       // likewise
+// Set by the uploader when frames may not have reached the collector, so the next one is a keyframe.
+static volatile bool s_tile_resync;
+// Pre-event buffer; capture task only except for the trigger flags.
+static preroll_ring_t s_preroll;
+static uint8_t *s_preroll_mem;
+// Frames of the last burst, held until the queue has room for them. Capture task only.
+static struct {
+    cam_frame_t *frames[CAM_UPLOADER_MAX_BURST_FRAMES];
+    uint8_t count;
+    uint8_t next; // first frame not yet handed to the uploader
+    uint32_t id;
+} s_burst;
+static size_t s_preroll_requested; // size configured; the allocation is retried only when it changes
+static change_detect_t s_event_change;
+static volatile uint32_t s_event_sources; // 1 << cam_uploader_event_source_t per pending trigger
+static int s_event_gpio = -1;             // input the trigger interrupt is attached to
+static quality_ctrl_t s_quality;
+// Frame size the camera buffer was allocated for; larger sizes need a re-init.
+static framesize_t s_camera_frame_size;
+// Frame buffers the camera was initialized for (camera_fb_count()), whether or not the driver managed them.
+static int s_camera_fb_wanted;
+// Sensor settings last applied by the capture task.
+static int s_applied_quality;
+static framesize_t s_applied_frame_size;
+static int s_applied_window = WINDOW_CYCLE_FULL; // preset index the sensor is programmed with
+static window_preset_t s_applied_preset; // its settings; empty name for the normal frame size
 static bool s_wifi_connected;
 static bool s_camera_inited;
+static cam_uploader_stats_t s_stats;
 
 static int hex_nibble(char c)
 {
@@ -465,6 +681,29 @@ static void cfg_set_defaults(cam_uploader_config_t *cfg)
 {
     memset(cfg, 0, sizeof(*cfg));
     cfg->interval_sec = 60;
+    cfg->missed_slot_policy = CAPTURE_SCHED_MISSED_SKIP;
+    cfg->phase_offset_ms = CAM_UPLOADER_PHASE_FROM_MAC;
+    cfg->change_heartbeat = 10;
+    cfg->veg_jpeg_every = 10;
+    cfg->gate_retries = 2;
+    cfg->settle_max_ms = 1500;
+    cfg->preroll_sec = 10;
+    cfg->postroll_sec = 5;
+    cfg->preroll_kb = 64;
+    cfg->event_gpio = -1;
+    cfg->burst_frames = 0;
+    cfg->frame_size = FRAMESIZE_QVGA;
+    cfg->jpeg_quality = 12;
+    cfg->adapt_quality_worst = 30;
+    cfg->adapt_frame_size_min = FRAMESIZE_QQVGA;
+    cfg->queue_drop_policy = FRAME_QUEUE_DROP_OLDEST;
+    cfg->batch_frames = 1;
+    cfg->batch_window_sec = 300;
+    cfg->spool_drain_per_min = 6;
+    cfg->spool_failed_uploads = true;
+    cfg->retry_attempts = 3;
+    cfg->breaker_failures = 5;
+    cfg->breaker_cooldown_sec = 60;
     cfg->url[0] = '\0';
     cfg->voltage_url[0] = '\0';
 }
@@ -503,6 +742,279 @@ static esp_err_t nvs_load_cfg(cam_uploader_config_t *cfg)
         cfg->interval_sec = (int)interval;
     }
 
+    int32_t align = 0;
+    err = nvs_get_i32(h, NVS_KEY_ALIGN, &align);
+    if (err == ESP_OK) {
+        cfg->align_to_wall_clock = align != 0;
+    }
+
+    int32_t missed = 0;
+    err = nvs_get_i32(h, NVS_KEY_MISSED_SLOT, &missed);
+    if (err == ESP_OK && (missed == CAPTURE_SCHED_MISSED_SKIP || missed == CAPTURE_SCHED_MISSED_CATCH_UP)) {
+        cfg->missed_slot_policy = (int)missed;
+    }
+
+    int32_t phase = 0;
+    err = nvs_get_i32(h, NVS_KEY_PHASE, &phase);
+    if (err == ESP_OK && phase >= CAM_UPLOADER_PHASE_FROM_MAC) {
+        cfg->phase_offset_ms = (int)phase;
+    }
+
+    int32_t phase_jitter = 0;
+    err = nvs_get_i32(h, NVS_KEY_PHASE_JITTER, &phase_jitter);
+    if (err == ESP_OK && phase_jitter >= 0 && phase_jitter <= UPLOADER_MAX_PHASE_JITTER_MS) {
+        cfg->phase_jitter_ms = (int)phase_jitter;
+    }
+
+    int32_t frame_size = 0;
+    err = nvs_get_i32(h, NVS_KEY_FRAME_SIZE, &frame_size);
+    if (err == ESP_OK && frame_size >= 0 && frame_size <= UPLOADER_MAX_FRAME_SIZE) {
+        cfg->frame_size = (int)frame_size;
+    }
+
+    int32_t quality = 0;
+    err = nvs_get_i32(h, NVS_KEY_JPEG_QUALITY, &quality);
+    if (err == ESP_OK && quality >= UPLOADER_MIN_JPEG_QUALITY && quality <= UPLOADER_MAX_JPEG_QUALITY) {
+        cfg->jpeg_quality = (int)quality;
+    }
+
+    int32_t adapt_ms = 0;
+    err = nvs_get_i32(h, NVS_KEY_ADAPT_MS, &adapt_ms);
+    if (err == ESP_OK && adapt_ms >= 0) {
+        cfg->adapt_target_ms = (int)adapt_ms;
+    }
+
+    int32_t adapt_kb = 0;
+    err = nvs_get_i32(h, NVS_KEY_ADAPT_KB, &adapt_kb);
+    if (err == ESP_OK && adapt_kb >= 0) {
+        cfg->adapt_target_kb = (int)adapt_kb;
+    }
+
+    int32_t quality_worst = 0;
+    err = nvs_get_i32(h, NVS_KEY_ADAPT_QUALITY_WORST, &quality_worst);
+    if (err == ESP_OK && quality_worst >= UPLOADER_MIN_JPEG_QUALITY && quality_worst <= UPLOADER_MAX_JPEG_QUALITY) {
+        cfg->adapt_quality_worst = (int)quality_worst;
+    }
+
+    int32_t frame_size_min = 0;
+    err = nvs_get_i32(h, NVS_KEY_ADAPT_FRAME_SIZE_MIN, &frame_size_min);
+    if (err == ESP_OK && frame_size_min >= 0 && frame_size_min <= UPLOADER_MAX_FRAME_SIZE) {
+        cfg->adapt_frame_size_min = (int)frame_size_min;
+    }
+
+    int32_t drop_policy = 0;
+    err = nvs_get_i32(h, NVS_KEY_QUEUE_DROP, &drop_policy);
+    if (err == ESP_OK && (drop_policy == FRAME_QUEUE_DROP_OLDEST || drop_policy == FRAME_QUEUE_DROP_NEWEST)) {
+        cfg->queue_drop_policy = (int)drop_policy;
+    }
+
+    int32_t chunked = 0;
+    err = nvs_get_i32(h, NVS_KEY_CHUNKED, &chunked);
+    if (err == ESP_OK) {
+        cfg->upload_chunked = chunked != 0;
+    }
+
+    int32_t combined = 0;
+    err = nvs_get_i32(h, NVS_KEY_COMBINED, &combined);
+    if (err == ESP_OK) {
+        cfg->combined_upload = combined != 0;
+    }
+
+    int32_t batch_frames = 0;
+    err = nvs_get_i32(h, NVS_KEY_BATCH_FRAMES, &batch_frames);
+    if (err == ESP_OK && batch_frames >= 1 && batch_frames <= UPLOADER_MAX_BATCH_FRAMES) {
+        cfg->batch_frames = (int)batch_frames;
+    }
+
+    int32_t batch_window = 0;
+    err = nvs_get_i32(h, NVS_KEY_BATCH_WINDOW, &batch_window);
+    if (err == ESP_OK && batch_window > 0) {
+        cfg->batch_window_sec = (int)batch_window;
+    }
+
+    int32_t spool_rate = 0;
+    err = nvs_get_i32(h, NVS_KEY_SPOOL_RATE, &spool_rate);
+    if (err == ESP_OK && spool_rate >= 0 && spool_rate <= UPLOADER_MAX_SPOOL_DRAIN_PER_MIN) {
+        cfg->spool_drain_per_min = (int)spool_rate;
+    }
+
+    int32_t spool_failed = 0;
+    err = nvs_get_i32(h, NVS_KEY_SPOOL_FAILED, &spool_failed);
+    if (err == ESP_OK) {
+        cfg->spool_failed_uploads = spool_failed != 0;
+    }
+
+    int32_t retry_attempts = 0;
+    err = nvs_get_i32(h, NVS_KEY_RETRY_ATTEMPTS, &retry_attempts);
+    if (err == ESP_OK && retry_attempts >= 1 && retry_attempts <= UPLOADER_MAX_RETRY_ATTEMPTS) {
+        cfg->retry_attempts = (int)retry_attempts;
+    }
+
+    int32_t breaker_failures = 0;
+    err = nvs_get_i32(h, NVS_KEY_BREAKER_FAILURES, &breaker_failures);
+    if (err == ESP_OK && breaker_failures >= 0) {
+        cfg->breaker_failures = (int)breaker_failures;
+    }
+
+    int32_t breaker_cooldown = 0;
+    err = nvs_get_i32(h, NVS_KEY_BREAKER_COOLDOWN, &breaker_cooldown);
+    if (err == ESP_OK && breaker_cooldown >= 1 && breaker_cooldown <= UPLOADER_BREAKER_MAX_OPEN_SEC) {
+        cfg->breaker_cooldown_sec = (int)breaker_cooldown;
+    }
+
+    int32_t preconnect_lead = 0;
+    err = nvs_get_i32(h, NVS_KEY_PRECONNECT_LEAD, &preconnect_lead);
+    if (err == ESP_OK && preconnect_lead >= 0 && preconnect_lead <= UPLOADER_MAX_PRECONNECT_LEAD_MS) {
+        cfg->preconnect_lead_ms = (int)preconnect_lead;
+    }
+
+    int32_t change_threshold = 0;
+    err = nvs_get_i32(h, NVS_KEY_CHANGE_THRESHOLD, &change_threshold);
+    if (err == ESP_OK && change_threshold >= 0 && change_threshold <= 1000) {
+        cfg->change_threshold_permille = (int)change_threshold;
+    }
+
+    int32_t change_heartbeat = 0;
+    err = nvs_get_i32(h, NVS_KEY_CHANGE_HEARTBEAT, &change_heartbeat);
+    if (err == ESP_OK && change_heartbeat >= 1 && change_heartbeat <= UPLOADER_MAX_CHANGE_HEARTBEAT) {
+        cfg->change_heartbeat = (int)change_heartbeat;
+    }
+
+    int32_t dedup_mode = 0;
+    err = nvs_get_i32(h, NVS_KEY_DEDUP_MODE, &dedup_mode);
+    if (err == ESP_OK && dedup_mode >= FRAME_DEDUP_OFF && dedup_mode <= FRAME_DEDUP_SKIP) {
+        cfg->dedup_mode = (int)dedup_mode;
+    }
+
+    int32_t capture_mode = 0;
+    err = nvs_get_i32(h, NVS_KEY_CAPTURE_MODE, &capture_mode);
+    if (err == ESP_OK && capture_mode >= CAM_UPLOADER_MODE_JPEG && capture_mode <= CAM_UPLOADER_MODE_VEG_INDEX) {
+        cfg->capture_mode = (int)capture_mode;
+    }
+
+    int32_t veg_jpeg_every = 0;
+    err = nvs_get_i32(h, NVS_KEY_VEG_JPEG_EVERY, &veg_jpeg_every);
+    if (err == ESP_OK && veg_jpeg_every >= 0 && veg_jpeg_every <= UPLOADER_MAX_VEG_JPEG_EVERY) {
+        cfg->veg_jpeg_every = (int)veg_jpeg_every;
+    }
+
+    uint8_t regions[ROI_LIST_ENCODED_MAX];
+    size_t regions_len = sizeof(regions);
+    err = nvs_get_blob(h, NVS_KEY_REGIONS, regions, &regions_len);
+    if (err == ESP_OK && !roi_list_decode(regions, regions_len, &cfg->regions)) {
+        memset(&cfg->regions, 0, sizeof(cfg->regions));
+    }
+
+    int32_t gate_min_luma = 0;
+    err = nvs_get_i32(h, NVS_KEY_GATE_MIN_LUMA, &gate_min_luma);
+    if (err == ESP_OK && gate_min_luma >= 0 && gate_min_luma <= 255) {
+        cfg->gate_min_luma = (int)gate_min_luma;
+    }
+
+    int32_t gate_max_clip = 0;
+    err = nvs_get_i32(h, NVS_KEY_GATE_MAX_CLIP, &gate_max_clip);
+    if (err == ESP_OK && gate_max_clip >= 0 && gate_max_clip <= 1000) {
+        cfg->gate_max_clip_permille = (int)gate_max_clip;
+    }
+
+    int32_t gate_min_sharpness = 0;
+    err = nvs_get_i32(h, NVS_KEY_GATE_MIN_SHARPNESS, &gate_min_sharpness);
+    if (err == ESP_OK && gate_min_sharpness >= 0 && gate_min_sharpness <= UPLOADER_MAX_GATE_SHARPNESS) {
+        cfg->gate_min_sharpness = (int)gate_min_sharpness;
+    }
+
+    int32_t gate_retries = 0;
+    err = nvs_get_i32(h, NVS_KEY_GATE_RETRIES, &gate_retries);
+    if (err == ESP_OK && gate_retries >= 0 && gate_retries <= UPLOADER_MAX_GATE_RETRIES) {
+        cfg->gate_retries = (int)gate_retries;
+    }
+
+    int32_t fresh_max_age = 0;
+    err = nvs_get_i32(h, NVS_KEY_FRESH_MAX_AGE, &fresh_max_age);
+    if (err == ESP_OK && fresh_max_age >= 0 && fresh_max_age <= UPLOADER_MAX_FRESH_AGE_MS) {
+        cfg->fresh_max_age_ms = (int)fresh_max_age;
+    }
+
+    int32_t settle_frames = 0;
+    err = nvs_get_i32(h, NVS_KEY_SETTLE_FRAMES, &settle_frames);
+    if (err == ESP_OK && settle_frames >= 0 && settle_frames <= UPLOADER_MAX_SETTLE_FRAMES) {
+        cfg->settle_max_frames = (int)settle_frames;
+    }
+
+    int32_t settle_ms = 0;
+    err = nvs_get_i32(h, NVS_KEY_SETTLE_MS, &settle_ms);
+    if (err == ESP_OK && settle_ms >= 0 && settle_ms <= UPLOADER_MAX_SETTLE_MS) {
+        cfg->settle_max_ms = (int)settle_ms;
+    }
+
+    uint8_t presets[WINDOW_PRESET_LIST_ENCODED_MAX];
+    size_t presets_len = sizeof(presets);
+    err = nvs_get_blob(h, NVS_KEY_WINDOW_PRESETS, presets, &presets_len);
+    if (err == ESP_OK && !window_preset_list_decode(presets, presets_len, &cfg->window_presets)) {
+        memset(&cfg->window_presets, 0, sizeof(cfg->window_presets));
+    }
+
+    int32_t tile_every = 0;
+    err = nvs_get_i32(h, NVS_KEY_TILE_KEYFRAME_EVERY, &tile_every);
+    if (err == ESP_OK && tile_every >= 0 && tile_every <= UPLOADER_MAX_TILE_KEYFRAME_EVERY) {
+        cfg->tile_keyframe_every = (int)tile_every;
+    }
+
+    int32_t preroll_ms = 0;
+    err = nvs_get_i32(h, NVS_KEY_PREROLL_INTERVAL, &preroll_ms);
+    if (err == ESP_OK && preroll_ms >= 0 && preroll_ms <= UPLOADER_MAX_PREROLL_INTERVAL_MS) {
+        cfg->preroll_interval_ms = (int)preroll_ms;
+    }
+
+    int32_t preroll_sec = 0;
+    err = nvs_get_i32(h, NVS_KEY_PREROLL_SEC, &preroll_sec);
+    if (err == ESP_OK && preroll_sec >= 0 && preroll_sec <= UPLOADER_MAX_PREROLL_SEC) {
+        cfg->preroll_sec = (int)preroll_sec;
+    }
+
+    int32_t postroll_sec = 0;
+    err = nvs_get_i32(h, NVS_KEY_POSTROLL_SEC, &postroll_sec);
+    if (err == ESP_OK && postroll_sec >= 0 && postroll_sec <= UPLOADER_MAX_PREROLL_SEC) {
+        cfg->postroll_sec = (int)postroll_sec;
+    }
+
+    int32_t preroll_kb = 0;
+    err = nvs_get_i32(h, NVS_KEY_PREROLL_KB, &preroll_kb);
+    if (err == ESP_OK && preroll_kb >= 1 && preroll_kb <= UPLOADER_MAX_PREROLL_KB) {
+        cfg->preroll_kb = (int)preroll_kb;
+    }
+
+    int32_t event_gpio = 0;
+    err = nvs_get_i32(h, NVS_KEY_EVENT_GPIO, &event_gpio);
+    if (err == ESP_OK && (event_gpio == -1 || GPIO_IS_VALID_GPIO(event_gpio))) {
+        cfg->event_gpio = (int)event_gpio;
+    }
+
+    int32_t event_change = 0;
+    err = nvs_get_i32(h, NVS_KEY_EVENT_CHANGE, &event_change);
+    if (err == ESP_OK && event_change >= 0 && event_change <= 1000) {
+        cfg->event_change_permille = (int)event_change;
+    }
+
+    int32_t burst_frames = 0;
+    err = nvs_get_i32(h, NVS_KEY_BURST_FRAMES, &burst_frames);
+    if (err == ESP_OK && burst_frames >= 0 && burst_frames <= CAM_UPLOADER_MAX_BURST_FRAMES) {
+        cfg->burst_frames = (int)burst_frames;
+    }
+
+    size_t cycle_len = sizeof(cfg->window_cycle);
+    window_cycle_t cycle;
+    err = nvs_get_str(h, NVS_KEY_WINDOW_CYCLE, cfg->window_cycle, &cycle_len);
+    if (err != ESP_OK || !window_cycle_parse(&cfg->window_presets, cfg->window_cycle, &cycle)) {
+        cfg->window_cycle[0] = '\0';
+    }
+
+    int32_t chunk_size = 0;
+    err = nvs_get_i32(h, NVS_KEY_CHUNK_SIZE, &chunk_size);
+    if (err == ESP_OK && chunk_size >= 0 && chunk_size <= UPLOADER_MAX_CHUNK_SIZE) {
+        cfg->upload_chunk_size = (int)chunk_size;
+    }
+
     nvs_close(h);
     return ESP_OK;
 }
@@ -522,13 +1034,188 @@ static esp_err_t nvs_save_cfg(const cam_uploader_config_t *cfg)
     if (err == ESP_OK) {
         err = nvs_set_i32(h, NVS_KEY_INTERVAL, (int32_t)cfg->interval_sec);
     }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_QUEUE_DROP, (int32_t)cfg->queue_drop_policy);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_ALIGN, cfg->align_to_wall_clock ? 1 : 0);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_MISSED_SLOT, (int32_t)cfg->missed_slot_policy);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_PHASE, (int32_t)cfg->phase_offset_ms);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_PHASE_JITTER, (int32_t)cfg->phase_jitter_ms);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_FRAME_SIZE, (int32_t)cfg->frame_size);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_JPEG_QUALITY, (int32_t)cfg->jpeg_quality);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_ADAPT_MS, (int32_t)cfg->adapt_target_ms);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_ADAPT_KB, (int32_t)cfg->adapt_target_kb);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_ADAPT_QUALITY_WORST, (int32_t)cfg->adapt_quality_worst);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_ADAPT_FRAME_SIZE_MIN, (int32_t)cfg->adapt_frame_size_min);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_CHUNKED, cfg->upload_chunked ? 1 : 0);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_CHUNK_SIZE, (int32_t)cfg->upload_chunk_size);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_COMBINED, cfg->combined_upload ? 1 : 0);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_BATCH_FRAMES, (int32_t)cfg->batch_frames);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_BATCH_WINDOW, (int32_t)cfg->batch_window_sec);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_SPOOL_RATE, (int32_t)cfg->spool_drain_per_min);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_SPOOL_FAILED, cfg->spool_failed_uploads ? 1 : 0);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_RETRY_ATTEMPTS, (int32_t)cfg->retry_attempts);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_BREAKER_FAILURES, (int32_t)cfg->breaker_failures);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_BREAKER_COOLDOWN, (int32_t)cfg->breaker_cooldown_sec);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_PRECONNECT_LEAD, (int32_t)cfg->preconnect_lead_ms);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_CHANGE_THRESHOLD, (int32_t)cfg->change_threshold_permille);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_CHANGE_HEARTBEAT, (int32_t)cfg->change_heartbeat);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_DEDUP_MODE, (int32_t)cfg->dedup_mode);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_CAPTURE_MODE, (int32_t)cfg->capture_mode);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_VEG_JPEG_EVERY, (int32_t)cfg->veg_jpeg_every);
+    }
+    if (err == ESP_OK) {
+        // A count byte plus one point count and x/y bytes per vertex: at most ROI_LIST_ENCODED_MAX bytes.
+        uint8_t regions[ROI_LIST_ENCODED_MAX];
+        size_t regions_len = roi_list_encode(&cfg->regions, regions, sizeof(regions));
+        err = regions_len > 0 ? nvs_set_blob(h, NVS_KEY_REGIONS, regions, regions_len) : ESP_ERR_INVALID_ARG;
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_GATE_MIN_LUMA, (int32_t)cfg->gate_min_luma);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_GATE_MAX_CLIP, (int32_t)cfg->gate_max_clip_permille);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_GATE_MIN_SHARPNESS, (int32_t)cfg->gate_min_sharpness);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_GATE_RETRIES, (int32_t)cfg->gate_retries);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_FRESH_MAX_AGE, (int32_t)cfg->fresh_max_age_ms);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_SETTLE_FRAMES, (int32_t)cfg->settle_max_frames);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_SETTLE_MS, (int32_t)cfg->settle_max_ms);
+    }
+    if (err == ESP_OK) {
+        uint8_t presets[WINDOW_PRESET_LIST_ENCODED_MAX];
+        size_t presets_len = window_preset_list_encode(&cfg->window_presets, presets, sizeof(presets));
+        err = presets_len > 0 ? nvs_set_blob(h, NVS_KEY_WINDOW_PRESETS, presets, presets_len) : ESP_ERR_INVALID_ARG;
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_str(h, NVS_KEY_WINDOW_CYCLE, cfg->window_cycle);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_TILE_KEYFRAME_EVERY, (int32_t)cfg->tile_keyframe_every);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_PREROLL_INTERVAL, (int32_t)cfg->preroll_interval_ms);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_PREROLL_SEC, (int32_t)cfg->preroll_sec);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_POSTROLL_SEC, (int32_t)cfg->postroll_sec);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_PREROLL_KB, (int32_t)cfg->preroll_kb);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_EVENT_GPIO, (int32_t)cfg->event_gpio);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_EVENT_CHANGE, (int32_t)cfg->event_change_permille);
+    }
+    if (err == ESP_OK) {
+        err = nvs_set_i32(h, NVS_KEY_BURST_FRAMES, (int32_t)cfg->burst_frames);
+    }
+    if (err == ESP_OK) {
+        err = nvs_commit(h);
+    }
+    nvs_close(h);
+    return err;
+}
+
+// Count this boot in NVS; frames carry the number so those spooled by an earlier run stay apart.
+static esp_err_t nvs_count_boot(uint32_t *out_boot)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        return err;
+    }
+    uint32_t boot = 0;
+    err = nvs_get_u32(h, NVS_KEY_BOOT_COUNT, &boot);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    if (err == ESP_OK) {
+        boot++;
+        err = nvs_set_u32(h, NVS_KEY_BOOT_COUNT, boot);
+    }
     if (err == ESP_OK) {
         err = nvs_commit(h);
     }
     nvs_close(h);
+    *out_boot = boot;
     return err;
 }
 
+static void quality_bounds_from_cfg(const cam_uploader_config_t *cfg, quality_ctrl_bounds_t *bounds)
+{
+    bounds->target_ms = cfg->adapt_target_ms;
+    bounds->target_bytes = cfg->adapt_target_kb * 1024;
+    bounds->quality_best = cfg->jpeg_quality;
+    bounds->quality_worst = cfg->adapt_quality_worst;
+    bounds->framesize_max = (framesize_t)cfg->frame_size;
+    bounds->framesize_min = (framesize_t)cfg->adapt_frame_size_min;
+}
+
 esp_err_t cam_uploader_init(void)
 {
     if (!s_lock) {
@@ -543,8 +1230,20 @@ esp_err_t cam_uploader_init(void)
 
     xSemaphoreTake(s_lock, portMAX_DELAY);
     s_cfg = cfg;
+    s_phase_saved_ms = cfg.phase_offset_ms;
     xSemaphoreGive(s_lock);
 
+    if (s_boot_count == 0) {
+        esp_err_t err = nvs_count_boot(&s_boot_count);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "boot counter not saved: %s", esp_err_to_name(err));
+        }
+    }
+
+    quality_ctrl_bounds_t bounds;
+    quality_bounds_from_cfg(&cfg, &bounds);
+    quality_ctrl_init(&s_quality, &bounds);
+
     return ESP_OK;
 }
 
@@ -573,48 +1272,308 @@ esp_err_t cam_uploader_set_config(const cam_uploader_config_t *cfg)
     if (cleaned.interval_sec < 1) {
         cleaned.interval_sec = 1;
     }
-
-    ESP_RETURN_ON_ERROR(nvs_save_cfg(&cleaned), TAG, "nvs_save_cfg failed");
-
-    xSemaphoreTake(s_lock, portMAX_DELAY);
-    s_cfg = cleaned;
-    xSemaphoreGive(s_lock);
-
-    if (s_task) {
-        xTaskNotifyGive(s_task);
+    if (cleaned.missed_slot_policy != CAPTURE_SCHED_MISSED_CATCH_UP) {
+        cleaned.missed_slot_policy = CAPTURE_SCHED_MISSED_SKIP;
     }
-
-    return ESP_OK;
-}
-
-void cam_uploader_set_wifi_connected(bool connected)
-{
-    s_wifi_connected = connected;
-    if (s_task) {
-        xTaskNotifyGive(s_task);
+    if (cleaned.phase_offset_ms < CAM_UPLOADER_PHASE_FROM_MAC) {
+        cleaned.phase_offset_ms = CAM_UPLOADER_PHASE_FROM_MAC;
     }
-}
-
-esp_err_t cam_uploader_camera_init(void)
-{
-    if (s_camera_inited) {
-        return ESP_OK;
+    if (cleaned.phase_jitter_ms < 0) {
+        cleaned.phase_jitter_ms = 0;
+    } else if (cleaned.phase_jitter_ms > UPLOADER_MAX_PHASE_JITTER_MS) {
+        cleaned.phase_jitter_ms = UPLOADER_MAX_PHASE_JITTER_MS;
     }
-
-    esp_err_t last_err = ESP_FAIL;
-    for (size_t i = 0; i < (sizeof(s_cam_model_try_list) / sizeof(s_cam_model_try_list[0])); i++) {
-        const cam_model_pins_t *m = &s_cam_model_try_list[i];
-
-        camera_config_t config = {
-            .ledc_channel = LEDC_CHANNEL_0,
-            .ledc_timer = LEDC_TIMER_0,
-            .pin_d0 = m->pin_d0,
-            .pin_d1 = m->pin_d1,
-            .pin_d2 = m->pin_d2,
-            .pin_d3 = m->pin_d3,
-            .pin_d4 = m->pin_d4,
-            .pin_d5 = m->pin_d5,
-            .pin_d6 = m->pin_d6,
+    if (cleaned.frame_size < 0 || cleaned.frame_size > UPLOADER_MAX_FRAME_SIZE) {
+        cleaned.frame_size = UPLOADER_MAX_FRAME_SIZE;
+    }
+    if (cleaned.adapt_frame_size_min < 0 || cleaned.adapt_frame_size_min > cleaned.frame_size) {
+        cleaned.adapt_frame_size_min = cleaned.frame_size;
+    }
+    if (cleaned.jpeg_quality < UPLOADER_MIN_JPEG_QUALITY) {
+        cleaned.jpeg_quality = UPLOADER_MIN_JPEG_QUALITY;
+    } else if (cleaned.jpeg_quality > UPLOADER_MAX_JPEG_QUALITY) {
+        cleaned.jpeg_quality = UPLOADER_MAX_JPEG_QUALITY;
+    }
+    if (cleaned.adapt_quality_worst < cleaned.jpeg_quality) {
+        cleaned.adapt_quality_worst = cleaned.jpeg_quality;
+    } else if (cleaned.adapt_quality_worst > UPLOADER_MAX_JPEG_QUALITY) {
+        cleaned.adapt_quality_worst = UPLOADER_MAX_JPEG_QUALITY;
+    }
+    if (cleaned.adapt_target_ms < 0) {
+        cleaned.adapt_target_ms = 0;
+    }
+    if (cleaned.adapt_target_kb < 0) {
+        cleaned.adapt_target_kb = 0;
+    }
+    if (cleaned.queue_drop_policy != FRAME_QUEUE_DROP_NEWEST) {
+        cleaned.queue_drop_policy = FRAME_QUEUE_DROP_OLDEST;
+    }
+    if (cleaned.batch_frames < 1) {
+        cleaned.batch_frames = 1;
+    } else if (cleaned.batch_frames > UPLOADER_MAX_BATCH_FRAMES) {
+        cleaned.batch_frames = UPLOADER_MAX_BATCH_FRAMES;
+    }
+    if (cleaned.batch_window_sec < 1) {
+        cleaned.batch_window_sec = 1;
+    }
+    if (cleaned.spool_drain_per_min < 0) {
+        cleaned.spool_drain_per_min = 0;
+    } else if (cleaned.spool_drain_per_min > UPLOADER_MAX_SPOOL_DRAIN_PER_MIN) {
+        cleaned.spool_drain_per_min = UPLOADER_MAX_SPOOL_DRAIN_PER_MIN;
+    }
+    if (cleaned.retry_attempts < 1) {
+        cleaned.retry_attempts = 1;
+    } else if (cleaned.retry_attempts > UPLOADER_MAX_RETRY_ATTEMPTS) {
+        cleaned.retry_attempts = UPLOADER_MAX_RETRY_ATTEMPTS;
+    }
+    if (cleaned.breaker_failures < 0) {
+        cleaned.breaker_failures = 0;
+    }
+    if (cleaned.breaker_cooldown_sec < 1) {
+        cleaned.breaker_cooldown_sec = 1;
+    } else if (cleaned.breaker_cooldown_sec > UPLOADER_BREAKER_MAX_OPEN_SEC) {
+        cleaned.breaker_cooldown_sec = UPLOADER_BREAKER_MAX_OPEN_SEC;
+    }
+    if (cleaned.preconnect_lead_ms < 0) {
+        cleaned.preconnect_lead_ms = 0;
+    } else if (cleaned.preconnect_lead_ms > UPLOADER_MAX_PRECONNECT_LEAD_MS) {
+        cleaned.preconnect_lead_ms = UPLOADER_MAX_PRECONNECT_LEAD_MS;
+    }
+    if (cleaned.change_threshold_permille < 0) {
+        cleaned.change_threshold_permille = 0;
+    } else if (cleaned.change_threshold_permille > 1000) {
+        cleaned.change_threshold_permille = 1000;
+    }
+    if (cleaned.change_heartbeat < 1) {
+        cleaned.change_heartbeat = 1;
+    } else if (cleaned.change_heartbeat > UPLOADER_MAX_CHANGE_HEARTBEAT) {
+        cleaned.change_heartbeat = UPLOADER_MAX_CHANGE_HEARTBEAT;
+    }
+    if (cleaned.dedup_mode < FRAME_DEDUP_OFF || cleaned.dedup_mode > FRAME_DEDUP_SKIP) {
+        cleaned.dedup_mode = FRAME_DEDUP_OFF;
+    }
+    if (cleaned.capture_mode != CAM_UPLOADER_MODE_VEG_INDEX) {
+        cleaned.capture_mode = CAM_UPLOADER_MODE_JPEG;
+    }
+    if (cleaned.veg_jpeg_every < 0) {
+        cleaned.veg_jpeg_every = 0;
+    } else if (cleaned.veg_jpeg_every > UPLOADER_MAX_VEG_JPEG_EVERY) {
+        cleaned.veg_jpeg_every = UPLOADER_MAX_VEG_JPEG_EVERY;
+    }
+    uint8_t regions[ROI_LIST_ENCODED_MAX];
+    size_t regions_len = roi_list_encode(&cleaned.regions, regions, sizeof(regions));
+    if (regions_len == 0 || !roi_list_decode(regions, regions_len, &cleaned.regions)) {
+        memset(&cleaned.regions, 0, sizeof(cleaned.regions));
+    }
+    if (cleaned.gate_min_luma < 0) {
+        cleaned.gate_min_luma = 0;
+    } else if (cleaned.gate_min_luma > 255) {
+        cleaned.gate_min_luma = 255;
+    }
+    if (cleaned.gate_max_clip_permille < 0) {
+        cleaned.gate_max_clip_permille = 0;
+    } else if (cleaned.gate_max_clip_permille > 1000) {
+        cleaned.gate_max_clip_permille = 1000;
+    }
+    if (cleaned.gate_min_sharpness < 0) {
+        cleaned.gate_min_sharpness = 0;
+    } else if (cleaned.gate_min_sharpness > UPLOADER_MAX_GATE_SHARPNESS) {
+        cleaned.gate_min_sharpness = UPLOADER_MAX_GATE_SHARPNESS;
+    }
+    if (cleaned.gate_retries < 0) {
+        cleaned.gate_retries = 0;
+    } else if (cleaned.gate_retries > UPLOADER_MAX_GATE_RETRIES) {
+        cleaned.gate_retries = UPLOADER_MAX_GATE_RETRIES;
+    }
+    if (cleaned.fresh_max_age_ms < 0) {
+        cleaned.fresh_max_age_ms = 0;
+    } else if (cleaned.fresh_max_age_ms > UPLOADER_MAX_FRESH_AGE_MS) {
+        cleaned.fresh_max_age_ms = UPLOADER_MAX_FRESH_AGE_MS;
+    }
+    if (cleaned.settle_max_frames < 0) {
+        cleaned.settle_max_frames = 0;
+    } else if (cleaned.settle_max_frames > UPLOADER_MAX_SETTLE_FRAMES) {
+        cleaned.settle_max_frames = UPLOADER_MAX_SETTLE_FRAMES;
+    }
+    if (cleaned.settle_max_ms < 0) {
+        cleaned.settle_max_ms = 0;
+    } else if (cleaned.settle_max_ms > UPLOADER_MAX_SETTLE_MS) {
+        cleaned.settle_max_ms = UPLOADER_MAX_SETTLE_MS;
+    }
+    uint8_t presets[WINDOW_PRESET_LIST_ENCODED_MAX];
+    size_t presets_len = window_preset_list_encode(&cleaned.window_presets, presets, sizeof(presets));
+    if (presets_len == 0 || !window_preset_list_decode(presets, presets_len, &cleaned.window_presets)) {
+        memset(&cleaned.window_presets, 0, sizeof(cleaned.window_presets));
+    }
+    cleaned.window_cycle[sizeof(cleaned.window_cycle) - 1] = '\0';
+    window_cycle_t cycle;
+    if (!window_cycle_parse(&cleaned.window_presets, cleaned.window_cycle, &cycle)) {
+        cleaned.window_cycle[0] = '\0';
+    }
+    if (cleaned.tile_keyframe_every < 0) {
+        cleaned.tile_keyframe_every = 0;
+    } else if (cleaned.tile_keyframe_every > UPLOADER_MAX_TILE_KEYFRAME_EVERY) {
+        cleaned.tile_keyframe_every = UPLOADER_MAX_TILE_KEYFRAME_EVERY;
+    }
+    if (cleaned.preroll_interval_ms < 0) {
+        cleaned.preroll_interval_ms = 0;
+    } else if (cleaned.preroll_interval_ms > UPLOADER_MAX_PREROLL_INTERVAL_MS) {
+        cleaned.preroll_interval_ms = UPLOADER_MAX_PREROLL_INTERVAL_MS;
+    }
+    if (cleaned.preroll_sec < 0) {
+        cleaned.preroll_sec = 0;
+    } else if (cleaned.preroll_sec > UPLOADER_MAX_PREROLL_SEC) {
+        cleaned.preroll_sec = UPLOADER_MAX_PREROLL_SEC;
+    }
+    if (cleaned.postroll_sec < 0) {
+        cleaned.postroll_sec = 0;
+    } else if (cleaned.postroll_sec > UPLOADER_MAX_PREROLL_SEC) {
+        cleaned.postroll_sec = UPLOADER_MAX_PREROLL_SEC;
+    }
+    if (cleaned.preroll_kb < 1) {
+        cleaned.preroll_kb = 1;
+    } else if (cleaned.preroll_kb > UPLOADER_MAX_PREROLL_KB) {
+        cleaned.preroll_kb = UPLOADER_MAX_PREROLL_KB;
+    }
+    if (cleaned.event_gpio != -1 && !GPIO_IS_VALID_GPIO(cleaned.event_gpio)) {
+        cleaned.event_gpio = -1;
+    }
+    if (cleaned.event_change_permille < 0) {
+        cleaned.event_change_permille = 0;
+    } else if (cleaned.event_change_permille > 1000) {
+        cleaned.event_change_permille = 1000;
+    }
+    if (cleaned.burst_frames < 0) {
+        cleaned.burst_frames = 0;
+    } else if (cleaned.burst_frames > CAM_UPLOADER_MAX_BURST_FRAMES) {
+        cleaned.burst_frames = CAM_UPLOADER_MAX_BURST_FRAMES;
+    }
+    if (cleaned.upload_chunk_size < 0) {
+        cleaned.upload_chunk_size = 0;
+    } else if (cleaned.upload_chunk_size > UPLOADER_MAX_CHUNK_SIZE) {
+        cleaned.upload_chunk_size = UPLOADER_MAX_CHUNK_SIZE;
+    }
+
+    ESP_RETURN_ON_ERROR(nvs_save_cfg(&cleaned), TAG, "nvs_save_cfg failed");
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_cfg = cleaned;
+    s_phase_saved_ms = cleaned.phase_offset_ms;
+    xSemaphoreGive(s_lock);
+
+    quality_ctrl_bounds_t bounds;
+    quality_bounds_from_cfg(&cleaned, &bounds);
+    quality_ctrl_configure(&s_quality, &bounds);
+    if (s_camera_inited && cleaned.frame_size > (int)s_camera_frame_size) {
+        ESP_LOGW(TAG, "frame size %d exceeds the camera buffer (%d) until reboot", cleaned.frame_size,
+                 (int)s_camera_frame_size);
+    }
+
+    if (s_capture_task) {
+        xTaskNotify(s_capture_task, CAPTURE_NOTIFY_CONFIG, eSetBits);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t cam_uploader_get_stats(cam_uploader_stats_t *out_stats)
+{
+    if (!out_stats || !s_lock) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out_stats = s_stats;
+    xSemaphoreGive(s_lock);
+    out_stats->queue = s_frame_queue.stats;
+    out_stats->queued = (uint32_t)frame_queue_count(&s_frame_queue);
+    capture_sched_get_stats(&s_sched, &out_stats->sched);
+    quality_ctrl_get_stats(&s_quality, &out_stats->quality);
+    frame_spool_get_stats(&s_spool, &out_stats->spool);
+    out_stats->spool_pending = (uint32_t)frame_spool_pending(&s_spool);
+    return ESP_OK;
+}
+
+esp_err_t cam_uploader_trigger_event(cam_uploader_event_source_t source)
+{
+    if ((int)source < 0 || source >= CAM_UPLOADER_EVENT_SOURCES || !s_lock) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool enabled = s_cfg.preroll_interval_ms > 0 && s_cfg.url[0] != '\0' && s_stats.preroll_budget > 0;
+    xSemaphoreGive(s_lock);
+    if (!enabled || !s_capture_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    __atomic_fetch_or(&s_event_sources, 1u << source, __ATOMIC_RELAXED);
+    xTaskNotify(s_capture_task, CAPTURE_NOTIFY_EVENT, eSetBits);
+    return ESP_OK;
+}
+
+esp_err_t cam_uploader_trigger_capture(bool *out_coalesced)
+{
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool enabled = s_cfg.url[0] != '\0' && s_capture_task;
+    bool coalesced = enabled && s_trigger_us != 0;
+    bool notify = enabled && !coalesced && !s_upload_busy;
+    if (enabled) {
+        s_stats.triggers++;
+        s_stats.triggers_coalesced += coalesced ? 1 : 0;
+        if (!coalesced) {
+            s_trigger_us = esp_timer_get_time();
+        }
+    }
+    xSemaphoreGive(s_lock);
+    if (!enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (notify) {
+        xTaskNotify(s_capture_task, CAPTURE_NOTIFY_TRIGGER, eSetBits);
+    }
+    if (out_coalesced) {
+        *out_coalesced = coalesced;
+    }
+    return ESP_OK;
+}
+
+void cam_uploader_set_wifi_connected(bool connected)
+{
+    s_wifi_connected = connected;
+    if (s_upload_task) {
+        xTaskNotifyGive(s_upload_task);
+    }
+}
+
+// Frame buffers the driver should run with: one unless bursts need the sensor to keep going
+// while the previous frame is copied out.
+static int camera_fb_count(const cam_uploader_config_t *cfg)
+{
+#if CONFIG_SPIRAM
+    return cfg->burst_frames > 1 ? UPLOADER_BURST_FB_COUNT : 2;
+#else
+    return cfg->burst_frames > 1 ? UPLOADER_BURST_FB_COUNT : 1;
+#endif
+}
+
+static esp_err_t camera_init_models(const cam_uploader_config_t *cfg, int quality, framesize_t frame_size,
+                                    int fb_count)
+{
+    esp_err_t last_err = ESP_FAIL;
+    for (size_t i = 0; i < (sizeof(s_cam_model_try_list) / sizeof(s_cam_model_try_list[0])); i++) {
+        const cam_model_pins_t *m = &s_cam_model_try_list[i];
+
+        camera_config_t config = {
+            .ledc_channel = LEDC_CHANNEL_0,
+            .ledc_timer = LEDC_TIMER_0,
+            .pin_d0 = m->pin_d0,
+            .pin_d1 = m->pin_d1,
+            .pin_d2 = m->pin_d2,
+            .pin_d3 = m->pin_d3,
+            .pin_d4 = m->pin_d4,
+            .pin_d5 = m->pin_d5,
+            .pin_d6 = m->pin_d6,
             .pin_d7 = m->pin_d7,
             .pin_xclk = m->pin_xclk,
             .pin_pclk = m->pin_pclk,
@@ -626,17 +1585,17 @@ esp_err_t cam_uploader_camera_init(void)
             .pin_reset = m->pin_reset,
             .xclk_freq_hz = 20000000,
             .pixel_format = PIXFORMAT_JPEG,
-            .frame_size = FRAMESIZE_QVGA,
-            .jpeg_quality = 12,
-            .fb_count = 1,
-            .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+            // The JPEG buffer is sized for the largest frame the quality controller may pick.
+            .frame_size = (framesize_t)cfg->frame_size,
+            .jpeg_quality = quality,
+            .fb_count = (size_t)fb_count,
+            // With several buffers the driver keeps capturing; hand out the newest.
+            .grab_mode = fb_count > 1 ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY,
             .fb_location = CAMERA_FB_IN_DRAM,
         };
 
 #if CONFIG_SPIRAM
         config.fb_location = CAMERA_FB_IN_PSRAM;
-        config.fb_count = 2;
-        config.grab_mode = CAMERA_GRAB_LATEST;
 #endif
 
         ESP_LOGI(TAG,
@@ -657,11 +1616,10 @@ esp_err_t cam_uploader_camera_init(void)
         if (err == ESP_OK) {
             sensor_t *s = esp_camera_sensor_get();
             if (s) {
-                s->set_framesize(s, FRAMESIZE_QVGA);
+                s->set_framesize(s, frame_size);
             }
 
-            s_camera_inited = true;
-            ESP_LOGI(TAG, "camera initialized with model %s", m->name);
+            ESP_LOGI(TAG, "camera initialized with model %s, %d frame buffer(s)", m->name, fb_count);
             return ESP_OK;
         }
 
@@ -671,59 +1629,165 @@ esp_err_t cam_uploader_camera_init(void)
         // Best-effort cleanup in case the driver partially initialized.
         (void)esp_camera_deinit();
     }
-
-    ESP_LOGE(TAG, "all camera models failed; last error: 0x%x (%s)", last_err, esp_err_to_name(last_err));
     return last_err;
 }
 
-static esp_err_t http_post_jpeg(const char *url, const uint8_t *buf, size_t len)
+esp_err_t cam_uploader_camera_init(void)
 {
-    if (!url || url[0] == '\0') {
-        return ESP_ERR_INVALID_ARG;
+    if (s_camera_inited) {
+        return ESP_OK;
     }
 
-    // Guard against percent-encoded URL slipping through.
-    char url_buf[256];
-    const char *use_url = url;
-    if (strchr(url, '%') && url_percent_decode(url, url_buf, sizeof(url_buf))) {
-        if (strncmp(url_buf, "http://", 7) == 0 || strncmp(url_buf, "https://", 8) == 0) {
-            use_url = url_buf;
-        }
+    cam_uploader_config_t cfg;
+    cam_uploader_get_config(&cfg);
+    int quality = 0;
+    framesize_t frame_size = FRAMESIZE_QVGA;
+    quality_ctrl_current(&s_quality, &quality, &frame_size);
+
+    int fb_count = camera_fb_count(&cfg);
+    esp_err_t err = camera_init_models(&cfg, quality, frame_size, fb_count);
+    if (err != ESP_OK && fb_count > 1) {
+        // Extra buffers may not fit in internal RAM; bursts then run at a lower rate.
+        ESP_LOGW(TAG, "camera init with %d frame buffers failed; trying one", fb_count);
+        fb_count = 1;
+        err = camera_init_models(&cfg, quality, frame_size, fb_count);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "all camera models failed; last error: 0x%x (%s)", err, esp_err_to_name(err));
+        return err;
     }
 
-    esp_http_client_config_t config = {
-        .url = use_url,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 15000,
-    };
+    s_camera_frame_size = (framesize_t)cfg.frame_size;
+    s_applied_quality = quality;
+    s_applied_frame_size = frame_size;
+    s_applied_window = WINDOW_CYCLE_FULL;
+    memset(&s_applied_preset, 0, sizeof(s_applied_preset));
+    s_camera_fb_wanted = camera_fb_count(&cfg);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.camera_fb_count = (uint8_t)fb_count;
+    xSemaphoreGive(s_lock);
+    s_camera_inited = true;
+    return ESP_OK;
+}
 
-#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-    config.crt_bundle_attach = esp_crt_bundle_attach;
-#endif
+// Guard against percent-encoded URL slipping through.
+static const char *resolve_post_url(const char *url, char *buf, size_t buf_len)
+{
+    if (strchr(url, '%') && url_percent_decode(url, buf, buf_len)) {
+        if (strncmp(buf, "http://", 7) == 0 || strncmp(buf, "https://", 8) == 0) {
+            return buf;
+        }
+    }
+    return url;
+}
 
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        return ESP_ERR_NO_MEM;
+// Tile deltas, and frames that skipped dedup, carry no hash; compute it on the way out.
+static bool frame_hash_hex(cam_frame_t *frame, char hex[FRAME_DEDUP_HEX_LEN])
+{
+    if (!frame->hashed) {
+        frame->hashed = frame_dedup_hash(frame->buf, frame->len, frame->sha256) == ESP_OK;
     }
+    if (!frame->hashed) {
+        return false;
+    }
+    frame_dedup_to_hex(frame->sha256, hex);
+    return true;
+}
 
-    esp_http_client_set_header(client, "Content-Type", "image/jpeg");
-    esp_http_client_set_post_field(client, (const char *)buf, (int)len);
+static void format_capture_text(const cam_frame_t *frame, char text[UPLOADER_CAPTURE_TEXT_MAX])
+{
+    int n = snprintf(text, UPLOADER_CAPTURE_TEXT_MAX, "%u;%u;%lld;", (unsigned)frame->boot, (unsigned)frame->seq,
+                     (long long)frame->capture_us);
+    if (frame->unix_us != 0 && n > 0 && n < UPLOADER_CAPTURE_TEXT_MAX) {
+        snprintf(text + n, UPLOADER_CAPTURE_TEXT_MAX - n, "%lld", (long long)frame->unix_us);
+    }
+}
 
-    esp_err_t err = esp_http_client_perform(client);
-    int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
+// Whether the JPEG of a duplicate is left out and only its "same as" reference is sent.
+static bool frame_sent_as_reference(const cam_uploader_config_t *cfg, const cam_frame_t *frame)
+{
+    return frame->duplicate && cfg->dedup_mode == FRAME_DEDUP_REFERENCE;
+}
 
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "POST failed: %s", esp_err_to_name(err));
-        return err;
+static void count_references(size_t referenced)
+{
+    if (referenced == 0) {
+        return;
     }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.dedup_referenced += (uint32_t)referenced;
+    xSemaphoreGive(s_lock);
+}
 
-    if (status < 200 || status >= 300) {
-        ESP_LOGW(TAG, "POST http status=%d", status);
-        return ESP_FAIL;
+/**
+ * Streams the JPEG straight from the frame buffer; nothing is staged in an intermediate copy.
+ * The hash header lets the collector recognise a frame it already stored from an earlier attempt.
+ * A tile delta goes the same way with its own content type; its hash is that of the delta, which names
+ * its keyframe in the payload.
+ */
+static esp_err_t http_post_jpeg(upload_client_t *uc, const cam_uploader_config_t *cfg, cam_frame_t *frame)
+{
+    if (cfg->url[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
     }
 
-    return ESP_OK;
+    char capture[UPLOADER_CAPTURE_TEXT_MAX];
+    format_capture_text(frame, capture);
+    (void)upload_client_add_header(uc, UPLOADER_CAPTURE_HEADER, capture);
+    char hex[FRAME_DEDUP_HEX_LEN];
+    bool reference = false;
+    if (frame_hash_hex(frame, hex)) {
+        (void)upload_client_add_header(uc, FRAME_DEDUP_HASH_HEADER, hex);
+        if (frame->duplicate && cfg->dedup_mode != FRAME_DEDUP_OFF) {
+            (void)upload_client_add_header(uc, FRAME_DEDUP_SAME_AS_HEADER, hex);
+            reference = frame_sent_as_reference(cfg, frame);
+        }
+    }
+    count_references(reference ? 1 : 0);
+    if (frame->regions_json) {
+        (void)upload_client_add_header(uc, UPLOADER_REGIONS_HEADER, frame->regions_json);
+    }
+    if (frame->quality[0] != '\0') {
+        (void)upload_client_add_header(uc, UPLOADER_QUALITY_HEADER, frame->quality);
+    }
+    if (frame->window[0] != '\0') {
+        (void)upload_client_add_header(uc, UPLOADER_WINDOW_HEADER, frame->window);
+    }
+    if (frame->event[0] != '\0') {
+        (void)upload_client_add_header(uc, UPLOADER_EVENT_HEADER, frame->event);
+    }
+    if (frame->burst[0] != '\0') {
+        (void)upload_client_add_header(uc, UPLOADER_BURST_HEADER, frame->burst);
+    }
+
+    char url_buf[256];
+    upload_client_set_chunk_size(uc, (size_t)cfg->upload_chunk_size);
+    const char *content_type = frame->kind == CAM_FRAME_TILE_DELTA ? TILE_DIFF_CONTENT_TYPE : "image/jpeg";
+    return upload_client_post(uc, resolve_post_url(cfg->url, url_buf, sizeof(url_buf)), content_type, frame->buf,
+                              reference ? 0 : frame->len, cfg->upload_chunked, NULL);
+}
+
+static esp_err_t http_post_veg_record(upload_client_t *uc, const cam_uploader_config_t *cfg, const cam_frame_t *frame)
+{
+    if (cfg->url[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    char capture[UPLOADER_CAPTURE_TEXT_MAX];
+    format_capture_text(frame, capture);
+    (void)upload_client_add_header(uc, UPLOADER_CAPTURE_HEADER, capture);
+    char url_buf[256];
+    return upload_client_post(uc, resolve_post_url(cfg->url, url_buf, sizeof(url_buf)), "application/json",
+                              frame->buf, frame->len, false, NULL);
+}
+
+// A frame on its own: the JPEG (or its tile delta), or the vegetation record that stands in for it.
+static esp_err_t http_post_single(upload_client_t *uc, const cam_uploader_config_t *cfg, cam_frame_t *frame)
+{
+    if (frame->kind == CAM_FRAME_VEG_RECORD) {
+        return http_post_veg_record(uc, cfg, frame);
+    }
+    return http_post_jpeg(uc, cfg, frame);
 }
 
 static esp_err_t read_supply_voltage_mv(int *out_mv)
@@ -804,126 +1868,1706 @@ static esp_err_t read_supply_voltage_mv(int *out_mv)
     return err;
 }
 
-static esp_err_t http_post_voltage_mv(const char *url, int voltage_mv)
+static esp_err_t http_post_voltage_mv(upload_client_t *uc, const char *url, int voltage_mv)
 {
     if (!url || url[0] == '\0') {
         return ESP_ERR_INVALID_ARG;
     }
 
-    char url_buf[256];
-    const char *use_url = url;
-    if (strchr(url, '%') && url_percent_decode(url, url_buf, sizeof(url_buf))) {
-        if (strncmp(url_buf, "http://", 7) == 0 || strncmp(url_buf, "https://", 8) == 0) {
-            use_url = url_buf;
-        }
-    }
-
-    esp_http_client_config_t config = {
-        .url = use_url,
-        .method = HTTP_METHOD_POST,
-        .timeout_ms = 15000,
-    };
-
-#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
-    config.crt_bundle_attach = esp_crt_bundle_attach;
-#endif
-
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    if (!client) {
-        return ESP_ERR_NO_MEM;
-    }
-
     char body[32];
     snprintf(body, sizeof(body), "%d", voltage_mv);
 
-    esp_http_client_set_header(client, "Content-Type", "text/plain");
-    esp_http_client_set_post_field(client, body, (int)strlen(body));
+    char url_buf[256];
+    return upload_client_post(uc, resolve_post_url(url, url_buf, sizeof(url_buf)), "text/plain",
+                              (const uint8_t *)body, strlen(body), false, NULL);
+}
 
-    esp_err_t err = esp_http_client_perform(client);
-    int status = esp_http_client_get_status_code(client);
-    esp_http_client_cleanup(client);
+typedef struct {
+    const multipart_part_t *parts;
+    size_t count;
+} multipart_body_t;
 
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Voltage POST failed: %s", esp_err_to_name(err));
-        return err;
-    }
-    if (status < 200 || status >= 300) {
-        ESP_LOGW(TAG, "Voltage POST http status=%d", status);
-        return ESP_FAIL;
-    }
-    return ESP_OK;
+static esp_err_t write_multipart_body(upload_client_t *uc, void *ctx)
+{
+    const multipart_body_t *body = (const multipart_body_t *)ctx;
+    return multipart_write(uc, body->parts, body->count);
 }
 
-static void uploader_task(void *arg)
+static multipart_part_t text_part(const char *name, const char *value)
 {
-    (void)arg;
+    multipart_part_t part = {
+        .name = name,
+        .data = (const uint8_t *)value,
+        .len = strlen(value),
+    };
+    return part;
+}
 
-    for (;;) {
-        // Wait until WiFi is connected.
-        while (!s_wifi_connected) {
-            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
-        }
+typedef struct {
+    char seq[12];
+    char capture_us[24];
+    char boot[12];
+    char unix_us[24];
+    char len[12];
+    char sha256[FRAME_DEDUP_HEX_LEN];
+    char filename[32];
+} frame_part_text_t;
+
+// Parts per frame: seq, capture_us, boot, unix_us, len, sha256, same_as, regions, quality, window, event, burst,
+// image (or veg).
+#define PARTS_PER_FRAME 13
+
+/**
+ * One multipart/form-data request carrying the supply voltage and, for each frame, its metadata
+ * followed by the JPEG itself. Repeated field names keep the frames in order for the server.
+ * "boot" and "seq" identify a frame across reboots; "capture_us" is esp_timer time of that boot and
+ * "unix_us" the wall-clock capture time, left out while the clock was not set.
+ * A duplicate frame gets a "same_as" part (its hash) and, in FRAME_DEDUP_REFERENCE mode, no image.
+ * A vegetation record travels as a "veg" JSON part in place of the image, without a hash. Region
+ * statistics of a JPEG go in a "regions" JSON part ahead of it, its quality score in a "quality" part
+ * and the sensor window preset it was taken with in a "window" part; a frame from the pre-event
+ * buffer has an "event" part and a burst frame a "burst" part. A tile delta replaces the image with a "tiles" part.
+ * The request header lists the JPEG hashes so a retried batch can be recognised without parsing it.
+ */
+static esp_err_t http_post_frames(upload_client_t *uc, const cam_uploader_config_t *cfg, cam_frame_t *const *frames,
+                                  size_t count, const int *voltage_mv)
+{
+    if (cfg->url[0] == '\0' || count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-        cam_uploader_config_t cfg;
-        cam_uploader_get_config(&cfg);
+    size_t max_parts = 1 + count * PARTS_PER_FRAME;
+    multipart_part_t *parts = calloc(max_parts, sizeof(*parts));
+    frame_part_text_t *text = calloc(count, sizeof(*text));
+    char *hash_list = calloc(count, FRAME_DEDUP_HEX_LEN);
+    if (!parts || !text || !hash_list) {
+        free(parts);
+        free(text);
+        free(hash_list);
+        return ESP_ERR_NO_MEM;
+    }
 
-        // Disabled until URL is set.
-        if (cfg.url[0] == '\0') {
-            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    char voltage[12];
+    size_t n = 0;
+    if (voltage_mv) {
+        snprintf(voltage, sizeof(voltage), "%d", *voltage_mv);
+        parts[n++] = text_part("voltage_mv", voltage);
+    }
+    size_t hash_list_len = 0;
+    bool hashes_complete = true;
+    size_t referenced = 0;
+    for (size_t i = 0; i < count; i++) {
+        cam_frame_t *frame = frames[i];
+        frame_part_text_t *t = &text[i];
+        snprintf(t->seq, sizeof(t->seq), "%u", (unsigned)frame->seq);
+        snprintf(t->capture_us, sizeof(t->capture_us), "%lld", (long long)frame->capture_us);
+        snprintf(t->boot, sizeof(t->boot), "%u", (unsigned)frame->boot);
+        snprintf(t->unix_us, sizeof(t->unix_us), "%lld", (long long)frame->unix_us);
+        snprintf(t->len, sizeof(t->len), "%u", (unsigned)frame->len);
+        bool tiles = frame->kind == CAM_FRAME_TILE_DELTA;
+        snprintf(t->filename, sizeof(t->filename), "frame_%u.%s", (unsigned)frame->seq, tiles ? "jtd" : "jpg");
+
+        parts[n++] = text_part("seq", t->seq);
+        parts[n++] = text_part("capture_us", t->capture_us);
+        parts[n++] = text_part("boot", t->boot);
+        if (frame->unix_us != 0) {
+            parts[n++] = text_part("unix_us", t->unix_us);
+        }
+        parts[n++] = text_part("len", t->len);
+        if (frame->kind == CAM_FRAME_VEG_RECORD) {
+            parts[n++] = (multipart_part_t) {
+                .name = "veg",
+                .content_type = "application/json",
+                .data = frame->buf,
+                .len = frame->len,
+            };
             continue;
         }
-
-        if (!s_camera_inited) {
-            esp_err_t cam_err = cam_uploader_camera_init();
-            if (cam_err != ESP_OK) {
-                // Wait a bit (or config change) before retry.
-                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5000));
+        bool hashed = frame_hash_hex(frame, t->sha256);
+        if (hashed) {
+            parts[n++] = text_part("sha256", t->sha256);
+            size_t room = FRAME_DEDUP_HEX_LEN * count - hash_list_len;
+            hash_list_len += (size_t)snprintf(hash_list + hash_list_len, room, "%s%s", hash_list_len ? "," : "", t->sha256);
+        } else {
+            hashes_complete = false;
+        }
+        if (frame->regions_json) {
+            parts[n++] = (multipart_part_t) {
+                .name = "regions",
+                .content_type = "application/json",
+                .data = (const uint8_t *)frame->regions_json,
+                .len = strlen(frame->regions_json),
+            };
+        }
+        if (frame->quality[0] != '\0') {
+            parts[n++] = text_part("quality", frame->quality);
+        }
+        if (frame->window[0] != '\0') {
+            parts[n++] = text_part("window", frame->window);
+        }
+        if (frame->event[0] != '\0') {
+            parts[n++] = text_part("event", frame->event);
+        }
+        if (frame->burst[0] != '\0') {
+            parts[n++] = text_part("burst", frame->burst);
+        }
+        if (hashed && frame->duplicate && cfg->dedup_mode != FRAME_DEDUP_OFF) {
+            parts[n++] = text_part("same_as", t->sha256);
+            if (frame_sent_as_reference(cfg, frame)) {
+                referenced++;
                 continue;
             }
         }
+        parts[n++] = (multipart_part_t) {
+            .name = tiles ? "tiles" : "image",
+            .filename = t->filename,
+            .content_type = tiles ? TILE_DIFF_CONTENT_TYPE : "image/jpeg",
+            .data = frame->buf,
+            .len = frame->len,
+        };
+    }
+    if (hashes_complete && hash_list_len > 0) {
+        (void)upload_client_add_header(uc, FRAME_DEDUP_HASH_HEADER, hash_list);
+    }
+    count_references(referenced);
 
-        int64_t t0 = esp_timer_get_time();
-        camera_fb_t *fb = esp_camera_fb_get();
-        if (!fb) {
-            ESP_LOGW(TAG, "camera capture failed");
-        } else if (fb->format != PIXFORMAT_JPEG) {
-            ESP_LOGW(TAG, "frame format not JPEG (%d)", fb->format);
-            esp_camera_fb_return(fb);
-        } else {
-            if (cfg.voltage_url[0] != '\0') {
-                int voltage_mv = 0;
-                esp_err_t v_err = read_supply_voltage_mv(&voltage_mv);
-                if (v_err == ESP_OK) {
-                    (void)http_post_voltage_mv(cfg.voltage_url, voltage_mv);
-                } else {
-                    ESP_LOGW(TAG, "read voltage failed: %s", esp_err_to_name(v_err));
-                }
-            }
-
-            size_t frame_len = fb->len;
-            esp_err_t post_err = http_post_jpeg(cfg.url, fb->buf, fb->len);
-            esp_camera_fb_return(fb);
+    multipart_body_t body = {
+        .parts = parts,
+        .count = n,
+    };
+    int64_t content_len = cfg->upload_chunked ? UPLOAD_CLIENT_CHUNKED : (int64_t)multipart_body_length(parts, n);
 
-            int64_t dt_ms = (esp_timer_get_time() - t0) / 1000;
-            if (post_err == ESP_OK) {
-                ESP_LOGI(TAG, "uploaded %u bytes in %lld ms", (unsigned)frame_len, (long long)dt_ms);
-            }
-        }
+    char url_buf[256];
+    upload_client_set_chunk_size(uc, (size_t)cfg->upload_chunk_size);
+    esp_err_t err = upload_client_post_stream(uc, resolve_post_url(cfg->url, url_buf, sizeof(url_buf)),
+                                              MULTIPART_CONTENT_TYPE, content_len, write_multipart_body, &body, NULL);
+    free(parts);
+    free(text);
+    free(hash_list);
+    return err;
+}
 
-        // Sleep until next interval, but wake early if config changes or WiFi state changes.
-        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(cfg.interval_sec * 1000));
+static int age_bucket(int32_t age_ms)
+{
+    int i = 0;
+    while (i < CAM_UPLOADER_AGE_BUCKETS - 1 && age_ms >= s_age_bounds_ms[i]) {
+        i++;
     }
+    return i;
 }
 
-esp_err_t cam_uploader_start(void)
+// `ack_latency_us` is recorded when positive (live uploads only).
+static void publish_stats(const upload_client_t *image, const upload_client_t *voltage, cam_frame_t *const *frames,
+                          size_t count, bool ok, int64_t ack_latency_us)
 {
-    if (s_task) {
-        return ESP_OK;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (size_t i = 0; ok && i < count; i++) {
+        int32_t age_ms = frames[i]->capture_age_ms;
+        if (age_ms < 0) {
+            continue;
+        }
+        s_stats.capture_age_hist[age_bucket(age_ms)]++;
+        if (age_ms > s_stats.capture_age_ms_max) {
+            s_stats.capture_age_ms_max = age_ms;
+        }
+    }
+    if (ok && ack_latency_us > 0) {
+        s_stats.ack_latency_us_last = ack_latency_us;
+        s_stats.ack_latency_us_total += ack_latency_us;
+        s_stats.acks++;
+    }
+    s_stats.image = image->stats;
+    s_stats.voltage = voltage->stats;
+    s_stats.batches++;
+    if (ok) {
+        s_stats.frames_uploaded += (uint32_t)count;
+    } else {
+        s_stats.frames_failed += (uint32_t)count;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+static void apply_retry_policy(upload_client_t *uc, const cam_uploader_config_t *cfg)
+{
+    retry_policy_config_t policy = {
+        .max_attempts = cfg->retry_attempts,
+        .backoff_base_ms = UPLOADER_RETRY_BASE_MS,
+        .backoff_max_ms = UPLOADER_RETRY_MAX_MS,
+        .failure_threshold = cfg->breaker_failures,
+        .open_ms = cfg->breaker_cooldown_sec * 1000,
+        .open_max_ms = UPLOADER_BREAKER_MAX_OPEN_SEC * 1000,
+    };
+    upload_client_set_retry_policy(uc, &policy);
+}
+
+// Upload one batch (a single frame when batching is off) and report the outcome.
+static esp_err_t upload_batch(upload_client_t *image_client, upload_client_t *voltage_client,
+                              const cam_uploader_config_t *cfg, cam_frame_t *const *frames, size_t count)
+{
+    int voltage_mv = 0;
+    bool want_voltage = cfg->combined_upload || cfg->voltage_url[0] != '\0';
+    esp_err_t v_err = want_voltage ? read_supply_voltage_mv(&voltage_mv) : ESP_ERR_NOT_FOUND;
+    if (want_voltage && v_err != ESP_OK) {
+        ESP_LOGW(TAG, "read voltage failed: %s", esp_err_to_name(v_err));
+    }
+
+    if (cfg->combined_upload) {
+        // Voltage travels inside the image request; the separate voltage endpoint is not used.
+        upload_client_close(voltage_client);
+    } else if (cfg->voltage_url[0] != '\0') {
+        if (v_err == ESP_OK) {
+            (void)http_post_voltage_mv(voltage_client, cfg->voltage_url, voltage_mv);
+        }
+    } else {
+        upload_client_close(voltage_client);
+    }
+
+    const int *voltage_part = (cfg->combined_upload && v_err == ESP_OK) ? &voltage_mv : NULL;
+    if (count == 1 && !cfg->combined_upload) {
+        return http_post_single(image_client, cfg, frames[0]);
+    }
+    return http_post_frames(image_client, cfg, frames, count, voltage_part);
+}
+
+// Re-send one frame recovered from the spool. Its voltage reading is long stale, so none is attached.
+static esp_err_t upload_spooled(upload_client_t *image_client, const cam_uploader_config_t *cfg, cam_frame_t *frame)
+{
+    if (cfg->combined_upload) {
+        return http_post_frames(image_client, cfg, &frame, 1, NULL);
+    }
+    return http_post_single(image_client, cfg, frame);
+}
+
+// Whether the collector refused an upload for good: it answered with a status that retrying does not
+// change (4xx other than 429). Such frames are neither spooled nor kept in the spool.
+static bool upload_refused(const upload_client_t *uc, esp_err_t err)
+{
+    return err == ESP_FAIL && uc->status > 0 && !retry_policy_retryable(err, uc->status);
+}
+
+// Wall-clock time of an esp_timer timestamp of this boot; 0 while the clock has not been set (SNTP).
+static int64_t unix_us_at(int64_t timer_us)
+{
+    if (!capture_sched_wall_clock_valid()) {
+        return 0;
+    }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (esp_timer_get_time() - timer_us);
+}
+
+// Keep frames that could not be delivered; the spool re-sends them once the uplink is back.
+static void spool_frames(cam_frame_t *const *frames, size_t count)
+{
+    if (!frame_spool_ready(&s_spool)) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        // Its esp_timer time means nothing after a reboot; the clock may have been set since capture.
+        if (frames[i]->unix_us == 0 && frames[i]->boot == s_boot_count) {
+            frames[i]->unix_us = unix_us_at(frames[i]->capture_us);
+        }
+        esp_err_t err = frame_spool_append(&s_spool, frames[i]);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "spool frame #%u failed: %s", (unsigned)frames[i]->seq, esp_err_to_name(err));
+        }
+    }
+}
+
+// Push the controller's current choice to the sensor before the next capture. Returns true if the
+// frame size was reprogrammed, which also resets any sensor window.
+static bool apply_quality_setting(void)
+{
+    int quality = 0;
+    framesize_t frame_size = FRAMESIZE_QVGA;
+    quality_ctrl_current(&s_quality, &quality, &frame_size);
+    if (frame_size > s_camera_frame_size) {
+        frame_size = s_camera_frame_size;
+    }
+    if (quality == s_applied_quality && frame_size == s_applied_frame_size) {
+        return false;
+    }
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s) {
+        return false;
+    }
+    if (quality != s_applied_quality) {
+        s->set_quality(s, quality);
+        s_applied_quality = quality;
+    }
+    if (frame_size != s_applied_frame_size) {
+        s->set_framesize(s, frame_size);
+        s_applied_frame_size = frame_size;
+        // The frame already in the buffer was taken at the old size.
+        camera_fb_t *stale = esp_camera_fb_get();
+        if (stale) {
+            esp_camera_fb_return(stale);
+        }
+        return true;
+    }
+    return false;
+}
+
+// Program the sensor window for the next capture: preset `slot` of the config, or the normal frame
+// size for WINDOW_CYCLE_FULL. The sensor then reads out and encodes only that crop. `reset` says
+// the frame size was just reprogrammed, which already restored the full window. A preset whose
+// output could overflow the JPEG buffer (sized for the configured frame size) or that the sensor
+// refuses is skipped for the normal frame size.
+static void apply_window(const cam_uploader_config_t *cfg, int slot, bool reset)
+{
+    if (reset) {
+        s_applied_window = WINDOW_CYCLE_FULL;
+        memset(&s_applied_preset, 0, sizeof(s_applied_preset));
+    }
+    // A config edit may have changed the preset behind the same index.
+    if (slot == s_applied_window &&
+        (slot == WINDOW_CYCLE_FULL ||
+         memcmp(&s_applied_preset, &cfg->window_presets.presets[slot], sizeof(s_applied_preset)) == 0)) {
+        return;
+    }
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s) {
+        return;
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    bool failed = false;
+    if (slot != WINDOW_CYCLE_FULL) {
+        const window_preset_t *p = &cfg->window_presets.presets[slot];
+        uint32_t buffer_pixels = (uint32_t)resolution[s_camera_frame_size].width * resolution[s_camera_frame_size].height;
+        if ((uint32_t)p->output_x * p->output_y > buffer_pixels) {
+            ESP_LOGW(TAG, "window %s: %ux%u output exceeds the frame buffer, using the normal frame size", p->name,
+                     (unsigned)p->output_x, (unsigned)p->output_y);
+            failed = true;
+        } else if (s->set_res_raw(s, p->start_x, p->start_y, p->end_x, p->end_y, p->offset_x, p->offset_y, p->total_x,
+                                  p->total_y, p->output_x, p->output_y, p->scale, p->binning) != 0) {
+            ESP_LOGW(TAG, "window %s: sensor refused it, using the normal frame size", p->name);
+            failed = true;
+        } else {
+            s_applied_window = slot;
+            s_applied_preset = *p;
+        }
+    }
+    if (slot == WINDOW_CYCLE_FULL || failed) {
+        if (s_applied_window == WINDOW_CYCLE_FULL) {
+            // Nothing was reprogrammed.
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_stats.window_failures++;
+            xSemaphoreGive(s_lock);
+            return;
+        }
+        s->set_framesize(s, s_applied_frame_size);
+        s_applied_window = WINDOW_CYCLE_FULL;
+        memset(&s_applied_preset, 0, sizeof(s_applied_preset));
+    }
+    // The frame already in the buffer was taken with the old window.
+    camera_fb_t *stale = esp_camera_fb_get();
+    if (stale) {
+        esp_camera_fb_return(stale);
+    }
+    int64_t dt_us = esp_timer_get_time() - t0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.window_switches++;
+    s_stats.window_failures += failed ? 1 : 0;
+    s_stats.window_switch_us_last = dt_us;
+    if (dt_us > s_stats.window_switch_us_max) {
+        s_stats.window_switch_us_max = dt_us;
+    }
+    xSemaphoreGive(s_lock);
+}
+
+// Offset of this device's capture slots within the interval. Devices that boot together after a
+// power cut would otherwise capture and upload in lockstep; a hash of the station MAC spreads a fleet
+// evenly over the interval and keeps each device's phase stable across reboots and interval changes.
+// tools/stagger_sim.py mirrors this mapping.
+static int64_t capture_phase_us(const cam_uploader_config_t *cfg, int64_t period_us)
+{
+    if (cfg->phase_offset_ms != CAM_UPLOADER_PHASE_FROM_MAC) {
+        return (int64_t)cfg->phase_offset_ms * 1000 % period_us;
+    }
+    uint8_t mac[6];
+    if (esp_read_mac(mac, ESP_MAC_WIFI_STA) != ESP_OK) {
+        return 0;
+    }
+    // FNV-1a, then the murmur3 finalizer so neighbouring MACs land far apart.
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < sizeof(mac); i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (int64_t)(((uint64_t)h * (uint64_t)period_us) >> 32);
+}
+
+static esp_err_t nvs_save_phase(int phase_ms)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_i32(h, NVS_KEY_PHASE, phase_ms);
+    if (err == ESP_OK) {
+        err = nvs_commit(h);
+    }
+    nvs_close(h);
+    return err;
+}
+
+// A collector may assign the phase itself (UPLOAD_CLIENT_PHASE_HEADER). The hint takes effect at once
+// but only its own key is rewritten, and only when it moved by UPLOADER_PHASE_SAVE_MIN_DELTA_MS or
+// replaces the MAC-derived phase, so a collector that keeps nudging the fleet does not wear the flash.
+static void apply_phase_hint(const upload_client_t *uc)
+{
+    if (uc->phase_hint_ms < 0) {
+        return;
+    }
+    int hint = uc->phase_hint_ms;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int was = s_cfg.phase_offset_ms;
+    int saved = s_phase_saved_ms;
+    s_cfg.phase_offset_ms = hint;
+    xSemaphoreGive(s_lock);
+    if (was == hint) {
+        return;
+    }
+    ESP_LOGI(TAG, "collector assigned capture phase %d ms (was %d)", hint, was);
+    if (s_capture_task) {
+        xTaskNotify(s_capture_task, CAPTURE_NOTIFY_CONFIG, eSetBits);
+    }
+
+    if (saved != CAM_UPLOADER_PHASE_FROM_MAC && abs(hint - saved) < UPLOADER_PHASE_SAVE_MIN_DELTA_MS) {
+        return;
+    }
+    esp_err_t err = nvs_save_phase(hint);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "saving collector phase failed: %s", esp_err_to_name(err));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_phase_saved_ms = hint;
+    xSemaphoreGive(s_lock);
+}
+
+// Run the change detector on a fresh capture. False if the frame adds nothing and can be dropped.
+static bool frame_wanted(const camera_fb_t *fb, uint32_t seq)
+{
+    if (!change_detect_enabled(&s_change)) {
+        return true;
+    }
+    int64_t t0 = esp_timer_get_time();
+    change_detect_verdict_t verdict = change_detect_check(&s_change, fb->buf, fb->len);
+    int64_t dt_us = esp_timer_get_time() - t0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.change = s_change.stats;
+    s_stats.change_us_last = dt_us;
+    if (dt_us > s_stats.change_us_max) {
+        s_stats.change_us_max = dt_us;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (verdict == CHANGE_DETECT_UNCHANGED) {
+        ESP_LOGD(TAG, "frame #%u unchanged (%d/1000 of the scene), skipped", (unsigned)seq,
+                 s_change.stats.last_changed_permille);
+    } else if (verdict == CHANGE_DETECT_UNDECODABLE) {
+        ESP_LOGW(TAG, "frame #%u: change detection could not parse the JPEG", (unsigned)seq);
+    }
+    return verdict != CHANGE_DETECT_UNCHANGED;
+}
+
+// esp_timer time the driver stamped on a frame.
+static int64_t fb_capture_us(const camera_fb_t *fb)
+{
+    return (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+}
+
+/**
+ * Take a frame from the driver; `*out_age_ms` is how long ago the driver captured it. With one
+ * frame buffer and CAMERA_GRAB_WHEN_EMPTY the driver refills the buffer as soon as it is returned,
+ * so after a long sleep it holds a picture of the previous slot. In freshness mode such a buffer is
+ * handed back for a new exposure, which costs one frame time and only happens when it is stale.
+ * Likewise a buffer whose driver timestamp is earlier than `not_before_us` (esp_timer time, 0 = any).
+ */
+static camera_fb_t *grab_frame(const cam_uploader_config_t *cfg, int64_t not_before_us, int32_t *out_age_ms)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint32_t discarded = 0;
+    int64_t age_us = 0;
+    camera_fb_t *fb = esp_camera_fb_get();
+    while (fb) {
+        int64_t capture_us = fb_capture_us(fb);
+        age_us = esp_timer_get_time() - capture_us;
+        bool stale = cfg->fresh_max_age_ms > 0 && age_us > (int64_t)cfg->fresh_max_age_ms * 1000;
+        if (!(stale || capture_us < not_before_us) || discarded >= UPLOADER_FRESH_MAX_DISCARDS) {
+            break;
+        }
+        ESP_LOGD(TAG, "discarding a frame exposed %lld ms ago", (long long)(age_us / 1000));
+        esp_camera_fb_return(fb);
+        discarded++;
+        fb = esp_camera_fb_get();
+    }
+    *out_age_ms = (int32_t)(age_us / 1000);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.fresh_discarded += discarded;
+    if (cfg->fresh_max_age_ms > 0 || not_before_us != 0) {
+        s_stats.fresh_wait_us_last = discarded > 0 ? esp_timer_get_time() - t0 : 0;
+    }
+    if (fb) {
+        s_stats.capture_age_ms_last = *out_age_ms;
+    }
+    xSemaphoreGive(s_lock);
+    return fb;
+}
+
+/**
+ * Grab frames until auto exposure has settled (successive frames agree in mean luma), bounded by
+ * `settle_max_frames` and `settle_max_ms`; the frames before the last go back to the driver. Off
+ * (the first frame is used) when `settle_max_frames` is 0.
+ */
+static camera_fb_t *grab_settled(const cam_uploader_config_t *cfg, uint32_t seq, int64_t not_before_us,
+                                 int32_t *out_age_ms)
+{
+    camera_fb_t *fb = grab_frame(cfg, not_before_us, out_age_ms);
+    if (!fb || cfg->settle_max_frames <= 0 || fb->format != PIXFORMAT_JPEG) {
+        return fb;
+    }
+    int64_t t0 = esp_timer_get_time();
+    int64_t deadline_us = t0 + (int64_t)cfg->settle_max_ms * 1000;
+    exposure_settle_begin(&s_settle);
+    exposure_settle_verdict_t verdict = exposure_settle_feed(&s_settle, fb->buf, fb->len);
+    while (verdict == EXPOSURE_SETTLE_SETTLING && s_settle.frames < cfg->settle_max_frames &&
+           esp_timer_get_time() < deadline_us) {
+        esp_camera_fb_return(fb);
+        fb = grab_frame(cfg, not_before_us, out_age_ms);
+        if (!fb) {
+            break;
+        }
+        verdict = exposure_settle_feed(&s_settle, fb->buf, fb->len);
+    }
+    int32_t dt_ms = (int32_t)((esp_timer_get_time() - t0) / 1000);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.settle_runs++;
+    if (fb && verdict == EXPOSURE_SETTLE_SETTLING) {
+        s_stats.settle_timeouts++;
+    }
+    s_stats.settle_frames_last = (uint16_t)s_settle.frames;
+    s_stats.settle_ms_last = dt_ms;
+    if (dt_ms > s_stats.settle_ms_max) {
+        s_stats.settle_ms_max = dt_ms;
+    }
+    s_stats.settle_luma_first = (int16_t)s_settle.luma_first;
+    s_stats.settle_luma_last = (int16_t)s_settle.last_luma;
+    xSemaphoreGive(s_lock);
+
+    if (verdict == EXPOSURE_SETTLE_SETTLING) {
+        ESP_LOGI(TAG, "frame #%u: exposure still moving after %d frames / %d ms (luma %d -> %d), using the last",
+                 (unsigned)seq, s_settle.frames, (int)dt_ms, s_settle.luma_first, s_settle.last_luma);
+    } else if (verdict == EXPOSURE_SETTLE_UNDECODABLE) {
+        ESP_LOGW(TAG, "frame #%u: exposure could not be measured, using it as it is", (unsigned)seq);
+    } else {
+        ESP_LOGD(TAG, "frame #%u: exposure settled after %d frames / %d ms (luma %d -> %d)", (unsigned)seq,
+                 s_settle.frames, (int)dt_ms, s_settle.luma_first, s_settle.last_luma);
+    }
+    return fb;
+}
+
+// Run the quality gate on a fresh capture, re-capturing up to `gate_retries` times while it is
+// rejected. Returns the frame to use with `quality` set to its score (empty when not scored), or
+// NULL once every attempt was rejected and the slot is skipped. `*age_ms` follows the frame.
+static camera_fb_t *capture_gated(camera_fb_t *fb, uint32_t seq, const cam_uploader_config_t *cfg,
+                                  char quality[FRAME_QUALITY_TEXT_MAX], int32_t *age_ms)
+{
+    quality[0] = '\0';
+    if (!frame_quality_enabled(&s_gate)) {
+        return fb;
+    }
+    for (int attempt = 0;; attempt++) {
+        frame_quality_result_t result;
+        int64_t t0 = esp_timer_get_time();
+        frame_quality_verdict_t verdict = frame_quality_check(&s_gate, fb->buf, fb->len, &result);
+        int64_t dt_us = esp_timer_get_time() - t0;
+
+        bool give_up = verdict != FRAME_QUALITY_OK && verdict != FRAME_QUALITY_UNDECODABLE &&
+                       attempt >= cfg->gate_retries;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.gate = s_gate.stats;
+        s_stats.gate_last = result;
+        s_stats.gate_us_last = dt_us;
+        if (dt_us > s_stats.gate_us_max) {
+            s_stats.gate_us_max = dt_us;
+        }
+        if (give_up) {
+            s_stats.gate_skipped++;
+        }
+        xSemaphoreGive(s_lock);
+
+        if (verdict == FRAME_QUALITY_OK) {
+            frame_quality_format(&result, quality, FRAME_QUALITY_TEXT_MAX);
+            return fb;
+        }
+        if (verdict == FRAME_QUALITY_UNDECODABLE) {
+            ESP_LOGW(TAG, "frame #%u: quality gate could not parse the JPEG", (unsigned)seq);
+            return fb;
+        }
+        esp_camera_fb_return(fb);
+        if (give_up) {
+            ESP_LOGI(TAG, "frame #%u %s (luma %u, clipped %u/1000, sharpness %u), skipped", (unsigned)seq,
+                     frame_quality_verdict_name(verdict), (unsigned)result.mean_luma,
+                     (unsigned)result.clipped_permille, (unsigned)result.sharpness);
+            return NULL;
+        }
+        ESP_LOGD(TAG, "frame #%u %s, capturing again", (unsigned)seq, frame_quality_verdict_name(verdict));
+        vTaskDelay(pdMS_TO_TICKS(UPLOADER_GATE_RETRY_DELAY_MS));
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.gate_retries++;
+        xSemaphoreGive(s_lock);
+        fb = grab_frame(cfg, 0, age_ms);
+        if (!fb) {
+            ESP_LOGW(TAG, "camera capture failed");
+            return NULL;
+        }
+        if (fb->format != PIXFORMAT_JPEG) {
+            esp_camera_fb_return(fb);
+            return NULL;
+        }
+    }
+}
+
+// Hash a frame that passed the change detector and check it against the recent ones. False if it
+// is a duplicate that `dedup_mode` drops; otherwise `hash`/`*out_duplicate` describe it.
+static bool frame_unique(const camera_fb_t *fb, uint32_t seq, int dedup_mode, uint8_t hash[FRAME_DEDUP_HASH_LEN],
+                         bool *out_hashed, bool *out_duplicate)
+{
+    uint32_t first_seq = 0;
+    esp_err_t err = frame_dedup_check(&s_dedup, fb->buf, fb->len, seq, hash, out_duplicate, &first_seq);
+    *out_hashed = err == ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "frame #%u: hashing failed: %s", (unsigned)seq, esp_err_to_name(err));
+    }
+    bool drop = *out_duplicate && dedup_mode == FRAME_DEDUP_SKIP;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.dedup = s_dedup.stats;
+    if (drop) {
+        s_stats.dedup_skipped++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (*out_duplicate) {
+        ESP_LOGD(TAG, "frame #%u is identical to #%u%s", (unsigned)seq, (unsigned)first_seq, drop ? ", skipped" : "");
+    }
+    return !drop;
+}
+
+static void preconnect_clients(upload_client_t *image_client, upload_client_t *voltage_client,
+                               const cam_uploader_config_t *cfg)
+{
+    char url_buf[256];
+    if (cfg->url[0] != '\0') {
+        (void)upload_client_preconnect(image_client, resolve_post_url(cfg->url, url_buf, sizeof(url_buf)));
+    }
+    if (!cfg->combined_upload && cfg->voltage_url[0] != '\0') {
+        (void)upload_client_preconnect(voltage_client,
+                                       resolve_post_url(cfg->voltage_url, url_buf, sizeof(url_buf)));
+    }
+}
+
+// Shorten `wait` so the uploader is awake again by `at_us` (esp_timer time).
+static void wake_by(TickType_t *wait, int64_t at_us)
+{
+    int64_t remaining_ms = (at_us - esp_timer_get_time()) / 1000;
+    TickType_t ticks = remaining_ms > 0 ? pdMS_TO_TICKS(remaining_ms) + 1 : 0;
+    if (ticks < *wait) {
+        *wait = ticks;
+    }
+}
+
+// Size of a JPEG frame as encoded. The driver reports the configured frame size, which a sensor
+// window overrides.
+static void fb_frame_size(const camera_fb_t *fb, uint16_t *width, uint16_t *height)
+{
+    if (!jpeg_dc_frame_size(fb->buf, fb->len, width, height)) {
+        *width = (uint16_t)fb->width;
+        *height = (uint16_t)fb->height;
+    }
+}
+
+// Record which window the last capture used and the size the sensor sent for it.
+static void note_window(const camera_fb_t *fb)
+{
+    uint16_t width = 0;
+    uint16_t height = 0;
+    fb_frame_size(fb, &width, &height);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(s_stats.window_last, s_applied_preset.name, sizeof(s_stats.window_last));
+    s_stats.window_width_last = width;
+    s_stats.window_height_last = height;
+    xSemaphoreGive(s_lock);
+}
+
+// Differential uploads: whether to send this frame as the delta tile_diff_classify() just worked
+// out. Frames without a hash cannot become keyframes, and duplicates the dedup mode already
+// shortens are left to it.
+static bool tile_delta_wanted(const camera_fb_t *fb, const cam_uploader_config_t *cfg, uint32_t seq,
+                              const uint8_t hash[FRAME_DEDUP_HASH_LEN], bool hashed, bool duplicate)
+{
+    static uint32_t lost_seen; // queue drops and allocation failures when last checked
+    tile_diff_configure(&s_tiles, cfg->tile_keyframe_every);
+    if (!tile_diff_enabled(&s_tiles) || !hashed || (duplicate && cfg->dedup_mode != FRAME_DEDUP_OFF)) {
+        return false;
+    }
+    // A lost frame may have been the keyframe the next deltas would refer to.
+    uint32_t lost = s_frame_queue.stats.dropped + s_frame_queue.stats.alloc_failures;
+    if (s_tile_resync || lost != lost_seen) {
+        s_tile_resync = false;
+        lost_seen = lost;
+        tile_diff_resync(&s_tiles);
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    tile_diff_kind_t kind = tile_diff_classify(&s_tiles, fb->buf, fb->len, hash);
+    int64_t dt_us = esp_timer_get_time() - t0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.tiles = s_tiles.stats;
+    s_stats.tiles_us_last = dt_us;
+    if (dt_us > s_stats.tiles_us_max) {
+        s_stats.tiles_us_max = dt_us;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (kind == TILE_DIFF_DELTA) {
+        ESP_LOGD(TAG, "frame #%u: %u of %u strips changed, %u of %u bytes", (unsigned)seq,
+                 (unsigned)s_tiles.stats.changed_last, (unsigned)s_tiles.stats.strips_last,
+                 (unsigned)tile_diff_delta_len(&s_tiles), (unsigned)fb->len);
+    } else if (kind == TILE_DIFF_UNSPLITTABLE) {
+        ESP_LOGD(TAG, "frame #%u has no restart markers to split at, sent whole", (unsigned)seq);
+    }
+    return kind == TILE_DIFF_DELTA;
+}
+
+// Detached copy of a frame; with `tile_delta` only the changed strips tile_delta_wanted() found.
+static cam_frame_t *frame_from_fb(const camera_fb_t *fb, uint32_t seq, int32_t age_ms, bool tile_delta)
+{
+    cam_frame_t *frame = tile_delta ? cam_frame_alloc(NULL, tile_diff_delta_len(&s_tiles))
+                                    : cam_frame_alloc(fb->buf, fb->len);
+    if (frame) {
+        if (tile_delta) {
+            frame->kind = CAM_FRAME_TILE_DELTA;
+            tile_diff_write_delta(&s_tiles, fb->buf, fb->len, frame->buf);
+        }
+        fb_frame_size(fb, &frame->width, &frame->height);
+        frame->capture_us = fb_capture_us(fb);
+        frame->capture_age_ms = age_ms;
+        frame->seq = seq;
+        memcpy(frame->window, s_applied_preset.name, sizeof(frame->window));
+    }
+    return frame;
+}
+
+// Hand a detached frame (NULL if its allocation failed) to the uploader.
+static void enqueue_frame(cam_frame_t *frame, const cam_uploader_config_t *cfg)
+{
+    if (frame) {
+        frame->boot = s_boot_count;
+        frame->unix_us = unix_us_at(frame->capture_us);
+    }
+    if (!frame) {
+        s_frame_queue.stats.alloc_failures++;
+        ESP_LOGW(TAG, "no memory to queue frame");
+    } else if (!s_wifi_connected && frame_spool_ready(&s_spool)) {
+        // Offline: straight to flash instead of cycling frames through the small RAM queue.
+        spool_frames(&frame, 1);
+        cam_frame_free(frame);
+    } else if (!frame_queue_push(&s_frame_queue, frame, (frame_queue_drop_policy_t)cfg->queue_drop_policy)) {
+        ESP_LOGD(TAG, "upload queue full, dropped newest frame");
+    }
+}
+
+// RGB565 copy of a frame for the on-device analyses (vegetation index, region statistics).
+typedef struct {
+    uint8_t *rgb; // high byte of each pixel first
+    uint16_t width;
+    uint16_t height;
+} analysis_image_t;
+
+/**
+ * Decode a JPEG at the largest 1/2^n scale that is at most UPLOADER_ANALYSIS_MAX_WIDTH wide.
+ * Decoding small keeps the RGB565 buffer (about 38 KB for a QVGA frame at 1/2) affordable without
+ * PSRAM, where an RGB565 capture would need the full frame. The caller frees `out->rgb`.
+ */
+static bool decode_for_analysis(const uint8_t *jpg, size_t len, uint16_t width, uint16_t height,
+                                analysis_image_t *out)
+{
+    int shift = 0;
+    while (shift < JPG_SCALE_8X && (width >> shift) > UPLOADER_ANALYSIS_MAX_WIDTH) {
+        shift++;
+    }
+    out->width = (uint16_t)(width >> shift);
+    out->height = (uint16_t)(height >> shift);
+    // The decoder rounds partial blocks up; leave room for that.
+    out->rgb = malloc((size_t)(out->width + 1) * (out->height + 1) * 2);
+    if (!out->rgb) {
+        return false;
+    }
+    if (!jpg2rgb565(jpg, len, out->rgb, (jpg_scale_t)shift)) {
+        free(out->rgb);
+        out->rgb = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Statistics of the configured regions as a JSON array (heap, caller frees); NULL without regions or on failure.
+static char *region_stats_json(const analysis_image_t *img, uint32_t seq)
+{
+    if (s_roi.list.count == 0) {
+        return NULL;
+    }
+    roi_region_stats_t stats[ROI_MAX_REGIONS];
+    int64_t t0 = esp_timer_get_time();
+    bool ok = roi_stats_compute(&s_roi, img->rgb, img->width, img->height, stats);
+    int64_t dt_us = esp_timer_get_time() - t0;
+    if (!ok) {
+        ESP_LOGW(TAG, "frame #%u: no memory for the region masks", (unsigned)seq);
+        return NULL;
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    memcpy(s_stats.regions, stats, sizeof(stats[0]) * s_roi.list.count);
+    s_stats.region_count = s_roi.list.count;
+    s_stats.regions_us_last = dt_us;
+    xSemaphoreGive(s_lock);
+
+    int n = roi_stats_format_json(stats, s_roi.list.count, NULL, 0);
+    char *json = n > 0 ? malloc((size_t)n + 1) : NULL;
+    if (json) {
+        roi_stats_format_json(stats, s_roi.list.count, json, (size_t)n + 1);
+    }
+    return json;
+}
+
+// JPEG mode: decode a queued frame's copy and attach its region statistics, if regions are configured.
+static void attach_region_stats(cam_frame_t *frame)
+{
+    analysis_image_t img;
+    if (s_roi.list.count == 0 || !frame) {
+        return;
+    }
+    if (!decode_for_analysis(frame->buf, frame->len, frame->width, frame->height, &img)) {
+        ESP_LOGW(TAG, "frame #%u: could not decode for the region statistics", (unsigned)frame->seq);
+        return;
+    }
+    frame->regions_json = region_stats_json(&img, frame->seq);
+    free(img.rgb);
+}
+
+// Vegetation mode: queue the index record instead of the image, plus the JPEG every `veg_jpeg_every` cycles.
+static void capture_vegetation(camera_fb_t *fb, uint32_t seq, const cam_uploader_config_t *cfg, uint32_t cycle,
+                               const char *quality, int32_t age_ms, int64_t trigger_us)
+{
+    veg_index_result_t veg;
+    char *regions = NULL;
+    analysis_image_t img;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    fb_frame_size(fb, &width, &height);
+    int64_t t0 = esp_timer_get_time();
+    bool measured = decode_for_analysis(fb->buf, fb->len, width, height, &img);
+    if (measured) {
+        veg_index_rgb565(img.rgb, img.width, img.height, &veg);
+    }
+    int64_t dt_us = esp_timer_get_time() - t0;
+    // Audit frames keep the numbers verifiable; an undecodable frame goes out as a JPEG instead.
+    bool with_jpeg = !measured || (cfg->veg_jpeg_every > 0 && cycle % (uint32_t)cfg->veg_jpeg_every == 0);
+    int64_t capture_us = fb_capture_us(fb);
+    cam_frame_t *jpeg = with_jpeg ? frame_from_fb(fb, seq, age_ms, false) : NULL;
+    if (jpeg) {
+        strncpy(jpeg->quality, quality, sizeof(jpeg->quality) - 1);
+        jpeg->trigger_us = trigger_us;
+    }
+    esp_camera_fb_return(fb);
+    if (measured) {
+        regions = region_stats_json(&img, seq);
+        free(img.rgb);
+    }
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (measured) {
+        s_stats.veg = veg;
+        s_stats.veg_records++;
+        s_stats.veg_us_last = dt_us;
+    } else {
+        s_stats.veg_failures++;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (measured) {
+        // The record carries the region statistics too; the audit JPEG does not repeat them.
+        size_t cap = 256 + (regions ? strlen(regions) : 0);
+        char *text = malloc(cap);
+        cam_frame_t *record = NULL;
+        if (text) {
+            int n = veg_index_format_record(&veg, seq, capture_us, with_jpeg, regions, text, cap);
+            record = cam_frame_alloc((const uint8_t *)text, (size_t)n);
+            free(text);
+        }
+        if (record) {
+            record->kind = CAM_FRAME_VEG_RECORD;
+            record->width = veg.width;
+            record->height = veg.height;
+            record->capture_us = capture_us;
+            record->capture_age_ms = age_ms;
+            record->seq = seq;
+            record->trigger_us = trigger_us;
+        }
+        enqueue_frame(record, cfg);
+        ESP_LOGD(TAG, "frame #%u: ExG %d, ExGR %d, cover %u/1000 (%lld us)", (unsigned)seq, (int)veg.exg_mean_milli,
+                 (int)veg.exgr_mean_milli, (unsigned)veg.exgr_cover_permille, (long long)dt_us);
+    } else {
+        ESP_LOGW(TAG, "frame #%u: could not decode for the vegetation index", (unsigned)seq);
+    }
+    free(regions);
+    if (with_jpeg) {
+        enqueue_frame(jpeg, cfg);
+    }
+}
+
+static void *preroll_alloc(size_t size)
+{
+#if CONFIG_SPIRAM
+    void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p) {
+        return p;
+    }
+#endif
+    return heap_caps_malloc(size, MALLOC_CAP_8BIT);
+}
+
+static void IRAM_ATTR event_gpio_isr(void *arg)
+{
+    (void)arg;
+    BaseType_t woken = pdFALSE;
+    __atomic_fetch_or(&s_event_sources, 1u << CAM_UPLOADER_EVENT_GPIO, __ATOMIC_RELAXED);
+    xTaskNotifyFromISR(s_capture_task, CAPTURE_NOTIFY_EVENT, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+// Attach the trigger interrupt to `pin` (falling edge, pulled up), detaching it from the previous one.
+static void event_gpio_configure(int pin)
+{
+    if (pin == s_event_gpio) {
+        return;
+    }
+    if (s_event_gpio >= 0) {
+        gpio_isr_handler_remove((gpio_num_t)s_event_gpio);
+        gpio_reset_pin((gpio_num_t)s_event_gpio);
+        s_event_gpio = -1;
+    }
+    if (pin < 0) {
+        return;
+    }
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << pin,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t err = gpio_config(&io);
+    if (err == ESP_OK) {
+        // The camera driver may have installed the service already.
+        err = gpio_install_isr_service(0);
+        err = err == ESP_ERR_INVALID_STATE ? ESP_OK : err;
+    }
+    if (err == ESP_OK) {
+        err = gpio_isr_handler_add((gpio_num_t)pin, event_gpio_isr, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "event trigger on GPIO %d unavailable: %s", pin, esp_err_to_name(err));
+        return;
+    }
+    s_event_gpio = pin;
+}
+
+static void publish_preroll_stats(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.preroll = s_preroll.stats;
+    s_stats.preroll_frames = s_preroll.count;
+    s_stats.preroll_bytes = (uint32_t)s_preroll.used;
+    s_stats.preroll_budget = (uint32_t)s_preroll.cap;
+    xSemaphoreGive(s_lock);
+}
+
+// (Re)size the pre-event buffer and set up its triggers. A new size starts the buffer empty.
+static void preroll_configure(const cam_uploader_config_t *cfg)
+{
+    size_t size = cfg->preroll_interval_ms > 0 ? (size_t)cfg->preroll_kb * 1024 : 0;
+    if (size != s_preroll_requested) {
+        s_preroll_requested = size;
+        heap_caps_free(s_preroll_mem);
+        s_preroll_mem = size > 0 ? preroll_alloc(size) : NULL;
+        if (size > 0 && !s_preroll_mem) {
+            ESP_LOGW(TAG, "no memory for a %u KB pre-event buffer", (unsigned)(size / 1024));
+        }
+        preroll_ring_stats_t stats = s_preroll.stats;
+        preroll_ring_init(&s_preroll, s_preroll_mem, s_preroll_mem ? size : 0);
+        s_preroll.stats = stats;
+        publish_preroll_stats();
+    }
+    change_detect_configure(&s_event_change, cfg->event_change_permille, 1);
+    event_gpio_configure(s_preroll_mem ? cfg->event_gpio : -1);
+}
+
+static bool preroll_active(const cam_uploader_config_t *cfg)
+{
+    return cfg->preroll_interval_ms > 0 && s_preroll_mem;
+}
+
+// Pre-event buffer: the event being uploaded, if any.
+typedef struct {
+    uint32_t id;       // events so far; the current one while `until_us` lies ahead
+    int64_t trigger_us; // first trigger of the current event
+    int64_t until_us;   // end of its post-roll
+} event_state_t;
+
+// Start an event, or extend the running one, for the triggers in `sources`.
+static void event_trigger(const cam_uploader_config_t *cfg, event_state_t *ev, uint32_t sources)
+{
+    int64_t now = esp_timer_get_time();
+    bool running = now < ev->until_us;
+    if (!running) {
+        ev->id++;
+        ev->trigger_us = now;
+        // The pre-roll is what the buffer holds from the last `preroll_sec`.
+        preroll_ring_expire(&s_preroll, now - (int64_t)cfg->preroll_sec * 1000000);
+    }
+    ev->until_us = now + (int64_t)cfg->postroll_sec * 1000000;
+    preroll_ring_mark_all(&s_preroll);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.events += running ? 0 : 1;
+    for (int i = 0; i < CAM_UPLOADER_EVENT_SOURCES; i++) {
+        if (sources & (1u << i)) {
+            s_stats.event_triggers[i]++;
+        }
+    }
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "event %u %s: %u buffered frames to upload", (unsigned)ev->id, running ? "extended" : "triggered",
+             (unsigned)s_preroll.pending);
+}
+
+// Keep a frame in the pre-event buffer; during an event it is uploaded too.
+static void preroll_capture(const cam_uploader_config_t *cfg, event_state_t *ev, uint32_t seq)
+{
+    int32_t age_ms = 0;
+    camera_fb_t *fb = grab_frame(cfg, 0, &age_ms);
+    if (!fb) {
+        ESP_LOGW(TAG, "camera capture failed");
+        return;
+    }
+    if (fb->format == PIXFORMAT_JPEG) {
+        preroll_meta_t meta = {
+            .capture_us = fb_capture_us(fb),
+            .seq = seq,
+        };
+        fb_frame_size(fb, &meta.width, &meta.height);
+        bool in_event = meta.capture_us < ev->until_us;
+        if (!preroll_ring_push(&s_preroll, fb->buf, fb->len, &meta, in_event)) {
+            ESP_LOGW(TAG, "frame of %u bytes does not fit the pre-event buffer", (unsigned)fb->len);
+        }
+        // Compared with the previous buffered frame; the first one has nothing to compare with.
+        bool first = s_event_change.stats.checked == 0;
+        if (change_detect_enabled(&s_event_change) &&
+            change_detect_check(&s_event_change, fb->buf, fb->len) == CHANGE_DETECT_CHANGED && !first) {
+            __atomic_fetch_or(&s_event_sources, 1u << CAM_UPLOADER_EVENT_CHANGE, __ATOMIC_RELAXED);
+        }
+    }
+    esp_camera_fb_return(fb);
+    if (esp_timer_get_time() >= ev->until_us) {
+        preroll_ring_expire(&s_preroll, esp_timer_get_time() - (int64_t)cfg->preroll_sec * 1000000);
+    }
+}
+
+// Whether the uploader takes another frame now: the queue has room, or offline frames go to the spool.
+static bool upload_room(void)
+{
+    return (!s_wifi_connected && frame_spool_ready(&s_spool)) ||
+           frame_queue_count(&s_frame_queue) < s_frame_queue.depth;
+}
+
+// Hand buffered event frames to the uploader as far as the queue takes them; the rest wait in the buffer.
+static void preroll_drain(const cam_uploader_config_t *cfg, const event_state_t *ev)
+{
+    preroll_meta_t meta;
+    const uint8_t *jpg = NULL;
+    size_t len = 0;
+    uint32_t sent = 0;
+    while (preroll_ring_peek(&s_preroll, &meta, &jpg, &len)) {
+        if (!upload_room()) {
+            break;
+        }
+        cam_frame_t *frame = cam_frame_alloc(jpg, len);
+        if (!frame) {
+            break; // try again on the next wake
+        }
+        frame->seq = meta.seq;
+        frame->capture_us = meta.capture_us;
+        frame->width = meta.width;
+        frame->height = meta.height;
+        snprintf(frame->event, sizeof(frame->event), "%u;%lld", (unsigned)ev->id,
+                 (long long)((meta.capture_us - ev->trigger_us) / 1000));
+        preroll_ring_pop(&s_preroll);
+        enqueue_frame(frame, cfg);
+        sent++;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.event_frames += sent;
+    xSemaphoreGive(s_lock);
+}
+
+// Work out the rate and timing spread of the burst just taken from the driver's frame timestamps.
+static void publish_burst_stats(cam_frame_t *const *frames, int count, bool short_burst)
+{
+    uint32_t gaps[CAM_UPLOADER_MAX_BURST_FRAMES - 1] = {0};
+    int64_t span_us = count > 1 ? frames[count - 1]->capture_us - frames[0]->capture_us : 0;
+    int64_t mean_us = count > 1 ? span_us / (count - 1) : 0;
+    uint64_t sq_sum = 0;
+    uint32_t dev_max = 0;
+    for (int i = 1; i < count; i++) {
+        int64_t gap = frames[i]->capture_us - frames[i - 1]->capture_us;
+        uint32_t dev = (uint32_t)llabs(gap - mean_us);
+        gaps[i - 1] = gap > 0 ? (uint32_t)gap : 0;
+        sq_sum += (uint64_t)dev * dev;
+        dev_max = dev > dev_max ? dev : dev_max;
+    }
+    uint32_t rms = count > 1 ? (uint32_t)sqrt((double)sq_sum / (count - 1)) : 0;
+    uint32_t fps_x100 = span_us > 0 ? (uint32_t)((int64_t)(count - 1) * 100000000 / span_us) : 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.bursts++;
+    s_stats.burst_frames += (uint32_t)count;
+    s_stats.burst_short += short_burst ? 1 : 0;
+    s_stats.burst_count_last = (uint8_t)count;
+    s_stats.burst_fps_x100_last = fps_x100;
+    s_stats.burst_gap_us_mean_last = (uint32_t)mean_us;
+    s_stats.burst_jitter_us_rms_last = rms;
+    s_stats.burst_jitter_us_max_last = dev_max;
+    memcpy(s_stats.burst_gaps_us_last, gaps, sizeof(gaps));
+    xSemaphoreGive(s_lock);
+    ESP_LOGI(TAG, "burst %u: %d frames at %u.%02u fps, gap %u us, jitter %u us rms / %u us max", (unsigned)s_burst.id,
+             count, (unsigned)(fps_x100 / 100), (unsigned)(fps_x100 % 100), (unsigned)mean_us, (unsigned)rms,
+             (unsigned)dev_max);
+}
+
+/**
+ * Take `burst_frames` frames back to back as fast as the sensor delivers them. Each one is copied
+ * out and its buffer handed straight back, so with several frame buffers (CAMERA_GRAB_LATEST) the
+ * sensor keeps filling the next while the copy runs. The copies are held in s_burst and go to the
+ * uploader as the queue has room (burst_drain()); the gate, change detection, dedup and tile deltas
+ * are skipped, as a burst is wanted whole.
+ */
+static void capture_burst(const cam_uploader_config_t *cfg, uint32_t *seq, bool note)
+{
+    if (s_burst.next < s_burst.count) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.burst_skipped++;
+        xSemaphoreGive(s_lock);
+        ESP_LOGW(TAG, "previous burst still waiting for upload; slot skipped");
+        return;
+    }
+    s_burst.count = 0;
+    s_burst.next = 0;
+    s_burst.id++;
+
+    int32_t age_ms = 0;
+    camera_fb_t *fb = grab_settled(cfg, *seq, 0, &age_ms);
+    if (fb && note) {
+        note_window(fb);
+    }
+    bool short_burst = false;
+    while (s_burst.count < cfg->burst_frames) {
+        if (!fb || fb->format != PIXFORMAT_JPEG) {
+            ESP_LOGW(TAG, "burst %u: capture failed after %u frames", (unsigned)s_burst.id, (unsigned)s_burst.count);
+            short_burst = true;
+            break;
+        }
+        cam_frame_t *frame = frame_from_fb(fb, (*seq)++, age_ms, false);
+        esp_camera_fb_return(fb);
+        fb = NULL;
+        if (!frame) {
+            // Not the queue's counter: it would read as a lost upload and force a tile keyframe.
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            s_stats.burst_alloc_failures++;
+            xSemaphoreGive(s_lock);
+            ESP_LOGW(TAG, "burst %u: no memory to hold frame %u", (unsigned)s_burst.id, (unsigned)s_burst.count);
+            short_burst = true;
+            break;
+        }
+        s_burst.frames[s_burst.count++] = frame;
+        if (s_burst.count < cfg->burst_frames) {
+            fb = esp_camera_fb_get();
+            age_ms = fb ? (int32_t)((esp_timer_get_time() - fb_capture_us(fb)) / 1000) : 0;
+        }
+    }
+    if (fb) {
+        esp_camera_fb_return(fb);
+    }
+
+    int count = s_burst.count;
+    for (int i = 0; i < count; i++) {
+        cam_frame_t *frame = s_burst.frames[i];
+        snprintf(frame->burst, sizeof(frame->burst), "%u;%d;%d;%lld", (unsigned)s_burst.id, i, count,
+                 (long long)(frame->capture_us - s_burst.frames[0]->capture_us));
+    }
+    if (count > 0) {
+        publish_burst_stats(s_burst.frames, count, short_burst);
+    }
+}
+
+// Hand held burst frames to the uploader as far as the queue takes them.
+static void burst_drain(const cam_uploader_config_t *cfg)
+{
+    while (s_burst.next < s_burst.count && upload_room()) {
+        cam_frame_t *frame = s_burst.frames[s_burst.next];
+        s_burst.frames[s_burst.next++] = NULL;
+        enqueue_frame(frame, cfg);
+    }
+}
+
+// Take the pending on-demand request, if any; 0 if there is none or an upload is under way, as the
+// frame could not start uploading before it ends anyway. Requests meanwhile merge into this one.
+static int64_t trigger_take(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t trigger_us = s_upload_busy ? 0 : s_trigger_us;
+    if (trigger_us != 0) {
+        s_trigger_us = 0;
+    }
+    xSemaphoreGive(s_lock);
+    return trigger_us;
+}
+
+static void note_trigger_capture(int64_t trigger_us)
+{
+    int64_t dt_us = esp_timer_get_time() - trigger_us;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_stats.trigger_capture_us_last = dt_us;
+    xSemaphoreGive(s_lock);
+}
+
+static void capture_task(void *arg)
+{
+    (void)arg;
+    uint32_t seq = 0;
+
+    if (capture_sched_init(&s_sched, xTaskGetCurrentTaskHandle(), CAPTURE_NOTIFY_SLOT) != ESP_OK) {
+        ESP_LOGE(TAG, "capture scheduler init failed");
+        vTaskDelete(NULL);
+        return;
+    }
+    change_detect_init(&s_change, &s_jpeg_dec);
+    frame_dedup_init(&s_dedup);
+    roi_stats_init(&s_roi);
+    frame_quality_init(&s_gate, &s_jpeg_dec);
+    exposure_settle_init(&s_settle, &s_jpeg_dec);
+    tile_diff_init(&s_tiles, &s_jpeg_dec);
+    change_detect_init(&s_event_change, &s_jpeg_dec);
+    preroll_ring_init(&s_preroll, NULL, 0);
+    event_state_t event = {0};
+    int64_t next_preroll_us = 0;
+    uint32_t veg_cycle = 0; // vegetation mode captures, for the audit JPEG period
+    uint32_t window_pos = 0; // captures so far, for the window cycle
+    // Schedule parameters currently applied to s_sched.
+    int sched_interval_sec = 0;
+    bool sched_align = false;
+    int sched_policy = -1;
+    int64_t sched_phase_us = -1;
+    int sched_jitter_ms = -1;
+
+    for (;;) {
+        cam_uploader_config_t cfg;
+        cam_uploader_get_config(&cfg);
+
+        // Disabled until URL is set.
+        if (cfg.url[0] == '\0') {
+            capture_sched_stop(&s_sched);
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        // Bursts want a different number of frame buffers, which the driver only takes at init.
+        if (s_camera_inited && camera_fb_count(&cfg) != s_camera_fb_wanted) {
+            (void)esp_camera_deinit();
+            s_camera_inited = false;
+        }
+        if (!s_camera_inited) {
+            esp_err_t cam_err = cam_uploader_camera_init();
+            if (cam_err != ESP_OK) {
+                // Wait a bit (or config change) before retry.
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5000));
+                continue;
+            }
+        }
+
+        // Restart the grid only when its parameters change (or the clock just got synced), so other
+        // config edits keep the phase.
+        int64_t period_us = (int64_t)cfg.interval_sec * 1000000;
+        int64_t phase_us = capture_phase_us(&cfg, period_us);
+        bool clock_synced = cfg.align_to_wall_clock && !s_sched.stats.wall_aligned && capture_sched_wall_clock_valid();
+        if (!capture_sched_running(&s_sched) || clock_synced || sched_interval_sec != cfg.interval_sec ||
+            sched_align != cfg.align_to_wall_clock || sched_policy != cfg.missed_slot_policy ||
+            sched_phase_us != phase_us || sched_jitter_ms != cfg.phase_jitter_ms) {
+            esp_err_t sched_err = capture_sched_start(&s_sched, period_us, cfg.align_to_wall_clock,
+                                                      (capture_sched_missed_policy_t)cfg.missed_slot_policy,
+                                                      phase_us, (int64_t)cfg.phase_jitter_ms * 1000);
+            if (sched_err != ESP_OK) {
+                ESP_LOGE(TAG, "capture scheduler start failed: %s", esp_err_to_name(sched_err));
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(5000));
+                continue;
+            }
+            sched_interval_sec = cfg.interval_sec;
+            sched_align = cfg.align_to_wall_clock;
+            sched_policy = cfg.missed_slot_policy;
+            sched_phase_us = phase_us;
+            sched_jitter_ms = cfg.phase_jitter_ms;
+        }
+
+        change_detect_configure(&s_change, cfg.change_threshold_permille, cfg.change_heartbeat);
+        roi_stats_configure(&s_roi, &cfg.regions);
+        frame_quality_configure(&s_gate, cfg.gate_min_luma, cfg.gate_max_clip_permille, cfg.gate_min_sharpness);
+        preroll_configure(&cfg);
+        window_cycle_t window_cycle;
+        if (!window_cycle_parse(&cfg.window_presets, cfg.window_cycle, &window_cycle)) {
+            window_cycle.count = 0;
+        }
+        // Change detection compares a frame with the previous upload; across windows that is meaningless.
+        bool windows_alternate = false;
+        for (int i = 1; i < window_cycle.count; i++) {
+            windows_alternate |= window_cycle.slots[i] != window_cycle.slots[0];
+        }
+
+        // Sleep until the next slot, but wake early if config changes, for the pre-event buffer, for
+        // event triggers and to pass on held burst frames.
+        TickType_t wait = portMAX_DELAY;
+        if (preroll_active(&cfg)) {
+            wake_by(&wait, next_preroll_us);
+            if (s_preroll.pending > 0) {
+                wake_by(&wait, esp_timer_get_time() + UPLOADER_HELD_DRAIN_POLL_MS * 1000);
+            }
+        }
+        if (s_burst.next < s_burst.count) {
+            wake_by(&wait, esp_timer_get_time() + UPLOADER_HELD_DRAIN_POLL_MS * 1000);
+        }
+        uint32_t bits = ulTaskNotifyTake(pdTRUE, wait);
+        burst_drain(&cfg);
+        uint32_t sources = __atomic_exchange_n(&s_event_sources, 0, __ATOMIC_RELAXED);
+        if (preroll_active(&cfg)) {
+            if (esp_timer_get_time() >= next_preroll_us) {
+                next_preroll_us = esp_timer_get_time() + (int64_t)cfg.preroll_interval_ms * 1000;
+                preroll_capture(&cfg, &event, seq++);
+                sources |= __atomic_exchange_n(&s_event_sources, 0, __ATOMIC_RELAXED); // change detector
+            }
+            if (sources) {
+                event_trigger(&cfg, &event, sources);
+            }
+            preroll_drain(&cfg, &event);
+            publish_preroll_stats();
+        }
+        // An on-demand capture is a single frame taken and sent whatever the gate, change detection
+        // and dedup would say; one that falls on a slot serves both.
+        int64_t trigger_us = trigger_take();
+        bool slot = (bits & CAPTURE_NOTIFY_SLOT) && capture_sched_begin_slot(&s_sched, NULL);
+        if (!slot && trigger_us == 0) {
+            continue;
+        }
+
+        bool window_reset = apply_quality_setting();
+        // Between slots the current window stays rather than pay for a switch.
+        int window_slot = slot ? WINDOW_CYCLE_FULL : s_applied_window;
+        if (slot && window_cycle.count > 0) {
+            window_slot = window_cycle.slots[window_pos++ % window_cycle.count];
+        }
+        apply_window(&cfg, window_slot, window_reset);
+        if (trigger_us == 0 && cfg.burst_frames > 1 && cfg.capture_mode != CAM_UPLOADER_MODE_VEG_INDEX) {
+            capture_burst(&cfg, &seq, window_cycle.count > 0);
+            burst_drain(&cfg);
+            continue;
+        }
+        uint8_t hash[FRAME_DEDUP_HASH_LEN];
+        bool hashed = false;
+        bool duplicate = false;
+        char quality[FRAME_QUALITY_TEXT_MAX] = "";
+        int32_t age_ms = 0;
+        // An on-demand frame must be exposed after the request: one whose driver timestamp is earlier
+        // than `trigger_us` goes back for a new exposure.
+        camera_fb_t *fb = grab_settled(&cfg, seq, trigger_us, &age_ms);
+        if (fb && trigger_us != 0) {
+            note_trigger_capture(trigger_us);
+        }
+        if (fb && window_cycle.count > 0) {
+            note_window(fb);
+        }
+        if (!fb) {
+            ESP_LOGW(TAG, "camera capture failed");
+        } else if (fb->format != PIXFORMAT_JPEG) {
+            ESP_LOGW(TAG, "frame format not JPEG (%d)", fb->format);
+            esp_camera_fb_return(fb);
+        } else if (trigger_us == 0 && !(fb = capture_gated(fb, seq, &cfg, quality, &age_ms))) {
+            seq++;
+        } else if (cfg.capture_mode == CAM_UPLOADER_MODE_VEG_INDEX) {
+            capture_vegetation(fb, seq++, &cfg, veg_cycle++, quality, age_ms, trigger_us);
+        } else if (trigger_us == 0 && (!(windows_alternate || frame_wanted(fb, seq)) ||
+                                       !frame_unique(fb, seq, cfg.dedup_mode, hash, &hashed, &duplicate))) {
+            seq++;
+            esp_camera_fb_return(fb);
+        } else {
+            bool tile_delta = tile_delta_wanted(fb, &cfg, seq, hash, hashed, duplicate);
+            // Detach the frame from the driver right away so a slow uplink never holds the DMA buffer.
+            cam_frame_t *frame = frame_from_fb(fb, seq++, age_ms, tile_delta);
+            if (frame) {
+                memcpy(frame->sha256, hash, sizeof(frame->sha256));
+                frame->hashed = hashed && !tile_delta; // a delta is hashed on the way out
+                frame->duplicate = duplicate;
+                strncpy(frame->quality, quality, sizeof(frame->quality) - 1);
+                frame->trigger_us = trigger_us;
+            }
+            esp_camera_fb_return(fb);
+            attach_region_stats(frame);
+            enqueue_frame(frame, &cfg);
+        }
+    }
+}
+
+// Mark the uploader as sending or not; a capture request held back by the upload goes ahead when it ends.
+static void set_upload_busy(bool busy)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    s_upload_busy = busy;
+    bool release = !busy && s_trigger_us != 0;
+    xSemaphoreGive(s_lock);
+    if (release) {
+        xTaskNotify(s_capture_task, CAPTURE_NOTIFY_TRIGGER, eSetBits);
+    }
+}
+
+// Request -> upload start for the on-demand frames in a batch whose upload started at `start_us`.
+static void note_trigger_uploads(cam_frame_t *const *frames, size_t count, int64_t start_us)
+{
+    static int64_t counted_us; // a vegetation record and its audit JPEG answer the same request
+    for (size_t i = 0; i < count; i++) {
+        if (frames[i]->trigger_us == 0 || frames[i]->trigger_us == counted_us) {
+            continue;
+        }
+        counted_us = frames[i]->trigger_us;
+        int64_t dt_us = start_us - frames[i]->trigger_us;
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        s_stats.trigger_uploads++;
+        s_stats.trigger_upload_us_last = dt_us;
+        s_stats.trigger_upload_us_total += dt_us;
+        if (dt_us > s_stats.trigger_upload_us_max) {
+            s_stats.trigger_upload_us_max = dt_us;
+        }
+        xSemaphoreGive(s_lock);
+        ESP_LOGI(TAG, "on-demand frame #%u: upload starting %lld ms after the request", (unsigned)frames[i]->seq,
+                 (long long)(dt_us / 1000));
+    }
+}
+
+static void uploader_task(void *arg)
+{
+    (void)arg;
+
+    // Long-lived clients so consecutive cycles reuse the TCP/TLS session.
+    upload_client_t image_client;
+    upload_client_t voltage_client;
+    upload_client_init(&image_client, "image");
+    upload_client_init(&voltage_client, "voltage");
+
+    // Frames accumulated for the next request; flushed when full or when the batch window expires.
+    cam_frame_t *batch[UPLOADER_MAX_BATCH_FRAMES];
+    size_t batch_count = 0;
+    int64_t batch_deadline_us = 0;
+    int64_t next_drain_us = 0;
+    uint32_t drain_id = 0;   // spool record the failed drain attempts below belong to
+    int drain_attempts = 0;
+    int64_t preconnected_for_us = 0; // capture slot the connections were last pre-opened for
+
+    for (;;) {
+        // Wait until WiFi is connected; captures go to the spool (or keep queueing without one).
+        // Handles stay alive so the first upload after reconnect resumes the TLS session.
+        if (!s_wifi_connected) {
+            upload_client_disconnect(&image_client);
+            upload_client_disconnect(&voltage_client);
+        }
+        while (!s_wifi_connected) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            // Let the live frames after reconnect go first before the backlog starts draining.
+            next_drain_us = esp_timer_get_time() + (int64_t)UPLOADER_IDLE_POLL_MS * 1000;
+        }
+
+        cam_uploader_config_t cfg;
+        cam_uploader_get_config(&cfg);
+        apply_retry_policy(&image_client, &cfg);
+        apply_retry_policy(&voltage_client, &cfg);
+
+        TickType_t wait = pdMS_TO_TICKS(UPLOADER_IDLE_POLL_MS);
+        if (batch_count > 0) {
+            wake_by(&wait, batch_deadline_us);
+        }
+        bool drain_enabled = cfg.spool_drain_per_min > 0 && frame_spool_pending(&s_spool) > 0 &&
+                             upload_client_available(&image_client);
+        if (drain_enabled && batch_count == 0) {
+            wake_by(&wait, next_drain_us);
+        }
+
+        // Get the connection up while the next frame is being captured, if that frame will be sent right away.
+        int64_t next_capture_us = cfg.preconnect_lead_ms > 0 ? capture_sched_next_deadline(&s_sched) : 0;
+        if (next_capture_us > 0 && next_capture_us != preconnected_for_us &&
+            batch_count + 1 >= (size_t)cfg.batch_frames) {
+            int64_t preconnect_at_us = next_capture_us - (int64_t)cfg.preconnect_lead_ms * 1000;
+            if (esp_timer_get_time() >= preconnect_at_us) {
+                preconnected_for_us = next_capture_us;
+                preconnect_clients(&image_client, &voltage_client, &cfg);
+            } else {
+                wake_by(&wait, preconnect_at_us);
+            }
+        }
+
+        cam_frame_t *frame = frame_queue_pop(&s_frame_queue, wait);
+        if (frame) {
+            if (batch_count == 0) {
+                batch_deadline_us = esp_timer_get_time() + (int64_t)cfg.batch_window_sec * 1000000;
+            }
+            batch[batch_count++] = frame;
+        }
+
+        // An on-demand frame is sent right away rather than wait for the batch to fill.
+        bool flush = batch_count > 0 &&
+                     (batch_count >= (size_t)cfg.batch_frames || esp_timer_get_time() >= batch_deadline_us ||
+                      (frame && frame->trigger_us != 0));
+        if (!flush) {
+            // The spool only gets the uplink when no live frame is waiting or being batched.
+            if (!frame && batch_count == 0 && drain_enabled && esp_timer_get_time() >= next_drain_us) {
+                next_drain_us = esp_timer_get_time() + 60000000LL / cfg.spool_drain_per_min;
+                cam_frame_t *spooled = NULL;
+                uint32_t spool_id = 0;
+                if (frame_spool_peek(&s_spool, &spooled, &spool_id) == ESP_OK) {
+                    set_upload_busy(true);
+                    esp_err_t err = upload_spooled(&image_client, &cfg, spooled);
+                    set_upload_busy(false);
+                    if (spool_id != drain_id) {
+                        drain_id = spool_id;
+                        drain_attempts = 0;
+                    }
+                    // Only answered failures count: a dead link says nothing about the frame.
+                    if (err != ESP_OK && image_client.status > 0) {
+                        drain_attempts++;
+                    }
+                    if (err == ESP_OK) {
+                        apply_phase_hint(&image_client);
+                        (void)frame_spool_ack(&s_spool, spool_id);
+                        ESP_LOGI(TAG, "re-sent spooled frame #%u (%u bytes), %u left", (unsigned)spooled->seq,
+                                 (unsigned)spooled->len, (unsigned)frame_spool_pending(&s_spool));
+                    } else if (upload_refused(&image_client, err) || drain_attempts >= UPLOADER_SPOOL_MAX_ATTEMPTS) {
+                        (void)frame_spool_reject(&s_spool, spool_id);
+                        ESP_LOGW(TAG, "dropping spooled frame #%u: http status %d after %d attempt(s)",
+                                 (unsigned)spooled->seq, image_client.status, drain_attempts);
+                    }
+                    publish_stats(&image_client, &voltage_client, &spooled, 1, err == ESP_OK, 0);
+                    cam_frame_free(spooled);
+                }
+                continue;
+            }
+            if (!frame) {
+                upload_client_check_idle(&image_client);
+                upload_client_check_idle(&voltage_client);
+            }
+            continue;
+        }
+
+        set_upload_busy(true);
+        int64_t t0 = esp_timer_get_time();
+        esp_err_t post_err = upload_batch(&image_client, &voltage_client, &cfg, batch, batch_count);
+        int64_t dt_us = esp_timer_get_time() - t0;
+        set_upload_busy(false);
+        note_trigger_uploads(batch, batch_count, t0);
+        int64_t dt_ms = dt_us / 1000;
+
+        size_t bytes = 0;
+        size_t jpeg_count = 0;
+        size_t jpeg_bytes = 0;
+        for (size_t i = 0; i < batch_count; i++) {
+            bytes += batch[i]->len;
+            if (batch[i]->kind == CAM_FRAME_JPEG) {
+                jpeg_count++;
+                jpeg_bytes += batch[i]->len;
+            }
+        }
+        const upload_client_timing_t *t = &image_client.stats.last;
+        if (s_wifi_connected && post_err != RETRY_POLICY_ERR_CIRCUIT_OPEN && jpeg_count > 0) {
+            // Per-JPEG cost of the image request (the whole cycle if it failed) drives the quality loop;
+            // vegetation records are too small to say anything about the link.
+            int64_t image_us = post_err == ESP_OK ? t->connect_us + t->send_us + t->response_us : dt_us;
+            quality_ctrl_observe(&s_quality, image_us / (int64_t)jpeg_count, jpeg_bytes / jpeg_count,
+                                 post_err == ESP_OK);
+        }
+        if (post_err == ESP_OK) {
+            apply_phase_hint(&image_client);
+            ESP_LOGI(TAG, "uploaded %u frame(s) from #%u (%u bytes) in %lld ms (connect=%lld send=%lld response=%lld ms%s)",
+                     (unsigned)batch_count, (unsigned)batch[0]->seq, (unsigned)bytes, (long long)dt_ms,
+                     (long long)(t->connect_us / 1000), (long long)(t->send_us / 1000),
+                     (long long)(t->response_us / 1000), t->reused ? ", reused" : "");
+        }
+        publish_stats(&image_client, &voltage_client, batch, batch_count, post_err == ESP_OK,
+                      esp_timer_get_time() - batch[batch_count - 1]->capture_us);
+        if (post_err != ESP_OK && cfg.spool_failed_uploads && !upload_refused(&image_client, post_err)) {
+            spool_frames(batch, batch_count);
+        }
+        if (post_err != ESP_OK) {
+            s_tile_resync = true; // a spooled keyframe may arrive after deltas that need it, or never
+        }
+
+        for (size_t i = 0; i < batch_count; i++) {
+            cam_frame_free(batch[i]);
+        }
+        batch_count = 0;
+    }
+}
+
+esp_err_t cam_uploader_start(void)
+{
+    if (s_upload_task) {
+        return ESP_OK;
     }
     if (!s_lock) {
         return ESP_ERR_INVALID_STATE;
     }
 
-    BaseType_t ok = xTaskCreate(uploader_task, "cam_uploader", 8192, NULL, 5, &s_task);
+    ESP_RETURN_ON_ERROR(frame_queue_init(&s_frame_queue, UPLOADER_QUEUE_DEPTH), TAG, "frame_queue_init failed");
+
+    // Optional: without the partition, outages simply drop frames as before.
+    esp_err_t spool_err = frame_spool_init(&s_spool, FRAME_SPOOL_PARTITION_LABEL);
+    if (spool_err != ESP_OK) {
+        ESP_LOGW(TAG, "offline spool disabled: %s", esp_err_to_name(spool_err));
+    }
+
+    BaseType_t ok = xTaskCreate(uploader_task, "cam_uploader", 8192, NULL, 5, &s_upload_task);
+    if (ok != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    // Slightly higher priority than the uploader so capture cadence is not held up by the network.
+    // The stack holds a config copy (about 1.1 KB) and the window cycle across JPEG analysis, RGB565
+    // decoding, hashing and JSON formatting.
+    ok = xTaskCreate(capture_task, "cam_capture", 8192, NULL, 6, &s_capture_task);
     return ok == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
 }
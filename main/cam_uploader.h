@@ -1,6 +1,20 @@
 #pragma once
 
 #include "esp_err.h"
+#include "capture_sched.h"
+#include "change_detect.h"
+#include "exposure_settle.h"
+#include "frame_dedup.h"
+#include "frame_quality.h"
+#include "frame_queue.h"
+#include "frame_spool.h"
+#include "preroll_ring.h"
+#include "quality_ctrl.h"
+#include "roi_stats.h"
+#include "tile_diff.h"
+#include "upload_client.h"
+#include "veg_index.h"
+#include "window_preset.h"
 
 #include <stdbool.h>
 
@@ -8,19 +22,171 @@
 extern "C" {
 #endif
 
+/** `phase_offset_ms` value that derives the capture phase from the station MAC. */
+#define CAM_UPLOADER_PHASE_FROM_MAC (-1)
+
+/** Upper bounds (ms) of the capture-age histogram buckets; one more bucket holds everything older. */
+#define CAM_UPLOADER_AGE_BOUNDS_MS 50, 100, 200, 500, 1000, 5000
+#define CAM_UPLOADER_AGE_BUCKETS 7
+
+/** What flushed the pre-event buffer (cam_uploader_trigger_event()). */
+typedef enum {
+    CAM_UPLOADER_EVENT_HTTP = 0,
+    CAM_UPLOADER_EVENT_GPIO = 1,
+    CAM_UPLOADER_EVENT_CHANGE = 2, // buffered frames differ by at least event_change_permille
+} cam_uploader_event_source_t;
+#define CAM_UPLOADER_EVENT_SOURCES 3
+
+/** Most frames in one burst. */
+#define CAM_UPLOADER_MAX_BURST_FRAMES 16
+
+typedef enum {
+    CAM_UPLOADER_MODE_JPEG = 0,      // upload the JPEG of every capture
+    CAM_UPLOADER_MODE_VEG_INDEX = 1, // upload a vegetation index record; the JPEG only every `veg_jpeg_every` cycles
+} cam_uploader_capture_mode_t;
+
 typedef struct {
     char url[256];
     char voltage_url[256];
     int interval_sec;
+    bool align_to_wall_clock; // capture on UTC multiples of the interval once the clock is synced
+    int missed_slot_policy;   // capture_sched_missed_policy_t for slots that could not be served in time
+    int phase_offset_ms;      // capture offset into each interval, or CAM_UPLOADER_PHASE_FROM_MAC
+    int phase_jitter_ms;      // random extra delay per capture, at most this long; 0 = none
+    int frame_size;           // framesize_t; largest size used (the camera buffer is sized for it)
+    int jpeg_quality;         // best (lowest) jpeg_quality number used
+    int adapt_target_ms;      // per-frame upload time budget for adaptive quality; 0 = off
+    int adapt_target_kb;      // per-frame JPEG size budget for adaptive quality; 0 = off
+    int adapt_quality_worst;  // highest jpeg_quality number the controller may fall back to
+    int adapt_frame_size_min; // framesize_t; smallest size the controller may fall back to
+    int queue_drop_policy; // frame_queue_drop_policy_t applied when the upload queue is full
+    bool upload_chunked;   // stream the JPEG with chunked transfer encoding instead of Content-Length
+    int upload_chunk_size; // bytes per socket write; 0 = TCP send buffer size
+    bool combined_upload;  // one multipart POST to `url` with JPEG, voltage and frame metadata
+    int batch_frames;      // frames per request (1 = no batching); batches are sent as multipart
+    int batch_window_sec;  // flush a partial batch this long after its first frame arrived
+    int spool_drain_per_min; // spooled frames re-sent per minute once back online; 0 = keep them spooled
+    bool spool_failed_uploads; // spool frames whose upload may still succeed later (transport error, 5xx, 429, open circuit)
+    int retry_attempts;        // attempts per request including the first
+    int breaker_failures;      // consecutive failed requests that open an endpoint's circuit; 0 = never
+    int breaker_cooldown_sec;  // first open period; doubles on failed probes
+    int preconnect_lead_ms;    // open the upload connection this long before a capture; 0 = off
+    int change_threshold_permille; // upload only if this much (1/1000) of the scene changed since the last upload; 0 = off
+    int change_heartbeat;      // upload at least every N-th frame even if nothing changed
+    int dedup_mode;            // frame_dedup_mode_t for frames byte-identical to a recent one
+    int capture_mode;          // cam_uploader_capture_mode_t
+    int veg_jpeg_every;        // vegetation mode: also upload the JPEG every N-th cycle; 0 = never
+    roi_list_t regions;        // plant-bed regions to report statistics for; none = off
+    int gate_min_luma;         // quality gate: reject frames darker than this mean luma (0..255); 0 = off
+    int gate_max_clip_permille; // quality gate: reject frames with more blown-out area (1/1000); 0 = off
+    int gate_min_sharpness;    // quality gate: reject frames with a lower Laplacian variance; 0 = off
+    int gate_retries;          // re-captures after a rejected frame before the slot is skipped
+    int fresh_max_age_ms;      // hand back frame buffers exposed longer ago than this and grab again; 0 = off
+    int settle_max_frames;     // grab until exposure settles, at most this many frames; 0 = use the first frame
+    int settle_max_ms;         // ... and at most this long
+    window_preset_list_t window_presets; // named sensor windows (set_res_raw())
+    char window_cycle[64];     // preset names used by successive captures (window_cycle_parse()); empty = none
+    int tile_keyframe_every;   // upload only the changed strips of a frame, with a full keyframe every N; 0 = off
+    int preroll_interval_ms;   // pre-event buffer: keep a frame this often; 0 = off
+    int preroll_sec;           // ... seconds of frames uploaded from before a trigger
+    int postroll_sec;          // ... and after it
+    int preroll_kb;            // ... memory for the buffer; the oldest frames make way when it is full
+    int event_gpio;            // input that triggers an event when pulled low; -1 = none
+    int event_change_permille; // trigger when this much (1/1000) of the scene changes between buffered frames; 0 = off
+    int burst_frames;          // frames grabbed back to back per capture slot; 0 or 1 = single frames
 } cam_uploader_config_t;
 
+typedef struct {
+    upload_client_stats_t image;
+    upload_client_stats_t voltage;
+    frame_queue_stats_t queue;
+    uint32_t queued; // frames waiting for upload
+    uint32_t batches;         // upload requests issued (one per batch)
+    uint32_t frames_uploaded;
+    uint32_t frames_failed;
+    int64_t ack_latency_us_last;  // capture of the newest frame in a request -> 2xx received
+    int64_t ack_latency_us_total; // summed over `acks`
+    uint32_t acks;
+    capture_sched_stats_t sched;
+    quality_ctrl_stats_t quality;
+    frame_spool_stats_t spool;
+    uint32_t spool_pending; // frames held in flash waiting to be re-sent
+    change_detect_stats_t change;
+    int64_t change_us_last; // time spent deciding on the last frame
+    int64_t change_us_max;
+    frame_dedup_stats_t dedup;
+    uint32_t dedup_skipped;    // duplicates not sent (FRAME_DEDUP_SKIP)
+    uint32_t dedup_referenced; // duplicates sent as "same as" requests without the JPEG
+    veg_index_result_t veg;    // last vegetation measurement
+    uint32_t veg_records;
+    uint32_t veg_failures;     // frames that could not be decoded for the index
+    int64_t veg_us_last;       // decode + index time of the last measurement
+    roi_region_stats_t regions[ROI_MAX_REGIONS]; // last region statistics
+    uint8_t region_count;
+    int64_t regions_us_last;   // time of the last region pass (without the decode)
+    frame_quality_stats_t gate;
+    frame_quality_result_t gate_last; // measurement of the last frame checked
+    uint32_t gate_retries;     // re-captures after a rejected frame
+    uint32_t gate_skipped;     // slots skipped because every attempt was rejected
+    int64_t gate_us_last;      // decode + scoring time of the last check
+    int64_t gate_us_max;
+    uint32_t capture_age_hist[CAM_UPLOADER_AGE_BUCKETS]; // uploaded live frames by capture age (CAM_UPLOADER_AGE_BOUNDS_MS)
+    int32_t capture_age_ms_last; // exposure start -> frame taken, last capture
+    int32_t capture_age_ms_max;  // largest among uploaded frames
+    uint32_t fresh_discarded;    // stale buffers handed back in freshness mode
+    int64_t fresh_wait_us_last;  // time the last capture spent on discarded buffers
+    uint32_t settle_runs;        // captures that waited for exposure to settle
+    uint32_t settle_timeouts;    // ... and used the last frame because the wait ran out
+    uint16_t settle_frames_last; // frames grabbed by the last wait, the one used included
+    int32_t settle_ms_last;
+    int32_t settle_ms_max;
+    int16_t settle_luma_first;   // mean luma of the first and the used frame of the last wait
+    int16_t settle_luma_last;
+    uint32_t window_switches;    // sensor window changes between captures
+    uint32_t window_failures;    // presets the sensor refused or the frame buffer could not hold
+    int64_t window_switch_us_last; // reprogramming plus the stale frame handed back
+    int64_t window_switch_us_max;
+    char window_last[WINDOW_PRESET_NAME_MAX]; // preset of the last capture; empty = normal frame size
+    uint16_t window_width_last;  // size the sensor actually sent for it
+    uint16_t window_height_last;
+    tile_diff_stats_t tiles;     // differential uploads
+    int64_t tiles_us_last;       // split, signature and delta of the last frame
+    int64_t tiles_us_max;
+    preroll_ring_stats_t preroll;
+    uint32_t preroll_frames;     // frames in the pre-event buffer
+    uint32_t preroll_bytes;      // ... and the bytes they take
+    uint32_t preroll_budget;     // buffer size; 0 = off or not allocated
+    uint32_t events;             // triggers that started an event (the others extended a running one)
+    uint32_t event_triggers[CAM_UPLOADER_EVENT_SOURCES]; // triggers by cam_uploader_event_source_t
+    uint32_t event_frames;       // buffered frames handed to the uploader
+    uint8_t camera_fb_count;     // frame buffers the camera driver runs with
+    uint32_t bursts;
+    uint32_t burst_frames;       // frames taken in bursts
+    uint32_t burst_short;        // bursts cut short: capture failed or no memory to hold a frame
+    uint32_t burst_alloc_failures; // burst frames that found no memory to be held in
+    uint32_t burst_skipped;      // slots skipped because the last burst was still waiting for upload
+    uint8_t burst_count_last;    // frames in the last burst
+    uint32_t burst_fps_x100_last; // its rate from the driver's frame timestamps, 1/100 fps
+    uint32_t burst_gap_us_mean_last; // mean time between its frames
+    uint32_t burst_jitter_us_rms_last; // spread of those gaps around the mean
+    uint32_t burst_jitter_us_max_last; // largest deviation of one gap from the mean
+    uint32_t burst_gaps_us_last[CAM_UPLOADER_MAX_BURST_FRAMES - 1]; // gap before each frame after the first
+    uint32_t triggers;           // on-demand capture requests
+    uint32_t triggers_coalesced; // requests merged into one still waiting to be captured
+    uint32_t trigger_uploads;    // triggered frames whose upload started
+    int64_t trigger_capture_us_last; // request -> frame copied out of the driver
+    int64_t trigger_upload_us_last;  // request -> its upload starting
+    int64_t trigger_upload_us_max;
+    int64_t trigger_upload_us_total; // over trigger_uploads, for the mean
+} cam_uploader_stats_t;
+
 /** Load config from NVS (or defaults) and create internal locks. */
 esp_err_t cam_uploader_init(void);
 
 /** Initialize camera (idempotent). */
 esp_err_t cam_uploader_camera_init(void);
 
-/** Start background uploader task (safe to call once). */
+/** Start background capture and upload tasks (safe to call once). */
 esp_err_t cam_uploader_start(void);
 
 /** Get current config (thread-safe copy). */
@@ -29,6 +195,22 @@ esp_err_t cam_uploader_get_config(cam_uploader_config_t *out_cfg);
 /** Set config (persist to NVS + notify task). */
 esp_err_t cam_uploader_set_config(const cam_uploader_config_t *cfg);
 
+/** Get upload statistics (thread-safe copy, refreshed after every upload cycle). */
+esp_err_t cam_uploader_get_stats(cam_uploader_stats_t *out_stats);
+
+/**
+ * Upload the pre-event buffer and keep uploading buffered frames for `postroll_sec`; a trigger
+ * during that time extends the event. ESP_ERR_INVALID_STATE if the buffer is off.
+ */
+esp_err_t cam_uploader_trigger_event(cam_uploader_event_source_t source);
+
+/**
+ * Capture and upload a frame now, outside the schedule and without touching the config. A request
+ * made while an earlier one is still waiting to be captured, e.g. behind an upload in progress, is
+ * merged into it (`*out_coalesced`, may be NULL). ESP_ERR_INVALID_STATE while no URL is set.
+ */
+esp_err_t cam_uploader_trigger_capture(bool *out_coalesced);
+
 /** Notify uploader about WiFi connectivity changes. */
 void cam_uploader_set_wifi_connected(bool connected);
 
@@ -0,0 +1,231 @@
+#include "capture_sched.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+
+static const char *TAG = "capture_sched";
+
+// Anything before late 2023 means the RTC was never set.
+#define CAPTURE_SCHED_MIN_VALID_EPOCH 1700000000
+// Longest back-to-back run under the catch-up policy; older missed slots are skipped.
+#define CAPTURE_SCHED_MAX_CATCH_UP 3
+
+static int64_t slot_deadline(const capture_sched_t *cs, int64_t slot)
+{
+    return cs->t0_us + slot * cs->period_us;
+}
+
+static int64_t random_jitter(int64_t jitter_bound_us)
+{
+    return jitter_bound_us > 0 ? (int64_t)(esp_random() % (uint32_t)(jitter_bound_us + 1)) : 0;
+}
+
+static void sched_timer_cb(void *arg)
+{
+    capture_sched_t *cs = (capture_sched_t *)arg;
+
+    portENTER_CRITICAL(&cs->mux);
+    bool running = cs->running;
+    int64_t t0_us = cs->t0_us;
+    int64_t period_us = cs->period_us;
+    int64_t jitter_bound_us = cs->jitter_bound_us;
+    portEXIT_CRITICAL(&cs->mux);
+    if (!running) {
+        return;
+    }
+
+    // Always re-arm against the absolute grid, so callback latency (and jitter) never accumulates.
+    // The jitter stays below half a period, so `now` is still inside the slot that just fired.
+    int64_t now = esp_timer_get_time();
+    int64_t next = now < t0_us ? t0_us : t0_us + ((now - t0_us) / period_us + 1) * period_us;
+    int64_t jitter = random_jitter(jitter_bound_us);
+    portENTER_CRITICAL(&cs->mux);
+    cs->fired_jitter_us = cs->armed_jitter_us;
+    cs->armed_jitter_us = jitter;
+    cs->armed_us = next + jitter;
+    portEXIT_CRITICAL(&cs->mux);
+    esp_timer_start_once(cs->timer, (uint64_t)(next + jitter - now));
+
+    xTaskNotify(cs->task, cs->notify_bits, eSetBits);
+}
+
+esp_err_t capture_sched_init(capture_sched_t *cs, TaskHandle_t task, uint32_t notify_bits)
+{
+    if (!cs || !task || notify_bits == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(cs, 0, sizeof(*cs));
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    cs->mux = mux;
+    cs->task = task;
+    cs->notify_bits = notify_bits;
+
+    const esp_timer_create_args_t args = {
+        .callback = sched_timer_cb,
+        .arg = cs,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "capture_sched",
+    };
+    return esp_timer_create(&args, &cs->timer);
+}
+
+bool capture_sched_wall_clock_valid(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec >= CAPTURE_SCHED_MIN_VALID_EPOCH;
+}
+
+esp_err_t capture_sched_start(capture_sched_t *cs, int64_t period_us, bool align_wall_clock,
+                              capture_sched_missed_policy_t policy, int64_t phase_us, int64_t jitter_bound_us)
+{
+    if (!cs || !cs->timer || period_us <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    capture_sched_stop(cs);
+
+    phase_us = (phase_us % period_us + period_us) % period_us;
+    if (jitter_bound_us < 0) {
+        jitter_bound_us = 0;
+    } else if (jitter_bound_us > period_us / 2) {
+        jitter_bound_us = period_us / 2;
+    }
+
+    int64_t now = esp_timer_get_time();
+    int64_t t0_us = now + phase_us;
+    bool aligned = false;
+    if (align_wall_clock && capture_sched_wall_clock_valid()) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        int64_t wall_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+        t0_us = now + ((phase_us - wall_us % period_us) % period_us + period_us) % period_us;
+        aligned = true;
+    }
+    int64_t jitter = random_jitter(jitter_bound_us);
+
+    portENTER_CRITICAL(&cs->mux);
+    cs->t0_us = t0_us;
+    cs->period_us = period_us;
+    cs->next_slot = 0;
+    cs->policy = policy;
+    cs->jitter_bound_us = jitter_bound_us;
+    cs->armed_jitter_us = jitter;
+    cs->fired_jitter_us = 0;
+    cs->armed_us = t0_us + jitter;
+    cs->stats.wall_aligned = aligned;
+    cs->stats.phase_us = phase_us;
+    cs->stats.jitter_bound_us = jitter_bound_us;
+    cs->running = true;
+    portEXIT_CRITICAL(&cs->mux);
+
+    ESP_LOGI(TAG, "period %lld ms, phase %lld ms, jitter <= %lld ms, first slot in %lld ms%s, missed slots: %s",
+             (long long)(period_us / 1000), (long long)(phase_us / 1000), (long long)(jitter_bound_us / 1000),
+             (long long)((t0_us + jitter - now) / 1000), aligned ? " (wall-clock aligned)" : "",
+             policy == CAPTURE_SCHED_MISSED_CATCH_UP ? "catch up" : "skip");
+    return esp_timer_start_once(cs->timer, (uint64_t)(t0_us + jitter - now));
+}
+
+void capture_sched_stop(capture_sched_t *cs)
+{
+    if (!cs || !cs->timer) {
+        return;
+    }
+    portENTER_CRITICAL(&cs->mux);
+    cs->running = false;
+    portEXIT_CRITICAL(&cs->mux);
+    (void)esp_timer_stop(cs->timer);
+}
+
+bool capture_sched_running(capture_sched_t *cs)
+{
+    if (!cs->timer) {
+        return false;
+    }
+    portENTER_CRITICAL(&cs->mux);
+    bool running = cs->running;
+    portEXIT_CRITICAL(&cs->mux);
+    return running;
+}
+
+bool capture_sched_begin_slot(capture_sched_t *cs, int64_t *out_deadline_us)
+{
+    int64_t now = esp_timer_get_time();
+    if (!cs->running || now < cs->t0_us) {
+        return false;
+    }
+
+    int64_t current = (now - cs->t0_us) / cs->period_us;
+    if (current < cs->next_slot) {
+        return false;
+    }
+    int64_t behind = current - cs->next_slot;
+
+    int64_t serve = current;
+    uint32_t skipped = 0;
+    bool late = false;
+    if (cs->policy == CAPTURE_SCHED_MISSED_CATCH_UP && behind > 0) {
+        int64_t backlog = behind > CAPTURE_SCHED_MAX_CATCH_UP ? CAPTURE_SCHED_MAX_CATCH_UP : behind;
+        serve = current - backlog;
+        skipped = (uint32_t)(behind - backlog);
+        late = true;
+    } else {
+        skipped = (uint32_t)behind;
+    }
+    cs->next_slot = serve + 1;
+
+    portENTER_CRITICAL(&cs->mux);
+    // The random delay is intended; only lateness beyond it counts as jitter.
+    int64_t deadline = slot_deadline(cs, serve) + (late ? 0 : cs->fired_jitter_us);
+    int64_t lateness = now - deadline;
+    cs->stats.skipped += skipped;
+    if (late) {
+        cs->stats.caught_up++;
+    } else {
+        cs->stats.slots++;
+        cs->stats.jitter_last_us = lateness;
+        cs->stats.jitter_total_us += lateness;
+        if (lateness > cs->stats.jitter_max_us) {
+            cs->stats.jitter_max_us = lateness;
+        }
+    }
+    portEXIT_CRITICAL(&cs->mux);
+
+    if (skipped > 0) {
+        ESP_LOGW(TAG, "missed %u capture slot(s)", (unsigned)skipped);
+    }
+    if (cs->next_slot <= current) {
+        // More missed slots to serve; come straight back instead of waiting for the timer.
+        xTaskNotify(cs->task, cs->notify_bits, eSetBits);
+    }
+
+    if (out_deadline_us) {
+        *out_deadline_us = deadline;
+    }
+    return true;
+}
+
+int64_t capture_sched_next_deadline(capture_sched_t *cs)
+{
+    if (!cs->timer) {
+        return 0;
+    }
+    portENTER_CRITICAL(&cs->mux);
+    int64_t next = cs->running ? cs->armed_us : 0;
+    portEXIT_CRITICAL(&cs->mux);
+    return next;
+}
+
+void capture_sched_get_stats(capture_sched_t *cs, capture_sched_stats_t *out)
+{
+    if (!cs->timer) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    portENTER_CRITICAL(&cs->mux);
+    *out = cs->stats;
+    portEXIT_CRITICAL(&cs->mux);
+}
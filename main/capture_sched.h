@@ -0,0 +1,87 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CAPTURE_SCHED_MISSED_SKIP = 0,     // resume at the current slot; missed ones are dropped
+    CAPTURE_SCHED_MISSED_CATCH_UP = 1, // serve missed slots back to back (bounded)
+} capture_sched_missed_policy_t;
+
+typedef struct {
+    uint32_t slots;          // slots served on time (the current slot when the task woke)
+    uint32_t skipped;        // slots never served
+    uint32_t caught_up;      // slots served late under CAPTURE_SCHED_MISSED_CATCH_UP
+    int64_t jitter_last_us;  // wake-up lateness of the last on-time slot
+    int64_t jitter_max_us;
+    int64_t jitter_total_us; // sum over `slots`, for the mean
+    bool wall_aligned;       // slots sit on wall-clock multiples of the period (plus the phase)
+    int64_t phase_us;        // offset of the grid within the period
+    int64_t jitter_bound_us; // bound of the random delay added to each slot
+} capture_sched_stats_t;
+
+/**
+ * Fires at absolute deadlines t0 + k * period from an esp_timer, so neither capture/upload time
+ * nor the FreeRTOS tick rate shifts the cadence. The timer re-arms itself for the next slot and
+ * sets `notify_bits` on the owning task; the task calls capture_sched_begin_slot() on each wake.
+ */
+typedef struct {
+    esp_timer_handle_t timer;
+    TaskHandle_t task;
+    uint32_t notify_bits;
+    portMUX_TYPE mux;
+    bool running;
+    int64_t t0_us;
+    int64_t period_us;
+    int64_t next_slot; // first slot not yet served
+    int64_t jitter_bound_us;
+    int64_t armed_us;        // when the timer fires next
+    int64_t armed_jitter_us; // random delay included in armed_us
+    int64_t fired_jitter_us; // random delay of the slot that fired last
+    capture_sched_missed_policy_t policy;
+    capture_sched_stats_t stats;
+} capture_sched_t;
+
+/** Create the timer. `task` receives `notify_bits` (eSetBits) when a slot is due. */
+esp_err_t capture_sched_init(capture_sched_t *cs, TaskHandle_t task, uint32_t notify_bits);
+
+/**
+ * (Re)start the schedule. With `align_wall_clock` and a valid system time, slots land on multiples
+ * of the period in UTC (e.g. :00 of every minute); otherwise slot 0 is due right away. Either way the
+ * grid is shifted by `phase_us` (taken modulo the period), and each slot fires up to `jitter_bound_us`
+ * late at random (capped at half the period), so a fleet sharing one interval does not fire in lockstep.
+ */
+esp_err_t capture_sched_start(capture_sched_t *cs, int64_t period_us, bool align_wall_clock,
+                              capture_sched_missed_policy_t policy, int64_t phase_us, int64_t jitter_bound_us);
+
+void capture_sched_stop(capture_sched_t *cs);
+
+bool capture_sched_running(capture_sched_t *cs);
+
+/** True once the system clock has been set (e.g. by SNTP), so wall-clock alignment is possible. */
+bool capture_sched_wall_clock_valid(void);
+
+/**
+ * Account for a wake-up. Returns true if a slot should be served now and stores its deadline in
+ * `out_deadline_us`; false for spurious wakes (slot already served, or a stale notification).
+ */
+bool capture_sched_begin_slot(capture_sched_t *cs, int64_t *out_deadline_us);
+
+/** esp_timer time the next slot fires (jitter included), or 0 when the schedule is stopped. Thread-safe. */
+int64_t capture_sched_next_deadline(capture_sched_t *cs);
+
+void capture_sched_get_stats(capture_sched_t *cs, capture_sched_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
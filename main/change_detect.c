@@ -0,0 +1,69 @@
+#include "change_detect.h"
+
+#include <string.h>
+
+// Luma difference (0..255) for a grid cell to count as changed; above sensor noise and JPEG
+// requantization, below a person or animal entering a cell.
+#define CHANGE_DETECT_CELL_DELTA 10
+
+#define CHANGE_DETECT_CELLS (JPEG_DC_GRID_W * JPEG_DC_GRID_H)
+
+void change_detect_init(change_detect_t *cd, jpeg_dc_decoder_t *dec)
+{
+    memset(cd, 0, sizeof(*cd));
+    cd->dec = dec;
+}
+
+void change_detect_configure(change_detect_t *cd, int threshold_permille, int heartbeat)
+{
+    if (threshold_permille <= 0 && cd->threshold_permille > 0) {
+        // Turned off: start from a fresh reference if it is turned on again.
+        cd->have_ref = false;
+    }
+    cd->threshold_permille = threshold_permille < 0 ? 0 : threshold_permille;
+    cd->heartbeat = heartbeat < 1 ? 1 : heartbeat;
+}
+
+bool change_detect_enabled(const change_detect_t *cd)
+{
+    return cd->threshold_permille > 0;
+}
+
+static change_detect_verdict_t send(change_detect_t *cd, change_detect_verdict_t verdict)
+{
+    cd->ref = cd->cur;
+    cd->have_ref = true;
+    cd->unchanged_run = 0;
+    if (verdict == CHANGE_DETECT_HEARTBEAT) {
+        cd->stats.heartbeats++;
+    } else {
+        cd->stats.changed++;
+    }
+    return verdict;
+}
+
+change_detect_verdict_t change_detect_check(change_detect_t *cd, const uint8_t *jpg, size_t len)
+{
+    cd->stats.checked++;
+    if (!jpeg_dc_luma_grid(cd->dec, jpg, len, &cd->cur)) {
+        cd->stats.undecodable++;
+        return CHANGE_DETECT_UNDECODABLE;
+    }
+    if (!cd->have_ref) {
+        cd->stats.last_changed_permille = 1000;
+        return send(cd, CHANGE_DETECT_CHANGED);
+    }
+
+    int changed = jpeg_dc_grid_changed_cells(&cd->ref, &cd->cur, CHANGE_DETECT_CELL_DELTA);
+    cd->stats.last_changed_permille = changed * 1000 / CHANGE_DETECT_CELLS;
+    if (changed * 1000 >= cd->threshold_permille * CHANGE_DETECT_CELLS) {
+        return send(cd, CHANGE_DETECT_CHANGED);
+    }
+    if (cd->unchanged_run + 1 >= cd->heartbeat) {
+        return send(cd, CHANGE_DETECT_HEARTBEAT);
+    }
+    cd->unchanged_run++;
+    cd->stats.skipped++;
+    cd->stats.bytes_skipped += len;
+    return CHANGE_DETECT_UNCHANGED;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "jpeg_dc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CHANGE_DETECT_CHANGED = 0,     // scene changed (or nothing to compare against yet): send
+    CHANGE_DETECT_UNCHANGED = 1,   // below the threshold: skip
+    CHANGE_DETECT_HEARTBEAT = 2,   // unchanged, but sent so the collector keeps hearing from us
+    CHANGE_DETECT_UNDECODABLE = 3, // could not be analysed: send
+} change_detect_verdict_t;
+
+typedef struct {
+    uint32_t checked;
+    uint32_t changed;
+    uint32_t skipped;
+    uint32_t heartbeats;
+    uint32_t undecodable;
+    uint64_t bytes_skipped;
+    int last_changed_permille; // share of grid cells that changed in the last frame checked
+} change_detect_stats_t;
+
+/**
+ * Decides whether a frame differs enough from the last one sent to be worth uploading, using
+ * the DC-only luma grid from jpeg_dc.h. Comparing against the last frame sent (not the previous
+ * capture) means slow drift still triggers an upload once it adds up.
+ *
+ * Single-threaded and free of ESP-IDF dependencies, so tools/change_bench.c replays the same
+ * decisions on the host.
+ */
+typedef struct {
+    jpeg_dc_decoder_t *dec; // scratch, may be shared with other users on the same task
+    jpeg_dc_grid_t ref; // grid of the last frame sent
+    jpeg_dc_grid_t cur;
+    bool have_ref;
+    int threshold_permille;
+    int heartbeat;
+    int unchanged_run; // frames skipped since the last one sent
+    change_detect_stats_t stats;
+} change_detect_t;
+
+void change_detect_init(change_detect_t *cd, jpeg_dc_decoder_t *dec);
+
+/**
+ * `threshold_permille`: share of grid cells (1/1000) that must change for a frame to count as
+ * changed; 0 turns detection off (everything is sent). `heartbeat`: send at least every N-th frame.
+ */
+void change_detect_configure(change_detect_t *cd, int threshold_permille, int heartbeat);
+
+bool change_detect_enabled(const change_detect_t *cd);
+
+/** Classify the next frame; only CHANGE_DETECT_UNCHANGED means it should not be uploaded. */
+change_detect_verdict_t change_detect_check(change_detect_t *cd, const uint8_t *jpg, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
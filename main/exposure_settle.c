@@ -0,0 +1,47 @@
+#include "exposure_settle.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void exposure_settle_init(exposure_settle_t *es, jpeg_dc_decoder_t *dec)
+{
+    memset(es, 0, sizeof(*es));
+    es->dec = dec;
+}
+
+void exposure_settle_begin(exposure_settle_t *es)
+{
+    es->frames = 0;
+    es->last_luma = -1;
+    es->stable_run = 0;
+    es->luma_first = -1;
+}
+
+static int grid_mean(const jpeg_dc_grid_t *grid)
+{
+    uint32_t sum = 0;
+    for (int y = 0; y < JPEG_DC_GRID_H; y++) {
+        for (int x = 0; x < JPEG_DC_GRID_W; x++) {
+            sum += grid->cells[y][x];
+        }
+    }
+    return (int)(sum / (JPEG_DC_GRID_W * JPEG_DC_GRID_H));
+}
+
+exposure_settle_verdict_t exposure_settle_feed(exposure_settle_t *es, const uint8_t *jpg, size_t len)
+{
+    es->frames++;
+    if (!jpeg_dc_luma_grid(es->dec, jpg, len, &es->grid)) {
+        return EXPOSURE_SETTLE_UNDECODABLE;
+    }
+    int luma = grid_mean(&es->grid);
+    if (es->last_luma < 0) {
+        es->luma_first = luma;
+    } else if (abs(luma - es->last_luma) <= EXPOSURE_SETTLE_TOLERANCE) {
+        es->stable_run++;
+    } else {
+        es->stable_run = 0;
+    }
+    es->last_luma = luma;
+    return es->stable_run >= EXPOSURE_SETTLE_STABLE_PAIRS ? EXPOSURE_SETTLE_SETTLED : EXPOSURE_SETTLE_SETTLING;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "jpeg_dc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Mean luma change between successive frames (0..255) still counted as settled. */
+#define EXPOSURE_SETTLE_TOLERANCE 3
+
+/** Successive frame pairs within the tolerance before exposure counts as settled. */
+#define EXPOSURE_SETTLE_STABLE_PAIRS 2
+
+typedef enum {
+    EXPOSURE_SETTLE_SETTLING = 0,    // still moving: grab another frame
+    EXPOSURE_SETTLE_SETTLED = 1,     // stable for EXPOSURE_SETTLE_STABLE_PAIRS frames
+    EXPOSURE_SETTLE_UNDECODABLE = 2, // could not be measured: use it as it is
+} exposure_settle_verdict_t;
+
+/**
+ * Watches the mean luma of successive frames (from the DC-only grid, jpeg_dc.h) while the
+ * sensor's AEC/AGC adapts after a wake-up, and reports when it has stopped moving. Measuring the
+ * picture rather than the sensor registers works for every sensor model: the driver's
+ * `sensor_t.status` only caches the values last written, not the live exposure and gain.
+ *
+ * Single-threaded and free of ESP-IDF dependencies.
+ */
+typedef struct {
+    jpeg_dc_decoder_t *dec; // scratch, may be shared with other users on the same task
+    jpeg_dc_grid_t grid;
+    int frames;      // frames fed since exposure_settle_begin()
+    int last_luma;   // -1 before the first frame
+    int stable_run;  // successive pairs within the tolerance
+    int luma_first;  // mean luma of the first frame, for the log
+} exposure_settle_t;
+
+void exposure_settle_init(exposure_settle_t *es, jpeg_dc_decoder_t *dec);
+
+/** Start watching a new series of frames. */
+void exposure_settle_begin(exposure_settle_t *es);
+
+/** Feed the next frame of the series. */
+exposure_settle_verdict_t exposure_settle_feed(exposure_settle_t *es, const uint8_t *jpg, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,115 @@
+#include "frame_dedup.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+
+void frame_dedup_init(frame_dedup_t *fd)
+{
+    memset(fd, 0, sizeof(*fd));
+}
+
+esp_err_t frame_dedup_hash(const uint8_t *data, size_t len, uint8_t out[FRAME_DEDUP_HASH_LEN])
+{
+    // One call over the whole buffer: with CONFIG_MBEDTLS_HARDWARE_SHA the peripheral takes the frame
+    // in a single DMA run instead of block by block.
+    return mbedtls_sha256(data, len, out, 0) == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t frame_dedup_check(frame_dedup_t *fd, const uint8_t *data, size_t len, uint32_t seq,
+                            uint8_t out_hash[FRAME_DEDUP_HASH_LEN], bool *out_duplicate, uint32_t *out_first_seq)
+{
+    *out_duplicate = false;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = frame_dedup_hash(data, len, out_hash);
+    if (err != ESP_OK) {
+        return err;
+    }
+    int64_t dt_us = esp_timer_get_time() - t0;
+    fd->stats.hashed++;
+    fd->stats.bytes_hashed += len;
+    fd->stats.hash_us_total += dt_us;
+    fd->stats.hash_us_last = dt_us;
+    if (dt_us > fd->stats.hash_us_max) {
+        fd->stats.hash_us_max = dt_us;
+    }
+
+    for (size_t i = 0; i < fd->count; i++) {
+        if (memcmp(fd->recent[i], out_hash, FRAME_DEDUP_HASH_LEN) == 0) {
+            fd->stats.duplicates++;
+            fd->stats.duplicate_bytes += len;
+            if (out_first_seq) {
+                *out_first_seq = fd->recent_seq[i];
+            }
+            *out_duplicate = true;
+            return ESP_OK;
+        }
+    }
+
+    memcpy(fd->recent[fd->next], out_hash, FRAME_DEDUP_HASH_LEN);
+    fd->recent_seq[fd->next] = seq;
+    fd->next = (fd->next + 1) % FRAME_DEDUP_RECENT;
+    if (fd->count < FRAME_DEDUP_RECENT) {
+        fd->count++;
+    }
+    return ESP_OK;
+}
+
+void frame_dedup_to_hex(const uint8_t hash[FRAME_DEDUP_HASH_LEN], char out[FRAME_DEDUP_HEX_LEN])
+{
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < FRAME_DEDUP_HASH_LEN; i++) {
+        out[2 * i] = digits[hash[i] >> 4];
+        out[2 * i + 1] = digits[hash[i] & 0x0f];
+    }
+    out[FRAME_DEDUP_HEX_LEN - 1] = '\0';
+}
+
+static uint32_t kib_per_s(size_t len, int rounds, int64_t total_us)
+{
+    if (total_us <= 0) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)len * (uint64_t)rounds * 1000000ULL) / 1024ULL / (uint64_t)total_us);
+}
+
+esp_err_t frame_dedup_benchmark(size_t len, int rounds, frame_dedup_bench_t *out)
+{
+    if (len == 0 || rounds <= 0 || !out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint8_t *buf = malloc(len);
+    if (!buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    memset(buf, 0xa5, len); // SHA cost does not depend on the content
+
+    uint8_t digest[FRAME_DEDUP_HASH_LEN];
+    esp_err_t err = ESP_OK;
+    int64_t t0 = esp_timer_get_time();
+    for (int i = 0; i < rounds && err == ESP_OK; i++) {
+        err = frame_dedup_hash(buf, len, digest);
+    }
+    int64_t sha256_total = esp_timer_get_time() - t0;
+
+    t0 = esp_timer_get_time();
+    for (int i = 0; i < rounds && err == ESP_OK; i++) {
+        err = mbedtls_sha1(buf, len, digest) == 0 ? ESP_OK : ESP_FAIL;
+    }
+    int64_t sha1_total = esp_timer_get_time() - t0;
+    free(buf);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    out->len = len;
+    out->rounds = rounds;
+    out->sha256_us = sha256_total / rounds;
+    out->sha1_us = sha1_total / rounds;
+    out->sha256_kbps = kib_per_s(len, rounds, sha256_total);
+    out->sha1_kbps = kib_per_s(len, rounds, sha1_total);
+    return ESP_OK;
+}
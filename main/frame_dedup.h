@@ -0,0 +1,85 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FRAME_DEDUP_HASH_LEN 32 // SHA-256
+#define FRAME_DEDUP_HEX_LEN (FRAME_DEDUP_HASH_LEN * 2 + 1)
+
+/** Recent frame hashes remembered; a frame matching any of them is a duplicate. */
+#define FRAME_DEDUP_RECENT 16
+
+/** Request header carrying the hex SHA-256 of the JPEG (comma-separated, in order, for batches). */
+#define FRAME_DEDUP_HASH_HEADER "X-Frame-SHA256"
+
+/** Request header naming the earlier frame (by hash) a duplicate is identical to. */
+#define FRAME_DEDUP_SAME_AS_HEADER "X-Frame-Same-As"
+
+typedef enum {
+    FRAME_DEDUP_OFF = 0,       // hash sent with every upload, duplicates uploaded as usual
+    FRAME_DEDUP_MARK = 1,      // duplicates uploaded in full and tagged with FRAME_DEDUP_SAME_AS_HEADER
+    FRAME_DEDUP_REFERENCE = 2, // duplicates sent as a body-less "same as <hash>" request
+    FRAME_DEDUP_SKIP = 3,      // duplicates not sent at all
+} frame_dedup_mode_t;
+
+typedef struct {
+    uint32_t hashed;
+    uint64_t bytes_hashed;
+    int64_t hash_us_total;
+    int64_t hash_us_last;
+    int64_t hash_us_max;
+    uint32_t duplicates;
+    uint64_t duplicate_bytes;
+} frame_dedup_stats_t;
+
+/** Table of recently seen frame hashes. Single-threaded (capture task). */
+typedef struct {
+    uint8_t recent[FRAME_DEDUP_RECENT][FRAME_DEDUP_HASH_LEN];
+    uint32_t recent_seq[FRAME_DEDUP_RECENT]; // seq of the frame each hash was first seen on
+    size_t count;
+    size_t next; // slot overwritten by the next new hash
+    frame_dedup_stats_t stats;
+} frame_dedup_t;
+
+/** Throughput of the SHA engine through mbedTLS for one buffer size. */
+typedef struct {
+    size_t len;
+    int rounds;
+    int64_t sha256_us; // mean time per buffer
+    int64_t sha1_us;
+    uint32_t sha256_kbps; // KiB/s
+    uint32_t sha1_kbps;
+} frame_dedup_bench_t;
+
+void frame_dedup_init(frame_dedup_t *fd);
+
+/** SHA-256 of `len` bytes through mbedTLS, which uses the SHA peripheral when it is enabled. */
+esp_err_t frame_dedup_hash(const uint8_t *data, size_t len, uint8_t out[FRAME_DEDUP_HASH_LEN]);
+
+/**
+ * Hash a frame, record the timing, and look the hash up among the recent ones. `*out_duplicate`
+ * is set if the same bytes were seen before; `*out_first_seq` (may be NULL) is then the seq of the
+ * frame they were first seen on. New hashes replace the oldest entry.
+ */
+esp_err_t frame_dedup_check(frame_dedup_t *fd, const uint8_t *data, size_t len, uint32_t seq,
+                            uint8_t out_hash[FRAME_DEDUP_HASH_LEN], bool *out_duplicate, uint32_t *out_first_seq);
+
+/** Lower-case hex of a hash, NUL terminated. */
+void frame_dedup_to_hex(const uint8_t hash[FRAME_DEDUP_HASH_LEN], char out[FRAME_DEDUP_HEX_LEN]);
+
+/**
+ * Time SHA-256 and SHA-1 over `rounds` buffers of `len` bytes (allocated like a frame copy).
+ * Blocks the caller for the duration; meant for the diagnostics page, not the capture path.
+ */
+esp_err_t frame_dedup_benchmark(size_t len, int rounds, frame_dedup_bench_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,182 @@
+#include "frame_quality.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Mean luma range that scores full marks for exposure; the score falls linearly to 0 at black and white.
+#define FRAME_QUALITY_EXPOSURE_LOW 80
+#define FRAME_QUALITY_EXPOSURE_HIGH 170
+
+void frame_quality_init(frame_quality_t *fq, jpeg_dc_decoder_t *dec)
+{
+    memset(fq, 0, sizeof(*fq));
+    fq->dec = dec;
+}
+
+void frame_quality_configure(frame_quality_t *fq, int min_luma, int max_clip_permille, int min_sharpness)
+{
+    fq->min_luma = min_luma < 0 ? 0 : min_luma;
+    fq->max_clip_permille = max_clip_permille < 0 ? 0 : max_clip_permille;
+    fq->min_sharpness = min_sharpness < 0 ? 0 : min_sharpness;
+}
+
+bool frame_quality_enabled(const frame_quality_t *fq)
+{
+    return fq->min_luma > 0 || fq->max_clip_permille > 0 || fq->min_sharpness > 0;
+}
+
+void frame_quality_free(frame_quality_t *fq)
+{
+    free(fq->image);
+    fq->image = NULL;
+    fq->image_cap = 0;
+}
+
+static bool decode(frame_quality_t *fq, const uint8_t *jpg, size_t len, uint16_t *w, uint16_t *h)
+{
+    if (jpeg_dc_luma_image(fq->dec, jpg, len, fq->image, fq->image_cap, w, h)) {
+        return true;
+    }
+    size_t need = (size_t)*w * *h;
+    if (need <= fq->image_cap) {
+        return false; // a real decode error, not a short buffer
+    }
+    // First frame, or a larger frame size than before.
+    uint8_t *image = realloc(fq->image, need);
+    if (!image) {
+        return false;
+    }
+    fq->image = image;
+    fq->image_cap = need;
+    return jpeg_dc_luma_image(fq->dec, jpg, len, fq->image, fq->image_cap, w, h);
+}
+
+static int clamp_score(int score)
+{
+    return score < 0 ? 0 : score > 100 ? 100 : score;
+}
+
+static void measure(frame_quality_t *fq, uint16_t w, uint16_t h, frame_quality_result_t *r)
+{
+    const uint8_t *img = fq->image;
+    uint32_t pixels = (uint32_t)w * h;
+    memset(fq->hist, 0, sizeof(fq->hist));
+    for (uint32_t i = 0; i < pixels; i++) {
+        fq->hist[img[i]]++;
+    }
+    uint64_t sum = 0;
+    uint32_t crushed = 0;
+    uint32_t clipped = 0;
+    for (int v = 0; v < 256; v++) {
+        sum += (uint64_t)fq->hist[v] * (uint32_t)v;
+        if (v <= FRAME_QUALITY_CLIP_LOW) {
+            crushed += fq->hist[v];
+        } else if (v >= FRAME_QUALITY_CLIP_HIGH) {
+            clipped += fq->hist[v];
+        }
+    }
+
+    // Laplacian over the interior; its variance drops as edges soften.
+    int64_t lap_sum = 0;
+    uint64_t lap_sq = 0;
+    uint32_t lap_n = 0;
+    for (int y = 1; y + 1 < h; y++) {
+        const uint8_t *row = img + (size_t)y * w;
+        for (int x = 1; x + 1 < w; x++) {
+            int lap = 4 * row[x] - row[x - 1] - row[x + 1] - row[x - w] - row[x + w];
+            lap_sum += lap;
+            lap_sq += (uint64_t)(lap * lap);
+        }
+        lap_n += (uint32_t)(w - 2);
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->width = w;
+    r->height = h;
+    if (pixels == 0) {
+        return;
+    }
+    r->mean_luma = (uint8_t)(sum / pixels);
+    r->crushed_permille = (uint16_t)((uint64_t)crushed * 1000 / pixels);
+    r->clipped_permille = (uint16_t)((uint64_t)clipped * 1000 / pixels);
+    if (lap_n > 0) {
+        int64_t mean = lap_sum / (int64_t)lap_n;
+        int64_t var = (int64_t)(lap_sq / lap_n) - mean * mean;
+        r->sharpness = var > 0 ? (uint32_t)var : 0;
+    }
+
+    int exposure = 100;
+    if (r->mean_luma < FRAME_QUALITY_EXPOSURE_LOW) {
+        exposure = r->mean_luma * 100 / FRAME_QUALITY_EXPOSURE_LOW;
+    } else if (r->mean_luma > FRAME_QUALITY_EXPOSURE_HIGH) {
+        exposure = (255 - r->mean_luma) * 100 / (255 - FRAME_QUALITY_EXPOSURE_HIGH);
+    }
+    int clipping = 100 - (r->crushed_permille + r->clipped_permille) / 10;
+    int sharp = r->sharpness >= FRAME_QUALITY_SHARP_REFERENCE
+                    ? 100
+                    : (int)(r->sharpness * 100 / FRAME_QUALITY_SHARP_REFERENCE);
+    int score = exposure < clipping ? exposure : clipping;
+    r->score = (uint8_t)clamp_score(sharp < score ? sharp : score);
+}
+
+frame_quality_verdict_t frame_quality_check(frame_quality_t *fq, const uint8_t *jpg, size_t len,
+                                            frame_quality_result_t *out)
+{
+    fq->stats.checked++;
+    uint16_t w = 0;
+    uint16_t h = 0;
+    if (!decode(fq, jpg, len, &w, &h)) {
+        fq->stats.undecodable++;
+        memset(&fq->last, 0, sizeof(fq->last));
+        if (out) {
+            *out = fq->last;
+        }
+        return FRAME_QUALITY_UNDECODABLE;
+    }
+    measure(fq, w, h, &fq->last);
+    if (out) {
+        *out = fq->last;
+    }
+
+    // A dark frame is also soft and noisy; report the cause a user can act on first.
+    const frame_quality_result_t *r = &fq->last;
+    if (fq->min_luma > 0 && r->mean_luma < fq->min_luma) {
+        fq->stats.dark++;
+        return FRAME_QUALITY_DARK;
+    }
+    if (fq->max_clip_permille > 0 && r->clipped_permille > fq->max_clip_permille) {
+        fq->stats.overexposed++;
+        return FRAME_QUALITY_OVEREXPOSED;
+    }
+    if (fq->min_sharpness > 0 && r->sharpness < (uint32_t)fq->min_sharpness) {
+        fq->stats.blurred++;
+        return FRAME_QUALITY_BLURRED;
+    }
+    fq->stats.passed++;
+    return FRAME_QUALITY_OK;
+}
+
+int frame_quality_format(const frame_quality_result_t *r, char *buf, size_t len)
+{
+    return snprintf(buf, len, "score=%u;luma=%u;crushed=%u;clipped=%u;sharpness=%u", (unsigned)r->score,
+                    (unsigned)r->mean_luma, (unsigned)r->crushed_permille, (unsigned)r->clipped_permille,
+                    (unsigned)r->sharpness);
+}
+
+const char *frame_quality_verdict_name(frame_quality_verdict_t verdict)
+{
+    switch (verdict) {
+    case FRAME_QUALITY_OK:
+        return "ok";
+    case FRAME_QUALITY_DARK:
+        return "dark";
+    case FRAME_QUALITY_OVEREXPOSED:
+        return "overexposed";
+    case FRAME_QUALITY_BLURRED:
+        return "blurred";
+    case FRAME_QUALITY_UNDECODABLE:
+        return "undecodable";
+    }
+    return "?";
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "jpeg_dc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** 1/8-scale pixels at or below this count as crushed black, at or above FRAME_QUALITY_CLIP_HIGH as blown out. */
+#define FRAME_QUALITY_CLIP_LOW 5
+#define FRAME_QUALITY_CLIP_HIGH 250
+
+/** Laplacian variance that scores full marks for sharpness; typical of a focused outdoor scene at 1/8 scale. */
+#define FRAME_QUALITY_SHARP_REFERENCE 400
+
+/** Longest frame_quality_format() output including the terminator. */
+#define FRAME_QUALITY_TEXT_MAX 72
+
+typedef enum {
+    FRAME_QUALITY_OK = 0,
+    FRAME_QUALITY_DARK = 1,        // mean luma below the minimum
+    FRAME_QUALITY_OVEREXPOSED = 2, // too much of the frame blown out
+    FRAME_QUALITY_BLURRED = 3,     // Laplacian variance below the minimum (focus, fog, motion)
+    FRAME_QUALITY_UNDECODABLE = 4, // could not be analysed: passed on unscored
+} frame_quality_verdict_t;
+
+typedef struct {
+    uint16_t width; // analysed image, 1/8 of the frame
+    uint16_t height;
+    uint8_t mean_luma;
+    uint16_t crushed_permille; // pixels at or below FRAME_QUALITY_CLIP_LOW
+    uint16_t clipped_permille; // pixels at or above FRAME_QUALITY_CLIP_HIGH
+    uint32_t sharpness;        // variance of the 4-neighbour Laplacian
+    uint8_t score;             // 0..100, the worst of the exposure, clipping and sharpness scores
+} frame_quality_result_t;
+
+typedef struct {
+    uint32_t checked;
+    uint32_t passed;
+    uint32_t dark;
+    uint32_t overexposed;
+    uint32_t blurred;
+    uint32_t undecodable;
+} frame_quality_stats_t;
+
+/**
+ * Scores a JPEG from its DC-only luma image (jpeg_dc_luma_image(), no IDCT): histogram mean and
+ * clipping for exposure, Laplacian variance for sharpness. At 1/8 scale only blur that spans whole
+ * blocks registers, which is what fog, a lost focus or a camera moving during exposure produce.
+ *
+ * Single-threaded and free of ESP-IDF dependencies, so tools/quality_bench.c runs the same code on
+ * the host.
+ */
+typedef struct {
+    jpeg_dc_decoder_t *dec; // scratch, may be shared with other users on the same task
+    uint8_t *image; // grown to the largest frame seen
+    size_t image_cap;
+    uint32_t hist[256];
+    int min_luma;          // 0 = no darkness check
+    int max_clip_permille; // 0 = no overexposure check
+    int min_sharpness;     // 0 = no blur check
+    frame_quality_stats_t stats;
+    frame_quality_result_t last;
+} frame_quality_t;
+
+void frame_quality_init(frame_quality_t *fq, jpeg_dc_decoder_t *dec);
+
+/** Set the rejection thresholds; each one is off at 0. */
+void frame_quality_configure(frame_quality_t *fq, int min_luma, int max_clip_permille, int min_sharpness);
+
+/** True if any threshold is set. */
+bool frame_quality_enabled(const frame_quality_t *fq);
+
+/** Measure a frame and judge it against the thresholds. `out` (optional) receives the measurement. */
+frame_quality_verdict_t frame_quality_check(frame_quality_t *fq, const uint8_t *jpg, size_t len,
+                                            frame_quality_result_t *out);
+
+/** Release the image buffer. */
+void frame_quality_free(frame_quality_t *fq);
+
+/** "score=87;luma=112;crushed=3;clipped=0;sharpness=412", for an upload header or form part. */
+int frame_quality_format(const frame_quality_result_t *r, char *buf, size_t len);
+
+const char *frame_quality_verdict_name(frame_quality_verdict_t verdict);
+
+#ifdef __cplusplus
+}
+#endif
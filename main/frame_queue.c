@@ -0,0 +1,102 @@
+#include "frame_queue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+
+static void *frame_buf_alloc(size_t len)
+{
+#if CONFIG_SPIRAM
+    // Keep queued frames out of internal RAM when PSRAM is available.
+    void *p = heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (p) {
+        return p;
+    }
+#endif
+    return malloc(len);
+}
+
+cam_frame_t *cam_frame_alloc(const uint8_t *data, size_t len)
+{
+    cam_frame_t *frame = calloc(1, sizeof(*frame));
+    if (!frame) {
+        return NULL;
+    }
+    frame->buf = frame_buf_alloc(len);
+    if (!frame->buf) {
+        free(frame);
+        return NULL;
+    }
+    if (data) {
+        memcpy(frame->buf, data, len);
+    }
+    frame->len = len;
+    frame->capture_age_ms = -1;
+    return frame;
+}
+
+void cam_frame_free(cam_frame_t *frame)
+{
+    if (!frame) {
+        return;
+    }
+    free(frame->buf);
+    free(frame->regions_json);
+    free(frame);
+}
+
+esp_err_t frame_queue_init(frame_queue_t *fq, size_t depth)
+{
+    if (!fq || depth == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(fq, 0, sizeof(*fq));
+    fq->q = xQueueCreate(depth, sizeof(cam_frame_t *));
+    if (!fq->q) {
+        return ESP_ERR_NO_MEM;
+    }
+    fq->depth = depth;
+    return ESP_OK;
+}
+
+bool frame_queue_push(frame_queue_t *fq, cam_frame_t *frame, frame_queue_drop_policy_t policy)
+{
+    while (xQueueSend(fq->q, &frame, 0) != pdTRUE) {
+        if (policy == FRAME_QUEUE_DROP_NEWEST) {
+            cam_frame_free(frame);
+            fq->stats.dropped++;
+            return false;
+        }
+
+        // The consumer may have drained a slot in the meantime; just retry in that case.
+        cam_frame_t *oldest = NULL;
+        if (xQueueReceive(fq->q, &oldest, 0) == pdTRUE) {
+            cam_frame_free(oldest);
+            fq->stats.dropped++;
+        }
+    }
+
+    fq->stats.pushed++;
+    uint32_t n = (uint32_t)uxQueueMessagesWaiting(fq->q);
+    if (n > fq->stats.high_water) {
+        fq->stats.high_water = n;
+    }
+    return true;
+}
+
+cam_frame_t *frame_queue_pop(frame_queue_t *fq, TickType_t wait)
+{
+    cam_frame_t *frame = NULL;
+    if (xQueueReceive(fq->q, &frame, wait) != pdTRUE) {
+        return NULL;
+    }
+    fq->stats.popped++;
+    return frame;
+}
+
+size_t frame_queue_count(const frame_queue_t *fq)
+{
+    return fq->q ? (size_t)uxQueueMessagesWaiting(fq->q) : 0;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "esp_err.h"
+#include "frame_dedup.h"
+#include "frame_quality.h"
+#include "window_preset.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CAM_FRAME_JPEG = 0,
+    CAM_FRAME_VEG_RECORD = 1, // `buf` holds a veg_index JSON record instead of an image
+    CAM_FRAME_TILE_DELTA = 2, // `buf` holds the changed strips of a JPEG (tile_diff.h) instead of all of it
+} cam_frame_kind_t;
+
+/** Longest cam_frame_t::event text including the terminator. */
+#define CAM_FRAME_EVENT_TEXT_MAX 24
+
+/** Longest cam_frame_t::burst text including the terminator. */
+#define CAM_FRAME_BURST_TEXT_MAX 40
+
+/** A captured JPEG frame that owns its buffer (detached from the camera driver). */
+typedef struct {
+    cam_frame_kind_t kind;
+    uint8_t *buf;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+    int64_t capture_us; // esp_timer time at which the driver finished the frame (of boot `boot`)
+    uint32_t seq;
+    uint32_t boot;      // boot number of the run that captured it; with `seq` unique across reboots
+    int64_t unix_us;    // capture time in microseconds since the Unix epoch; 0 if the clock was not set
+    uint8_t sha256[FRAME_DEDUP_HASH_LEN]; // valid when `hashed`
+    bool hashed;
+    bool duplicate; // same bytes as a recent frame; `sha256` is then also that frame's hash
+    char *regions_json; // per-region statistics (roi_stats.h) sent along with the JPEG; owned, may be NULL
+    char quality[FRAME_QUALITY_TEXT_MAX]; // quality gate score (frame_quality_format()); empty if not scored
+    int32_t capture_age_ms; // exposure start -> handed to the capture task; -1 if unknown (spooled frames)
+    char window[WINDOW_PRESET_NAME_MAX]; // sensor window preset it was taken with; empty = normal frame size
+    char event[CAM_FRAME_EVENT_TEXT_MAX]; // "<event>;<ms from the trigger>" for pre-event buffer frames; empty otherwise
+    char burst[CAM_FRAME_BURST_TEXT_MAX]; // "<burst>;<index>;<count>;<us from the first frame>" for burst frames; empty otherwise
+    int64_t trigger_us; // esp_timer time of the on-demand request it answers (cam_uploader_trigger_capture()); 0 if none
+} cam_frame_t;
+
+typedef enum {
+    FRAME_QUEUE_DROP_OLDEST = 0,
+    FRAME_QUEUE_DROP_NEWEST = 1,
+} frame_queue_drop_policy_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t popped;
+    uint32_t dropped;
+    uint32_t alloc_failures;
+    uint32_t high_water;
+} frame_queue_stats_t;
+
+/** Bounded single-producer/single-consumer queue of owned frames. */
+typedef struct {
+    QueueHandle_t q;
+    size_t depth;
+    frame_queue_stats_t stats;
+} frame_queue_t;
+
+/** Allocate a frame and copy `len` bytes of JPEG data into it. Returns NULL on OOM. */
+cam_frame_t *cam_frame_alloc(const uint8_t *data, size_t len);
+
+void cam_frame_free(cam_frame_t *frame);
+
+esp_err_t frame_queue_init(frame_queue_t *fq, size_t depth);
+
+/**
+ * Enqueue `frame`, taking ownership. When the queue is full the oldest queued frame or
+ * `frame` itself is freed according to `policy`. Returns false if `frame` was dropped.
+ */
+bool frame_queue_push(frame_queue_t *fq, cam_frame_t *frame, frame_queue_drop_policy_t policy);
+
+/** Dequeue the oldest frame, waiting up to `wait` ticks. Caller owns the result. */
+cam_frame_t *frame_queue_pop(frame_queue_t *fq, TickType_t wait);
+
+/** Number of frames currently queued. */
+size_t frame_queue_count(const frame_queue_t *fq);
+
+#ifdef __cplusplus
+}
+#endif
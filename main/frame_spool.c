@@ -0,0 +1,510 @@
+#include "frame_spool.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "frame_spool";
+
+#define SPOOL_SECTOR_SIZE 4096
+#define SPOOL_MAGIC 0x344c5053u // "SPL4" little-endian; the digit is the record layout version
+#define SPOOL_FLAG_SET 0xffffffffu
+#define SPOOL_FLAG_CLEARED 0x00000000u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t len; // payload bytes following the header
+    uint32_t frame_seq;
+    int64_t capture_us; // esp_timer time of boot `boot`
+    int64_t unix_us;
+    uint32_t boot;
+    uint16_t width;
+    uint16_t height;
+    uint32_t kind; // cam_frame_kind_t
+    uint32_t meta_len; // metadata block (spool_meta_t and the regions text) between header and payload
+    uint32_t meta_crc;
+    uint32_t data_crc;
+    uint32_t hdr_crc;   // CRC32 of all fields above
+    uint32_t committed; // SPOOL_FLAG_SET until the payload is fully written
+    uint32_t drained;   // SPOOL_FLAG_SET until the frame has been uploaded
+} spool_hdr_t;
+
+#define SPOOL_META_VERSION 2
+#define SPOOL_META_HASHED (1u << 0)
+#define SPOOL_META_DUPLICATE (1u << 1)
+
+/**
+ * Frame metadata that travels with the upload, written right after the header and followed by
+ * `regions_len` bytes of region statistics. Fields are only ever appended (with a version bump);
+ * a reader takes the first `size` bytes and leaves fields an older writer did not know empty.
+ */
+typedef struct {
+    uint16_t version;
+    uint16_t size; // sizeof(spool_meta_t) of the writer
+    uint32_t flags; // SPOOL_META_*
+    uint32_t regions_len;
+    uint8_t sha256[FRAME_DEDUP_HASH_LEN];
+    char quality[FRAME_QUALITY_TEXT_MAX];
+    char window[WINDOW_PRESET_NAME_MAX];
+    char event[CAM_FRAME_EVENT_TEXT_MAX];
+    char burst[CAM_FRAME_BURST_TEXT_MAX]; // since version 2
+} spool_meta_t;
+
+static uint32_t hdr_crc(const spool_hdr_t *h)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(spool_hdr_t, hdr_crc));
+}
+
+static uint32_t record_sectors(uint64_t body_len)
+{
+    uint64_t sectors = (sizeof(spool_hdr_t) + body_len + SPOOL_SECTOR_SIZE - 1) / SPOOL_SECTOR_SIZE;
+    return sectors > UINT32_MAX ? UINT32_MAX : (uint32_t)sectors;
+}
+
+// Sectors taken by the record behind `h`.
+static uint32_t hdr_span(const spool_hdr_t *h)
+{
+    return record_sectors((uint64_t)h->meta_len + h->len);
+}
+
+static bool hdr_valid(const frame_spool_t *sp, const spool_hdr_t *h)
+{
+    return h->magic == SPOOL_MAGIC && h->hdr_crc == hdr_crc(h) && hdr_span(h) <= sp->sector_count;
+}
+
+static bool hdr_pending(const spool_hdr_t *h)
+{
+    return h->committed == SPOOL_FLAG_CLEARED && h->drained == SPOOL_FLAG_SET;
+}
+
+static uint32_t sector_add(const frame_spool_t *sp, uint32_t sector, uint32_t n)
+{
+    return (sector + n) % sp->sector_count;
+}
+
+static bool sector_in_span(const frame_spool_t *sp, uint32_t sector, uint32_t start, uint32_t span)
+{
+    return ((sector + sp->sector_count - start) % sp->sector_count) < span;
+}
+
+// Read or write `len` bytes at `offset` into the record starting at `sector`, wrapping at the partition end.
+static esp_err_t ring_io(const frame_spool_t *sp, uint32_t sector, size_t offset, void *buf, size_t len, bool write)
+{
+    size_t size = (size_t)sp->sector_count * SPOOL_SECTOR_SIZE;
+    size_t pos = ((size_t)sector * SPOOL_SECTOR_SIZE + offset) % size;
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0) {
+        size_t n = len < size - pos ? len : size - pos;
+        esp_err_t err = write ? esp_partition_write(sp->part, pos, p, n) : esp_partition_read(sp->part, pos, p, n);
+        if (err != ESP_OK) {
+            return err;
+        }
+        p += n;
+        len -= n;
+        pos = 0;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t read_hdr(const frame_spool_t *sp, uint32_t sector, spool_hdr_t *h)
+{
+    return esp_partition_read(sp->part, (size_t)sector * SPOOL_SECTOR_SIZE, h, sizeof(*h));
+}
+
+static esp_err_t clear_flag(const frame_spool_t *sp, uint32_t sector, size_t field_offset)
+{
+    uint32_t cleared = SPOOL_FLAG_CLEARED;
+    return esp_partition_write(sp->part, (size_t)sector * SPOOL_SECTOR_SIZE + field_offset, &cleared,
+                               sizeof(cleared));
+}
+
+// Walk forward from `from` to the head and return the first sector holding a pending record (or the head).
+static uint32_t find_pending_from(const frame_spool_t *sp, uint32_t from)
+{
+    uint32_t s = from;
+    for (uint32_t steps = 0; s != sp->head_sector && steps < sp->sector_count;) {
+        spool_hdr_t h;
+        if (read_hdr(sp, s, &h) == ESP_OK && hdr_valid(sp, &h)) {
+            if (hdr_pending(&h)) {
+                return s;
+            }
+            uint32_t span = hdr_span(&h);
+            s = sector_add(sp, s, span);
+            steps += span;
+        } else {
+            s = sector_add(sp, s, 1);
+            steps++;
+        }
+    }
+    return sp->head_sector;
+}
+
+static esp_err_t recover(frame_spool_t *sp)
+{
+    bool found = false;
+    uint32_t max_id = 0;
+    uint32_t min_pending_id = UINT32_MAX;
+
+    sp->head_sector = 0;
+    sp->tail_sector = 0;
+    sp->pending = 0;
+
+    for (uint32_t s = 0; s < sp->sector_count; s++) {
+        spool_hdr_t h;
+        esp_err_t err = read_hdr(sp, s, &h);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (!hdr_valid(sp, &h)) {
+            continue;
+        }
+        // Uncommitted (torn) records still advance the head so their sectors are not mistaken for free space.
+        if (!found || h.id > max_id) {
+            found = true;
+            max_id = h.id;
+            sp->head_sector = sector_add(sp, s, hdr_span(&h));
+        }
+        if (hdr_pending(&h)) {
+            sp->pending++;
+            if (h.id < min_pending_id) {
+                min_pending_id = h.id;
+                sp->tail_sector = s;
+            }
+        }
+    }
+
+    sp->next_id = found ? max_id + 1 : 1;
+    if (sp->pending == 0) {
+        sp->tail_sector = sp->head_sector;
+    }
+    sp->stats.recovered = sp->pending;
+    return ESP_OK;
+}
+
+esp_err_t frame_spool_init(frame_spool_t *sp, const char *label)
+{
+    if (!sp || !label) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(sp, 0, sizeof(*sp));
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!part) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (part->size < 2 * SPOOL_SECTOR_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    sp->lock = xSemaphoreCreateMutex();
+    if (!sp->lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    sp->part = part;
+    sp->sector_count = part->size / SPOOL_SECTOR_SIZE;
+
+    esp_err_t err = recover(sp);
+    if (err != ESP_OK) {
+        sp->part = NULL;
+        return err;
+    }
+
+    ESP_LOGI(TAG, "spool '%s': %u sectors, %u pending frame(s), head=%u tail=%u", label, (unsigned)sp->sector_count,
+             (unsigned)sp->pending, (unsigned)sp->head_sector, (unsigned)sp->tail_sector);
+    return ESP_OK;
+}
+
+bool frame_spool_ready(const frame_spool_t *sp)
+{
+    return sp && sp->part;
+}
+
+// Make room for a record of `span` sectors at the head: drop pending records in the way and erase.
+static esp_err_t reserve(frame_spool_t *sp, uint32_t span)
+{
+    for (uint32_t i = 0; i < span; i++) {
+        uint32_t s = sector_add(sp, sp->head_sector, i);
+        while (sp->pending > 0) {
+            spool_hdr_t h;
+            if (read_hdr(sp, sp->tail_sector, &h) != ESP_OK || !hdr_valid(sp, &h) ||
+                !sector_in_span(sp, s, sp->tail_sector, hdr_span(&h))) {
+                break;
+            }
+            sp->pending--;
+            sp->stats.dropped++;
+            uint32_t after = sector_add(sp, sp->tail_sector, hdr_span(&h));
+            sp->tail_sector = sp->pending > 0 ? find_pending_from(sp, after) : sp->head_sector;
+        }
+
+        esp_err_t err = esp_partition_erase_range(sp->part, (size_t)s * SPOOL_SECTOR_SIZE, SPOOL_SECTOR_SIZE);
+        if (err != ESP_OK) {
+            return err;
+        }
+        sp->stats.erases++;
+    }
+    return ESP_OK;
+}
+
+esp_err_t frame_spool_append(frame_spool_t *sp, const cam_frame_t *frame)
+{
+    if (!frame_spool_ready(sp) || !frame || !frame->buf) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    spool_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    meta.version = SPOOL_META_VERSION;
+    meta.size = sizeof(meta);
+    meta.flags = (frame->hashed ? SPOOL_META_HASHED : 0) | (frame->duplicate ? SPOOL_META_DUPLICATE : 0);
+    meta.regions_len = frame->regions_json ? (uint32_t)strlen(frame->regions_json) : 0;
+    memcpy(meta.sha256, frame->sha256, sizeof(meta.sha256));
+    memcpy(meta.quality, frame->quality, sizeof(meta.quality));
+    memcpy(meta.window, frame->window, sizeof(meta.window));
+    memcpy(meta.event, frame->event, sizeof(meta.event));
+    memcpy(meta.burst, frame->burst, sizeof(meta.burst));
+
+    uint32_t meta_len = (uint32_t)sizeof(meta) + meta.regions_len;
+    uint32_t span = record_sectors((uint64_t)meta_len + frame->len);
+    if (span >= sp->sector_count) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint32_t meta_crc = esp_rom_crc32_le(0, (const uint8_t *)&meta, sizeof(meta));
+    if (meta.regions_len > 0) {
+        meta_crc = esp_rom_crc32_le(meta_crc, (const uint8_t *)frame->regions_json, meta.regions_len);
+    }
+
+    spool_hdr_t h = {
+        .magic = SPOOL_MAGIC,
+        .len = (uint32_t)frame->len,
+        .frame_seq = frame->seq,
+        .capture_us = frame->capture_us,
+        .unix_us = frame->unix_us,
+        .boot = frame->boot,
+        .width = frame->width,
+        .height = frame->height,
+        .kind = (uint32_t)frame->kind,
+        .meta_len = meta_len,
+        .meta_crc = meta_crc,
+        .data_crc = esp_rom_crc32_le(0, frame->buf, (uint32_t)frame->len),
+        .committed = SPOOL_FLAG_SET,
+        .drained = SPOOL_FLAG_SET,
+    };
+
+    xSemaphoreTake(sp->lock, portMAX_DELAY);
+
+    uint32_t start = sp->head_sector;
+    h.id = sp->next_id;
+    h.hdr_crc = hdr_crc(&h);
+
+    esp_err_t err = reserve(sp, span);
+    if (err == ESP_OK) {
+        err = ring_io(sp, start, 0, &h, sizeof(h), true);
+    }
+    if (err == ESP_OK) {
+        err = ring_io(sp, start, sizeof(h), &meta, sizeof(meta), true);
+    }
+    if (err == ESP_OK && meta.regions_len > 0) {
+        err = ring_io(sp, start, sizeof(h) + sizeof(meta), frame->regions_json, meta.regions_len, true);
+    }
+    if (err == ESP_OK) {
+        err = ring_io(sp, start, sizeof(h) + meta_len, frame->buf, frame->len, true);
+    }
+    if (err == ESP_OK) {
+        err = clear_flag(sp, start, offsetof(spool_hdr_t, committed));
+    }
+
+    // The sectors are consumed either way; a torn record is skipped on the next scan.
+    sp->next_id++;
+    sp->head_sector = sector_add(sp, start, span);
+    if (err == ESP_OK) {
+        if (sp->pending == 0) {
+            sp->tail_sector = start;
+        }
+        sp->pending++;
+        sp->stats.spooled++;
+    } else {
+        ESP_LOGW(TAG, "append failed: %s", esp_err_to_name(err));
+    }
+
+    xSemaphoreGive(sp->lock);
+    return err;
+}
+
+// Copy a fixed-size text field, which a damaged or foreign record might not terminate.
+static void copy_text(char *dst, const char *src, size_t size)
+{
+    memcpy(dst, src, size);
+    dst[size - 1] = '\0';
+}
+
+// Load the record at the tail into a new frame. ESP_ERR_INVALID_CRC if its contents do not check out.
+static esp_err_t read_record(const frame_spool_t *sp, const spool_hdr_t *h, cam_frame_t **out_frame)
+{
+    uint8_t *meta_buf = malloc(h->meta_len ? h->meta_len : 1);
+    if (!meta_buf) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = ring_io(sp, sp->tail_sector, sizeof(*h), meta_buf, h->meta_len, false);
+    if (err != ESP_OK) {
+        free(meta_buf);
+        return err;
+    }
+    spool_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    memcpy(&meta, meta_buf, h->meta_len < sizeof(meta) ? h->meta_len : sizeof(meta));
+    if (esp_rom_crc32_le(0, meta_buf, h->meta_len) != h->meta_crc || meta.size < offsetof(spool_meta_t, sha256) ||
+        (uint64_t)meta.size + meta.regions_len != h->meta_len) {
+        free(meta_buf);
+        return ESP_ERR_INVALID_CRC;
+    }
+    if (meta.size < sizeof(meta)) {
+        // Written before the later fields existed.
+        memset((uint8_t *)&meta + meta.size, 0, sizeof(meta) - meta.size);
+    }
+
+    cam_frame_t *frame = cam_frame_alloc(NULL, h->len);
+    if (frame && meta.regions_len > 0) {
+        frame->regions_json = malloc(meta.regions_len + 1);
+        if (frame->regions_json) {
+            memcpy(frame->regions_json, meta_buf + meta.size, meta.regions_len);
+            frame->regions_json[meta.regions_len] = '\0';
+        }
+    }
+    free(meta_buf);
+    if (!frame || (meta.regions_len > 0 && !frame->regions_json)) {
+        cam_frame_free(frame);
+        return ESP_ERR_NO_MEM;
+    }
+    err = ring_io(sp, sp->tail_sector, sizeof(*h) + h->meta_len, frame->buf, h->len, false);
+    if (err == ESP_OK && esp_rom_crc32_le(0, frame->buf, h->len) != h->data_crc) {
+        err = ESP_ERR_INVALID_CRC;
+    }
+    if (err != ESP_OK) {
+        cam_frame_free(frame);
+        return err;
+    }
+
+    frame->seq = h->frame_seq;
+    frame->capture_us = h->capture_us;
+    frame->unix_us = h->unix_us;
+    frame->boot = h->boot;
+    frame->width = h->width;
+    frame->height = h->height;
+    frame->kind = (cam_frame_kind_t)h->kind;
+    frame->hashed = (meta.flags & SPOOL_META_HASHED) != 0;
+    frame->duplicate = (meta.flags & SPOOL_META_DUPLICATE) != 0;
+    memcpy(frame->sha256, meta.sha256, sizeof(frame->sha256));
+    copy_text(frame->quality, meta.quality, sizeof(frame->quality));
+    copy_text(frame->window, meta.window, sizeof(frame->window));
+    copy_text(frame->event, meta.event, sizeof(frame->event));
+    copy_text(frame->burst, meta.burst, sizeof(frame->burst));
+    *out_frame = frame;
+    return ESP_OK;
+}
+
+esp_err_t frame_spool_peek(frame_spool_t *sp, cam_frame_t **out_frame, uint32_t *out_id)
+{
+    if (!frame_spool_ready(sp) || !out_frame || !out_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_frame = NULL;
+
+    xSemaphoreTake(sp->lock, portMAX_DELAY);
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    while (sp->pending > 0) {
+        spool_hdr_t h;
+        err = read_hdr(sp, sp->tail_sector, &h);
+        if (err != ESP_OK) {
+            break;
+        }
+
+        if (hdr_valid(sp, &h) && hdr_pending(&h)) {
+            cam_frame_t *frame = NULL;
+            err = read_record(sp, &h, &frame);
+            if (err == ESP_OK) {
+                *out_frame = frame;
+                *out_id = h.id;
+                break;
+            }
+            if (err != ESP_ERR_INVALID_CRC) {
+                break;
+            }
+        }
+
+        // Bad metadata or payload (or a header that no longer checks out): retire it and move on.
+        ESP_LOGW(TAG, "discarding corrupt record at sector %u", (unsigned)sp->tail_sector);
+        sp->stats.corrupt++;
+        sp->pending--;
+        if (hdr_valid(sp, &h)) {
+            (void)clear_flag(sp, sp->tail_sector, offsetof(spool_hdr_t, drained));
+        }
+        uint32_t after = sector_add(sp, sp->tail_sector, hdr_valid(sp, &h) ? hdr_span(&h) : 1);
+        sp->tail_sector = sp->pending > 0 ? find_pending_from(sp, after) : sp->head_sector;
+        err = ESP_ERR_NOT_FOUND;
+    }
+    xSemaphoreGive(sp->lock);
+    return err;
+}
+
+// Clear the tail record's `drained` word so the next peek moves on; `uploaded` picks the counter.
+static esp_err_t release(frame_spool_t *sp, uint32_t id, bool uploaded)
+{
+    if (!frame_spool_ready(sp)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(sp->lock, portMAX_DELAY);
+    spool_hdr_t h;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    // The record may have been overwritten by an append while it was being uploaded.
+    if (sp->pending > 0 && read_hdr(sp, sp->tail_sector, &h) == ESP_OK && hdr_valid(sp, &h) && h.id == id) {
+        err = clear_flag(sp, sp->tail_sector, offsetof(spool_hdr_t, drained));
+        if (err == ESP_OK) {
+            sp->pending--;
+            if (uploaded) {
+                sp->stats.drained++;
+            } else {
+                sp->stats.rejected++;
+            }
+            uint32_t after = sector_add(sp, sp->tail_sector, hdr_span(&h));
+            sp->tail_sector = sp->pending > 0 ? find_pending_from(sp, after) : sp->head_sector;
+        }
+    }
+    xSemaphoreGive(sp->lock);
+    return err;
+}
+
+esp_err_t frame_spool_ack(frame_spool_t *sp, uint32_t id)
+{
+    return release(sp, id, true);
+}
+
+esp_err_t frame_spool_reject(frame_spool_t *sp, uint32_t id)
+{
+    return release(sp, id, false);
+}
+
+size_t frame_spool_pending(frame_spool_t *sp)
+{
+    if (!frame_spool_ready(sp)) {
+        return 0;
+    }
+    xSemaphoreTake(sp->lock, portMAX_DELAY);
+    size_t n = sp->pending;
+    xSemaphoreGive(sp->lock);
+    return n;
+}
+
+void frame_spool_get_stats(frame_spool_t *sp, frame_spool_stats_t *out)
+{
+    if (!frame_spool_ready(sp)) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(sp->lock, portMAX_DELAY);
+    *out = sp->stats;
+    xSemaphoreGive(sp->lock);
+}
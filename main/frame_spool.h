@@ -0,0 +1,86 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "frame_queue.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Label of the data partition used for the spool (see partitions.csv; the Arduino sketch has its own in sdk/). */
+#define FRAME_SPOOL_PARTITION_LABEL "spool"
+
+typedef struct {
+    uint32_t spooled;   // frames appended
+    uint32_t drained;   // frames uploaded from the spool and released
+    uint32_t rejected;  // frames released without being uploaded (frame_spool_reject())
+    uint32_t dropped;   // oldest frames overwritten because the spool was full
+    uint32_t corrupt;   // records discarded due to a CRC mismatch
+    uint32_t erases;    // sector erases since boot
+    uint32_t recovered; // pending frames found at boot
+} frame_spool_stats_t;
+
+/**
+ * Append-only frame log on a raw data partition.
+ *
+ * Records start on a sector boundary and are written in ring order, so every sector is erased
+ * once per lap regardless of frame size and reboots resume where the previous run stopped.
+ * A record is only considered valid once its `committed` word has been cleared after the payload
+ * was written; uploading clears its `drained` word. Both are 1->0 flips that need no erase, so
+ * head/tail can be rebuilt at boot by scanning sector headers. When full, the oldest pending
+ * record is overwritten.
+ *
+ * Only uses esp_partition, so it runs unchanged on the linux target's file-backed partitions.
+ */
+typedef struct {
+    const esp_partition_t *part;
+    SemaphoreHandle_t lock;
+    uint32_t sector_count;
+    uint32_t head_sector; // next sector to write
+    uint32_t tail_sector; // first sector of the oldest pending record
+    uint32_t next_id;
+    uint32_t pending;
+    frame_spool_stats_t stats;
+} frame_spool_t;
+
+/** Find the partition by label and recover head/tail. ESP_ERR_NOT_FOUND if there is no such partition. */
+esp_err_t frame_spool_init(frame_spool_t *sp, const char *label);
+
+/** True once frame_spool_init() succeeded. */
+bool frame_spool_ready(const frame_spool_t *sp);
+
+/**
+ * Persist a copy of `frame` with the metadata its upload carries (hash, region statistics, quality
+ * score, window, event and burst tags), overwriting the oldest pending frames if needed.
+ */
+esp_err_t frame_spool_append(frame_spool_t *sp, const cam_frame_t *frame);
+
+/**
+ * Read the oldest pending frame into a newly allocated frame. `out_id` identifies it for
+ * frame_spool_ack(). Returns ESP_ERR_NOT_FOUND when the spool is empty.
+ */
+esp_err_t frame_spool_peek(frame_spool_t *sp, cam_frame_t **out_frame, uint32_t *out_id);
+
+/** Mark the record returned by frame_spool_peek() as uploaded. */
+esp_err_t frame_spool_ack(frame_spool_t *sp, uint32_t id);
+
+/** Release the record returned by frame_spool_peek() without uploading it, e.g. the collector refused it. */
+esp_err_t frame_spool_reject(frame_spool_t *sp, uint32_t id);
+
+/** Number of frames waiting in the spool. */
+size_t frame_spool_pending(frame_spool_t *sp);
+
+void frame_spool_get_stats(frame_spool_t *sp, frame_spool_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,5 +1,7 @@
 
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
 #include "sdkconfig.h"
@@ -15,8 +17,10 @@
 #include "nvs_flash.h"
 #include "esp_http_server.h"
 #include "esp_netif.h"
+#include "esp_netif_sntp.h"
 #include "lwip/inet.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
 
 #include "cam_uploader.h"
 
@@ -136,6 +140,20 @@ static const char *config_page_html =
 "</body>"
 "</html>";
 
+// Wall-clock time lets the uploader align capture slots to UTC boundaries.
+static void start_time_sync(void)
+{
+    static bool started;
+    if (started) {
+        return;
+    }
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG("pool.ntp.org");
+    config.wait_for_sync = false;
+    if (esp_netif_sntp_init(&config) == ESP_OK) {
+        started = true;
+    }
+}
+
 // Event handler for WiFi events
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                                 int32_t event_id, void* event_data)
@@ -157,69 +175,184 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "Got IP:" IPSTR, IP2STR(&event->ip_info.ip));
+        start_time_sync();
         cam_uploader_set_wifi_connected(true);
     }
 }
 
+static const char *root_page_head =
+    "<!DOCTYPE html>"
+    "<html><head><title>WiFi Configuration</title>"
+    "<meta name='viewport' content='width=device-width, initial-scale=1'>"
+    "<style>"
+    "body {font-family: Arial, Helvetica, sans-serif;}"
+    "input[type=text], input[type=password], select {width: 100%; padding: 12px 20px; margin: 8px 0; display: inline-block; border: 1px solid #ccc; box-sizing: border-box;}"
+    "button {background-color: #4CAF50; color: white; padding: 14px 20px; margin: 8px 0; border: none; cursor: pointer; width: 100%;}"
+    "button:hover {opacity: 0.8;}"
+    ".container {padding: 16px;}"
+    "</style></head><body>"
+    "<h2>WiFi Configuration</h2>"
+    "<form action='/save' method='post'><div class='container'>"
+    "<label for='ssid'><b>WiFi SSID</b></label>"
+    "<input type='text' placeholder='Enter SSID' name='ssid' required>"
+    "<label for='password'><b>Password</b></label>"
+    "<input type='password' placeholder='Enter Password' name='password' required>"
+    "<button type='submit'>Connect</button>"
+    "</div></form>"
+    "<h2>Uploader Configuration</h2>"
+    "<form action='/uploader_save' method='post'><div class='container'>";
+
+static const char *root_page_tail =
+    "<button type='submit'>Save Uploader Settings</button>"
+    "</div></form>"
+    "</body></html>";
+
+static void send_text_field(httpd_req_t *req, const char *label, const char *name, const char *placeholder,
+                            const char *value)
+{
+    char esc[600];
+    if (!html_escape_attr(value, esc, sizeof(esc))) {
+        esc[0] = '\0';
+    }
+
+    char buf[800];
+    snprintf(buf, sizeof(buf),
+             "<label for='%s'><b>%s</b></label>"
+             "<input type='text' placeholder='%s' name='%s' value='%s'>",
+             name, label, placeholder, name, esc);
+    httpd_resp_sendstr_chunk(req, buf);
+}
+
+static void send_int_field(httpd_req_t *req, const char *label, const char *name, int value)
+{
+    char num[16];
+    snprintf(num, sizeof(num), "%d", value);
+    send_text_field(req, label, name, num, num);
+}
+
+// `options` holds `count` labels; option i is submitted as value i.
+static void send_select_field(httpd_req_t *req, const char *label, const char *name, const char *const *options,
+                              int count, int selected)
+{
+    char buf[160];
+    snprintf(buf, sizeof(buf), "<label for='%s'><b>%s</b></label><select name='%s'>", name, label, name);
+    httpd_resp_sendstr_chunk(req, buf);
+    for (int i = 0; i < count; i++) {
+        snprintf(buf, sizeof(buf), "<option value='%d'%s>%s</option>", i, i == selected ? " selected" : "",
+                 options[i]);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "</select>");
+}
+
+// Frame sizes offered in the form; the select submits an index into this table.
+static const framesize_t s_frame_size_values[] = {
+    FRAMESIZE_QQVGA, FRAMESIZE_QVGA, FRAMESIZE_CIF, FRAMESIZE_VGA, FRAMESIZE_SVGA,
+    FRAMESIZE_XGA,   FRAMESIZE_HD,   FRAMESIZE_SXGA, FRAMESIZE_UXGA,
+};
+static const char *const s_frame_size_labels[] = {
+    "160x120", "320x240", "400x296", "640x480", "800x600", "1024x768", "1280x720", "1280x1024", "1600x1200",
+};
+#define FRAME_SIZE_OPTION_COUNT ((int)(sizeof(s_frame_size_values) / sizeof(s_frame_size_values[0])))
+
+static int frame_size_option(int frame_size)
+{
+    for (int i = 0; i < FRAME_SIZE_OPTION_COUNT; i++) {
+        if ((int)s_frame_size_values[i] == frame_size) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 // HTTP GET handler for root page
 static esp_err_t root_get_handler(httpd_req_t *req)
 {
     cam_uploader_config_t cfg;
     memset(&cfg, 0, sizeof(cfg));
-    (void)cam_uploader_get_config(&cfg);
-
-    char url_esc[600];
-    char vurl_esc[600];
-    if (!html_escape_attr(cfg.url, url_esc, sizeof(url_esc))) {
-        url_esc[0] = '\0';
-    }
-    if (!html_escape_attr(cfg.voltage_url, vurl_esc, sizeof(vurl_esc))) {
-        vurl_esc[0] = '\0';
-    }
-
-    char page[2600];
-    int n = snprintf(
-        page,
-        sizeof(page),
-        "<!DOCTYPE html>"
-        "<html><head><title>WiFi Configuration</title>"
-        "<meta name='viewport' content='width=device-width, initial-scale=1'>"
-        "<style>"
-        "body {font-family: Arial, Helvetica, sans-serif;}"
-        "input[type=text], input[type=password] {width: 100%%; padding: 12px 20px; margin: 8px 0; display: inline-block; border: 1px solid #ccc; box-sizing: border-box;}"
-        "button {background-color: #4CAF50; color: white; padding: 14px 20px; margin: 8px 0; border: none; cursor: pointer; width: 100%%;}"
-        "button:hover {opacity: 0.8;}"
-        ".container {padding: 16px;}"
-        "</style></head><body>"
-        "<h2>WiFi Configuration</h2>"
-        "<form action='/save' method='post'><div class='container'>"
-        "<label for='ssid'><b>WiFi SSID</b></label>"
-        "<input type='text' placeholder='Enter SSID' name='ssid' required>"
-        "<label for='password'><b>Password</b></label>"
-        "<input type='password' placeholder='Enter Password' name='password' required>"
-        "<button type='submit'>Connect</button>"
-        "</div></form>"
-        "<h2>Uploader Configuration</h2>"
-        "<form action='/uploader_save' method='post'><div class='container'>"
-        "<label for='url'><b>POST URL</b></label>"
-        "<input type='text' placeholder='http(s)://example.com/upload' name='url' value='%s'>"
-        "<label for='vurl'><b>Voltage POST URL</b></label>"
-        "<input type='text' placeholder='http(s)://example.com/voltage' name='vurl' value='%s'>"
-        "<label for='interval'><b>Interval (seconds)</b></label>"
-        "<input type='text' placeholder='60' name='interval' value='%d'>"
-        "<button type='submit'>Save Uploader Settings</button>"
-        "</div></form>"
-        "</body></html>",
-        url_esc,
-        vurl_esc,
-        cfg.interval_sec);
-
-    if (n < 0 || (size_t)n >= sizeof(page)) {
+    if (cam_uploader_get_config(&cfg) != ESP_OK) {
         httpd_resp_send(req, config_page_html, HTTPD_RESP_USE_STRLEN);
         return ESP_OK;
     }
 
-    httpd_resp_send(req, page, HTTPD_RESP_USE_STRLEN);
+    static const char *const drop_options[] = {"Drop oldest", "Drop newest"};
+    static const char *const align_options[] = {"Every interval from boot", "Aligned to wall clock (UTC)"};
+    static const char *const missed_options[] = {"Skip", "Catch up"};
+    static const char *const failed_options[] = {"Drop", "Keep in spool"};
+    static const char *const transfer_options[] = {"Content-Length", "Chunked"};
+    static const char *const request_options[] = {"Separate image and voltage POSTs", "Single multipart POST"};
+    static const char *const mode_options[] = {"JPEG every capture", "Vegetation index (ExG/ExGR) record"};
+    static const char *const dedup_options[] = {"Upload (hash header only)", "Upload and mark", "Send \"same as\" only",
+                                                "Skip"};
+
+    // Sent in pieces: the page with current values does not fit comfortably on the httpd task stack.
+    httpd_resp_sendstr_chunk(req, root_page_head);
+    send_text_field(req, "POST URL", "url", "http(s)://example.com/upload", cfg.url);
+    send_text_field(req, "Voltage POST URL", "vurl", "http(s)://example.com/voltage", cfg.voltage_url);
+    send_int_field(req, "Interval (seconds)", "interval", cfg.interval_sec);
+    send_select_field(req, "Upload", "mode", mode_options, 2, cfg.capture_mode);
+    send_int_field(req, "Vegetation mode: JPEG every N captures (0 = never)", "veg_every", cfg.veg_jpeg_every);
+    send_select_field(req, "Capture timing", "align", align_options, 2, cfg.align_to_wall_clock ? 1 : 0);
+    send_select_field(req, "Missed capture slots", "missed", missed_options, 2, cfg.missed_slot_policy);
+    send_int_field(req, "Capture phase (ms into interval, -1 = from MAC)", "phase", cfg.phase_offset_ms);
+    send_int_field(req, "Capture jitter (max ms)", "phase_jit", cfg.phase_jitter_ms);
+    send_select_field(req, "Frame size (largest)", "fsize", s_frame_size_labels, FRAME_SIZE_OPTION_COUNT,
+                      frame_size_option(cfg.frame_size));
+    send_int_field(req, "JPEG quality (4-63, lower is better)", "quality", cfg.jpeg_quality);
+    send_int_field(req, "Adaptive: upload time budget per frame (ms, 0 = off)", "ad_ms", cfg.adapt_target_ms);
+    send_int_field(req, "Adaptive: size budget per frame (KB, 0 = off)", "ad_kb", cfg.adapt_target_kb);
+    send_int_field(req, "Adaptive: worst JPEG quality", "ad_qworst", cfg.adapt_quality_worst);
+    send_select_field(req, "Adaptive: smallest frame size", "ad_fsmin", s_frame_size_labels, FRAME_SIZE_OPTION_COUNT,
+                      frame_size_option(cfg.adapt_frame_size_min));
+    send_select_field(req, "Request layout", "combined", request_options, 2, cfg.combined_upload ? 1 : 0);
+    send_int_field(req, "Frames per upload (1 = no batching)", "batch_n", cfg.batch_frames);
+    send_int_field(req, "Batch flush deadline (seconds)", "batch_win", cfg.batch_window_sec);
+    send_int_field(req, "Spooled frames re-sent per minute (0 = hold)", "spool_rate", cfg.spool_drain_per_min);
+    send_select_field(req, "Failed uploads", "spool_fail", failed_options, 2, cfg.spool_failed_uploads ? 1 : 0);
+    send_int_field(req, "Attempts per request (1-5)", "retries", cfg.retry_attempts);
+    send_int_field(req, "Failures before pausing an endpoint (0 = never)", "brk_fail", cfg.breaker_failures);
+    send_int_field(req, "Endpoint pause (seconds)", "brk_cool", cfg.breaker_cooldown_sec);
+    send_int_field(req, "Pre-connect lead (ms, 0 = off)", "pre_ms", cfg.preconnect_lead_ms);
+    send_int_field(req, "Skip unchanged frames: min. changed area (1/1000 of scene, 0 = off)", "chg_pm",
+                   cfg.change_threshold_permille);
+    send_int_field(req, "Upload at least every N frames", "chg_beat", cfg.change_heartbeat);
+    send_select_field(req, "Frames identical to a recent one", "dedup", dedup_options, 4, cfg.dedup_mode);
+    send_int_field(req, "Send only changed strips: full keyframe every N frames (e.g. 10; 0 = off)", "tile_key",
+                   cfg.tile_keyframe_every);
+    send_int_field(req, "Pre-event buffer: keep a frame every N ms (e.g. 1000; 0 = off)", "pr_ms",
+                   cfg.preroll_interval_ms);
+    send_int_field(req, "Pre-event buffer: seconds before a trigger", "pr_sec", cfg.preroll_sec);
+    send_int_field(req, "Pre-event buffer: seconds after a trigger", "po_sec", cfg.postroll_sec);
+    send_int_field(req, "Pre-event buffer: memory (KB)", "pr_kb", cfg.preroll_kb);
+    send_int_field(req, "Event trigger input, active low (GPIO number; -1 = none)", "ev_gpio", cfg.event_gpio);
+    send_int_field(req, "Event trigger on scene change (1/1000 of scene between buffered frames; 0 = off)", "ev_chg",
+                   cfg.event_change_permille);
+    send_int_field(req, "Burst: frames taken back to back per capture (0 = single frames)", "burst",
+                   cfg.burst_frames);
+    char list[600]; // shared by the region and window lists to spare the httpd task stack
+    roi_list_format(&cfg.regions, list, sizeof(list));
+    send_text_field(req, "Regions (x,y points in % per bed, beds separated by ;)", "regions",
+                    "5,10 45,90; 55,10 95,10 75,90", list);
+    window_preset_list_format(&cfg.window_presets, list, sizeof(list));
+    send_text_field(req, "Sensor windows (name: set_res_raw arguments as on the /window page, separated by ;)",
+                    "win_presets", "trough: 0,0,0,0,400,300,1600,1200,400,300,1,0", list);
+    send_text_field(req, "Window per capture (preset names in turn, full = normal frame size)", "win_cycle",
+                    "full,trough,trough", cfg.window_cycle);
+    send_int_field(req, "Fresh frames only: max. buffer age (ms, e.g. 500; 0 = off)", "fresh_ms",
+                   cfg.fresh_max_age_ms);
+    send_int_field(req, "Wait for auto exposure to settle: max. frames (e.g. 10; 0 = off)", "ae_frames",
+                   cfg.settle_max_frames);
+    send_int_field(req, "Wait for auto exposure to settle: max. ms", "ae_ms", cfg.settle_max_ms);
+    send_int_field(req, "Quality gate: min. mean luma (0-255, e.g. 40; 0 = off)", "qg_luma", cfg.gate_min_luma);
+    send_int_field(req, "Quality gate: max. blown-out area (1/1000, e.g. 250; 0 = off)", "qg_clip",
+                   cfg.gate_max_clip_permille);
+    send_int_field(req, "Quality gate: min. sharpness (e.g. 150; 0 = off)", "qg_sharp", cfg.gate_min_sharpness);
+    send_int_field(req, "Quality gate: re-captures before skipping (0-5)", "qg_retries", cfg.gate_retries);
+    send_select_field(req, "When upload queue is full", "qdrop", drop_options, 2, cfg.queue_drop_policy);
+    send_select_field(req, "Upload transfer encoding", "chunked", transfer_options, 2, cfg.upload_chunked ? 1 : 0);
+    send_int_field(req, "Upload write chunk (bytes, 0 = TCP send buffer)", "chunk", cfg.upload_chunk_size);
+    httpd_resp_sendstr_chunk(req, root_page_tail);
+    httpd_resp_sendstr_chunk(req, NULL);
     return ESP_OK;
 }
 
@@ -299,18 +432,58 @@ static esp_err_t save_post_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+// Find `key=` as a whole field name in a form-urlencoded body; returns a pointer to its value.
+static const char *form_field_value(const char *content, const char *key)
+{
+    size_t key_len = strlen(key);
+    for (const char *p = content; p && *p; p = strchr(p, '&')) {
+        if (*p == '&') {
+            p++;
+        }
+        if (strncmp(p, key, key_len) == 0 && p[key_len] == '=') {
+            return p + key_len + 1;
+        }
+    }
+    return NULL;
+}
+
 // HTTP POST handler for saving uploader settings
+// Copy a form value up to the next field, undoing application/x-www-form-urlencoded escaping.
+static void form_value_decode(const char *val, char *out, size_t out_len)
+{
+    size_t n = 0;
+    while (*val && *val != '&' && n + 1 < out_len) {
+        if (*val == '+') {
+            out[n++] = ' ';
+            val++;
+        } else if (val[0] == '%' && isxdigit((unsigned char)val[1]) && isxdigit((unsigned char)val[2])) {
+            char hex[3] = {val[1], val[2], '\0'};
+            out[n++] = (char)strtol(hex, NULL, 16);
+            val += 3;
+        } else {
+            out[n++] = *val++;
+        }
+    }
+    out[n] = '\0';
+}
+
 static esp_err_t uploader_save_post_handler(httpd_req_t *req)
 {
-    char content[512];
+    // Two URLs plus the region and window lists outgrow the httpd task stack; the server handles one
+    // request at a time.
+    static char content[4096];
     size_t recv_size = MIN(req->content_len, sizeof(content) - 1);
 
-    int ret = httpd_req_recv(req, content, recv_size);
-    if (ret <= 0) {
-        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-            httpd_resp_send_408(req);
+    size_t received = 0;
+    while (received < recv_size) {
+        int ret = httpd_req_recv(req, content + received, recv_size - received);
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req);
+            }
+            return ESP_FAIL;
         }
-        return ESP_FAIL;
+        received += (size_t)ret;
     }
     content[recv_size] = '\0';
 
@@ -353,6 +526,206 @@ static esp_err_t uploader_save_post_handler(httpd_req_t *req)
         }
     }
 
+    // Parse queue-full policy and upload transfer options
+    const char *val = form_field_value(content, "qdrop");
+    if (val) {
+        cfg.queue_drop_policy = atoi(val) == FRAME_QUEUE_DROP_NEWEST ? FRAME_QUEUE_DROP_NEWEST
+                                                                       : FRAME_QUEUE_DROP_OLDEST;
+    }
+    val = form_field_value(content, "align");
+    if (val) {
+        cfg.align_to_wall_clock = atoi(val) != 0;
+    }
+    val = form_field_value(content, "missed");
+    if (val) {
+        cfg.missed_slot_policy = atoi(val) == CAPTURE_SCHED_MISSED_CATCH_UP ? CAPTURE_SCHED_MISSED_CATCH_UP
+                                                                           : CAPTURE_SCHED_MISSED_SKIP;
+    }
+    val = form_field_value(content, "phase");
+    if (val) {
+        cfg.phase_offset_ms = atoi(val);
+    }
+    val = form_field_value(content, "phase_jit");
+    if (val) {
+        cfg.phase_jitter_ms = atoi(val);
+    }
+    val = form_field_value(content, "fsize");
+    if (val && atoi(val) >= 0 && atoi(val) < FRAME_SIZE_OPTION_COUNT) {
+        cfg.frame_size = (int)s_frame_size_values[atoi(val)];
+    }
+    val = form_field_value(content, "quality");
+    if (val) {
+        cfg.jpeg_quality = atoi(val);
+    }
+    val = form_field_value(content, "ad_ms");
+    if (val) {
+        cfg.adapt_target_ms = atoi(val);
+    }
+    val = form_field_value(content, "ad_kb");
+    if (val) {
+        cfg.adapt_target_kb = atoi(val);
+    }
+    val = form_field_value(content, "ad_qworst");
+    if (val) {
+        cfg.adapt_quality_worst = atoi(val);
+    }
+    val = form_field_value(content, "ad_fsmin");
+    if (val && atoi(val) >= 0 && atoi(val) < FRAME_SIZE_OPTION_COUNT) {
+        cfg.adapt_frame_size_min = (int)s_frame_size_values[atoi(val)];
+    }
+    val = form_field_value(content, "combined");
+    if (val) {
+        cfg.combined_upload = atoi(val) != 0;
+    }
+    val = form_field_value(content, "batch_n");
+    if (val) {
+        cfg.batch_frames = atoi(val);
+    }
+    val = form_field_value(content, "batch_win");
+    if (val) {
+        cfg.batch_window_sec = atoi(val);
+    }
+    val = form_field_value(content, "spool_rate");
+    if (val) {
+        cfg.spool_drain_per_min = atoi(val);
+    }
+    val = form_field_value(content, "spool_fail");
+    if (val) {
+        cfg.spool_failed_uploads = atoi(val) != 0;
+    }
+    val = form_field_value(content, "retries");
+    if (val) {
+        cfg.retry_attempts = atoi(val);
+    }
+    val = form_field_value(content, "brk_fail");
+    if (val) {
+        cfg.breaker_failures = atoi(val);
+    }
+    val = form_field_value(content, "brk_cool");
+    if (val) {
+        cfg.breaker_cooldown_sec = atoi(val);
+    }
+    val = form_field_value(content, "pre_ms");
+    if (val) {
+        cfg.preconnect_lead_ms = atoi(val);
+    }
+    val = form_field_value(content, "chg_pm");
+    if (val) {
+        cfg.change_threshold_permille = atoi(val);
+    }
+    val = form_field_value(content, "chg_beat");
+    if (val) {
+        cfg.change_heartbeat = atoi(val);
+    }
+    val = form_field_value(content, "mode");
+    if (val) {
+        cfg.capture_mode = atoi(val);
+    }
+    val = form_field_value(content, "veg_every");
+    if (val) {
+        cfg.veg_jpeg_every = atoi(val);
+    }
+    val = form_field_value(content, "regions");
+    if (val) {
+        char text[600];
+        form_value_decode(val, text, sizeof(text));
+        if (!roi_list_parse(text, &cfg.regions)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Regions: use x,y points in percent, regions separated by ;");
+            return ESP_FAIL;
+        }
+    }
+    val = form_field_value(content, "win_presets");
+    if (val) {
+        char text[600];
+        form_value_decode(val, text, sizeof(text));
+        if (!window_preset_list_parse(text, &cfg.window_presets)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                "Sensor windows: use name: and 12 numbers separated by commas, windows separated by ;");
+            return ESP_FAIL;
+        }
+    }
+    val = form_field_value(content, "win_cycle");
+    if (val) {
+        window_cycle_t cycle;
+        form_value_decode(val, cfg.window_cycle, sizeof(cfg.window_cycle));
+        if (!window_cycle_parse(&cfg.window_presets, cfg.window_cycle, &cycle)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Window per capture: unknown window name or too many entries");
+            return ESP_FAIL;
+        }
+    }
+    val = form_field_value(content, "dedup");
+    if (val) {
+        cfg.dedup_mode = atoi(val);
+    }
+    val = form_field_value(content, "tile_key");
+    if (val) {
+        cfg.tile_keyframe_every = atoi(val);
+    }
+    val = form_field_value(content, "pr_ms");
+    if (val) {
+        cfg.preroll_interval_ms = atoi(val);
+    }
+    val = form_field_value(content, "pr_sec");
+    if (val) {
+        cfg.preroll_sec = atoi(val);
+    }
+    val = form_field_value(content, "po_sec");
+    if (val) {
+        cfg.postroll_sec = atoi(val);
+    }
+    val = form_field_value(content, "pr_kb");
+    if (val) {
+        cfg.preroll_kb = atoi(val);
+    }
+    val = form_field_value(content, "ev_gpio");
+    if (val) {
+        cfg.event_gpio = atoi(val);
+    }
+    val = form_field_value(content, "ev_chg");
+    if (val) {
+        cfg.event_change_permille = atoi(val);
+    }
+    val = form_field_value(content, "burst");
+    if (val) {
+        cfg.burst_frames = atoi(val);
+    }
+    val = form_field_value(content, "fresh_ms");
+    if (val) {
+        cfg.fresh_max_age_ms = atoi(val);
+    }
+    val = form_field_value(content, "ae_frames");
+    if (val) {
+        cfg.settle_max_frames = atoi(val);
+    }
+    val = form_field_value(content, "ae_ms");
+    if (val) {
+        cfg.settle_max_ms = atoi(val);
+    }
+    val = form_field_value(content, "qg_luma");
+    if (val) {
+        cfg.gate_min_luma = atoi(val);
+    }
+    val = form_field_value(content, "qg_clip");
+    if (val) {
+        cfg.gate_max_clip_permille = atoi(val);
+    }
+    val = form_field_value(content, "qg_sharp");
+    if (val) {
+        cfg.gate_min_sharpness = atoi(val);
+    }
+    val = form_field_value(content, "qg_retries");
+    if (val) {
+        cfg.gate_retries = atoi(val);
+    }
+    val = form_field_value(content, "chunked");
+    if (val) {
+        cfg.upload_chunked = atoi(val) != 0;
+    }
+    val = form_field_value(content, "chunk");
+    if (val) {
+        cfg.upload_chunk_size = atoi(val);
+    }
+
     esp_err_t err = cam_uploader_set_config(&cfg);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save uploader config: %s", esp_err_to_name(err));
@@ -369,10 +742,316 @@ static esp_err_t uploader_save_post_handler(httpd_req_t *req)
     return ESP_OK;
 }
 
+static void send_client_stats_json(httpd_req_t *req, const char *name, const upload_client_stats_t *st, bool last)
+{
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "\"%s\":{\"requests\":%" PRIu32 ",\"failures\":%" PRIu32 ",\"connects\":%" PRIu32
+             ",\"reuses\":%" PRIu32 ",\"reconnects\":%" PRIu32 ",\"idle_closes\":%" PRIu32
+             ",\"bytes_total\":%llu,\"connect_us_total\":%lld,\"send_us_total\":%lld,\"response_us_total\":%lld"
+             ",\"last\":{\"connect_us\":%lld,\"send_us\":%lld,\"response_us\":%lld,\"reused\":%s,\"status\":%d},",
+             name, st->requests, st->failures, st->connects, st->reuses, st->reconnects, st->idle_closes,
+             (unsigned long long)st->bytes_total, (long long)st->connect_us_total, (long long)st->send_us_total, (long long)st->response_us_total,
+             (long long)st->last.connect_us, (long long)st->last.send_us, (long long)st->last.response_us,
+             st->last.reused ? "true" : "false", st->last.status);
+    httpd_resp_sendstr_chunk(req, buf);
+
+    static const char *const circuit_states[] = {"closed", "open", "half-open"};
+    const retry_policy_stats_t *r = &st->retry;
+    int64_t open_for_ms = 0;
+    if (r->state == RETRY_CIRCUIT_OPEN && r->open_until_us > esp_timer_get_time()) {
+        open_for_ms = (r->open_until_us - esp_timer_get_time()) / 1000;
+    }
+    snprintf(buf, sizeof(buf),
+             "\"tls\":{\"full\":%" PRIu32 ",\"session_offered\":%" PRIu32 ",\"full_us_avg\":%lld,"
+             "\"session_offered_us_avg\":%lld},",
+             st->tls_full, st->tls_session_offered,
+             (long long)(st->tls_full ? st->tls_full_us_total / st->tls_full : 0),
+             (long long)(st->tls_session_offered ? st->tls_session_offered_us_total / st->tls_session_offered : 0));
+    httpd_resp_sendstr_chunk(req, buf);
+
+    snprintf(buf, sizeof(buf),
+             "\"preconnect\":{\"opened\":%" PRIu32 ",\"hits\":%" PRIu32 ",\"misses\":%" PRIu32
+             ",\"hidden_us_total\":%lld},",
+             st->preconnects, st->preconnect_hits, st->preconnect_misses, (long long)st->hidden_us_total);
+    httpd_resp_sendstr_chunk(req, buf);
+
+    snprintf(buf, sizeof(buf),
+             "\"circuit\":{\"state\":\"%s\",\"open_for_ms\":%lld,\"attempts\":%" PRIu32 ",\"retries\":%" PRIu32
+             ",\"throttled\":%" PRIu32 ",\"rejected\":%" PRIu32 ",\"opens\":%" PRIu32 "}}%s",
+             circuit_states[r->state], (long long)open_for_ms, r->attempts, r->retries, r->throttled, r->rejected,
+             r->opens, last ? "" : ",");
+    httpd_resp_sendstr_chunk(req, buf);
+}
+
+// HTTP GET handler for uploader statistics (JSON)
+static esp_err_t uploader_stats_get_handler(httpd_req_t *req)
+{
+    cam_uploader_stats_t st;
+    memset(&st, 0, sizeof(st));
+    (void)cam_uploader_get_stats(&st);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{");
+    send_client_stats_json(req, "image", &st.image, false);
+    send_client_stats_json(req, "voltage", &st.voltage, false);
+
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "\"queue\":{\"queued\":%" PRIu32 ",\"pushed\":%" PRIu32 ",\"popped\":%" PRIu32 ",\"dropped\":%" PRIu32
+             ",\"alloc_failures\":%" PRIu32 ",\"high_water\":%" PRIu32 "}",
+             st.queued, st.queue.pushed, st.queue.popped, st.queue.dropped, st.queue.alloc_failures, st.queue.high_water);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"batches\":%" PRIu32 ",\"frames_uploaded\":%" PRIu32 ",\"frames_failed\":%" PRIu32,
+             st.batches, st.frames_uploaded, st.frames_failed);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf), ",\"ack_latency\":{\"last_us\":%lld,\"mean_us\":%lld,\"count\":%" PRIu32 "}",
+             (long long)st.ack_latency_us_last, (long long)(st.acks ? st.ack_latency_us_total / st.acks : 0), st.acks);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"schedule\":{\"slots\":%" PRIu32 ",\"skipped\":%" PRIu32 ",\"caught_up\":%" PRIu32
+             ",\"jitter_last_us\":%lld,\"jitter_max_us\":%lld,\"jitter_mean_us\":%lld,\"wall_aligned\":%s"
+             ",\"phase_ms\":%lld,\"random_delay_max_ms\":%lld}",
+             st.sched.slots, st.sched.skipped, st.sched.caught_up, (long long)st.sched.jitter_last_us,
+             (long long)st.sched.jitter_max_us,
+             (long long)(st.sched.slots ? st.sched.jitter_total_us / st.sched.slots : 0),
+             st.sched.wall_aligned ? "true" : "false", (long long)(st.sched.phase_us / 1000),
+             (long long)(st.sched.jitter_bound_us / 1000));
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"adaptive\":{\"samples\":%" PRIu32 ",\"steps_down\":%" PRIu32 ",\"steps_up\":%" PRIu32
+             ",\"load\":%.2f,\"quality\":%d,\"frame_size\":%d}",
+             st.quality.samples, st.quality.steps_down, st.quality.steps_up, (double)st.quality.load,
+             st.quality.quality, (int)st.quality.framesize);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"spool\":{\"pending\":%" PRIu32 ",\"spooled\":%" PRIu32 ",\"drained\":%" PRIu32 ",\"rejected\":%" PRIu32
+             ",\"dropped\":%" PRIu32 ",\"corrupt\":%" PRIu32 ",\"erases\":%" PRIu32 ",\"recovered\":%" PRIu32 "}",
+             st.spool_pending, st.spool.spooled, st.spool.drained, st.spool.rejected, st.spool.dropped, st.spool.corrupt,
+             st.spool.erases, st.spool.recovered);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"change\":{\"checked\":%" PRIu32 ",\"changed\":%" PRIu32 ",\"skipped\":%" PRIu32
+             ",\"heartbeats\":%" PRIu32 ",\"undecodable\":%" PRIu32 ",\"bytes_skipped\":%llu"
+             ",\"last_changed_permille\":%d,\"us_last\":%lld,\"us_max\":%lld}",
+             st.change.checked, st.change.changed, st.change.skipped, st.change.heartbeats, st.change.undecodable,
+             (unsigned long long)st.change.bytes_skipped, st.change.last_changed_permille, (long long)st.change_us_last,
+             (long long)st.change_us_max);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"dedup\":{\"hashed\":%" PRIu32 ",\"duplicates\":%" PRIu32 ",\"skipped\":%" PRIu32
+             ",\"referenced\":%" PRIu32 ",\"duplicate_bytes\":%llu,\"hash_us_last\":%lld,\"hash_us_max\":%lld"
+             ",\"hash_kib_per_s\":%llu}",
+             st.dedup.hashed, st.dedup.duplicates, st.dedup_skipped, st.dedup_referenced,
+             (unsigned long long)st.dedup.duplicate_bytes, (long long)st.dedup.hash_us_last,
+             (long long)st.dedup.hash_us_max,
+             (unsigned long long)(st.dedup.hash_us_total > 0
+                                      ? st.dedup.bytes_hashed * 1000000ULL / 1024ULL / (uint64_t)st.dedup.hash_us_total
+                                      : 0));
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"vegetation\":{\"records\":%" PRIu32 ",\"failures\":%" PRIu32 ",\"width\":%u,\"height\":%u"
+             ",\"exg_milli\":%" PRId32 ",\"exgr_milli\":%" PRId32 ",\"exg_cover_pm\":%u,\"exgr_cover_pm\":%u"
+             ",\"us_last\":%lld}",
+             st.veg_records, st.veg_failures, (unsigned)st.veg.width, (unsigned)st.veg.height, st.veg.exg_mean_milli,
+             st.veg.exgr_mean_milli, (unsigned)st.veg.exg_cover_permille, (unsigned)st.veg.exgr_cover_permille,
+             (long long)st.veg_us_last);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf), ",\"regions\":{\"us_last\":%lld,\"last\":[", (long long)st.regions_us_last);
+    httpd_resp_sendstr_chunk(req, buf);
+    for (int i = 0; i < st.region_count; i++) {
+        const roi_region_stats_t *r = &st.regions[i];
+        snprintf(buf, sizeof(buf), "%s{\"px\":%" PRIu32 ",\"luma\":%u,\"green_pm\":%u,\"change_pm\":%d}",
+                 i ? "," : "", r->pixels, (unsigned)r->luma_mean, (unsigned)r->green_permille,
+                 (int)r->changed_permille);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    snprintf(buf, sizeof(buf),
+             ",\"quality_gate\":{\"checked\":%" PRIu32 ",\"passed\":%" PRIu32 ",\"dark\":%" PRIu32
+             ",\"overexposed\":%" PRIu32 ",\"blurred\":%" PRIu32 ",\"undecodable\":%" PRIu32 ",\"retries\":%" PRIu32
+             ",\"skipped\":%" PRIu32,
+             st.gate.checked, st.gate.passed, st.gate.dark, st.gate.overexposed, st.gate.blurred, st.gate.undecodable,
+             st.gate_retries, st.gate_skipped);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"us_last\":%lld,\"us_max\":%lld,\"last\":{\"score\":%u,\"luma\":%u,\"crushed_pm\":%u"
+             ",\"clipped_pm\":%u,\"sharpness\":%" PRIu32 ",\"width\":%u,\"height\":%u}}",
+             (long long)st.gate_us_last, (long long)st.gate_us_max, (unsigned)st.gate_last.score,
+             (unsigned)st.gate_last.mean_luma, (unsigned)st.gate_last.crushed_permille,
+             (unsigned)st.gate_last.clipped_permille, st.gate_last.sharpness, (unsigned)st.gate_last.width,
+             (unsigned)st.gate_last.height);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"exposure_settle\":{\"runs\":%" PRIu32 ",\"timeouts\":%" PRIu32 ",\"frames_last\":%u"
+             ",\"ms_last\":%" PRId32 ",\"ms_max\":%" PRId32 ",\"luma_first\":%d,\"luma_last\":%d}",
+             st.settle_runs, st.settle_timeouts, (unsigned)st.settle_frames_last, st.settle_ms_last, st.settle_ms_max,
+             (int)st.settle_luma_first, (int)st.settle_luma_last);
+    httpd_resp_sendstr_chunk(req, buf);
+    // Histogram of uploaded frames: "below_ms" holds each bucket's upper bound, the last bucket is open.
+    static const int age_bounds_ms[] = {CAM_UPLOADER_AGE_BOUNDS_MS};
+    snprintf(buf, sizeof(buf),
+             ",\"capture_age\":{\"last_ms\":%" PRId32 ",\"max_ms\":%" PRId32 ",\"fresh_discarded\":%" PRIu32
+             ",\"fresh_wait_us_last\":%lld,\"below_ms\":[",
+             st.capture_age_ms_last, st.capture_age_ms_max, st.fresh_discarded, (long long)st.fresh_wait_us_last);
+    httpd_resp_sendstr_chunk(req, buf);
+    for (int i = 0; i < CAM_UPLOADER_AGE_BUCKETS - 1; i++) {
+        snprintf(buf, sizeof(buf), "%s%d", i ? "," : "", age_bounds_ms[i]);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "],\"frames\":[");
+    for (int i = 0; i < CAM_UPLOADER_AGE_BUCKETS; i++) {
+        snprintf(buf, sizeof(buf), "%s%" PRIu32, i ? "," : "", st.capture_age_hist[i]);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    snprintf(buf, sizeof(buf),
+             ",\"sensor_window\":{\"switches\":%" PRIu32 ",\"failures\":%" PRIu32
+             ",\"switch_us_last\":%lld,\"switch_us_max\":%lld,\"last\":\"%s\",\"width\":%u,\"height\":%u}",
+             st.window_switches, st.window_failures, (long long)st.window_switch_us_last,
+             (long long)st.window_switch_us_max, st.window_last[0] ? st.window_last : WINDOW_FULL_NAME,
+             (unsigned)st.window_width_last, (unsigned)st.window_height_last);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"tiles\":{\"keyframes\":%" PRIu32 ",\"deltas\":%" PRIu32 ",\"unsplittable\":%" PRIu32
+             ",\"strips_last\":%u,\"changed_last\":%u,\"bytes_full\":%llu,\"bytes_sent\":%llu"
+             ",\"us_last\":%lld,\"us_max\":%lld}",
+             st.tiles.keyframes, st.tiles.deltas, st.tiles.unsplittable, (unsigned)st.tiles.strips_last,
+             (unsigned)st.tiles.changed_last, (unsigned long long)st.tiles.bytes_full,
+             (unsigned long long)st.tiles.bytes_sent, (long long)st.tiles_us_last, (long long)st.tiles_us_max);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"preroll\":{\"budget\":%" PRIu32 ",\"bytes\":%" PRIu32 ",\"high_water\":%u,\"frames\":%" PRIu32
+             ",\"pushed\":%" PRIu32 ",\"expired\":%" PRIu32 ",\"lost\":%" PRIu32 ",\"too_large\":%" PRIu32 ",",
+             st.preroll_budget, st.preroll_bytes, (unsigned)st.preroll.high_water, st.preroll_frames,
+             st.preroll.pushed, st.preroll.expired, st.preroll.lost, st.preroll.too_large);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             "\"events\":%" PRIu32 ",\"triggers\":{\"http\":%" PRIu32 ",\"gpio\":%" PRIu32 ",\"change\":%" PRIu32
+             "},\"event_frames\":%" PRIu32 "}",
+             st.events, st.event_triggers[CAM_UPLOADER_EVENT_HTTP], st.event_triggers[CAM_UPLOADER_EVENT_GPIO],
+             st.event_triggers[CAM_UPLOADER_EVENT_CHANGE], st.event_frames);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             ",\"burst\":{\"fb_count\":%u,\"bursts\":%" PRIu32 ",\"frames\":%" PRIu32 ",\"short\":%" PRIu32
+             ",\"alloc_failures\":%" PRIu32 ",\"skipped\":%" PRIu32 ",",
+             (unsigned)st.camera_fb_count, st.bursts, st.burst_frames, st.burst_short, st.burst_alloc_failures,
+             st.burst_skipped);
+    httpd_resp_sendstr_chunk(req, buf);
+    snprintf(buf, sizeof(buf),
+             "\"count_last\":%u,\"fps_last\":%" PRIu32 ".%02" PRIu32 ",\"gap_us_mean_last\":%" PRIu32
+             ",\"jitter_us_rms_last\":%" PRIu32 ",\"jitter_us_max_last\":%" PRIu32,
+             (unsigned)st.burst_count_last, st.burst_fps_x100_last / 100, st.burst_fps_x100_last % 100,
+             st.burst_gap_us_mean_last, st.burst_jitter_us_rms_last, st.burst_jitter_us_max_last);
+    httpd_resp_sendstr_chunk(req, buf);
+    httpd_resp_sendstr_chunk(req, ",\"gaps_us_last\":[");
+    for (int i = 0; i + 1 < st.burst_count_last; i++) {
+        snprintf(buf, sizeof(buf), "%s%" PRIu32, i > 0 ? "," : "", st.burst_gaps_us_last[i]);
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    snprintf(buf, sizeof(buf),
+             ",\"trigger\":{\"requests\":%" PRIu32 ",\"coalesced\":%" PRIu32 ",\"uploads\":%" PRIu32
+             ",\"capture_us_last\":%lld,\"upload_us_last\":%lld,\"upload_us_max\":%lld,\"upload_us_mean\":%lld}",
+             st.triggers, st.triggers_coalesced, st.trigger_uploads, (long long)st.trigger_capture_us_last,
+             (long long)st.trigger_upload_us_last, (long long)st.trigger_upload_us_max,
+             st.trigger_uploads ? (long long)(st.trigger_upload_us_total / st.trigger_uploads) : 0LL);
+    httpd_resp_sendstr_chunk(req, buf);
+    httpd_resp_sendstr_chunk(req, "}");
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
+// HTTP POST handler that triggers an event: the pre-event buffer and the post-roll are uploaded.
+static esp_err_t event_post_handler(httpd_req_t *req)
+{
+    esp_err_t err = cam_uploader_trigger_event(CAM_UPLOADER_EVENT_HTTP);
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Pre-event buffer is off");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, "{\"triggered\":true}");
+    return ESP_OK;
+}
+
+// HTTP POST handler for an immediate capture and upload outside the schedule; the config is left alone.
+static esp_err_t trigger_post_handler(httpd_req_t *req)
+{
+    bool coalesced = false;
+    esp_err_t err = cam_uploader_trigger_capture(&coalesced);
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Uploader URL not set");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, coalesced ? "{\"triggered\":true,\"coalesced\":true}"
+                                      : "{\"triggered\":true,\"coalesced\":false}");
+    return ESP_OK;
+}
+
+// Bounds for /hash_bench. It runs on the httpd task, which serves nothing else meanwhile and needs
+// no login, so a request hashes at most 80 KB per algorithm: a few ms with the SHA engine.
+#define HASH_BENCH_MAX_KB 16
+#define HASH_BENCH_ROUNDS 4
+
+// HTTP GET handler timing the SHA engine used for frame dedup (JSON). Optional ?kb=N for one size.
+static esp_err_t hash_bench_get_handler(httpd_req_t *req)
+{
+    size_t sizes_kb[] = {4, HASH_BENCH_MAX_KB};
+    size_t count = sizeof(sizes_kb) / sizeof(sizes_kb[0]);
+    char query[32];
+    char kb[8];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "kb", kb, sizeof(kb)) == ESP_OK && atoi(kb) >= 1 &&
+        atoi(kb) <= HASH_BENCH_MAX_KB) {
+        sizes_kb[0] = (size_t)atoi(kb);
+        count = 1;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr_chunk(req, "{\"results\":[");
+    char buf[192];
+    for (size_t i = 0; i < count; i++) {
+        frame_dedup_bench_t r;
+        esp_err_t err = frame_dedup_benchmark(sizes_kb[i] * 1024, HASH_BENCH_ROUNDS, &r);
+        if (err != ESP_OK) {
+            snprintf(buf, sizeof(buf), "%s{\"bytes\":%u,\"error\":\"%s\"}", i ? "," : "",
+                     (unsigned)(sizes_kb[i] * 1024), esp_err_to_name(err));
+        } else {
+            snprintf(buf, sizeof(buf),
+                     "%s{\"bytes\":%u,\"rounds\":%d,\"sha256_us\":%lld,\"sha256_kib_per_s\":%" PRIu32
+                     ",\"sha1_us\":%lld,\"sha1_kib_per_s\":%" PRIu32 "}",
+                     i ? "," : "", (unsigned)r.len, r.rounds, (long long)r.sha256_us, r.sha256_kbps,
+                     (long long)r.sha1_us, r.sha1_kbps);
+        }
+        httpd_resp_sendstr_chunk(req, buf);
+    }
+#if CONFIG_MBEDTLS_HARDWARE_SHA
+    httpd_resp_sendstr_chunk(req, "],\"hardware\":true}");
+#else
+    httpd_resp_sendstr_chunk(req, "],\"hardware\":false}");
+#endif
+    httpd_resp_sendstr_chunk(req, NULL);
+    return ESP_OK;
+}
+
 // Start web server
 static httpd_handle_t start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    // The uploader handlers keep a whole config or stats struct (over 1 KB each) next to their text
+    // buffers, and saving goes on through cam_uploader_set_config() into NVS; 4 KB is not enough.
+    config.stack_size = 8192;
     httpd_handle_t server = NULL;
     
     if (httpd_start(&server, &config) == ESP_OK) {
@@ -402,6 +1081,42 @@ static httpd_handle_t start_webserver(void)
             .user_ctx  = NULL
         };
         httpd_register_uri_handler(server, &uploader_uri);
+
+        // URI handler for uploader statistics
+        httpd_uri_t uploader_stats_uri = {
+            .uri       = "/uploader_stats",
+            .method    = HTTP_GET,
+            .handler   = uploader_stats_get_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server, &uploader_stats_uri);
+
+        // URI handler for the frame hash benchmark
+        httpd_uri_t hash_bench_uri = {
+            .uri       = "/hash_bench",
+            .method    = HTTP_GET,
+            .handler   = hash_bench_get_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server, &hash_bench_uri);
+
+        // URI handler for event triggers
+        httpd_uri_t event_uri = {
+            .uri       = "/event",
+            .method    = HTTP_POST,
+            .handler   = event_post_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server, &event_uri);
+
+        // URI handler for on-demand captures
+        httpd_uri_t trigger_uri = {
+            .uri       = "/trigger",
+            .method    = HTTP_POST,
+            .handler   = trigger_post_handler,
+            .user_ctx  = NULL
+        };
+        httpd_register_uri_handler(server, &trigger_uri);
         
         return server;
     }
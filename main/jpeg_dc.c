@@ -0,0 +1,633 @@
+#include "jpeg_dc.h"
+
+#include <string.h>
+
+// Marker codes (ITU T.81 table B.1).
+#define M_SOF0 0xC0
+#define M_SOF1 0xC1
+#define M_DHT 0xC4
+#define M_SOI 0xD8
+#define M_EOI 0xD9
+#define M_SOS 0xDA
+#define M_DQT 0xDB
+#define M_DRI 0xDD
+
+#define JPEG_DC_MAX_COMPONENTS 3
+
+// jpeg_dc_decoder_t.mode
+#define MODE_GRID 0
+#define MODE_LUMA_IMAGE 1
+#define MODE_THUMBNAIL 2
+
+// Mean of the lowest AC basis functions over a 4x4 quarter of the block, Q12: 1/(4*sqrt(2)) * a and
+// a * a / 4, where a = mean of cos((2x + 1) * pi / 16) over x = 0..3 (0.641). The quarter's true mean
+// also has the u or v = 3, 5, 7 terms (per-axis means -0.225, 0.150, -0.127), which are not decoded,
+// so this is an approximation that holds for the smooth content of most blocks.
+#define QUARTER_K1 464
+#define QUARTER_K2 420
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t buf; // MSB-aligned; the top `bits` bits are valid
+    int bits;
+    bool marker;        // stopped in front of a marker; zeros are fed from here on
+    uint32_t zero_fill; // bytes fed after stopping
+} bitreader_t;
+
+typedef struct {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t tq;
+    uint8_t td;
+    uint8_t ta;
+    int pred;
+} component_t;
+
+static void br_fill(bitreader_t *br)
+{
+    while (br->bits <= 24) {
+        uint32_t byte = 0;
+        bool fed = false;
+        if (!br->marker && br->p < br->end) {
+            byte = *br->p;
+            if (byte == 0xFF) {
+                if (br->p + 1 < br->end && br->p[1] == 0x00) {
+                    br->p += 2; // stuffed 0xFF
+                } else {
+                    br->marker = true;
+                    byte = 0;
+                }
+            } else {
+                br->p++;
+            }
+            fed = !br->marker;
+        }
+        if (!fed) {
+            br->zero_fill++;
+        }
+        br->buf |= byte << (24 - br->bits);
+        br->bits += 8;
+    }
+}
+
+static void br_consume(bitreader_t *br, int n)
+{
+    br->buf <<= n;
+    br->bits -= n;
+}
+
+// Code lengths up to 16 bits; after br_fill() at least 25 bits are buffered.
+static int huff_decode(bitreader_t *br, const jpeg_dc_huff_t *h)
+{
+    br_fill(br);
+    uint16_t e = h->lookup[br->buf >> 24];
+    if (e) {
+        br_consume(br, e >> 8);
+        return e & 0xFF;
+    }
+    for (int l = 9; l <= 16; l++) {
+        int32_t code = (int32_t)(br->buf >> (32 - l));
+        if (code <= h->maxcode[l]) {
+            br_consume(br, l);
+            return h->vals[h->valptr[l] + code - h->mincode[l]];
+        }
+    }
+    return -1;
+}
+
+static int receive_extend(bitreader_t *br, int s)
+{
+    if (s == 0) {
+        return 0;
+    }
+    br_fill(br);
+    int v = (int)(br->buf >> (32 - s));
+    br_consume(br, s);
+    return v < (1 << (s - 1)) ? v - (1 << s) + 1 : v;
+}
+
+static bool huff_build(jpeg_dc_huff_t *h, const uint8_t counts[16], const uint8_t *symbols, int total)
+{
+    memset(h, 0, sizeof(*h));
+    int code = 0;
+    int k = 0;
+    for (int l = 1; l <= 16; l++) {
+        h->valptr[l] = k;
+        h->mincode[l] = (uint16_t)code;
+        for (int i = 0; i < counts[l - 1]; i++, k++, code++) {
+            if (l <= 8) {
+                int first = code << (8 - l);
+                for (int j = 0; j < (1 << (8 - l)); j++) {
+                    h->lookup[first + j] = (uint16_t)((l << 8) | symbols[k]);
+                }
+            }
+        }
+        h->maxcode[l] = counts[l - 1] ? code - 1 : -1;
+        if (code > (1 << l)) {
+            return false; // over-subscribed
+        }
+        code <<= 1;
+    }
+    memcpy(h->vals, symbols, (size_t)total);
+    h->defined = true;
+    return true;
+}
+
+// Decode one block; only the DC difference is kept, AC coefficients are skipped. With `lf`, the
+// coefficients at zig-zag positions 1, 2 and 4 (lowest horizontal, vertical and diagonal terms)
+// are stored there.
+static bool decode_block(bitreader_t *br, const jpeg_dc_huff_t *dc, const jpeg_dc_huff_t *ac, int *pred, int *lf)
+{
+    int t = huff_decode(br, dc);
+    if (t < 0 || t > 11) {
+        return false;
+    }
+    *pred += receive_extend(br, t);
+    if (lf) {
+        lf[0] = lf[1] = lf[2] = 0;
+    }
+    for (int k = 1; k < 64;) {
+        int rs = huff_decode(br, ac);
+        if (rs < 0) {
+            return false;
+        }
+        int r = rs >> 4;
+        int s = rs & 15;
+        if (s) {
+            k += r;
+            if (lf && k <= 4 && k != 3) {
+                lf[k == 4 ? 2 : k - 1] = receive_extend(br, s);
+            } else {
+                br_fill(br);
+                br_consume(br, s);
+            }
+            k++;
+        } else if (r == 15) {
+            k += 16;
+        } else {
+            break; // end of block
+        }
+    }
+    return true;
+}
+
+// Drop buffered bits and step over the RSTn marker that ends the interval.
+static bool restart_sync(bitreader_t *br)
+{
+    const uint8_t *p = br->p;
+    while (p + 1 < br->end && !(p[0] == 0xFF && p[1] >= 0xD0 && p[1] <= 0xD7)) {
+        p++;
+    }
+    if (p + 1 >= br->end) {
+        return false;
+    }
+    br->p = p + 2;
+    br->buf = 0;
+    br->bits = 0;
+    br->marker = false;
+    br->zero_fill = 0;
+    return true;
+}
+
+static uint8_t clamp_u8(int v)
+{
+    return (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+}
+
+static void accumulate(jpeg_dc_decoder_t *dec, const component_t *c, int hmax, int vmax, int width, int height,
+                       int bx, int by)
+{
+    int px = (bx * 8 + 4) * hmax / c->h;
+    int py = (by * 8 + 4) * vmax / c->v;
+    if (px >= width || py >= height) {
+        return; // padding block
+    }
+    if (dec->mode == MODE_LUMA_IMAGE) {
+        if (bx < dec->image_w && by < dec->image_h) {
+            dec->image[by * dec->image_w + bx] = clamp_u8(128 + c->pred * dec->image_q / 8);
+        }
+        return;
+    }
+    int gx = px * JPEG_DC_GRID_W / width;
+    int gy = py * JPEG_DC_GRID_H / height;
+    dec->sum[gy][gx] += c->pred;
+    dec->count[gy][gx]++;
+}
+
+// Thumbnail mode: spread one block's 1x1 (1/8 scale) or 2x2 (1/4 scale) values over the output
+// pixels it covers, as channel `ch` (0 = Y, 1 = Cb, 2 = Cr) of the 3-byte pixels.
+static void thumb_store(jpeg_dc_decoder_t *dec, const component_t *c, int ch, int hmax, int vmax, int bx, int by,
+                        const int *lf)
+{
+    int q = dec->dc_quant[c->tq];
+    int sub = 8 / dec->thumb_scale; // values per block side
+    int fx = hmax / c->h;            // output pixels per value (chroma subsampling)
+    int fy = vmax / c->v;
+    for (int sy = 0; sy < sub; sy++) {
+        for (int sx = 0; sx < sub; sx++) {
+            int v;
+            if (sub == 1) {
+                v = 128 + c->pred * q / 8;
+            } else {
+                const uint16_t *lq = dec->lf_quant[c->tq];
+                int h = lf[0] * lq[0] * (sx ? -1 : 1);
+                int w = lf[1] * lq[1] * (sy ? -1 : 1);
+                int d = lf[2] * lq[2] * (sx == sy ? 1 : -1);
+                int64_t sum = (int64_t)c->pred * q * 512 + (int64_t)QUARTER_K1 * (h + w) + (int64_t)QUARTER_K2 * d;
+                v = 128 + (int)((sum + 2048) >> 12);
+            }
+            uint8_t value = clamp_u8(v);
+            int x0 = (bx * sub + sx) * fx;
+            int y0 = (by * sub + sy) * fy;
+            for (int y = y0; y < y0 + fy && y < dec->image_h; y++) {
+                for (int x = x0; x < x0 + fx && x < dec->image_w; x++) {
+                    dec->image[(y * dec->image_w + x) * 3 + ch] = value;
+                }
+            }
+        }
+    }
+}
+
+static bool decode_scan(jpeg_dc_decoder_t *dec, bitreader_t *br, component_t *comps, int ncomp, const int *scan,
+                        int nscan, int width, int height, int restart)
+{
+    int hmax = 1;
+    int vmax = 1;
+    for (int i = 0; i < ncomp; i++) {
+        hmax = comps[i].h > hmax ? comps[i].h : hmax;
+        vmax = comps[i].v > vmax ? comps[i].v : vmax;
+    }
+    for (int i = 0; i < nscan; i++) {
+        component_t *c = &comps[scan[i]];
+        if (!dec->dc[c->td].defined || !dec->ac[c->ta].defined) {
+            return false;
+        }
+        c->pred = 0;
+    }
+
+    // A single-component scan is a plain raster of that component's blocks; only luma is useful.
+    bool thumbnail = dec->mode == MODE_THUMBNAIL;
+    int lf_coef[3];
+    int *lf = thumbnail && dec->thumb_scale == 4 ? lf_coef : NULL;
+    bool interleaved = nscan > 1;
+    if (!interleaved && scan[0] != 0) {
+        return false;
+    }
+    int mcus_x;
+    int mcus_y;
+    if (interleaved) {
+        mcus_x = (width + 8 * hmax - 1) / (8 * hmax);
+        mcus_y = (height + 8 * vmax - 1) / (8 * vmax);
+    } else {
+        mcus_x = ((width * comps[0].h + hmax - 1) / hmax + 7) / 8;
+        mcus_y = ((height * comps[0].v + vmax - 1) / vmax + 7) / 8;
+    }
+
+    memset(dec->sum, 0, sizeof(dec->sum));
+    memset(dec->count, 0, sizeof(dec->count));
+    int total = mcus_x * mcus_y;
+    for (int mcu = 0; mcu < total; mcu++) {
+        if (restart > 0 && mcu > 0 && mcu % restart == 0) {
+            if (!restart_sync(br)) {
+                return false;
+            }
+            for (int i = 0; i < nscan; i++) {
+                comps[scan[i]].pred = 0;
+            }
+        }
+        int mx = mcu % mcus_x;
+        int my = mcu / mcus_x;
+        if (!interleaved) {
+            component_t *c = &comps[0];
+            if (!decode_block(br, &dec->dc[c->td], &dec->ac[c->ta], &c->pred, lf)) {
+                return false;
+            }
+            if (thumbnail) {
+                thumb_store(dec, c, 0, hmax, vmax, mx, my, lf);
+            } else {
+                accumulate(dec, c, hmax, vmax, width, height, mx, my);
+            }
+            continue;
+        }
+        for (int i = 0; i < nscan; i++) {
+            component_t *c = &comps[scan[i]];
+            for (int v = 0; v < c->v; v++) {
+                for (int h = 0; h < c->h; h++) {
+                    if (!decode_block(br, &dec->dc[c->td], &dec->ac[c->ta], &c->pred, lf)) {
+                        return false;
+                    }
+                    if (thumbnail) {
+                        thumb_store(dec, c, scan[i], hmax, vmax, mx * c->h + h, my * c->v + v, lf);
+                    } else if (scan[i] == 0) {
+                        accumulate(dec, c, hmax, vmax, width, height, mx * c->h + h, my * c->v + v);
+                    }
+                }
+            }
+        }
+    }
+    // Running far past the end of the data means the scan was truncated.
+    return br->zero_fill <= 8;
+}
+
+// Walks the markers up to the first scan and decodes it into dec->image (luma image and thumbnail
+// modes) or `grid`.
+static bool decode_luma(jpeg_dc_decoder_t *dec, const uint8_t *jpg, size_t len, size_t image_size,
+                        jpeg_dc_grid_t *grid)
+{
+    if (len < 4 || jpg[0] != 0xFF || jpg[1] != M_SOI) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        dec->dc[i].defined = false;
+        dec->ac[i].defined = false;
+        dec->dc_quant[i] = 0;
+    }
+
+    component_t comps[JPEG_DC_MAX_COMPONENTS];
+    int ncomp = 0;
+    int width = 0;
+    int height = 0;
+    int restart = 0;
+    const uint8_t *p = jpg + 2;
+    const uint8_t *end = jpg + len;
+    while (p + 4 <= end) {
+        if (p[0] != 0xFF) {
+            return false;
+        }
+        uint8_t m = p[1];
+        if (m == 0xFF) {
+            p++; // fill byte
+            continue;
+        }
+        p += 2;
+        if (m == M_SOI || m == 0x01 || (m >= 0xD0 && m <= 0xD7)) {
+            continue; // no payload
+        }
+        if (m == M_EOI) {
+            return false;
+        }
+        int seglen = (p[0] << 8) | p[1];
+        if (seglen < 2 || p + seglen > end) {
+            return false;
+        }
+        const uint8_t *seg = p + 2;
+        const uint8_t *seg_end = p + seglen;
+
+        if (m == M_DQT) {
+            while (seg < seg_end) {
+                int pq = seg[0] >> 4;
+                int tq = seg[0] & 15;
+                int size = pq ? 128 : 64;
+                if (tq > 3 || seg + 1 + size > seg_end) {
+                    return false;
+                }
+                // Entries are in zig-zag order; keep DC and the three lowest AC terms.
+                static const int lf_pos[3] = {1, 2, 4};
+                dec->dc_quant[tq] = pq ? (uint16_t)((seg[1] << 8) | seg[2]) : seg[1];
+                for (int i = 0; i < 3; i++) {
+                    const uint8_t *e = seg + 1 + (pq ? 2 * lf_pos[i] : lf_pos[i]);
+                    dec->lf_quant[tq][i] = pq ? (uint16_t)((e[0] << 8) | e[1]) : e[0];
+                }
+                seg += 1 + size;
+            }
+        } else if (m == M_DHT) {
+            while (seg + 17 <= seg_end) {
+                int tc = seg[0] >> 4;
+                int th = seg[0] & 15;
+                int total = 0;
+                for (int i = 0; i < 16; i++) {
+                    total += seg[1 + i];
+                }
+                if (tc > 1 || th > 3 || total > 256 || seg + 17 + total > seg_end) {
+                    return false;
+                }
+                if (!huff_build(tc ? &dec->ac[th] : &dec->dc[th], seg + 1, seg + 17, total)) {
+                    return false;
+                }
+                seg += 17 + total;
+            }
+        } else if (m == M_SOF0 || m == M_SOF1) {
+            if (seglen < 8) {
+                return false;
+            }
+            height = (seg[1] << 8) | seg[2];
+            width = (seg[3] << 8) | seg[4];
+            ncomp = seg[5];
+            if (seg[0] != 8 || width == 0 || height == 0 || ncomp < 1 || ncomp > JPEG_DC_MAX_COMPONENTS ||
+                seglen < 8 + 3 * ncomp) {
+                return false;
+            }
+            for (int i = 0; i < ncomp; i++) {
+                const uint8_t *c = seg + 6 + 3 * i;
+                comps[i].id = c[0];
+                comps[i].h = c[1] >> 4;
+                comps[i].v = c[1] & 15;
+                comps[i].tq = c[2] & 3;
+                if (comps[i].h < 1 || comps[i].h > 4 || comps[i].v < 1 || comps[i].v > 4) {
+                    return false;
+                }
+            }
+        } else if (m >= 0xC2 && m <= 0xCF && m != M_DHT && m != 0xC8 && m != 0xCC) {
+            return false; // progressive, lossless or arithmetic coding
+        } else if (m == M_DRI) {
+            if (seglen < 4) {
+                return false;
+            }
+            restart = (seg[0] << 8) | seg[1];
+        } else if (m == M_SOS) {
+            int nscan = seg[0];
+            int scan[JPEG_DC_MAX_COMPONENTS];
+            if (ncomp == 0 || nscan < 1 || nscan > ncomp || seglen < 6 + 2 * nscan) {
+                return false;
+            }
+            for (int i = 0; i < nscan; i++) {
+                const uint8_t *s = seg + 1 + 2 * i;
+                scan[i] = -1;
+                for (int j = 0; j < ncomp; j++) {
+                    if (comps[j].id == s[0]) {
+                        scan[i] = j;
+                    }
+                }
+                if (scan[i] < 0) {
+                    return false;
+                }
+                comps[scan[i]].td = (s[1] >> 4) & 3;
+                comps[scan[i]].ta = s[1] & 3;
+            }
+            if (nscan > 1 && nscan != ncomp) {
+                return false;
+            }
+
+            // DC * q is 8x the block mean of (luma - 128).
+            int q = dec->dc_quant[comps[0].tq];
+            if (dec->mode == MODE_THUMBNAIL) {
+                // Chroma-only scans (non-interleaved files) are rejected by decode_scan().
+                dec->image_w = (width + dec->thumb_scale - 1) / dec->thumb_scale;
+                dec->image_h = (height + dec->thumb_scale - 1) / dec->thumb_scale;
+                if (JPEG_DC_THUMB_BUF_SIZE(dec->image_w, dec->image_h) > image_size) {
+                    return false;
+                }
+                // Grayscale files leave the chroma bytes neutral.
+                memset(dec->image, 128, JPEG_DC_THUMB_BUF_SIZE(dec->image_w, dec->image_h));
+            } else if (dec->mode == MODE_LUMA_IMAGE) {
+                int hmax = 1;
+                int vmax = 1;
+                for (int i = 0; i < ncomp; i++) {
+                    hmax = comps[i].h > hmax ? comps[i].h : hmax;
+                    vmax = comps[i].v > vmax ? comps[i].v : vmax;
+                }
+                dec->image_w = ((width * comps[0].h + hmax - 1) / hmax + 7) / 8;
+                dec->image_h = ((height * comps[0].v + vmax - 1) / vmax + 7) / 8;
+                dec->image_q = q;
+                if ((size_t)dec->image_w * (size_t)dec->image_h > image_size) {
+                    return false;
+                }
+            }
+
+            bitreader_t br = {.p = seg_end, .end = end};
+            if (!decode_scan(dec, &br, comps, ncomp, scan, nscan, width, height, restart)) {
+                return false;
+            }
+            if (dec->mode != MODE_GRID) {
+                return true;
+            }
+
+            grid->width = (uint16_t)width;
+            grid->height = (uint16_t)height;
+            for (int y = 0; y < JPEG_DC_GRID_H; y++) {
+                for (int x = 0; x < JPEG_DC_GRID_W; x++) {
+                    int luma = 0;
+                    if (dec->count[y][x]) {
+                        luma = 128 + (int)((int64_t)dec->sum[y][x] * q / (8 * dec->count[y][x]));
+                    }
+                    grid->cells[y][x] = clamp_u8(luma);
+                }
+            }
+            return true;
+        }
+        p = seg_end;
+    }
+    return false;
+}
+
+bool jpeg_dc_luma_grid(jpeg_dc_decoder_t *dec, const uint8_t *jpg, size_t len, jpeg_dc_grid_t *out)
+{
+    if (!dec || !jpg || !out) {
+        return false;
+    }
+    dec->mode = MODE_GRID;
+    return decode_luma(dec, jpg, len, 0, out);
+}
+
+bool jpeg_dc_luma_image(jpeg_dc_decoder_t *dec, const uint8_t *jpg, size_t len, uint8_t *out, size_t out_size,
+                        uint16_t *out_w, uint16_t *out_h)
+{
+    if (!dec || !jpg || !out_w || !out_h) {
+        return false;
+    }
+    dec->mode = MODE_LUMA_IMAGE;
+    dec->image = out;
+    dec->image_w = 0;
+    dec->image_h = 0;
+    bool ok = decode_luma(dec, jpg, len, out ? out_size : 0, NULL);
+    dec->mode = MODE_GRID;
+    dec->image = NULL;
+    *out_w = (uint16_t)dec->image_w;
+    *out_h = (uint16_t)dec->image_h;
+    return ok;
+}
+
+// Pack the decoded 3-byte YCbCr pixels into RGB565 at the start of the same buffer (JFIF matrix, Q16).
+static void ycc_to_rgb565(uint8_t *buf, size_t pixels)
+{
+    for (size_t i = 0; i < pixels; i++) {
+        const uint8_t *p = buf + 3 * i;
+        int y = p[0] << 16;
+        int cb = p[1] - 128;
+        int cr = p[2] - 128;
+        int r = clamp_u8((y + 91881 * cr + 32768) >> 16);
+        int g = clamp_u8((y - 22554 * cb - 46802 * cr + 32768) >> 16);
+        int b = clamp_u8((y + 116130 * cb + 32768) >> 16);
+        uint16_t px = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+        buf[2 * i] = (uint8_t)(px >> 8); // never ahead of the pixel being read
+        buf[2 * i + 1] = (uint8_t)px;
+    }
+}
+
+bool jpeg_dc_thumbnail(jpeg_dc_decoder_t *dec, const uint8_t *jpg, size_t len, int scale, uint8_t *out,
+                       size_t out_size, uint16_t *out_w, uint16_t *out_h)
+{
+    if (!dec || !jpg || !out_w || !out_h || (scale != 4 && scale != 8)) {
+        return false;
+    }
+    dec->mode = MODE_THUMBNAIL;
+    dec->thumb_scale = scale;
+    dec->image = out;
+    dec->image_w = 0;
+    dec->image_h = 0;
+    bool ok = decode_luma(dec, jpg, len, out ? out_size : 0, NULL);
+    dec->mode = MODE_GRID;
+    dec->image = NULL;
+    *out_w = (uint16_t)dec->image_w;
+    *out_h = (uint16_t)dec->image_h;
+    if (ok) {
+        ycc_to_rgb565(out, (size_t)dec->image_w * dec->image_h);
+    }
+    return ok;
+}
+
+bool jpeg_dc_frame_size(const uint8_t *jpg, size_t len, uint16_t *out_w, uint16_t *out_h)
+{
+    if (len < 4 || jpg[0] != 0xFF || jpg[1] != M_SOI) {
+        return false;
+    }
+    const uint8_t *p = jpg + 2;
+    const uint8_t *end = jpg + len;
+    while (p + 4 <= end) {
+        if (p[0] != 0xFF) {
+            return false;
+        }
+        uint8_t m = p[1];
+        if (m == 0xFF) {
+            p++;
+            continue;
+        }
+        p += 2;
+        if (m == M_SOI || m == 0x01 || (m >= 0xD0 && m <= 0xD7)) {
+            continue;
+        }
+        if (m == M_EOI || m == M_SOS) {
+            return false; // no frame header before the scan
+        }
+        int seglen = (p[0] << 8) | p[1];
+        if (seglen < 2 || p + seglen > end) {
+            return false;
+        }
+        if (m >= M_SOF0 && m <= 0xCF && m != M_DHT && m != 0xC8 && m != 0xCC) {
+            if (seglen < 8) {
+                return false;
+            }
+            *out_h = (uint16_t)((p[3] << 8) | p[4]);
+            *out_w = (uint16_t)((p[5] << 8) | p[6]);
+            return *out_w > 0 && *out_h > 0;
+        }
+        p += seglen;
+    }
+    return false;
+}
+
+int jpeg_dc_grid_changed_cells(const jpeg_dc_grid_t *a, const jpeg_dc_grid_t *b, int delta)
+{
+    int changed = 0;
+    for (int y = 0; y < JPEG_DC_GRID_H; y++) {
+        for (int x = 0; x < JPEG_DC_GRID_W; x++) {
+            int d = (int)a->cells[y][x] - (int)b->cells[y][x];
+            if (d > delta || d < -delta) {
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Coarse luma grid, independent of the frame size so frames taken at different sizes compare.
+#define JPEG_DC_GRID_W 32
+#define JPEG_DC_GRID_H 24
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint8_t cells[JPEG_DC_GRID_H][JPEG_DC_GRID_W]; // mean luma per cell, 0..255
+} jpeg_dc_grid_t;
+
+typedef struct {
+    uint16_t lookup[256]; // 8-bit prefix -> (code length << 8) | symbol; 0 = longer code
+    int32_t maxcode[17];
+    int32_t valptr[17];
+    uint16_t mincode[17];
+    uint8_t vals[256];
+    bool defined;
+} jpeg_dc_huff_t;
+
+/** Buffer jpeg_dc_thumbnail() needs for a w x h thumbnail: it decodes 3 bytes/pixel, then packs RGB565 in place. */
+#define JPEG_DC_THUMB_BUF_SIZE(w, h) ((size_t)(w) * (size_t)(h) * 3)
+
+/**
+ * Scratch state for the decoders below, about 12 KB; keep it off small task stacks. Nothing in it
+ * outlives a call, so the analysis modules running on one task share a single instance.
+ * Has no ESP-IDF dependencies so tools/change_bench.c can build it on the host.
+ */
+typedef struct {
+    jpeg_dc_huff_t dc[4];
+    jpeg_dc_huff_t ac[4];
+    uint16_t dc_quant[4]; // DC entry of each quantization table
+    uint16_t lf_quant[4][3]; // entries of the three lowest AC terms (zig-zag 1, 2 and 4), for thumbnails
+    int32_t sum[JPEG_DC_GRID_H][JPEG_DC_GRID_W];
+    uint16_t count[JPEG_DC_GRID_H][JPEG_DC_GRID_W];
+    uint8_t mode;   // what the running call produces (grid, luma image or thumbnail)
+    uint8_t *image; // jpeg_dc_luma_image() / jpeg_dc_thumbnail() output
+    int image_w;
+    int image_h;
+    int image_q;
+    int thumb_scale;
+} jpeg_dc_decoder_t;
+
+/**
+ * Build the luma grid of a baseline JPEG from the DC coefficients alone: the entropy-coded data is
+ * walked (AC coefficients are decoded only to be skipped) but nothing is dequantized beyond DC and
+ * no IDCT runs. Progressive and arithmetic-coded files are rejected. Returns false on any error.
+ */
+bool jpeg_dc_luma_grid(jpeg_dc_decoder_t *dec, const uint8_t *jpg, size_t len, jpeg_dc_grid_t *out);
+
+/**
+ * Luma at 1/8 scale: one pixel per 8x8 luma block (its DC term), (width + 7) / 8 by (height + 7) / 8
+ * pixels for the usual full-resolution luma. Same decoding as jpeg_dc_luma_grid(). Returns false on
+ * any error; if only `out_size` was too small (it may be 0, `out` NULL), `*out_w`/`*out_h` are set to
+ * the size needed.
+ */
+bool jpeg_dc_luma_image(jpeg_dc_decoder_t *dec, const uint8_t *jpg, size_t len, uint8_t *out, size_t out_size,
+                        uint16_t *out_w, uint16_t *out_h);
+
+/**
+ * Colour thumbnail at 1/8 scale from the DC terms alone, or at 1/4 scale from DC plus the three
+ * lowest AC terms of each block (no IDCT either way). The 1/4 scale pixels approximate the mean of
+ * each 4x4 quarter: the odd terms above them (u or v = 3, 5, 7) shift it too, by per-axis weights of
+ * about -0.225, 0.150 and -0.127 against 0.641 for u = 1, so edges inside a block come out softer
+ * than a full decode would show them. `scale` is 8 or 4. Writes (width + scale - 1) / scale by (height + scale - 1) / scale
+ * RGB565 pixels, high byte first like jpg2rgb565() and the camera's RGB565 frames, to the start of
+ * `out`, which must hold JPEG_DC_THUMB_BUF_SIZE() bytes. Size reporting as jpeg_dc_luma_image().
+ */
+bool jpeg_dc_thumbnail(jpeg_dc_decoder_t *dec, const uint8_t *jpg, size_t len, int scale, uint8_t *out,
+                       size_t out_size, uint16_t *out_w, uint16_t *out_h);
+
+/**
+ * Width and height from the frame header, without decoding anything. Drivers report the configured
+ * frame size, which is not what the sensor sends once its window has been set directly.
+ */
+bool jpeg_dc_frame_size(const uint8_t *jpg, size_t len, uint16_t *out_w, uint16_t *out_h);
+
+/** Number of cells whose mean luma differs by more than `delta` between the two grids. */
+int jpeg_dc_grid_changed_cells(const jpeg_dc_grid_t *a, const jpeg_dc_grid_t *b, int delta);
+
+#ifdef __cplusplus
+}
+#endif
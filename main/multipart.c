@@ -0,0 +1,61 @@
+#include "multipart.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MULTIPART_TRAILER "--" MULTIPART_BOUNDARY "--\r\n"
+
+// Part headers are short (field names and filenames are ours), so a small stack buffer is enough.
+#define MULTIPART_HEADER_MAX 192
+
+static int format_part_header(char *buf, size_t buf_len, const multipart_part_t *part)
+{
+    int n = snprintf(buf, buf_len, "--%s\r\nContent-Disposition: form-data; name=\"%s\"", MULTIPART_BOUNDARY,
+                     part->name);
+    if (n >= 0 && part->filename && (size_t)n < buf_len) {
+        n += snprintf(buf + n, buf_len - (size_t)n, "; filename=\"%s\"", part->filename);
+    }
+    if (n >= 0 && part->content_type && (size_t)n < buf_len) {
+        n += snprintf(buf + n, buf_len - (size_t)n, "\r\nContent-Type: %s", part->content_type);
+    }
+    if (n >= 0 && (size_t)n < buf_len) {
+        n += snprintf(buf + n, buf_len - (size_t)n, "\r\n\r\n");
+    }
+    return (n < 0 || (size_t)n >= buf_len) ? -1 : n;
+}
+
+size_t multipart_body_length(const multipart_part_t *parts, size_t count)
+{
+    char hdr[MULTIPART_HEADER_MAX];
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        int hl = format_part_header(hdr, sizeof(hdr), &parts[i]);
+        if (hl < 0) {
+            return 0;
+        }
+        total += (size_t)hl + parts[i].len + 2;
+    }
+    return total + strlen(MULTIPART_TRAILER);
+}
+
+esp_err_t multipart_write(upload_client_t *uc, const multipart_part_t *parts, size_t count)
+{
+    char hdr[MULTIPART_HEADER_MAX];
+    for (size_t i = 0; i < count; i++) {
+        int hl = format_part_header(hdr, sizeof(hdr), &parts[i]);
+        if (hl < 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        esp_err_t err = upload_client_write(uc, hdr, (size_t)hl);
+        if (err == ESP_OK && parts[i].len > 0) {
+            err = upload_client_write(uc, parts[i].data, parts[i].len);
+        }
+        if (err == ESP_OK) {
+            err = upload_client_write(uc, "\r\n", 2);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return upload_client_write(uc, MULTIPART_TRAILER, strlen(MULTIPART_TRAILER));
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "esp_err.h"
+#include "upload_client.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MULTIPART_BOUNDARY "farmcam-3f9a1c7e52d84b06"
+#define MULTIPART_CONTENT_TYPE "multipart/form-data; boundary=" MULTIPART_BOUNDARY
+
+/** One form-data part. The payload is referenced, never copied. */
+typedef struct {
+    const char *name;         // form field name
+    const char *filename;     // NULL for plain fields
+    const char *content_type; // NULL to omit the part Content-Type header
+    const uint8_t *data;
+    size_t len;
+} multipart_part_t;
+
+/** Exact encoded size of the body, so it can be sent with a Content-Length header. */
+size_t multipart_body_length(const multipart_part_t *parts, size_t count);
+
+/** Stream the encoded body through `uc`; part payloads go straight from their buffers to the socket. */
+esp_err_t multipart_write(upload_client_t *uc, const multipart_part_t *parts, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,142 @@
+#include "preroll_ring.h"
+
+#include <string.h>
+
+// Stored in front of each frame.
+typedef struct {
+    uint32_t len;
+    uint32_t seq;
+    int64_t capture_us;
+    uint16_t width;
+    uint16_t height;
+    uint32_t reserved;
+} record_t;
+
+_Static_assert(sizeof(record_t) == PREROLL_RING_RECORD_OVERHEAD, "record header size");
+
+static size_t record_size(size_t len)
+{
+    return (sizeof(record_t) + len + 7) & ~(size_t)7;
+}
+
+void preroll_ring_init(preroll_ring_t *ring, uint8_t *buf, size_t cap)
+{
+    memset(ring, 0, sizeof(*ring));
+    ring->buf = buf;
+    ring->cap = cap & ~(size_t)7;
+    ring->wrap = ring->cap;
+}
+
+static void drop_oldest(preroll_ring_t *ring)
+{
+    record_t rec;
+    memcpy(&rec, ring->buf + ring->tail, sizeof(rec));
+    size_t size = record_size(rec.len);
+    ring->tail += size;
+    ring->used -= size;
+    ring->count--;
+    if (ring->count == 0) {
+        ring->head = ring->tail = 0;
+        ring->wrap = ring->cap;
+    } else if (ring->tail == ring->wrap) {
+        ring->tail = 0; // the older part is used up; the frames no longer wrap
+        ring->wrap = ring->cap;
+    }
+}
+
+bool preroll_ring_push(preroll_ring_t *ring, const uint8_t *jpg, size_t len, const preroll_meta_t *meta,
+                       bool pending)
+{
+    size_t size = record_size(len);
+    if (size > ring->cap) {
+        ring->stats.too_large++;
+        return false;
+    }
+    for (;;) {
+        // Frames wrap when the newest ones start at or before the oldest (full when head == tail).
+        bool wrapped = ring->count > 0 && ring->head <= ring->tail;
+        if (!wrapped && ring->cap - ring->head >= size) {
+            break;
+        }
+        if (!wrapped && ring->count > 0) {
+            ring->wrap = ring->head; // no room at the end: continue from the start
+            ring->head = 0;
+            continue;
+        }
+        if (wrapped && ring->tail - ring->head >= size) {
+            break;
+        }
+        if (ring->pending > 0) {
+            ring->pending--;
+            ring->stats.lost++;
+        } else {
+            ring->stats.expired++;
+        }
+        drop_oldest(ring);
+    }
+
+    record_t rec = {
+        .len = (uint32_t)len,
+        .seq = meta->seq,
+        .capture_us = meta->capture_us,
+        .width = meta->width,
+        .height = meta->height,
+    };
+    memcpy(ring->buf + ring->head, &rec, sizeof(rec));
+    memcpy(ring->buf + ring->head + sizeof(rec), jpg, len);
+    ring->head += size;
+    ring->used += size;
+    ring->count++;
+    ring->stats.pushed++;
+    if (ring->used > ring->stats.high_water) {
+        ring->stats.high_water = ring->used;
+    }
+    if (pending) {
+        ring->pending = ring->count;
+    }
+    return true;
+}
+
+void preroll_ring_expire(preroll_ring_t *ring, int64_t cutoff_us)
+{
+    while (ring->count > 0 && ring->pending == 0) {
+        record_t rec;
+        memcpy(&rec, ring->buf + ring->tail, sizeof(rec));
+        if (rec.capture_us >= cutoff_us) {
+            break;
+        }
+        ring->stats.expired++;
+        drop_oldest(ring);
+    }
+}
+
+void preroll_ring_mark_all(preroll_ring_t *ring)
+{
+    ring->pending = ring->count;
+}
+
+bool preroll_ring_peek(const preroll_ring_t *ring, preroll_meta_t *meta, const uint8_t **jpg, size_t *len)
+{
+    if (ring->pending == 0) {
+        return false;
+    }
+    record_t rec;
+    memcpy(&rec, ring->buf + ring->tail, sizeof(rec));
+    meta->capture_us = rec.capture_us;
+    meta->seq = rec.seq;
+    meta->width = rec.width;
+    meta->height = rec.height;
+    *jpg = ring->buf + ring->tail + sizeof(rec);
+    *len = rec.len;
+    return true;
+}
+
+void preroll_ring_pop(preroll_ring_t *ring)
+{
+    if (ring->pending == 0) {
+        return;
+    }
+    ring->pending--;
+    ring->stats.taken++;
+    drop_oldest(ring);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Bytes of bookkeeping stored with each frame; a frame takes this plus its length, rounded up to 8. */
+#define PREROLL_RING_RECORD_OVERHEAD 24
+
+typedef struct {
+    int64_t capture_us;
+    uint32_t seq;
+    uint16_t width;
+    uint16_t height;
+} preroll_meta_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t expired;   // fell out of the pre-roll window or the budget without being wanted
+    uint32_t lost;      // marked for upload but overwritten before they could be taken out
+    uint32_t too_large; // frames larger than the whole buffer
+    uint32_t taken;     // handed on for upload
+    size_t high_water;  // most bytes in use
+} preroll_ring_stats_t;
+
+/**
+ * The last few seconds of JPEG frames in one fixed block of memory, so the budget is in bytes
+ * whatever the frames weigh and nothing is allocated per frame. Frames are stored whole and
+ * contiguous, oldest first; a new frame overwrites the oldest ones it needs room for.
+ *
+ * The oldest `pending` frames are marked for upload (an event's pre-roll and post-roll) and are
+ * taken out in order with preroll_ring_peek()/preroll_ring_pop(); the rest are history that ages out.
+ *
+ * Single-threaded and free of ESP-IDF dependencies; the caller provides the memory.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t head;  // where the next frame goes
+    size_t tail;  // oldest frame
+    size_t wrap;  // when the frames wrap around, where the older part ends
+    size_t used;  // bytes held, bookkeeping included
+    uint32_t count;
+    uint32_t pending;
+    preroll_ring_stats_t stats;
+} preroll_ring_t;
+
+/** Use `cap` bytes at `buf` (8-byte aligned), which must outlive the ring. Empties it. */
+void preroll_ring_init(preroll_ring_t *ring, uint8_t *buf, size_t cap);
+
+/**
+ * Store a copy of a frame, dropping the oldest frames as needed. With `pending` everything held,
+ * the new frame included, is marked for upload. False if the frame does not fit even in an empty ring.
+ */
+bool preroll_ring_push(preroll_ring_t *ring, const uint8_t *jpg, size_t len, const preroll_meta_t *meta,
+                       bool pending);
+
+/** Drop frames taken before `cutoff_us` that are not marked for upload. */
+void preroll_ring_expire(preroll_ring_t *ring, int64_t cutoff_us);
+
+/** Mark every frame held for upload (a trigger: the pre-roll is what the ring holds). */
+void preroll_ring_mark_all(preroll_ring_t *ring);
+
+/** The oldest frame marked for upload, valid until the next push or pop; false if there is none. */
+bool preroll_ring_peek(const preroll_ring_t *ring, preroll_meta_t *meta, const uint8_t **jpg, size_t *len);
+
+/** Remove the frame preroll_ring_peek() returned. */
+void preroll_ring_pop(preroll_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,188 @@
+#include "quality_ctrl.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+
+static const char *TAG = "quality_ctrl";
+
+// jpeg_quality numbers per ladder rung.
+#define QUALITY_CTRL_STEP 4
+// Weight of the newest sample in the smoothed load.
+#define QUALITY_CTRL_ALPHA 0.25f
+// Hysteresis band: step down above HIGH, step up below LOW, hold in between.
+#define QUALITY_CTRL_LOAD_HIGH 1.0f
+#define QUALITY_CTRL_LOAD_LOW 0.6f
+#define QUALITY_CTRL_DOWN_AFTER 2
+#define QUALITY_CTRL_UP_AFTER 3
+// Load recorded for a failed upload.
+#define QUALITY_CTRL_FAILURE_LOAD 2.0f
+
+// Frame sizes in increasing pixel count with a 4:3-ish aspect; square and odd sizes are not used.
+static const framesize_t s_ladder_sizes[] = {
+    FRAMESIZE_96X96, FRAMESIZE_QQVGA, FRAMESIZE_QCIF, FRAMESIZE_HQVGA, FRAMESIZE_QVGA, FRAMESIZE_CIF, FRAMESIZE_HVGA,
+    FRAMESIZE_VGA,   FRAMESIZE_SVGA,  FRAMESIZE_XGA,  FRAMESIZE_HD,    FRAMESIZE_SXGA, FRAMESIZE_UXGA,
+};
+
+static void level_setting(const quality_ctrl_t *qc, int level, int *quality, framesize_t *framesize)
+{
+    int q = qc->bounds.quality_worst - (level % qc->quality_levels) * QUALITY_CTRL_STEP;
+    *quality = q < qc->bounds.quality_best ? qc->bounds.quality_best : q;
+    *framesize = qc->sizes[level / qc->quality_levels];
+}
+
+static int top_level(const quality_ctrl_t *qc)
+{
+    return qc->size_count * qc->quality_levels - 1;
+}
+
+static void apply_bounds(quality_ctrl_t *qc, const quality_ctrl_bounds_t *bounds)
+{
+    qc->bounds = *bounds;
+    if (qc->bounds.quality_worst < qc->bounds.quality_best) {
+        qc->bounds.quality_worst = qc->bounds.quality_best;
+    }
+    if (qc->bounds.framesize_min > qc->bounds.framesize_max) {
+        qc->bounds.framesize_min = qc->bounds.framesize_max;
+    }
+
+    qc->size_count = 0;
+    for (size_t i = 0; i < sizeof(s_ladder_sizes) / sizeof(s_ladder_sizes[0]); i++) {
+        framesize_t fs = s_ladder_sizes[i];
+        if (fs >= qc->bounds.framesize_min && fs <= qc->bounds.framesize_max) {
+            qc->sizes[qc->size_count++] = fs;
+        }
+    }
+    if (qc->size_count == 0) {
+        qc->sizes[qc->size_count++] = qc->bounds.framesize_max;
+    }
+    qc->quality_levels =
+        (qc->bounds.quality_worst - qc->bounds.quality_best + QUALITY_CTRL_STEP - 1) / QUALITY_CTRL_STEP + 1;
+}
+
+static void publish_level(quality_ctrl_t *qc)
+{
+    level_setting(qc, qc->level, &qc->stats.quality, &qc->stats.framesize);
+}
+
+void quality_ctrl_init(quality_ctrl_t *qc, const quality_ctrl_bounds_t *bounds)
+{
+    memset(qc, 0, sizeof(*qc));
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    qc->mux = mux;
+    apply_bounds(qc, bounds);
+    qc->level = top_level(qc);
+    publish_level(qc);
+}
+
+void quality_ctrl_configure(quality_ctrl_t *qc, const quality_ctrl_bounds_t *bounds)
+{
+    portENTER_CRITICAL(&qc->mux);
+    int quality = qc->stats.quality;
+    framesize_t framesize = qc->stats.framesize;
+    apply_bounds(qc, bounds);
+
+    // Re-enter the new ladder at the highest rung not above the current setting.
+    int level = 0;
+    if (qc->bounds.target_ms > 0 || qc->bounds.target_bytes > 0) {
+        for (int l = top_level(qc); l >= 0; l--) {
+            int q;
+            framesize_t fs;
+            level_setting(qc, l, &q, &fs);
+            if (fs < framesize || (fs == framesize && q >= quality)) {
+                level = l;
+                break;
+            }
+        }
+    } else {
+        level = top_level(qc);
+    }
+    qc->level = level;
+    qc->over_streak = 0;
+    qc->under_streak = 0;
+    publish_level(qc);
+    portEXIT_CRITICAL(&qc->mux);
+}
+
+bool quality_ctrl_enabled(quality_ctrl_t *qc)
+{
+    portENTER_CRITICAL(&qc->mux);
+    bool enabled = qc->bounds.target_ms > 0 || qc->bounds.target_bytes > 0;
+    portEXIT_CRITICAL(&qc->mux);
+    return enabled;
+}
+
+void quality_ctrl_observe(quality_ctrl_t *qc, int64_t upload_us, size_t bytes, bool ok)
+{
+    portENTER_CRITICAL(&qc->mux);
+    if (qc->bounds.target_ms <= 0 && qc->bounds.target_bytes <= 0) {
+        portEXIT_CRITICAL(&qc->mux);
+        return;
+    }
+
+    // Whichever budget is tighter drives the loop.
+    float load = 0.0f;
+    if (qc->bounds.target_ms > 0) {
+        load = (float)upload_us / ((float)qc->bounds.target_ms * 1000.0f);
+    }
+    if (qc->bounds.target_bytes > 0) {
+        float byte_load = (float)bytes / (float)qc->bounds.target_bytes;
+        load = byte_load > load ? byte_load : load;
+    }
+    if (!ok && load < QUALITY_CTRL_FAILURE_LOAD) {
+        load = QUALITY_CTRL_FAILURE_LOAD;
+    }
+
+    qc->stats.load = qc->stats.samples == 0 ? load : qc->stats.load + QUALITY_CTRL_ALPHA * (load - qc->stats.load);
+    qc->stats.samples++;
+
+    int step = 0;
+    if (qc->stats.load > QUALITY_CTRL_LOAD_HIGH) {
+        qc->under_streak = 0;
+        if (++qc->over_streak >= QUALITY_CTRL_DOWN_AFTER && qc->level > 0) {
+            step = -1;
+        }
+    } else if (qc->stats.load < QUALITY_CTRL_LOAD_LOW) {
+        qc->over_streak = 0;
+        if (++qc->under_streak >= QUALITY_CTRL_UP_AFTER && qc->level < top_level(qc)) {
+            step = 1;
+        }
+    } else {
+        qc->over_streak = 0;
+        qc->under_streak = 0;
+    }
+
+    if (step != 0) {
+        qc->level += step;
+        qc->over_streak = 0;
+        qc->under_streak = 0;
+        if (step < 0) {
+            qc->stats.steps_down++;
+        } else {
+            qc->stats.steps_up++;
+        }
+        publish_level(qc);
+    }
+    quality_ctrl_stats_t st = qc->stats;
+    portEXIT_CRITICAL(&qc->mux);
+
+    if (step != 0) {
+        ESP_LOGI(TAG, "load %.2f: stepping %s to framesize %d quality %d", (double)st.load, step < 0 ? "down" : "up",
+                 (int)st.framesize, st.quality);
+    }
+}
+
+void quality_ctrl_current(quality_ctrl_t *qc, int *out_quality, framesize_t *out_framesize)
+{
+    portENTER_CRITICAL(&qc->mux);
+    *out_quality = qc->stats.quality;
+    *out_framesize = qc->stats.framesize;
+    portEXIT_CRITICAL(&qc->mux);
+}
+
+void quality_ctrl_get_stats(quality_ctrl_t *qc, quality_ctrl_stats_t *out)
+{
+    portENTER_CRITICAL(&qc->mux);
+    *out = qc->stats;
+    portEXIT_CRITICAL(&qc->mux);
+}
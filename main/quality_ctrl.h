@@ -0,0 +1,70 @@
+#pragma once
+
+#include "sensor.h"
+
+#include "freertos/FreeRTOS.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int target_ms;           // per-frame upload time budget; 0 = not used
+    int target_bytes;        // per-frame JPEG size budget; 0 = not used
+    int quality_best;        // lowest jpeg_quality number (best image) the controller may use
+    int quality_worst;       // highest jpeg_quality number it may fall back to
+    framesize_t framesize_max;
+    framesize_t framesize_min;
+} quality_ctrl_bounds_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t steps_down; // quality/frame size reduced
+    uint32_t steps_up;   // quality/frame size increased
+    float load;          // smoothed measured/budget ratio (1.0 = exactly on budget)
+    int quality;
+    framesize_t framesize;
+} quality_ctrl_stats_t;
+
+/**
+ * Picks jpeg_quality and frame size from upload feedback. The settings form a ladder from
+ * (framesize_min, quality_worst) to (framesize_max, quality_best); quality is walked first, then
+ * the frame size. A smoothed load above budget for a couple of uploads steps down, a load well
+ * under budget for a few more steps up, and anything in between holds, so it does not oscillate.
+ */
+typedef struct {
+    portMUX_TYPE mux;
+    quality_ctrl_bounds_t bounds;
+    framesize_t sizes[FRAMESIZE_INVALID];
+    int size_count;
+    int quality_levels;
+    int level;
+    int over_streak;
+    int under_streak;
+    quality_ctrl_stats_t stats;
+} quality_ctrl_t;
+
+/** Start at the top of the ladder (best quality, largest frame). */
+void quality_ctrl_init(quality_ctrl_t *qc, const quality_ctrl_bounds_t *bounds);
+
+/** Change bounds at runtime, keeping the current setting where it still fits. */
+void quality_ctrl_configure(quality_ctrl_t *qc, const quality_ctrl_bounds_t *bounds);
+
+/** True when at least one budget is set; otherwise the top of the ladder is used as a fixed setting. */
+bool quality_ctrl_enabled(quality_ctrl_t *qc);
+
+/** Feed one upload: per-frame duration and size. Failed uploads count as over budget. */
+void quality_ctrl_observe(quality_ctrl_t *qc, int64_t upload_us, size_t bytes, bool ok);
+
+/** Setting to use for the next capture. */
+void quality_ctrl_current(quality_ctrl_t *qc, int *out_quality, framesize_t *out_framesize);
+
+void quality_ctrl_get_stats(quality_ctrl_t *qc, quality_ctrl_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,151 @@
+#include "retry_policy.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+static const char *TAG = "retry_policy";
+
+#define RETRY_POLICY_DEFAULT_ATTEMPTS 3
+#define RETRY_POLICY_DEFAULT_BASE_MS 500
+#define RETRY_POLICY_DEFAULT_MAX_MS 8000
+#define RETRY_POLICY_DEFAULT_THRESHOLD 5
+#define RETRY_POLICY_DEFAULT_OPEN_MS 60000
+#define RETRY_POLICY_DEFAULT_OPEN_MAX_MS (15 * 60000)
+
+static bool is_throttle(int status)
+{
+    return status == 429 || status == 503;
+}
+
+// Transport errors, 5xx and 429 are worth another try; other statuses will not change on replay.
+bool retry_policy_retryable(esp_err_t err, int status)
+{
+    if (status == 0) {
+        return err != ESP_OK;
+    }
+    return status == 429 || status >= 500;
+}
+
+void retry_policy_init(retry_policy_t *rp)
+{
+    memset(rp, 0, sizeof(*rp));
+    rp->cfg.max_attempts = RETRY_POLICY_DEFAULT_ATTEMPTS;
+    rp->cfg.backoff_base_ms = RETRY_POLICY_DEFAULT_BASE_MS;
+    rp->cfg.backoff_max_ms = RETRY_POLICY_DEFAULT_MAX_MS;
+    rp->cfg.failure_threshold = RETRY_POLICY_DEFAULT_THRESHOLD;
+    rp->cfg.open_ms = RETRY_POLICY_DEFAULT_OPEN_MS;
+    rp->cfg.open_max_ms = RETRY_POLICY_DEFAULT_OPEN_MAX_MS;
+    rp->open_ms = rp->cfg.open_ms;
+    rp->stats.state = RETRY_CIRCUIT_CLOSED;
+}
+
+void retry_policy_configure(retry_policy_t *rp, const retry_policy_config_t *cfg)
+{
+    bool open_changed = cfg->open_ms != rp->cfg.open_ms;
+    rp->cfg = *cfg;
+    if (rp->cfg.max_attempts < 1) {
+        rp->cfg.max_attempts = 1;
+    }
+    if (rp->cfg.open_max_ms < rp->cfg.open_ms) {
+        rp->cfg.open_max_ms = rp->cfg.open_ms;
+    }
+    if (open_changed) {
+        rp->open_ms = rp->cfg.open_ms;
+    }
+}
+
+static void open_circuit(retry_policy_t *rp, int64_t open_ms)
+{
+    rp->stats.state = RETRY_CIRCUIT_OPEN;
+    rp->stats.open_until_us = esp_timer_get_time() + open_ms * 1000;
+    rp->stats.opens++;
+    ESP_LOGW(TAG, "circuit open for %lld s after %d failure(s)", (long long)(open_ms / 1000),
+             rp->consecutive_failures);
+}
+
+bool retry_policy_admit(retry_policy_t *rp)
+{
+    if (rp->stats.state != RETRY_CIRCUIT_OPEN) {
+        return true;
+    }
+    if (esp_timer_get_time() >= rp->stats.open_until_us) {
+        rp->stats.state = RETRY_CIRCUIT_HALF_OPEN;
+        return true;
+    }
+    rp->stats.rejected++;
+    return false;
+}
+
+bool retry_policy_should_retry(retry_policy_t *rp, int attempt, esp_err_t err, int status, int retry_after_s,
+                               int *out_delay_ms)
+{
+    rp->stats.attempts++;
+    if (attempt > 1) {
+        rp->stats.retries++;
+    }
+    if (is_throttle(status)) {
+        rp->stats.throttled++;
+    }
+
+    // A half-open circuit gets exactly one probe.
+    if (err == ESP_OK || attempt >= rp->cfg.max_attempts || rp->stats.state == RETRY_CIRCUIT_HALF_OPEN ||
+        !retry_policy_retryable(err, status)) {
+        return false;
+    }
+
+    int delay_ms;
+    if (is_throttle(status) && retry_after_s > 0) {
+        // Longer waits are left to the circuit breaker instead of blocking the uploader.
+        if ((int64_t)retry_after_s * 1000 > rp->cfg.backoff_max_ms) {
+            return false;
+        }
+        delay_ms = retry_after_s * 1000;
+    } else {
+        int64_t cap = (int64_t)rp->cfg.backoff_base_ms << (attempt - 1 < 16 ? attempt - 1 : 16);
+        if (cap > rp->cfg.backoff_max_ms) {
+            cap = rp->cfg.backoff_max_ms;
+        }
+        // Equal jitter: at least half the step, so retries still back off, spread over the rest.
+        int half = (int)(cap / 2);
+        delay_ms = half + (int)(esp_random() % (uint32_t)(half + 1));
+    }
+    *out_delay_ms = delay_ms;
+    return true;
+}
+
+void retry_policy_on_result(retry_policy_t *rp, bool ok, int status, int retry_after_s)
+{
+    if (ok) {
+        if (rp->stats.state != RETRY_CIRCUIT_CLOSED) {
+            ESP_LOGI(TAG, "circuit closed");
+        }
+        rp->stats.state = RETRY_CIRCUIT_CLOSED;
+        rp->consecutive_failures = 0;
+        rp->open_ms = rp->cfg.open_ms;
+        return;
+    }
+    if (!retry_policy_retryable(ESP_FAIL, status)) {
+        // Client errors (bad URL, auth, ...) say nothing about endpoint health.
+        if (rp->stats.state == RETRY_CIRCUIT_HALF_OPEN) {
+            rp->stats.state = RETRY_CIRCUIT_CLOSED;
+        }
+        return;
+    }
+
+    rp->consecutive_failures++;
+    if (is_throttle(status) && retry_after_s > 0) {
+        // The server said when to come back; that beats any local guess, up to the breaker's longest
+        // cool-down so a bogus or far-future value cannot stop uploads until the next reboot.
+        int64_t wait_ms = (int64_t)retry_after_s * 1000;
+        open_circuit(rp, wait_ms > rp->cfg.open_max_ms ? rp->cfg.open_max_ms : wait_ms);
+    } else if (rp->stats.state == RETRY_CIRCUIT_HALF_OPEN) {
+        int64_t next = (int64_t)rp->open_ms * 2;
+        rp->open_ms = (int)(next > rp->cfg.open_max_ms ? rp->cfg.open_max_ms : next);
+        open_circuit(rp, rp->open_ms);
+    } else if (rp->cfg.failure_threshold > 0 && rp->consecutive_failures >= rp->cfg.failure_threshold) {
+        open_circuit(rp, rp->open_ms);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Returned instead of attempting a request while the endpoint's circuit is open. */
+#define RETRY_POLICY_ERR_CIRCUIT_OPEN ESP_ERR_INVALID_STATE
+
+typedef enum {
+    RETRY_CIRCUIT_CLOSED = 0,    // requests flow normally
+    RETRY_CIRCUIT_OPEN = 1,      // endpoint is failing; requests are refused until the cool-down ends
+    RETRY_CIRCUIT_HALF_OPEN = 2, // cool-down over; one probe request decides whether to close again
+} retry_circuit_state_t;
+
+typedef struct {
+    int max_attempts;      // attempts per request, including the first (1 = no retries)
+    int backoff_base_ms;   // delay before the first retry; doubles per retry
+    int backoff_max_ms;    // cap for backoff and for Retry-After waits done in place
+    int failure_threshold; // consecutive failed requests that open the circuit; 0 = never
+    int open_ms;           // first cool-down; doubles on every failed probe up to open_max_ms
+    int open_max_ms;
+} retry_policy_config_t;
+
+typedef struct {
+    retry_circuit_state_t state;
+    uint32_t attempts;  // requests put on the wire
+    uint32_t retries;   // of which were retries
+    uint32_t throttled; // 429/503 responses
+    uint32_t rejected;  // requests refused while open
+    uint32_t opens;     // closed/half-open -> open transitions
+    int64_t open_until_us; // esp_timer time the cool-down ends (while open)
+} retry_policy_stats_t;
+
+/**
+ * Retry/backoff and circuit breaker state for one endpoint.
+ *
+ * Retries use capped exponential backoff with jitter, so a fleet does not retry in lockstep.
+ * A Retry-After from a 429/503 is honored: short ones are waited out in place, longer ones
+ * open the circuit for that long, capped at `open_max_ms`.
+ */
+typedef struct {
+    retry_policy_config_t cfg;
+    int consecutive_failures;
+    int open_ms; // cool-down applied on the next open
+    retry_policy_stats_t stats;
+} retry_policy_t;
+
+void retry_policy_init(retry_policy_t *rp);
+
+/** Replace the tunables; circuit state and counters are kept. */
+void retry_policy_configure(retry_policy_t *rp, const retry_policy_config_t *cfg);
+
+/** Whether a request may go out now. Moves open -> half-open once the cool-down has passed. */
+bool retry_policy_admit(retry_policy_t *rp);
+
+/** True if the request should be retried after `out_delay_ms`; `attempt` counts from 1. */
+bool retry_policy_should_retry(retry_policy_t *rp, int attempt, esp_err_t err, int status, int retry_after_s,
+                               int *out_delay_ms);
+
+/**
+ * Whether a failed request may succeed when sent again: transport errors (`status` 0), 5xx and 429.
+ * Any other status is the server refusing the request itself.
+ */
+bool retry_policy_retryable(esp_err_t err, int status);
+
+/** Record the final outcome of a request (after any retries). */
+void retry_policy_on_result(retry_policy_t *rp, bool ok, int status, int retry_after_s);
+
+#ifdef __cplusplus
+}
+#endif
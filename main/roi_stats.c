@@ -0,0 +1,287 @@
+#include "roi_stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "veg_index.h"
+
+void roi_stats_init(roi_stats_t *rs)
+{
+    memset(rs, 0, sizeof(*rs));
+}
+
+void roi_stats_free(roi_stats_t *rs)
+{
+    free(rs->mask);
+    free(rs->prev_luma);
+    rs->mask = NULL;
+    rs->prev_luma = NULL;
+    rs->width = 0;
+    rs->height = 0;
+    rs->have_prev = false;
+}
+
+void roi_stats_configure(roi_stats_t *rs, const roi_list_t *list)
+{
+    if (memcmp(&rs->list, list, sizeof(*list)) == 0) {
+        return;
+    }
+    rs->list = *list;
+    // Rebuilt for the new regions on the next frame; the previous luma no longer lines up with them.
+    roi_stats_free(rs);
+}
+
+// Even-odd test of a point (in 0..255 region units) against a polygon, or a rectangle for two points.
+static bool region_contains(const roi_region_t *r, float px, float py)
+{
+    if (r->count == 2) {
+        float x0 = r->x[0] < r->x[1] ? r->x[0] : r->x[1];
+        float x1 = r->x[0] < r->x[1] ? r->x[1] : r->x[0];
+        float y0 = r->y[0] < r->y[1] ? r->y[0] : r->y[1];
+        float y1 = r->y[0] < r->y[1] ? r->y[1] : r->y[0];
+        return px >= x0 && px <= x1 && py >= y0 && py <= y1;
+    }
+    bool inside = false;
+    for (int i = 0, j = r->count - 1; i < r->count; j = i++) {
+        float xi = r->x[i], yi = r->y[i];
+        float xj = r->x[j], yj = r->y[j];
+        if ((yi > py) != (yj > py) && px < (xj - xi) * (py - yi) / (yj - yi) + xi) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+static bool build_masks(roi_stats_t *rs, uint16_t width, uint16_t height)
+{
+    roi_stats_free(rs);
+    size_t count = (size_t)width * height;
+    rs->mask = calloc(count, 1);
+    rs->prev_luma = malloc(count);
+    if (!rs->mask || !rs->prev_luma) {
+        roi_stats_free(rs);
+        return false;
+    }
+    rs->width = width;
+    rs->height = height;
+    // Pixel centres in region units; runs once per list and resolution, so floats are fine here.
+    for (uint16_t y = 0; y < height; y++) {
+        float py = ((float)y + 0.5f) * 255.0f / (float)height;
+        for (uint16_t x = 0; x < width; x++) {
+            float px = ((float)x + 0.5f) * 255.0f / (float)width;
+            uint8_t bits = 0;
+            for (int r = 0; r < rs->list.count; r++) {
+                if (region_contains(&rs->list.regions[r], px, py)) {
+                    bits |= (uint8_t)(1u << r);
+                }
+            }
+            rs->mask[(size_t)y * width + x] = bits;
+        }
+    }
+    return true;
+}
+
+bool roi_stats_compute(roi_stats_t *rs, const uint8_t *rgb565, uint16_t width, uint16_t height,
+                       roi_region_stats_t *out)
+{
+    if (rs->list.count == 0) {
+        return true;
+    }
+    if ((!rs->mask || rs->width != width || rs->height != height) && !build_masks(rs, width, height)) {
+        return false;
+    }
+
+    uint32_t pixels[ROI_MAX_REGIONS] = {0};
+    uint32_t luma_sum[ROI_MAX_REGIONS] = {0};
+    uint32_t green[ROI_MAX_REGIONS] = {0};
+    uint32_t changed[ROI_MAX_REGIONS] = {0};
+    size_t count = (size_t)width * height;
+    for (size_t i = 0; i < count; i++) {
+        unsigned bits = rs->mask[i];
+        if (!bits) {
+            continue;
+        }
+        uint32_t p = ((uint32_t)rgb565[2 * i] << 8) | rgb565[2 * i + 1];
+        int32_t r5 = (int32_t)(p >> 11);
+        int32_t g6 = (int32_t)((p >> 5) & 0x3f);
+        int32_t b5 = (int32_t)(p & 0x1f);
+        int32_t r = (r5 << 3) | (r5 >> 2);
+        int32_t g = (g6 << 2) | (g6 >> 4);
+        int32_t b = (b5 << 3) | (b5 >> 2);
+        int32_t luma = (77 * r + 150 * g + 29 * b) >> 8;
+        bool is_green = r + g + b >= VEG_INDEX_MIN_SUM && 15 * g - 12 * r - 5 * b > 0;
+        int32_t delta = luma - rs->prev_luma[i];
+        bool is_changed = rs->have_prev && (delta > ROI_CHANGE_DELTA || delta < -ROI_CHANGE_DELTA);
+        rs->prev_luma[i] = (uint8_t)luma;
+
+        while (bits) {
+            int k = __builtin_ctz(bits);
+            bits &= bits - 1;
+            pixels[k]++;
+            luma_sum[k] += (uint32_t)luma;
+            green[k] += is_green;
+            changed[k] += is_changed;
+        }
+    }
+
+    for (int k = 0; k < rs->list.count; k++) {
+        roi_region_stats_t *s = &out[k];
+        s->pixels = pixels[k];
+        s->luma_mean = (uint8_t)(pixels[k] ? luma_sum[k] / pixels[k] : 0);
+        s->green_permille = (uint16_t)(pixels[k] ? (uint64_t)green[k] * 1000 / pixels[k] : 0);
+        if (!rs->have_prev) {
+            s->changed_permille = -1;
+        } else {
+            s->changed_permille = (int16_t)(pixels[k] ? (uint64_t)changed[k] * 1000 / pixels[k] : 0);
+        }
+    }
+    rs->have_prev = true;
+    return true;
+}
+
+int roi_stats_format_json(const roi_region_stats_t *stats, size_t count, char *buf, size_t len)
+{
+    size_t n = 0;
+    int w = snprintf(buf, len, "[");
+    for (size_t k = 0; k < count && w >= 0; k++) {
+        n += (size_t)w;
+        const roi_region_stats_t *s = &stats[k];
+        w = snprintf(buf + (n < len ? n : len), n < len ? len - n : 0,
+                     "%s{\"px\":%u,\"luma\":%u,\"green_pm\":%u,\"change_pm\":%d}", k ? "," : "", (unsigned)s->pixels,
+                     (unsigned)s->luma_mean, (unsigned)s->green_permille, (int)s->changed_permille);
+    }
+    if (w < 0) {
+        return w;
+    }
+    n += (size_t)w;
+    w = snprintf(buf + (n < len ? n : len), n < len ? len - n : 0, "]");
+    return w < 0 ? w : (int)(n + (size_t)w);
+}
+
+size_t roi_list_encode(const roi_list_t *list, uint8_t *buf, size_t len)
+{
+    size_t n = 0;
+    if (len < 1 || list->count > ROI_MAX_REGIONS) {
+        return 0;
+    }
+    buf[n++] = list->count;
+    for (int r = 0; r < list->count; r++) {
+        const roi_region_t *region = &list->regions[r];
+        if (region->count > ROI_MAX_POINTS || n + 1 + 2 * (size_t)region->count > len) {
+            return 0;
+        }
+        buf[n++] = region->count;
+        for (int i = 0; i < region->count; i++) {
+            buf[n++] = region->x[i];
+            buf[n++] = region->y[i];
+        }
+    }
+    return n;
+}
+
+bool roi_list_decode(const uint8_t *buf, size_t len, roi_list_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (len < 1 || buf[0] > ROI_MAX_REGIONS) {
+        return false;
+    }
+    size_t n = 1;
+    for (int r = 0; r < buf[0]; r++) {
+        if (n >= len) {
+            return false;
+        }
+        uint8_t points = buf[n++];
+        if (points < 2 || points > ROI_MAX_POINTS || n + 2 * (size_t)points > len) {
+            return false;
+        }
+        roi_region_t *region = &out->regions[r];
+        region->count = points;
+        for (int i = 0; i < points; i++) {
+            region->x[i] = buf[n++];
+            region->y[i] = buf[n++];
+        }
+    }
+    out->count = buf[0];
+    return n == len;
+}
+
+static uint8_t percent_to_unit(long percent)
+{
+    return (uint8_t)((percent * 255 + 50) / 100);
+}
+
+static long unit_to_percent(uint8_t unit)
+{
+    return ((long)unit * 100 + 127) / 255;
+}
+
+bool roi_list_parse(const char *text, roi_list_t *out)
+{
+    roi_list_t list;
+    memset(&list, 0, sizeof(list));
+    const char *p = text;
+    roi_region_t *region = NULL;
+    for (;;) {
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p == '\0' || *p == ';') {
+            if (region && region->count < 2) {
+                return false;
+            }
+            region = NULL;
+            if (*p == '\0') {
+                break;
+            }
+            p++;
+            continue;
+        }
+        char *end = NULL;
+        long x = strtol(p, &end, 10);
+        if (end == p || *end != ',') {
+            return false;
+        }
+        p = end + 1;
+        long y = strtol(p, &end, 10);
+        if (end == p || x < 0 || x > 100 || y < 0 || y > 100) {
+            return false;
+        }
+        p = end;
+        if (!region) {
+            if (list.count >= ROI_MAX_REGIONS) {
+                return false;
+            }
+            region = &list.regions[list.count++];
+        }
+        if (region->count >= ROI_MAX_POINTS) {
+            return false;
+        }
+        region->x[region->count] = percent_to_unit(x);
+        region->y[region->count] = percent_to_unit(y);
+        region->count++;
+    }
+    *out = list;
+    return true;
+}
+
+int roi_list_format(const roi_list_t *list, char *buf, size_t len)
+{
+    size_t n = 0;
+    if (len > 0) {
+        buf[0] = '\0';
+    }
+    for (int r = 0; r < list->count; r++) {
+        const roi_region_t *region = &list->regions[r];
+        for (int i = 0; i < region->count; i++) {
+            int w = snprintf(buf + (n < len ? n : len), n < len ? len - n : 0, "%s%ld,%ld",
+                             i ? " " : (r ? "; " : ""), unit_to_percent(region->x[i]),
+                             unit_to_percent(region->y[i]));
+            if (w < 0) {
+                return w;
+            }
+            n += (size_t)w;
+        }
+    }
+    return (int)n;
+}
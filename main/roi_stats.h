@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ROI_MAX_REGIONS 8
+#define ROI_MAX_POINTS 8
+
+/** Largest roi_list_encode() output: a count byte, then per region a point count and x/y pairs. */
+#define ROI_LIST_ENCODED_MAX (1 + ROI_MAX_REGIONS * (1 + 2 * ROI_MAX_POINTS))
+
+/** Luma difference (0..255) for a pixel to count as changed since the previous frame. */
+#define ROI_CHANGE_DELTA 12
+
+/**
+ * A polygon in frame coordinates scaled to 0..255 (0 = left/top edge, 255 = right/bottom edge), so
+ * one region list fits every resolution. Two points are the opposite corners of a rectangle.
+ */
+typedef struct {
+    uint8_t count;
+    uint8_t x[ROI_MAX_POINTS];
+    uint8_t y[ROI_MAX_POINTS];
+} roi_region_t;
+
+typedef struct {
+    uint8_t count;
+    roi_region_t regions[ROI_MAX_REGIONS];
+} roi_list_t;
+
+typedef struct {
+    uint32_t pixels;           // pixels inside the region at the analysed resolution
+    uint8_t luma_mean;
+    uint16_t green_permille;   // pixels with ExGR > 0 (see veg_index.h)
+    int16_t changed_permille;  // pixels whose luma moved by more than ROI_CHANGE_DELTA; -1 on the first frame
+} roi_region_stats_t;
+
+/**
+ * Per-region statistics over RGB565 frames. The region masks (one bit per region per pixel) are
+ * rasterised once per list and resolution; each frame is then a single pass over the pixels.
+ * Keeps the previous frame's luma for the change figure. Free of ESP-IDF dependencies.
+ */
+typedef struct {
+    roi_list_t list;
+    uint16_t width;
+    uint16_t height;
+    uint8_t *mask;      // width * height, bit i = inside region i
+    uint8_t *prev_luma; // width * height
+    bool have_prev;
+} roi_stats_t;
+
+void roi_stats_init(roi_stats_t *rs);
+
+/** Use `list` from the next frame on; masks are rebuilt only if it differs from the current one. */
+void roi_stats_configure(roi_stats_t *rs, const roi_list_t *list);
+
+/** Release the masks and the previous frame. */
+void roi_stats_free(roi_stats_t *rs);
+
+/**
+ * Statistics of every configured region for an RGB565 image (high byte first). `out` needs room
+ * for list.count entries. Returns false if the masks could not be allocated.
+ */
+bool roi_stats_compute(roi_stats_t *rs, const uint8_t *rgb565, uint16_t width, uint16_t height,
+                       roi_region_stats_t *out);
+
+/** JSON array of per-region statistics, in list order. Returns the length written (snprintf semantics). */
+int roi_stats_format_json(const roi_region_stats_t *stats, size_t count, char *buf, size_t len);
+
+/** Compact binary form of a region list for NVS; returns the bytes written (at most ROI_LIST_ENCODED_MAX). */
+size_t roi_list_encode(const roi_list_t *list, uint8_t *buf, size_t len);
+
+/** Inverse of roi_list_encode(); false if `buf` is not a valid encoding. */
+bool roi_list_decode(const uint8_t *buf, size_t len, roi_list_t *out);
+
+/**
+ * Parse the text form used on the config page: regions separated by ';', each a list of "x,y"
+ * points in percent of the frame separated by spaces, e.g. "5,10 45,90; 55,10 95,10 75,90".
+ * An empty string clears the list. Returns false on a syntax error or too many regions/points.
+ */
+bool roi_list_parse(const char *text, roi_list_t *out);
+
+/** Text form of a list as accepted by roi_list_parse(). */
+int roi_list_format(const roi_list_t *list, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,336 @@
+#include "tile_diff.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// A delta must save at least a quarter of the JPEG, or the frame goes up whole as a new keyframe.
+#define TILE_DIFF_MAX_DELTA_NUM 3
+#define TILE_DIFF_MAX_DELTA_DEN 4
+
+// What tile_diff_classify() learns from the headers besides the strip boundaries.
+typedef struct {
+    int width;
+    int height;
+    int hmax; // largest sampling factors: an MCU is 8 * hmax by 8 * vmax pixels
+    int vmax;
+    int restart; // MCUs per strip
+} layout_t;
+
+void tile_diff_init(tile_diff_t *td, jpeg_dc_decoder_t *dec)
+{
+    memset(td, 0, sizeof(*td));
+    td->dec = dec;
+}
+
+void tile_diff_configure(tile_diff_t *td, int keyframe_every)
+{
+    int every = keyframe_every < 0 ? 0 : keyframe_every;
+    if (every != td->keyframe_every) {
+        td->keyframe_every = every;
+        td->have_key = false;
+    }
+}
+
+bool tile_diff_enabled(const tile_diff_t *td)
+{
+    return td->keyframe_every > 0;
+}
+
+void tile_diff_resync(tile_diff_t *td)
+{
+    td->have_key = false;
+}
+
+void tile_diff_free(tile_diff_t *td)
+{
+    free(td->image);
+    td->image = NULL;
+    td->image_cap = 0;
+}
+
+uint64_t tile_diff_fnv64(uint64_t hash, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t fnv64_u64(uint64_t hash, uint64_t v)
+{
+    uint8_t b[8];
+    for (int i = 0; i < 8; i++) {
+        b[i] = (uint8_t)(v >> (8 * i));
+    }
+    return tile_diff_fnv64(hash, b, sizeof(b));
+}
+
+// Walk the headers up to the scan. Only a baseline interleaved scan with a restart interval splits.
+static bool parse_headers(tile_diff_t *td, const uint8_t *jpg, size_t len, layout_t *lay)
+{
+    if (len < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8) {
+        return false;
+    }
+    memset(lay, 0, sizeof(*lay));
+    int ncomp = 0;
+    size_t pos = 2;
+    while (pos + 4 <= len) {
+        if (jpg[pos] != 0xFF) {
+            return false;
+        }
+        uint8_t m = jpg[pos + 1];
+        if (m == 0xFF) {
+            pos++;
+            continue;
+        }
+        size_t seglen = (size_t)((jpg[pos + 2] << 8) | jpg[pos + 3]);
+        if (m == 0xD9 || seglen < 2 || pos + 2 + seglen > len) {
+            return false;
+        }
+        const uint8_t *seg = jpg + pos + 4;
+        if (m == 0xC0 || m == 0xC1) {
+            if (seglen < 8) {
+                return false;
+            }
+            lay->height = (seg[1] << 8) | seg[2];
+            lay->width = (seg[3] << 8) | seg[4];
+            ncomp = seg[5];
+            if (ncomp < 1 || ncomp > 3 || seglen < 8 + 3 * (size_t)ncomp) {
+                return false;
+            }
+            for (int i = 0; i < ncomp; i++) {
+                int h = seg[7 + 3 * i] >> 4;
+                int v = seg[7 + 3 * i] & 15;
+                lay->hmax = h > lay->hmax ? h : lay->hmax;
+                lay->vmax = v > lay->vmax ? v : lay->vmax;
+            }
+            if (ncomp == 1) {
+                lay->hmax = lay->vmax = 1; // a single-component scan is not interleaved: one block per MCU
+            }
+        } else if (m >= 0xC2 && m <= 0xCF && m != 0xC4 && m != 0xC8 && m != 0xCC) {
+            return false; // progressive, lossless or arithmetic coded
+        } else if (m == 0xDD) {
+            if (seglen < 4) {
+                return false;
+            }
+            lay->restart = (seg[0] << 8) | seg[1];
+        } else if (m == 0xDA) {
+            // All of the frame's components in the one scan, or the MCUs are not what the SOF says.
+            if (seglen < 3 || seg[0] != ncomp) {
+                return false;
+            }
+            td->header_len = pos + 2 + seglen;
+            return lay->width > 0 && lay->height > 0 && lay->hmax > 0 && lay->vmax > 0 && lay->restart > 0;
+        }
+        pos += 2 + seglen;
+    }
+    return false;
+}
+
+// Split the entropy-coded data at its RSTn markers; they must run in order and end at EOI.
+static bool split_strips(tile_diff_t *td, const uint8_t *jpg, size_t len)
+{
+    size_t pos = td->header_len;
+    size_t start = pos;
+    int n = 0;
+    while (pos + 1 < len) {
+        if (jpg[pos] != 0xFF || jpg[pos + 1] == 0x00) {
+            pos += jpg[pos] == 0xFF ? 2 : 1;
+            continue;
+        }
+        uint8_t m = jpg[pos + 1];
+        if (m == 0xFF) {
+            return false; // fill bytes would not survive the rebuild
+        }
+        bool rst = m >= 0xD0 && m <= 0xD7;
+        if ((!rst && m != 0xD9) || n >= TILE_DIFF_MAX_STRIPS || (rst && m != 0xD0 + (n % 8))) {
+            return false;
+        }
+        td->strip_off[n] = (uint32_t)start;
+        td->strip_len[n] = (uint32_t)(pos - start);
+        n++;
+        if (m == 0xD9) {
+            td->strips = (uint16_t)n;
+            return true;
+        }
+        pos += 2;
+        start = pos;
+    }
+    return false;
+}
+
+// Mean luma of TILE_DIFF_SIG_CELLS runs of MCUs per strip, from the 1/8-scale luma image.
+static void sign_strips(tile_diff_t *td, const layout_t *lay, uint16_t img_w, uint16_t img_h)
+{
+    int mcus_x = (lay->width + 8 * lay->hmax - 1) / (8 * lay->hmax);
+    int total = mcus_x * ((lay->height + 8 * lay->vmax - 1) / (8 * lay->vmax));
+    for (int s = 0; s < td->strips; s++) {
+        int first = s * lay->restart;
+        int count = (s + 1) * lay->restart <= total ? lay->restart : total - first;
+        for (int c = 0; c < TILE_DIFF_SIG_CELLS; c++) {
+            int a = first + c * count / TILE_DIFF_SIG_CELLS;
+            int b = first + (c + 1) * count / TILE_DIFF_SIG_CELLS;
+            if (b == a) {
+                b = a + 1; // fewer MCUs than cells: reuse one
+            }
+            uint32_t sum = 0;
+            uint32_t pixels = 0;
+            for (int m = a; m < b; m++) {
+                int bx0 = (m % mcus_x) * lay->hmax;
+                int by0 = (m / mcus_x) * lay->vmax;
+                for (int by = by0; by < by0 + lay->vmax && by < img_h; by++) {
+                    for (int bx = bx0; bx < bx0 + lay->hmax && bx < img_w; bx++) {
+                        sum += td->image[(size_t)by * img_w + bx];
+                        pixels++;
+                    }
+                }
+            }
+            td->sig[s][c] = (uint8_t)(pixels ? (sum + pixels / 2) / pixels : 0);
+        }
+    }
+}
+
+static bool decode_image(tile_diff_t *td, const uint8_t *jpg, size_t len, uint16_t *w, uint16_t *h)
+{
+    if (jpeg_dc_luma_image(td->dec, jpg, len, td->image, td->image_cap, w, h)) {
+        return true;
+    }
+    size_t need = (size_t)*w * *h;
+    if (need <= td->image_cap) {
+        return false; // a real decode error, not a short buffer
+    }
+    uint8_t *image = realloc(td->image, need);
+    if (!image) {
+        return false;
+    }
+    td->image = image;
+    td->image_cap = need;
+    return jpeg_dc_luma_image(td->dec, jpg, len, td->image, td->image_cap, w, h);
+}
+
+static bool strip_changed(const tile_diff_t *td, int s)
+{
+    for (int c = 0; c < TILE_DIFF_SIG_CELLS; c++) {
+        int d = (int)td->sig[s][c] - (int)td->key_sig[s][c];
+        if (d > TILE_DIFF_CELL_DELTA || d < -TILE_DIFF_CELL_DELTA) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void take_keyframe(tile_diff_t *td, const uint8_t *jpg, const uint8_t key[TILE_DIFF_KEY_LEN])
+{
+    td->have_key = true;
+    td->since_key = 0;
+    td->key_header_hash = td->header_hash;
+    td->key_strips = td->strips;
+    memcpy(td->key, key, TILE_DIFF_KEY_LEN);
+    memcpy(td->key_sig, td->sig, sizeof(td->sig[0]) * td->strips);
+    for (int s = 0; s < td->strips; s++) {
+        td->key_strip_hash[s] = tile_diff_fnv64(TILE_DIFF_FNV_INIT, jpg + td->strip_off[s], td->strip_len[s]);
+    }
+}
+
+tile_diff_kind_t tile_diff_classify(tile_diff_t *td, const uint8_t *jpg, size_t len,
+                                    const uint8_t key[TILE_DIFF_KEY_LEN])
+{
+    td->stats.bytes_full += len;
+    td->stats.bytes_sent += len; // corrected below for a delta
+    td->strips = 0;
+    td->changed_count = 0;
+
+    layout_t lay;
+    uint16_t img_w = 0;
+    uint16_t img_h = 0;
+    bool ok = parse_headers(td, jpg, len, &lay) && split_strips(td, jpg, len) &&
+              decode_image(td, jpg, len, &img_w, &img_h);
+    if (ok) {
+        int mcus_x = (lay.width + 8 * lay.hmax - 1) / (8 * lay.hmax);
+        int total = mcus_x * ((lay.height + 8 * lay.vmax - 1) / (8 * lay.vmax));
+        ok = td->strips == (total + lay.restart - 1) / lay.restart;
+    }
+    td->stats.strips_last = td->strips;
+    td->stats.changed_last = 0;
+    if (!ok) {
+        td->strips = 0;
+        td->have_key = false; // the collector cannot rebuild from a frame that did not split
+        td->stats.unsplittable++;
+        return TILE_DIFF_UNSPLITTABLE;
+    }
+    sign_strips(td, &lay, img_w, img_h);
+    td->header_hash = tile_diff_fnv64(TILE_DIFF_FNV_INIT, jpg, td->header_len);
+
+    bool keyframe = !td->have_key || td->since_key + 1 >= (uint32_t)td->keyframe_every ||
+                    td->header_hash != td->key_header_hash || td->strips != td->key_strips;
+    if (!keyframe) {
+        memset(td->changed, 0, sizeof(td->changed));
+        td->changed_bytes = 0;
+        for (int s = 0; s < td->strips; s++) {
+            if (strip_changed(td, s)) {
+                td->changed[s / 8] |= (uint8_t)(1u << (s % 8));
+                td->changed_count++;
+                td->changed_bytes += td->strip_len[s];
+            }
+        }
+        td->delta_len =
+            TILE_DIFF_HEADER_LEN + (size_t)(td->strips + 7) / 8 + 4 * (size_t)td->changed_count + td->changed_bytes;
+        td->stats.changed_last = td->changed_count;
+        keyframe = td->delta_len * TILE_DIFF_MAX_DELTA_DEN >= len * TILE_DIFF_MAX_DELTA_NUM;
+    }
+    if (keyframe) {
+        take_keyframe(td, jpg, key);
+        td->stats.keyframes++;
+        return TILE_DIFF_KEYFRAME;
+    }
+    td->since_key++;
+    td->stats.deltas++;
+    td->stats.bytes_sent -= len - td->delta_len;
+    return TILE_DIFF_DELTA;
+}
+
+size_t tile_diff_delta_len(const tile_diff_t *td)
+{
+    return td->delta_len;
+}
+
+static uint8_t *put_le(uint8_t *p, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++) {
+        *p++ = (uint8_t)(v >> (8 * i));
+    }
+    return p;
+}
+
+void tile_diff_write_delta(tile_diff_t *td, const uint8_t *jpg, size_t len, uint8_t *out)
+{
+    (void)len;
+    uint64_t digest = TILE_DIFF_FNV_INIT;
+    for (int s = 0; s < td->strips; s++) {
+        bool changed = (td->changed[s / 8] >> (s % 8)) & 1;
+        uint64_t h = changed ? tile_diff_fnv64(TILE_DIFF_FNV_INIT, jpg + td->strip_off[s], td->strip_len[s])
+                             : td->key_strip_hash[s];
+        digest = fnv64_u64(digest, h);
+    }
+
+    uint8_t *p = out;
+    memcpy(p, TILE_DIFF_MAGIC, 4);
+    p = put_le(p + 4, td->strips, 2);
+    p = put_le(p, td->changed_count, 2);
+    memcpy(p, td->key, TILE_DIFF_KEY_LEN);
+    p = put_le(p + TILE_DIFF_KEY_LEN, digest, 8);
+    memcpy(p, td->changed, (size_t)(td->strips + 7) / 8);
+    p += (td->strips + 7) / 8;
+    for (int s = 0; s < td->strips; s++) {
+        if ((td->changed[s / 8] >> (s % 8)) & 1) {
+            p = put_le(p, td->strip_len[s], 4);
+        }
+    }
+    for (int s = 0; s < td->strips; s++) {
+        if ((td->changed[s / 8] >> (s % 8)) & 1) {
+            memcpy(p, jpg + td->strip_off[s], td->strip_len[s]);
+            p += td->strip_len[s];
+        }
+    }
+}
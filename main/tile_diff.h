@@ -0,0 +1,127 @@
+#pragma once
+
+#include "jpeg_dc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Most restart-interval strips a frame may have; one per MCU row is 75 at UXGA 4:2:0. */
+#define TILE_DIFF_MAX_STRIPS 128
+
+/** Luma cells per strip signature; each averages an equal share of the strip's MCUs. */
+#define TILE_DIFF_SIG_CELLS 8
+
+/** Luma difference (0..255) of any cell that makes a strip count as changed since the keyframe. */
+#define TILE_DIFF_CELL_DELTA 10
+
+/** Reference key of a keyframe: the SHA-256 the collector indexes it by (X-Frame-SHA256). */
+#define TILE_DIFF_KEY_LEN 32
+
+/** Content type of a delta payload. */
+#define TILE_DIFF_CONTENT_TYPE "application/x-jpeg-tile-delta"
+
+/** First bytes of a delta payload. */
+#define TILE_DIFF_MAGIC "JTD1"
+
+/** Fixed part of a delta payload: magic, strip count, changed count, keyframe key, digest. */
+#define TILE_DIFF_HEADER_LEN (4 + 2 + 2 + TILE_DIFF_KEY_LEN + 8)
+
+typedef enum {
+    TILE_DIFF_KEYFRAME = 0,      // send the JPEG; later deltas refer to it
+    TILE_DIFF_DELTA = 1,         // send tile_diff_write_delta() output instead of the JPEG
+    TILE_DIFF_UNSPLITTABLE = 2,  // no restart markers (or not parseable): send the JPEG, no keyframe kept
+} tile_diff_kind_t;
+
+typedef struct {
+    uint32_t keyframes;
+    uint32_t deltas;
+    uint32_t unsplittable;
+    uint16_t strips_last;  // strips in the last frame
+    uint16_t changed_last; // ... and how many of them differed from the keyframe
+    uint64_t bytes_full;   // JPEG bytes of every frame classified
+    uint64_t bytes_sent;   // ... and what was sent for them
+} tile_diff_stats_t;
+
+/**
+ * Splits JPEGs at their restart markers into strips (each one restart interval of MCUs, decodable on
+ * its own) and compares a coarse luma signature per strip (from the DC terms, jpeg_dc_luma_image())
+ * with the last keyframe. A delta carries only the strips that changed plus a map of them; the
+ * collector rebuilds a complete JPEG from the keyframe's header and strips with those replaced.
+ *
+ * Delta payload, little endian:
+ *   "JTD1", u16 strips, u16 changed, keyframe key[32], u64 digest,
+ *   tile map ((strips + 7) / 8 bytes, bit i = 1 << (i % 8) of byte i / 8 set if strip i is replaced),
+ *   u32 length of each replaced strip, then the replaced strips' entropy-coded bytes in order.
+ * The rebuilt JPEG is the keyframe up to its first strip, then every strip followed by RST(i % 8)
+ * except the last, then EOI. `digest` is FNV-1a 64 over the FNV-1a 64 hashes (little endian) of the
+ * rebuilt JPEG's strips, so the collector can check it rebuilt exactly the frame the device meant.
+ *
+ * Single-threaded and free of ESP-IDF dependencies, so tools/tile_bench.c runs the same code on the host.
+ */
+typedef struct {
+    jpeg_dc_decoder_t *dec; // scratch, may be shared with other users on the same task
+    uint8_t *image; // 1/8-scale luma, grown to the largest frame seen
+    size_t image_cap;
+    int keyframe_every; // cycles; 0 = off
+    // Current frame.
+    size_t header_len; // bytes before the first strip
+    uint64_t header_hash;
+    uint16_t strips;
+    uint32_t strip_off[TILE_DIFF_MAX_STRIPS];
+    uint32_t strip_len[TILE_DIFF_MAX_STRIPS];
+    uint8_t sig[TILE_DIFF_MAX_STRIPS][TILE_DIFF_SIG_CELLS];
+    uint8_t changed[(TILE_DIFF_MAX_STRIPS + 7) / 8];
+    uint16_t changed_count;
+    size_t changed_bytes;
+    size_t delta_len;
+    // Keyframe.
+    bool have_key;
+    uint32_t since_key; // frames since the keyframe
+    uint64_t key_header_hash;
+    uint16_t key_strips;
+    uint8_t key[TILE_DIFF_KEY_LEN];
+    uint8_t key_sig[TILE_DIFF_MAX_STRIPS][TILE_DIFF_SIG_CELLS];
+    uint64_t key_strip_hash[TILE_DIFF_MAX_STRIPS];
+    tile_diff_stats_t stats;
+} tile_diff_t;
+
+void tile_diff_init(tile_diff_t *td, jpeg_dc_decoder_t *dec);
+
+/** Send a keyframe every `keyframe_every` frames; 0 turns differential uploads off. */
+void tile_diff_configure(tile_diff_t *td, int keyframe_every);
+
+bool tile_diff_enabled(const tile_diff_t *td);
+
+/** Make the next frame a keyframe, e.g. because the collector may have missed the last one. */
+void tile_diff_resync(tile_diff_t *td);
+
+/** Release the luma image. */
+void tile_diff_free(tile_diff_t *td);
+
+/**
+ * Decide how to send a frame. `key` identifies the frame should it become the keyframe. A frame
+ * becomes a keyframe when there is none, every `keyframe_every` frames, when its headers differ
+ * from the keyframe's (size, tables, restart interval) and when a delta would not save a quarter
+ * of the JPEG.
+ */
+tile_diff_kind_t tile_diff_classify(tile_diff_t *td, const uint8_t *jpg, size_t len,
+                                    const uint8_t key[TILE_DIFF_KEY_LEN]);
+
+/** Size of the delta payload for the frame just classified as TILE_DIFF_DELTA. */
+size_t tile_diff_delta_len(const tile_diff_t *td);
+
+/** Write that payload; `jpg`/`len` must be the frame passed to tile_diff_classify(). */
+void tile_diff_write_delta(tile_diff_t *td, const uint8_t *jpg, size_t len, uint8_t *out);
+
+/** FNV-1a 64 of `len` bytes, continuing from `hash` (start with TILE_DIFF_FNV_INIT). */
+#define TILE_DIFF_FNV_INIT 0xcbf29ce484222325ULL
+uint64_t tile_diff_fnv64(uint64_t hash, const uint8_t *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
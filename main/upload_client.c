@@ -0,0 +1,537 @@
+#include "upload_client.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+#include "esp_crt_bundle.h"
+#endif
+
+static const char *TAG = "upload_client";
+
+#define UPLOAD_CLIENT_TIMEOUT_MS 15000
+// An HTTP-date Retry-After is only usable once the clock has been set.
+#define UPLOAD_CLIENT_MIN_VALID_EPOCH 1700000000
+
+// Days since 1970-01-01 for a proleptic Gregorian date (month 1-12).
+static int64_t days_from_civil(int y, int m, int d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// Retry-After is either delta-seconds or an IMF-fixdate ("Wed, 21 Oct 2015 07:28:00 GMT").
+static int parse_retry_after(const char *value)
+{
+    char *end = NULL;
+    long secs = strtol(value, &end, 10);
+    if (end != value && (*end == '\0' || *end == ' ')) {
+        return secs > 0 ? (int)(secs > INT32_MAX ? INT32_MAX : secs) : 0;
+    }
+
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char mon[4] = {0};
+    int day, year, hh, mm, ss;
+    if (sscanf(value, "%*3s, %d %3s %d %d:%d:%d", &day, mon, &year, &hh, &mm, &ss) != 6) {
+        return 0;
+    }
+    const char *p = strstr(months, mon);
+    time_t now = time(NULL);
+    if (!p || (p - months) % 3 != 0 || now < UPLOAD_CLIENT_MIN_VALID_EPOCH) {
+        return 0;
+    }
+    int64_t when = days_from_civil(year, (int)(p - months) / 3 + 1, day) * 86400 + hh * 3600 + mm * 60 + ss;
+    return when > now ? (int)(when - now) : 0;
+}
+
+static esp_err_t upload_client_event_handler(esp_http_client_event_t *evt)
+{
+    upload_client_t *uc = (upload_client_t *)evt->user_data;
+    if (!uc) {
+        return ESP_OK;
+    }
+
+    switch (evt->event_id) {
+    case HTTP_EVENT_ON_CONNECTED:
+        uc->connected = true;
+        uc->connect_seen = true;
+        break;
+    case HTTP_EVENT_DISCONNECTED:
+        uc->connected = false;
+        break;
+    case HTTP_EVENT_ON_HEADER:
+        if (evt->header_key && evt->header_value && strcasecmp(evt->header_key, "Retry-After") == 0) {
+            uc->retry_after_s = parse_retry_after(evt->header_value);
+        } else if (evt->header_key && evt->header_value &&
+                   strcasecmp(evt->header_key, UPLOAD_CLIENT_PHASE_HEADER) == 0) {
+            char *end = NULL;
+            long ms = strtol(evt->header_value, &end, 10);
+            if (end != evt->header_value && ms >= 0 && ms <= INT32_MAX) {
+                uc->phase_hint_ms = (int)ms;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return ESP_OK;
+}
+
+void upload_client_init(upload_client_t *uc, const char *name)
+{
+    memset(uc, 0, sizeof(*uc));
+    uc->name = name ? name : "http";
+    uc->idle_timeout_ms = UPLOAD_CLIENT_IDLE_TIMEOUT_MS;
+    uc->chunk_size = UPLOAD_CLIENT_DEFAULT_CHUNK_SIZE;
+    uc->phase_hint_ms = -1;
+    retry_policy_init(&uc->retry);
+    uc->stats.retry = uc->retry.stats;
+}
+
+bool upload_client_available(const upload_client_t *uc)
+{
+    return uc->retry.stats.state != RETRY_CIRCUIT_OPEN || esp_timer_get_time() >= uc->retry.stats.open_until_us;
+}
+
+void upload_client_close(upload_client_t *uc)
+{
+    if (uc->client) {
+        esp_http_client_close(uc->client);
+        esp_http_client_cleanup(uc->client);
+        uc->client = NULL;
+    }
+    uc->connected = false;
+    uc->tls_session = false;
+    uc->url[0] = '\0';
+}
+
+void upload_client_disconnect(upload_client_t *uc)
+{
+    if (uc->client) {
+        esp_http_client_close(uc->client);
+    }
+    uc->connected = false;
+}
+
+void upload_client_check_idle(upload_client_t *uc)
+{
+    if (!uc->client || !uc->connected) {
+        return;
+    }
+    int64_t idle_ms = (esp_timer_get_time() - uc->last_used_us) / 1000;
+    if (idle_ms >= uc->idle_timeout_ms) {
+        ESP_LOGD(TAG, "%s: closing connection idle for %lld ms", uc->name, (long long)idle_ms);
+        upload_client_disconnect(uc);
+        uc->stats.idle_closes++;
+    }
+}
+
+static esp_err_t ensure_client(upload_client_t *uc, const char *url)
+{
+    // A different URL may point at another host; start over rather than juggling set_url().
+    if (uc->client && strcmp(uc->url, url) != 0) {
+        upload_client_close(uc);
+    }
+    if (uc->client) {
+        return ESP_OK;
+    }
+
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = UPLOAD_CLIENT_TIMEOUT_MS,
+        .event_handler = upload_client_event_handler,
+        .user_data = uc,
+        .keep_alive_enable = true,
+    };
+
+#if CONFIG_MBEDTLS_CERTIFICATE_BUNDLE
+    config.crt_bundle_attach = esp_crt_bundle_attach;
+#endif
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    // The transport keeps the last session and offers it on reconnect, for as long as the handle lives.
+    config.save_client_session = true;
+#endif
+
+    uc->client = esp_http_client_init(&config);
+    if (!uc->client) {
+        return ESP_ERR_NO_MEM;
+    }
+    strncpy(uc->url, url, sizeof(uc->url) - 1);
+    uc->url[sizeof(uc->url) - 1] = '\0';
+    uc->connected = false;
+    uc->tls = strncmp(url, "https://", 8) == 0;
+    uc->tls_session = false;
+    return ESP_OK;
+}
+
+esp_err_t upload_client_preconnect(upload_client_t *uc, const char *url)
+{
+    if (!uc || !url || url[0] == '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!upload_client_available(uc)) {
+        return RETRY_POLICY_ERR_CIRCUIT_OPEN;
+    }
+
+    upload_client_check_idle(uc);
+    esp_err_t err = ensure_client(uc, url);
+    if (err != ESP_OK || uc->connected) {
+        return err;
+    }
+
+    // The status does not matter (405 is fine); only the open connection is kept.
+    esp_http_client_set_method(uc->client, HTTP_METHOD_HEAD);
+    uc->connect_seen = false;
+    bool offered = uc->tls && uc->tls_session;
+    int64_t t0 = esp_timer_get_time();
+    err = esp_http_client_open(uc->client, 0);
+    int64_t connect_us = esp_timer_get_time() - t0;
+    if (err == ESP_OK && esp_http_client_fetch_headers(uc->client) < 0) {
+        err = ESP_ERR_HTTP_FETCH_HEADER;
+    }
+    if (err == ESP_OK) {
+        int drained = 0;
+        (void)esp_http_client_flush_response(uc->client, &drained);
+    }
+    if (err != ESP_OK || !uc->connected) {
+        ESP_LOGD(TAG, "%s: preconnect failed: %s", uc->name, esp_err_to_name(err));
+        upload_client_disconnect(uc);
+        return err != ESP_OK ? err : ESP_FAIL;
+    }
+
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (uc->tls) {
+        uc->tls_session = true;
+    }
+#endif
+    if (uc->tls && offered) {
+        uc->stats.tls_session_offered++;
+        uc->stats.tls_session_offered_us_total += connect_us;
+    } else if (uc->tls) {
+        uc->stats.tls_full++;
+        uc->stats.tls_full_us_total += connect_us;
+    }
+    uc->stats.connects++;
+    uc->stats.connect_us_total += connect_us;
+    uc->stats.preconnects++;
+    uc->warm_connect_us = connect_us;
+    uc->last_used_us = esp_timer_get_time();
+    ESP_LOGD(TAG, "%s: preconnected in %lld us", uc->name, (long long)connect_us);
+    return ESP_OK;
+}
+
+void upload_client_set_retry_policy(upload_client_t *uc, const retry_policy_config_t *cfg)
+{
+    retry_policy_configure(&uc->retry, cfg);
+}
+
+void upload_client_set_chunk_size(upload_client_t *uc, size_t chunk_size)
+{
+    uc->chunk_size = chunk_size > 0 ? chunk_size : UPLOAD_CLIENT_DEFAULT_CHUNK_SIZE;
+}
+
+static esp_err_t write_raw(upload_client_t *uc, const void *data, size_t len)
+{
+    const char *p = (const char *)data;
+    while (len > 0) {
+        int w = esp_http_client_write(uc->client, p, (int)len);
+        if (w <= 0) {
+            return ESP_ERR_HTTP_WRITE_DATA;
+        }
+        p += w;
+        len -= (size_t)w;
+    }
+    return ESP_OK;
+}
+
+esp_err_t upload_client_write(upload_client_t *uc, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0) {
+        size_t n = len < uc->chunk_size ? len : uc->chunk_size;
+        esp_err_t err;
+        if (uc->chunked) {
+            char hdr[12];
+            int hl = snprintf(hdr, sizeof(hdr), "%x\r\n", (unsigned)n);
+            err = write_raw(uc, hdr, (size_t)hl);
+            if (err == ESP_OK) {
+                err = write_raw(uc, p, n);
+            }
+            if (err == ESP_OK) {
+                err = write_raw(uc, "\r\n", 2);
+            }
+        } else {
+            err = write_raw(uc, p, n);
+        }
+        if (err != ESP_OK) {
+            return err;
+        }
+        uc->body_written += n;
+        p += n;
+        len -= n;
+    }
+    return ESP_OK;
+}
+
+/**
+ * One request/response exchange on the current connection.
+ * Sets *out_stale when the failure looks like the server had already closed a reused socket,
+ * i.e. nothing of the response was seen and replaying the request is safe.
+ */
+static esp_err_t post_once(upload_client_t *uc, const char *content_type, int64_t content_len,
+                           upload_body_writer_t writer, void *ctx, upload_client_timing_t *t, bool *out_stale)
+{
+    *out_stale = false;
+    memset(t, 0, sizeof(*t));
+    uc->retry_after_s = 0;
+    uc->phase_hint_ms = -1;
+    t->reused = uc->connected;
+
+    esp_http_client_set_method(uc->client, HTTP_METHOD_POST);
+    esp_http_client_set_header(uc->client, "Content-Type", content_type);
+    for (size_t i = 0; i < uc->extra_header_count; i++) {
+        esp_http_client_set_header(uc->client, uc->extra_headers[i].key, uc->extra_headers[i].value);
+    }
+
+    // A negative write length makes esp_http_client send "Transfer-Encoding: chunked".
+    uc->chunked = content_len < 0;
+    uc->body_written = 0;
+
+    uc->connect_seen = false;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_http_client_open(uc->client, uc->chunked ? -1 : (int)content_len);
+    int64_t t1 = esp_timer_get_time();
+    if (uc->connect_seen) {
+        t->reused = false;
+        t->connect_us = t1 - t0;
+        t->tls_handshake = uc->tls;
+        t->tls_session_offered = uc->tls && uc->tls_session;
+    }
+    if (err != ESP_OK) {
+        *out_stale = t->reused;
+        return err;
+    }
+#if CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS
+    if (t->tls_handshake) {
+        uc->tls_session = true;
+    }
+#endif
+
+    err = writer ? writer(uc, ctx) : ESP_OK;
+    if (err == ESP_OK && uc->chunked) {
+        err = write_raw(uc, "0\r\n\r\n", 5);
+    }
+    if (err == ESP_OK && !uc->chunked && (int64_t)uc->body_written != content_len) {
+        ESP_LOGE(TAG, "%s: body length mismatch (%u of %lld bytes)", uc->name, (unsigned)uc->body_written,
+                 (long long)content_len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK) {
+        *out_stale = t->reused && err == ESP_ERR_HTTP_WRITE_DATA;
+        return err;
+    }
+    int64_t t2 = esp_timer_get_time();
+    t->send_us = t2 - (t->reused ? t0 : t1);
+
+    int64_t resp_len = esp_http_client_fetch_headers(uc->client);
+    if (resp_len < 0) {
+        *out_stale = t->reused;
+        return ESP_ERR_HTTP_FETCH_HEADER;
+    }
+    t->status = esp_http_client_get_status_code(uc->client);
+    if (t->status <= 0) {
+        *out_stale = t->reused;
+        return ESP_ERR_HTTP_FETCH_HEADER;
+    }
+
+    int drained = 0;
+    (void)esp_http_client_flush_response(uc->client, &drained);
+    t->response_us = esp_timer_get_time() - t2;
+    return ESP_OK;
+}
+
+esp_err_t upload_client_add_header(upload_client_t *uc, const char *key, const char *value)
+{
+    if (!uc || !key || !value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (uc->extra_header_count >= UPLOAD_CLIENT_MAX_EXTRA_HEADERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    uc->extra_headers[uc->extra_header_count].key = key;
+    uc->extra_headers[uc->extra_header_count].value = value;
+    uc->extra_header_count++;
+    return ESP_OK;
+}
+
+// Headers stick to the esp_http_client handle; take the per-request ones off before the next request.
+static void clear_extra_headers(upload_client_t *uc)
+{
+    if (uc->client) {
+        for (size_t i = 0; i < uc->extra_header_count; i++) {
+            esp_http_client_delete_header(uc->client, uc->extra_headers[i].key);
+        }
+    }
+    uc->extra_header_count = 0;
+}
+
+typedef struct {
+    const uint8_t *body;
+    size_t len;
+} buffer_body_t;
+
+static esp_err_t write_buffer_body(upload_client_t *uc, void *ctx)
+{
+    const buffer_body_t *b = (const buffer_body_t *)ctx;
+    return upload_client_write(uc, b->body, b->len);
+}
+
+esp_err_t upload_client_post(upload_client_t *uc, const char *url, const char *content_type,
+                             const uint8_t *body, size_t len, bool chunked, int *out_status)
+{
+    buffer_body_t b = {
+        .body = body,
+        .len = len,
+    };
+    return upload_client_post_stream(uc, url, content_type, chunked ? UPLOAD_CLIENT_CHUNKED : (int64_t)len,
+                                     write_buffer_body, &b, out_status);
+}
+
+// One attempt, including the replay on a fresh socket when a kept-alive one turned out to be dead.
+static esp_err_t post_attempt(upload_client_t *uc, const char *url, const char *content_type, int64_t content_len,
+                              upload_body_writer_t writer, void *ctx, int *out_status)
+{
+    upload_client_check_idle(uc);
+
+    esp_err_t err = ensure_client(uc, url);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    upload_client_timing_t t;
+    bool stale = false;
+    err = post_once(uc, content_type, content_len, writer, ctx, &t, &stale);
+    if (err != ESP_OK && stale) {
+        // Keep-alive socket was closed by the peer (or a middlebox) while idle; replay once.
+        ESP_LOGD(TAG, "%s: kept-alive connection went stale (%s), reconnecting", uc->name, esp_err_to_name(err));
+        esp_http_client_close(uc->client);
+        uc->connected = false;
+        uc->stats.reconnects++;
+        err = post_once(uc, content_type, content_len, writer, ctx, &t, &stale);
+    }
+
+    uc->stats.requests++;
+    uc->last_used_us = esp_timer_get_time();
+
+    if (err != ESP_OK) {
+        // Leave no half-written request behind; the next call starts from a clean socket.
+        esp_http_client_close(uc->client);
+        uc->connected = false;
+        uc->stats.failures++;
+        if (out_status) {
+            *out_status = 0;
+        }
+        ESP_LOGW(TAG, "%s: POST failed: %s", uc->name, esp_err_to_name(err));
+        return err;
+    }
+
+    if (t.reused) {
+        uc->stats.reuses++;
+    } else {
+        uc->stats.connects++;
+    }
+    if (t.tls_handshake && t.tls_session_offered) {
+        uc->stats.tls_session_offered++;
+        uc->stats.tls_session_offered_us_total += t.connect_us;
+    } else if (t.tls_handshake) {
+        uc->stats.tls_full++;
+        uc->stats.tls_full_us_total += t.connect_us;
+    }
+    uc->stats.connect_us_total += t.connect_us;
+    uc->stats.send_us_total += t.send_us;
+    uc->stats.response_us_total += t.response_us;
+    uc->stats.bytes_total += uc->body_written;
+    uc->stats.last = t;
+
+    if (out_status) {
+        *out_status = t.status;
+    }
+    if (t.status < 200 || t.status >= 300) {
+        uc->stats.failures++;
+        ESP_LOGW(TAG, "%s: POST http status=%d%s", uc->name, t.status, uc->retry_after_s > 0 ? " (Retry-After)" : "");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGD(TAG, "%s: %u bytes%s connect=%lld us send=%lld us response=%lld us%s", uc->name,
+             (unsigned)uc->body_written, uc->chunked ? " (chunked)" : "", (long long)t.connect_us,
+             (long long)t.send_us, (long long)t.response_us, t.reused ? " (reused)" : "");
+    return ESP_OK;
+}
+
+esp_err_t upload_client_post_stream(upload_client_t *uc, const char *url, const char *content_type,
+                                    int64_t content_len, upload_body_writer_t writer, void *ctx, int *out_status)
+{
+    if (!uc) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!url || url[0] == '\0') {
+        clear_extra_headers(uc);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!retry_policy_admit(&uc->retry)) {
+        uc->stats.retry = uc->retry.stats;
+        clear_extra_headers(uc);
+        uc->status = 0;
+        if (out_status) {
+            *out_status = 0;
+        }
+        return RETRY_POLICY_ERR_CIRCUIT_OPEN;
+    }
+
+    esp_err_t err;
+    int status = 0;
+    int delay_ms = 0;
+    for (int attempt = 1;; attempt++) {
+        err = post_attempt(uc, url, content_type, content_len, writer, ctx, &status);
+        if (attempt == 1 && uc->warm_connect_us > 0) {
+            // Credit the pre-opened connection only if the POST actually rode on it.
+            if (uc->stats.last.reused && status != 0) {
+                uc->stats.preconnect_hits++;
+                uc->stats.hidden_us_total += uc->warm_connect_us;
+            } else {
+                uc->stats.preconnect_misses++;
+            }
+            uc->warm_connect_us = 0;
+        }
+        if (!retry_policy_should_retry(&uc->retry, attempt, err, status, uc->retry_after_s, &delay_ms)) {
+            break;
+        }
+        ESP_LOGI(TAG, "%s: retry %d in %d ms", uc->name, attempt, delay_ms);
+        vTaskDelay(pdMS_TO_TICKS(delay_ms));
+    }
+    retry_policy_on_result(&uc->retry, err == ESP_OK, status, uc->retry_after_s);
+    uc->stats.retry = uc->retry.stats;
+    clear_extra_headers(uc);
+
+    uc->status = status;
+    if (out_status) {
+        *out_status = status;
+    }
+    return err;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "retry_policy.h"
+#include "sdkconfig.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Close a kept-alive connection that has not been used for this long. */
+#define UPLOAD_CLIENT_IDLE_TIMEOUT_MS 90000
+
+/** Default body write size: one full TCP send buffer per esp_http_client_write(). */
+#define UPLOAD_CLIENT_DEFAULT_CHUNK_SIZE CONFIG_LWIP_TCP_SND_BUF_DEFAULT
+
+/** Pass as `content_len` to stream the body with chunked transfer encoding. */
+#define UPLOAD_CLIENT_CHUNKED (-1)
+
+/** Response header a collector uses to assign this device's capture phase (ms into the interval). */
+#define UPLOAD_CLIENT_PHASE_HEADER "X-Capture-Phase-Ms"
+
+/** Extra request headers upload_client_add_header() can hold for one POST. */
+#define UPLOAD_CLIENT_MAX_EXTRA_HEADERS 8
+
+typedef struct {
+    const char *key;
+    const char *value;
+} upload_client_header_t;
+
+/** Per-request phase timings (microseconds). */
+typedef struct {
+    int64_t connect_us;  // TCP connect + TLS handshake (0 when the connection was reused)
+    int64_t send_us;     // request headers + body written to the socket
+    int64_t response_us; // waiting for the status line/headers and draining the body
+    bool reused;         // request went out on an already open connection
+    bool tls_handshake;  // a TLS handshake was part of connect_us
+    bool tls_session_offered; // ...and it offered a cached session (whether the server took it is not known)
+    int status;          // HTTP status code (0 if none was received)
+} upload_client_timing_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t failures;
+    uint32_t connects;   // new connections opened
+    uint32_t reuses;     // requests served by a kept-alive connection
+    uint32_t reconnects; // server had closed a kept-alive socket; request replayed on a new one
+    uint32_t idle_closes;
+    int64_t connect_us_total;
+    int64_t send_us_total;
+    int64_t response_us_total;
+    uint64_t bytes_total; // body bytes of successfully answered requests
+    uint32_t tls_full;         // TLS handshakes without a cached session
+    // TLS handshakes that offered the cached session (ticket / session ID). esp_http_client does not
+    // report whether the server accepted it, so a server that dropped the session still counts here;
+    // compare the average times to see whether resumption actually happens.
+    uint32_t tls_session_offered;
+    int64_t tls_full_us_total; // connect + handshake time of each kind, to compare their cost
+    int64_t tls_session_offered_us_total;
+    uint32_t preconnects;      // connections opened ahead of a POST
+    uint32_t preconnect_hits;  // POSTs that went out on a pre-opened connection
+    uint32_t preconnect_misses; // pre-opened connection was gone by the time the POST came
+    int64_t hidden_us_total;   // connect/handshake time taken off the upload path by hits
+    upload_client_timing_t last;
+    retry_policy_stats_t retry;
+} upload_client_stats_t;
+
+/**
+ * Long-lived HTTP(S) client bound to one endpoint.
+ *
+ * Owned by a single task; not thread-safe. The underlying esp_http_client handle
+ * is created lazily on first use and kept open between requests.
+ */
+typedef struct {
+    const char *name;
+    esp_http_client_handle_t client;
+    char url[256];
+    bool connected;
+    bool connect_seen;
+    bool tls;            // URL is https
+    bool tls_session;    // a TLS session from an earlier handshake is cached in the client handle
+    bool chunked;       // current request uses chunked transfer encoding
+    size_t chunk_size;  // max bytes handed to esp_http_client_write() at once
+    size_t body_written;
+    int idle_timeout_ms;
+    int64_t last_used_us;
+    int status;         // HTTP status of the last upload_client_post_stream(), 0 if none was received
+    int retry_after_s;  // Retry-After of the last response, 0 if absent
+    int phase_hint_ms;  // UPLOAD_CLIENT_PHASE_HEADER of the last response, -1 if absent
+    int64_t warm_connect_us; // connect time of a pre-opened connection not yet used by a POST
+    upload_client_header_t extra_headers[UPLOAD_CLIENT_MAX_EXTRA_HEADERS]; // for the next POST only
+    size_t extra_header_count;
+    retry_policy_t retry;
+    upload_client_stats_t stats;
+} upload_client_t;
+
+/** Reset state; `name` is used for logging only and must outlive the client. */
+void upload_client_init(upload_client_t *uc, const char *name);
+
+/**
+ * Produces the request body by calling upload_client_write() one or more times.
+ * May be invoked several times for one request (stale kept-alive connection, retries),
+ * so it must be able to start over from the beginning.
+ */
+typedef esp_err_t (*upload_body_writer_t)(upload_client_t *uc, void *ctx);
+
+/**
+ * POST a streamed body to `url`, reusing the open connection when possible.
+ * `content_len` is the exact body size, or UPLOAD_CLIENT_CHUNKED when it is not known up front.
+ * Failed attempts are retried per the client's retry policy (the writer is replayed each time).
+ * Returns ESP_OK on a 2xx response, ESP_FAIL on other statuses and RETRY_POLICY_ERR_CIRCUIT_OPEN
+ * without touching the network while the endpoint's circuit is open. `out_status` may be NULL.
+ */
+esp_err_t upload_client_post_stream(upload_client_t *uc, const char *url, const char *content_type,
+                                    int64_t content_len, upload_body_writer_t writer, void *ctx, int *out_status);
+
+/**
+ * Write body bytes straight to the socket in `chunk_size` pieces (no staging copy).
+ * Only valid from inside an upload_body_writer_t.
+ */
+esp_err_t upload_client_write(upload_client_t *uc, const void *data, size_t len);
+
+/**
+ * Add a header to the next upload_client_post_stream() (kept across its retries, removed once it
+ * returns). `key` and `value` are not copied and must stay valid until then.
+ */
+esp_err_t upload_client_add_header(upload_client_t *uc, const char *key, const char *value);
+
+/** POST `len` bytes of `body` with a Content-Length header (or chunked if `chunked`). */
+esp_err_t upload_client_post(upload_client_t *uc, const char *url, const char *content_type,
+                             const uint8_t *body, size_t len, bool chunked, int *out_status);
+
+/** Apply retry/backoff and circuit breaker tunables; state and counters carry over. */
+void upload_client_set_retry_policy(upload_client_t *uc, const retry_policy_config_t *cfg);
+
+/**
+ * Resolve, connect and handshake with the endpoint ahead of the next POST by sending a HEAD
+ * request on a kept-alive connection. No-op if a connection is already open.
+ */
+esp_err_t upload_client_preconnect(upload_client_t *uc, const char *url);
+
+/** Whether the endpoint currently accepts requests (its circuit is not open). */
+bool upload_client_available(const upload_client_t *uc);
+
+/** Set the body write size; 0 restores UPLOAD_CLIENT_DEFAULT_CHUNK_SIZE. */
+void upload_client_set_chunk_size(upload_client_t *uc, size_t chunk_size);
+
+/** Close the connection if it has been idle for longer than the idle timeout. */
+void upload_client_check_idle(upload_client_t *uc);
+
+/**
+ * Close the socket but keep the client handle, and with it the cached TLS session, so the next
+ * request resumes instead of doing a full handshake.
+ */
+void upload_client_disconnect(upload_client_t *uc);
+
+/** Close the connection and free the underlying client handle (drops the cached TLS session). */
+void upload_client_close(upload_client_t *uc);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,85 @@
+#include "veg_index.h"
+
+#include <stdio.h>
+
+#define VEG_INDEX_MAX_SUM (3 * 255)
+
+// 2^20 / (r+g+b), rounded, for the sums that are evaluated; fits 16 bits because VEG_INDEX_MIN_SUM > 16.
+static uint16_t s_recip[VEG_INDEX_MAX_SUM + 1];
+static bool s_recip_ready;
+
+static void build_recip(void)
+{
+    for (int s = VEG_INDEX_MIN_SUM; s <= VEG_INDEX_MAX_SUM; s++) {
+        s_recip[s] = (uint16_t)(((1 << 20) + s / 2) / s);
+    }
+    s_recip_ready = true;
+}
+
+void veg_index_rgb565(const uint8_t *rgb565, uint16_t width, uint16_t height, veg_index_result_t *out)
+{
+    if (!s_recip_ready) {
+        build_recip();
+    }
+
+    // Q20 sums of the per-pixel indices; 64 bits hold any frame size.
+    int64_t exg_sum = 0;
+    int64_t exgr5_sum = 0;
+    uint32_t evaluated = 0;
+    uint32_t exg_cover = 0;
+    uint32_t exgr_cover = 0;
+    size_t count = (size_t)width * height;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t p = ((uint32_t)rgb565[2 * i] << 8) | rgb565[2 * i + 1];
+        int32_t r5 = (int32_t)(p >> 11);
+        int32_t g6 = (int32_t)((p >> 5) & 0x3f);
+        int32_t b5 = (int32_t)(p & 0x1f);
+        int32_t r = (r5 << 3) | (r5 >> 2);
+        int32_t g = (g6 << 2) | (g6 >> 4);
+        int32_t b = (b5 << 3) | (b5 >> 2);
+        int32_t sum = r + g + b;
+        if (sum < VEG_INDEX_MIN_SUM) {
+            continue;
+        }
+        evaluated++;
+
+        // With chromatic coordinates x' = x / sum, ExG > t  <=>  (2g - r - b) > t * sum, and
+        // 5 * ExGR = 5 * (3g' - 2.4r' - b') = (15g - 12r - 5b) / sum.
+        int32_t exg = 2 * g - r - b;
+        int32_t exgr5 = 15 * g - 12 * r - 5 * b;
+        exg_cover += exg * 1000 > VEG_INDEX_EXG_COVER_MILLI * sum;
+        exgr_cover += exgr5 > 0;
+        exg_sum += exg * (int32_t)s_recip[sum];
+        exgr5_sum += exgr5 * (int32_t)s_recip[sum];
+    }
+
+    out->width = width;
+    out->height = height;
+    out->pixels = evaluated;
+    out->dark = (uint32_t)count - evaluated;
+    if (evaluated == 0) {
+        out->exg_mean_milli = 0;
+        out->exgr_mean_milli = 0;
+        out->exg_cover_permille = 0;
+        out->exgr_cover_permille = 0;
+        return;
+    }
+    out->exg_mean_milli = (int32_t)(exg_sum * 1000 / ((int64_t)evaluated << 20));
+    out->exgr_mean_milli = (int32_t)(exgr5_sum * 200 / ((int64_t)evaluated << 20));
+    out->exg_cover_permille = (uint16_t)((uint64_t)exg_cover * 1000 / evaluated);
+    out->exgr_cover_permille = (uint16_t)((uint64_t)exgr_cover * 1000 / evaluated);
+}
+
+int veg_index_format_record(const veg_index_result_t *r, uint32_t seq, int64_t capture_us, bool with_jpeg,
+                            const char *regions_json, char *buf, size_t len)
+{
+    uint32_t total = r->pixels + r->dark;
+    return snprintf(buf, len,
+                    "{\"seq\":%u,\"capture_us\":%lld,\"width\":%u,\"height\":%u,\"exg_milli\":%d,\"exgr_milli\":%d"
+                    ",\"exg_cover_pm\":%u,\"exgr_cover_pm\":%u,\"dark_pm\":%u,\"jpeg\":%s%s%s}",
+                    (unsigned)seq, (long long)capture_us, (unsigned)r->width, (unsigned)r->height,
+                    (int)r->exg_mean_milli, (int)r->exgr_mean_milli, (unsigned)r->exg_cover_permille,
+                    (unsigned)r->exgr_cover_permille,
+                    (unsigned)(total ? (uint64_t)r->dark * 1000 / total : 0), with_jpeg ? "true" : "false",
+                    regions_json ? ",\"regions\":" : "", regions_json ? regions_json : "");
+}
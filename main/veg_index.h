@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Pixels with r+g+b (0..765) below this are too dark for chromatic coordinates and are left out. */
+#define VEG_INDEX_MIN_SUM 36
+
+/** ExG (on chromatic coordinates) above which a pixel counts as vegetation for `exg_cover_permille`. */
+#define VEG_INDEX_EXG_COVER_MILLI 100
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint32_t pixels; // pixels bright enough to be evaluated
+    uint32_t dark;   // pixels left out (VEG_INDEX_MIN_SUM)
+    int32_t exg_mean_milli;  // mean ExG = 2g - r - b over chromatic coordinates, x1000 (-1000..2000)
+    int32_t exgr_mean_milli; // mean ExGR = ExG - ExR with ExR = 1.4r - g, x1000
+    uint16_t exg_cover_permille;  // evaluated pixels with ExG > VEG_INDEX_EXG_COVER_MILLI
+    uint16_t exgr_cover_permille; // evaluated pixels with ExGR > 0 (Meyer & Neto)
+} veg_index_result_t;
+
+/**
+ * Excess-green indices over an RGB565 image with the high byte of each pixel first, as the camera
+ * and jpg2rgb565() produce it. Integer-only: the coverage tests need no division at all and the
+ * means use a reciprocal table, built on the first call (so the first call must not race another).
+ * Free of ESP-IDF dependencies.
+ */
+void veg_index_rgb565(const uint8_t *rgb565, uint16_t width, uint16_t height, veg_index_result_t *out);
+
+/**
+ * Compact JSON record of one measurement, as uploaded in place of the JPEG. `with_jpeg` tells the
+ * collector that a JPEG with the same seq follows; `regions_json` (may be NULL) is embedded as the
+ * "regions" member. Returns the length written (snprintf semantics).
+ */
+int veg_index_format_record(const veg_index_result_t *r, uint32_t seq, int64_t capture_us, bool with_jpeg,
+                            const char *regions_json, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,232 @@
+#include "window_preset.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-';
+}
+
+static bool name_valid(const char *name)
+{
+    size_t n = strnlen(name, WINDOW_PRESET_NAME_MAX);
+    if (n == 0 || n >= WINDOW_PRESET_NAME_MAX || strcmp(name, WINDOW_FULL_NAME) == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!name_char(name[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int window_preset_find(const window_preset_list_t *list, const char *name)
+{
+    for (int i = 0; i < list->count; i++) {
+        if (strncmp(list->presets[i].name, name, WINDOW_PRESET_NAME_MAX) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool window_preset_put(window_preset_list_t *list, const window_preset_t *preset)
+{
+    if (!name_valid(preset->name)) {
+        return false;
+    }
+    int i = window_preset_find(list, preset->name);
+    if (i < 0) {
+        if (list->count >= WINDOW_PRESET_MAX) {
+            return false;
+        }
+        i = list->count++;
+    }
+    list->presets[i] = *preset;
+    return true;
+}
+
+// The ten sizes in set_res_raw() order, so encode, decode, parse and format share one layout.
+static uint16_t *preset_fields(window_preset_t *p, int i)
+{
+    uint16_t *const fields[10] = {&p->start_x,  &p->start_y,  &p->end_x,   &p->end_y,    &p->offset_x,
+                                  &p->offset_y, &p->total_x, &p->total_y, &p->output_x, &p->output_y};
+    return fields[i];
+}
+
+size_t window_preset_list_encode(const window_preset_list_t *list, uint8_t *buf, size_t len)
+{
+    if (list->count > WINDOW_PRESET_MAX || len < 1 + (size_t)list->count * WINDOW_PRESET_RECORD_SIZE) {
+        return 0;
+    }
+    size_t n = 0;
+    buf[n++] = list->count;
+    for (int i = 0; i < list->count; i++) {
+        window_preset_t p = list->presets[i];
+        memset(buf + n, 0, WINDOW_PRESET_NAME_MAX);
+        memcpy(buf + n, p.name, strnlen(p.name, WINDOW_PRESET_NAME_MAX - 1));
+        n += WINDOW_PRESET_NAME_MAX;
+        for (int f = 0; f < 10; f++) {
+            uint16_t v = *preset_fields(&p, f);
+            buf[n++] = (uint8_t)(v & 0xFF);
+            buf[n++] = (uint8_t)(v >> 8);
+        }
+        buf[n++] = (uint8_t)((p.scale ? 1 : 0) | (p.binning ? 2 : 0));
+    }
+    return n;
+}
+
+bool window_preset_list_decode(const uint8_t *buf, size_t len, window_preset_list_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    if (len < 1 || buf[0] > WINDOW_PRESET_MAX || len != 1 + (size_t)buf[0] * WINDOW_PRESET_RECORD_SIZE) {
+        return false;
+    }
+    window_preset_list_t list;
+    memset(&list, 0, sizeof(list));
+    size_t n = 1;
+    for (int i = 0; i < buf[0]; i++) {
+        window_preset_t p;
+        memset(&p, 0, sizeof(p));
+        memcpy(p.name, buf + n, WINDOW_PRESET_NAME_MAX - 1);
+        n += WINDOW_PRESET_NAME_MAX;
+        for (int f = 0; f < 10; f++) {
+            *preset_fields(&p, f) = (uint16_t)(buf[n] | (buf[n + 1] << 8));
+            n += 2;
+        }
+        p.scale = (buf[n] & 1) != 0;
+        p.binning = (buf[n] & 2) != 0;
+        n++;
+        if (window_preset_find(&list, p.name) >= 0 || !window_preset_put(&list, &p)) {
+            return false;
+        }
+    }
+    *out = list;
+    return true;
+}
+
+bool window_preset_list_parse(const char *text, window_preset_list_t *out)
+{
+    window_preset_list_t list;
+    memset(&list, 0, sizeof(list));
+    const char *p = text;
+    for (;;) {
+        while (*p == ' ' || *p == ';') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        window_preset_t preset;
+        memset(&preset, 0, sizeof(preset));
+        size_t name_len = 0;
+        while (name_char(*p)) {
+            if (name_len + 1 >= WINDOW_PRESET_NAME_MAX) {
+                return false;
+            }
+            preset.name[name_len++] = *p++;
+        }
+        while (*p == ' ') {
+            p++;
+        }
+        if (*p++ != ':') {
+            return false;
+        }
+        long values[12];
+        for (int i = 0; i < 12; i++) {
+            char *end = NULL;
+            values[i] = strtol(p, &end, 10);
+            if (end == p || values[i] < 0 || values[i] > (i < 10 ? 0xFFFF : 1)) {
+                return false;
+            }
+            p = end;
+            while (*p == ' ') {
+                p++;
+            }
+            if (i < 11 && *p++ != ',') {
+                return false;
+            }
+        }
+        if (*p != ';' && *p != '\0') {
+            return false;
+        }
+        for (int f = 0; f < 10; f++) {
+            *preset_fields(&preset, f) = (uint16_t)values[f];
+        }
+        preset.scale = values[10] != 0;
+        preset.binning = values[11] != 0;
+        if (preset.output_x == 0 || preset.output_y == 0 || window_preset_find(&list, preset.name) >= 0 ||
+            !window_preset_put(&list, &preset)) {
+            return false;
+        }
+    }
+    *out = list;
+    return true;
+}
+
+int window_preset_list_format(const window_preset_list_t *list, char *buf, size_t len)
+{
+    size_t n = 0;
+    if (len > 0) {
+        buf[0] = '\0';
+    }
+    for (int i = 0; i < list->count; i++) {
+        window_preset_t p = list->presets[i];
+        int w = snprintf(buf + (n < len ? n : len), n < len ? len - n : 0, "%s%s:", i ? "; " : "", p.name);
+        for (int f = 0; f < 10 && w >= 0; f++) {
+            n += (size_t)w;
+            w = snprintf(buf + (n < len ? n : len), n < len ? len - n : 0, "%s%u", f ? "," : " ",
+                         (unsigned)*preset_fields(&p, f));
+        }
+        if (w >= 0) {
+            n += (size_t)w;
+            w = snprintf(buf + (n < len ? n : len), n < len ? len - n : 0, ",%d,%d", p.scale ? 1 : 0,
+                         p.binning ? 1 : 0);
+        }
+        if (w < 0) {
+            return w;
+        }
+        n += (size_t)w;
+    }
+    return (int)n;
+}
+
+bool window_cycle_parse(const window_preset_list_t *list, const char *text, window_cycle_t *out)
+{
+    window_cycle_t cycle;
+    memset(&cycle, 0, sizeof(cycle));
+    const char *p = text;
+    for (;;) {
+        while (*p == ' ' || *p == ',') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        char name[WINDOW_PRESET_NAME_MAX];
+        size_t name_len = 0;
+        while (name_char(*p)) {
+            if (name_len + 1 >= sizeof(name)) {
+                return false;
+            }
+            name[name_len++] = *p++;
+        }
+        name[name_len] = '\0';
+        if (name_len == 0 || (*p != ' ' && *p != ',' && *p != '\0') || cycle.count >= WINDOW_CYCLE_MAX) {
+            return false;
+        }
+        int slot = WINDOW_CYCLE_FULL;
+        if (strcmp(name, WINDOW_FULL_NAME) != 0) {
+            slot = window_preset_find(list, name);
+            if (slot < 0) {
+                return false;
+            }
+        }
+        cycle.slots[cycle.count++] = (int8_t)slot;
+    }
+    *out = cycle;
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WINDOW_PRESET_MAX 6
+/** Longest preset name including the terminator. */
+#define WINDOW_PRESET_NAME_MAX 12
+/** Captures in one window cycle. */
+#define WINDOW_CYCLE_MAX 8
+
+/** Cycle entry for the configured frame size instead of a preset. */
+#define WINDOW_CYCLE_FULL (-1)
+/** Name that selects WINDOW_CYCLE_FULL in a cycle; not allowed as a preset name. */
+#define WINDOW_FULL_NAME "full"
+
+/** Largest window_preset_list_encode() output: a count byte, then per preset a name, ten sizes and a flag byte. */
+#define WINDOW_PRESET_RECORD_SIZE (WINDOW_PRESET_NAME_MAX + 10 * 2 + 1)
+#define WINDOW_PRESET_LIST_ENCODED_MAX (1 + WINDOW_PRESET_MAX * WINDOW_PRESET_RECORD_SIZE)
+
+/**
+ * A named sensor window: the arguments of sensor_t::set_res_raw(), in the order the CameraWebServer
+ * /window page takes them. Their meaning is sensor specific (on the OV2640 `start_x` selects the
+ * sensor mode); output_x by output_y is what the sensor encodes.
+ */
+typedef struct {
+    char name[WINDOW_PRESET_NAME_MAX];
+    uint16_t start_x;
+    uint16_t start_y;
+    uint16_t end_x;
+    uint16_t end_y;
+    uint16_t offset_x;
+    uint16_t offset_y;
+    uint16_t total_x;
+    uint16_t total_y;
+    uint16_t output_x;
+    uint16_t output_y;
+    bool scale;
+    bool binning;
+} window_preset_t;
+
+typedef struct {
+    uint8_t count;
+    window_preset_t presets[WINDOW_PRESET_MAX];
+} window_preset_list_t;
+
+/** Preset index per capture, or WINDOW_CYCLE_FULL; captures walk the entries in order and wrap. */
+typedef struct {
+    uint8_t count;
+    int8_t slots[WINDOW_CYCLE_MAX];
+} window_cycle_t;
+
+/** Index of the preset called `name`, or -1. */
+int window_preset_find(const window_preset_list_t *list, const char *name);
+
+/** Replace the preset with the same name, or append it. False if the name is invalid or the list is full. */
+bool window_preset_put(window_preset_list_t *list, const window_preset_t *preset);
+
+/** Compact binary form for NVS; returns the bytes written (at most WINDOW_PRESET_LIST_ENCODED_MAX), 0 on error. */
+size_t window_preset_list_encode(const window_preset_list_t *list, uint8_t *buf, size_t len);
+
+/** Inverse of window_preset_list_encode(); false if `buf` is not a valid encoding. */
+bool window_preset_list_decode(const uint8_t *buf, size_t len, window_preset_list_t *out);
+
+/**
+ * Parse the text form used on the config page: presets separated by ';', each a name, ':' and the
+ * twelve set_res_raw() arguments separated by ',' (scale and binning as 0/1), e.g.
+ * "trough: 0,0,0,0,400,300,1600,1200,400,300,1,0". Names are letters, digits, '_' and '-'.
+ * An empty string clears the list. Returns false on a syntax error, a duplicate name or too many presets.
+ */
+bool window_preset_list_parse(const char *text, window_preset_list_t *out);
+
+/** Text form of a list as accepted by window_preset_list_parse(). */
+int window_preset_list_format(const window_preset_list_t *list, char *buf, size_t len);
+
+/**
+ * Parse a cycle of preset names separated by ',' (WINDOW_FULL_NAME for the normal frame size), e.g.
+ * "full,trough,trough". An empty string is an empty cycle (every capture at the normal frame size).
+ * Returns false on an unknown name or too many entries.
+ */
+bool window_cycle_parse(const window_preset_list_t *list, const char *text, window_cycle_t *out);
+
+#ifdef __cplusplus
+}
+#endif
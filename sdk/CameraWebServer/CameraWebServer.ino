@@ -9,6 +9,12 @@
 //            You must select partition scheme from the board menu that has at least 3MB APP space.
 //            Face Recognition is DISABLED for ESP32 and ESP32-S2, because it takes up from 15 
 //            seconds to process single frame. Face Detection is ENABLED if PSRAM is enabled as well
+//
+// Building: the Arduino IDE only compiles files in the sketch folder. Put these next to this file
+//            first: ../app_httpd.cpp, ../camera_index.h and ../camera_pins.h, plus jpeg_dc.c,
+//            jpeg_dc.h, window_preset.c and window_preset.h from the firmware's main/ directory.
+//            app_httpd.cpp needs the last four for the /thumb and /window handlers; the build
+//            fails with a missing jpeg_dc.h if they are left out.
 
 // ===================
 // Select camera model
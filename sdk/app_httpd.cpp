@@ -19,6 +19,10 @@
 #include "esp32-hal-ledc.h"
 #include "sdkconfig.h"
 #include "camera_index.h"
+#include "nvs.h"
+// Built from the firmware's sources; see the build note at the top of CameraWebServer.ino.
+#include "jpeg_dc.h"
+#include "window_preset.h"
 
 #if defined(ARDUINO_ARCH_ESP32) && defined(CONFIG_ARDUHAL_ESP_LOG)
 #include "esp32-hal-log.h"
@@ -350,6 +354,80 @@ static size_t jpg_encode_stream(void *arg, size_t index, const void *data, size_
     return len;
 }
 
+// Named sensor windows, stored in NVS in the uploader firmware's layout (window_preset.h), so a
+// window tuned with /window?...&save=name is then available by name here and to the uploader.
+#define WINDOW_NVS_NS "uploader"
+#define WINDOW_NVS_KEY "win_presets"
+
+static bool load_window_presets(window_preset_list_t *list)
+{
+    memset(list, 0, sizeof(*list));
+    nvs_handle_t h;
+    if (nvs_open(WINDOW_NVS_NS, NVS_READONLY, &h) != ESP_OK) {
+        return true; // nothing saved yet
+    }
+    uint8_t blob[WINDOW_PRESET_LIST_ENCODED_MAX];
+    size_t len = sizeof(blob);
+    esp_err_t err = nvs_get_blob(h, WINDOW_NVS_KEY, blob, &len);
+    nvs_close(h);
+    return err != ESP_OK || window_preset_list_decode(blob, len, list);
+}
+
+static bool save_window_presets(const window_preset_list_t *list)
+{
+    uint8_t blob[WINDOW_PRESET_LIST_ENCODED_MAX];
+    size_t len = window_preset_list_encode(list, blob, sizeof(blob));
+    nvs_handle_t h;
+    if (len == 0 || nvs_open(WINDOW_NVS_NS, NVS_READWRITE, &h) != ESP_OK) {
+        return false;
+    }
+    esp_err_t err = nvs_set_blob(h, WINDOW_NVS_KEY, blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(h);
+    }
+    nvs_close(h);
+    return err == ESP_OK;
+}
+
+// ?window=<name> on /capture and /stream: program the sensor with a saved window (or "full" for the
+// current frame size) so it reads out and encodes only that crop. The window stays set for later
+// requests, like one set through /window. Returns ESP_FAIL after sending an error response.
+static esp_err_t apply_window_query(httpd_req_t *req)
+{
+    char query[64];
+    char name[32];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "window", name, sizeof(name)) != ESP_OK) {
+        return ESP_OK;
+    }
+    sensor_t *s = esp_camera_sensor_get();
+    int res = -1;
+    if (strcmp(name, WINDOW_FULL_NAME) == 0) {
+        res = s->set_framesize(s, s->status.framesize);
+    } else {
+        window_preset_list_t list;
+        int i = load_window_presets(&list) ? window_preset_find(&list, name) : -1;
+        if (i < 0) {
+            httpd_resp_send_404(req);
+            return ESP_FAIL;
+        }
+        const window_preset_t *p = &list.presets[i];
+        res = s->set_res_raw(s, p->start_x, p->start_y, p->end_x, p->end_y, p->offset_x, p->offset_y, p->total_x,
+                             p->total_y, p->output_x, p->output_y, p->scale, p->binning);
+    }
+    if (res) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    // The frame already in the buffer was taken with the old window.
+    camera_fb_t *stale = esp_camera_fb_get();
+    if (stale) {
+        esp_camera_fb_return(stale);
+    }
+    log_i("Window: %s", name);
+    return ESP_OK;
+}
+
 static esp_err_t capture_handler(httpd_req_t *req)
 {
     camera_fb_t *fb = NULL;
@@ -357,6 +435,9 @@ static esp_err_t capture_handler(httpd_req_t *req)
 #if ARDUHAL_LOG_LEVEL >= ARDUHAL_LOG_LEVEL_INFO
     int64_t fr_start = esp_timer_get_time();
 #endif
+    if (apply_window_query(req) != ESP_OK) {
+        return ESP_FAIL;
+    }
 
 #if CONFIG_LED_ILLUMINATOR_ENABLED
     enable_led(true);
@@ -552,6 +633,10 @@ static esp_err_t stream_handler(httpd_req_t *req)
         last_frame = esp_timer_get_time();
     }
 
+    if (apply_window_query(req) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
     res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
     if (res != ESP_OK)
     {
@@ -1170,6 +1255,9 @@ static esp_err_t win_handler(httpd_req_t *req)
     int outputY = parse_get_var(buf, "oy", 0);
     bool scale = parse_get_var(buf, "scale", 0) == 1;
     bool binning = parse_get_var(buf, "binning", 0) == 1;
+    // Optional: keep this window under a name for /capture?window= and /stream?window= and the uploader.
+    char save_name[32];
+    bool save = httpd_query_key_value(buf, "save", save_name, sizeof(save_name)) == ESP_OK;
     free(buf);
 
     log_i("Set Window: Start: %d %d, End: %d %d, Offset: %d %d, Total: %d %d, Output: %d %d, Scale: %u, Binning: %u", startX, startY, endX, endY, offsetX, offsetY, totalX, totalY, outputX, outputY, scale, binning);
@@ -1178,11 +1266,208 @@ static esp_err_t win_handler(httpd_req_t *req)
     if (res) {
         return httpd_resp_send_500(req);
     }
+    if (save) {
+        window_preset_t preset = {};
+        strncpy(preset.name, save_name, sizeof(preset.name));
+        preset.start_x = startX;
+        preset.start_y = startY;
+        preset.end_x = endX;
+        preset.end_y = endY;
+        preset.offset_x = offsetX;
+        preset.offset_y = offsetY;
+        preset.total_x = totalX;
+        preset.total_y = totalY;
+        preset.output_x = outputX;
+        preset.output_y = outputY;
+        preset.scale = scale;
+        preset.binning = binning;
+        window_preset_list_t list;
+        (void)load_window_presets(&list); // an unreadable list is replaced
+        if (!window_preset_put(&list, &preset)) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "invalid window name or too many windows");
+        }
+        if (!save_window_presets(&list)) {
+            return httpd_resp_send_500(req);
+        }
+        log_i("Saved window %s", preset.name);
+    }
 
     httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
     return httpd_resp_send(req, NULL, 0);
 }
 
+// Preview thumbnails straight from the JPEG's DCT coefficients: DC terms only at 1/8 scale, DC plus
+// the three lowest AC terms at 1/4, so no IDCT and no full-size pixel buffer. The small RGB565
+// image is then re-encoded. ?scale=4|8 (default 8), ?quality=N (default 60). ?bench=N instead times
+// N runs of this path against the full fmt2rgb888() decode + downscale + fmt2jpg() and returns JSON.
+static jpeg_dc_decoder_t thumb_dec; // only used from the camera_httpd task
+
+static bool thumb_fast(camera_fb_t *fb, int scale, int quality, uint8_t **jpg, size_t *jpg_len,
+                       int64_t *decode_us)
+{
+    int64_t t0 = esp_timer_get_time();
+    uint16_t w = 0, h = 0;
+    if (!jpeg_dc_thumbnail(&thumb_dec, fb->buf, fb->len, scale, NULL, 0, &w, &h) && (w == 0 || h == 0)) {
+        return false;
+    }
+    size_t size = JPEG_DC_THUMB_BUF_SIZE(w, h);
+    uint8_t *rgb = (uint8_t *)malloc(size);
+    if (!rgb) {
+        return false;
+    }
+    bool ok = jpeg_dc_thumbnail(&thumb_dec, fb->buf, fb->len, scale, rgb, size, &w, &h);
+    if (decode_us) {
+        *decode_us = esp_timer_get_time() - t0;
+    }
+    ok = ok && fmt2jpg(rgb, (size_t)w * h * 2, w, h, PIXFORMAT_RGB565, quality, jpg, jpg_len);
+    free(rgb);
+    return ok;
+}
+
+// The path the fast one replaces: decode every pixel, box-filter down, encode.
+static bool thumb_full(camera_fb_t *fb, int scale, int quality, uint8_t **jpg, size_t *jpg_len)
+{
+    size_t fw = fb->width, fh = fb->height;
+    uint8_t *full = (uint8_t *)malloc(fw * fh * 3);
+    if (!full) {
+        return false;
+    }
+    if (!fmt2rgb888(fb->buf, fb->len, fb->format, full)) {
+        free(full);
+        return false;
+    }
+    size_t tw = fw / scale, th = fh / scale;
+    uint8_t *small = (uint8_t *)malloc(tw * th * 3);
+    if (!small) {
+        free(full);
+        return false;
+    }
+    for (size_t y = 0; y < th; y++) {
+        for (size_t x = 0; x < tw; x++) {
+            uint32_t sum[3] = {0, 0, 0};
+            for (int dy = 0; dy < scale; dy++) {
+                const uint8_t *p = full + ((y * scale + dy) * fw + x * scale) * 3;
+                for (int dx = 0; dx < scale * 3; dx++) {
+                    sum[dx % 3] += p[dx];
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                small[(y * tw + x) * 3 + c] = sum[c] / (scale * scale);
+            }
+        }
+    }
+    free(full);
+    bool ok = fmt2jpg(small, tw * th * 3, tw, th, PIXFORMAT_RGB888, quality, jpg, jpg_len);
+    free(small);
+    return ok;
+}
+
+static esp_err_t thumb_bench(httpd_req_t *req, camera_fb_t *fb, int scale, int quality, int runs)
+{
+    int64_t fast_us = 0, fast_max = 0, decode_us = 0, full_us = 0, full_max = 0;
+    size_t fast_len = 0, full_len = 0;
+    int fast_ok = 0, full_ok = 0;
+    for (int i = 0; i < runs; i++) {
+        uint8_t *jpg = NULL;
+        int64_t dec = 0;
+        int64_t t0 = esp_timer_get_time();
+        bool ok = thumb_fast(fb, scale, quality, &jpg, &fast_len, &dec);
+        int64_t dt = esp_timer_get_time() - t0;
+        free(jpg);
+        if (ok) {
+            fast_ok++;
+            fast_us += dt;
+            decode_us += dec;
+            fast_max = dt > fast_max ? dt : fast_max;
+        }
+    }
+    for (int i = 0; i < runs; i++) {
+        uint8_t *jpg = NULL;
+        int64_t t0 = esp_timer_get_time();
+        bool ok = thumb_full(fb, scale, quality, &jpg, &full_len);
+        int64_t dt = esp_timer_get_time() - t0;
+        free(jpg);
+        if (ok) {
+            full_ok++;
+            full_us += dt;
+            full_max = dt > full_max ? dt : full_max;
+        } else {
+            break; // usually no room for the full-size RGB888 buffer; one failure says so
+        }
+    }
+
+    char json[384];
+    int n = snprintf(json, sizeof(json),
+                     "{\"width\":%u,\"height\":%u,\"frame_bytes\":%u,\"scale\":%d,\"runs\":%d,"
+                     "\"dct\":{\"ok\":%d,\"mean_us\":%lld,\"max_us\":%lld,\"decode_us\":%lld,\"bytes\":%u},",
+                     (unsigned)fb->width, (unsigned)fb->height, (unsigned)fb->len, scale, runs, fast_ok,
+                     fast_ok ? (long long)(fast_us / fast_ok) : -1LL, (long long)fast_max,
+                     fast_ok ? (long long)(decode_us / fast_ok) : -1LL, (unsigned)fast_len);
+    snprintf(json + n, sizeof(json) - n, "\"full\":{\"ok\":%d,\"mean_us\":%lld,\"max_us\":%lld,\"bytes\":%u}}",
+             full_ok, full_ok ? (long long)(full_us / full_ok) : -1LL, (long long)full_max, (unsigned)full_len);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return httpd_resp_send(req, json, strlen(json));
+}
+
+static esp_err_t thumb_handler(httpd_req_t *req)
+{
+    int scale = 8, quality = 60, runs = 0;
+    char query[64];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        scale = parse_get_var(query, "scale", 8) == 4 ? 4 : 8;
+        quality = parse_get_var(query, "quality", 60);
+        quality = quality < 10 ? 10 : quality > 95 ? 95 : quality;
+        runs = parse_get_var(query, "bench", 0);
+        runs = runs < 0 ? 0 : runs > 50 ? 50 : runs;
+    }
+
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb) {
+        log_e("Camera capture failed");
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+    if (fb->format != PIXFORMAT_JPEG) {
+        esp_camera_fb_return(fb);
+        httpd_resp_set_status(req, "415 Unsupported Media Type");
+        return httpd_resp_sendstr(req, "thumbnails need a JPEG pixel format");
+    }
+    if (runs > 0) {
+        esp_err_t res = thumb_bench(req, fb, scale, quality, runs);
+        esp_camera_fb_return(fb);
+        return res;
+    }
+
+    char ts[32];
+    snprintf(ts, 32, "%ld.%06ld", fb->timestamp.tv_sec, fb->timestamp.tv_usec);
+    int64_t fr_start = esp_timer_get_time();
+    uint8_t *jpg = NULL;
+    size_t jpg_len = 0;
+    int64_t decode_us = 0;
+    bool ok = thumb_fast(fb, scale, quality, &jpg, &jpg_len, &decode_us);
+    int64_t total_us = esp_timer_get_time() - fr_start;
+    esp_camera_fb_return(fb);
+    if (!ok) {
+        free(jpg);
+        log_e("Thumbnail failed");
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "image/jpeg");
+    httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=thumb.jpg");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "X-Timestamp", (const char *)ts);
+    char timing[48];
+    snprintf(timing, sizeof(timing), "decode=%lld;total=%lld", (long long)decode_us, (long long)total_us);
+    httpd_resp_set_hdr(req, "X-Thumb-Us", timing);
+    esp_err_t res = httpd_resp_send(req, (const char *)jpg, jpg_len);
+    free(jpg);
+    log_i("THUMB 1/%d: %uB %lldus", scale, (unsigned)jpg_len, (long long)total_us);
+    return res;
+}
+
 static esp_err_t index_handler(httpd_req_t *req)
 {
     httpd_resp_set_type(req, "text/html");
@@ -1285,6 +1570,19 @@ void startCameraServer()
 #endif
     };
 
+    httpd_uri_t thumb_uri = {
+        .uri = "/thumb",
+        .method = HTTP_GET,
+        .handler = thumb_handler,
+        .user_ctx = NULL
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+        ,
+        .is_websocket = true,
+        .handle_ws_control_frames = false,
+        .supported_subprotocol = NULL
+#endif
+    };
+
     httpd_uri_t xclk_uri = {
         .uri = "/xclk",
         .method = HTTP_GET,
@@ -1366,6 +1664,7 @@ void startCameraServer()
         httpd_register_uri_handler(camera_httpd, &status_uri);
         httpd_register_uri_handler(camera_httpd, &capture_uri);
         httpd_register_uri_handler(camera_httpd, &bmp_uri);
+        httpd_register_uri_handler(camera_httpd, &thumb_uri);
 
         httpd_register_uri_handler(camera_httpd, &xclk_uri);
         httpd_register_uri_handler(camera_httpd, &reg_uri);
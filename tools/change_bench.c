@@ -0,0 +1,137 @@
+// Replay a corpus of consecutive frames through the firmware's change detector and report the
+// upload bandwidth it would save and what it costs per frame.
+//
+//   cc -O2 -Imain -o change_bench tools/change_bench.c main/change_detect.c main/jpeg_dc.c
+//   ./change_bench [-t 2,5,10,20] [-b 10] corpus/*.jpg
+//
+// Frames are replayed in argument order (shell globs sort by name). Any baseline JPEG works, e.g.
+// frames saved by the collector or written by tools/make_change_corpus.py. Thresholds are in
+// 1/1000 of the scene, as the "chg_pm" setting. Files whose name contains "event" mark frames
+// where something appeared, moved or left; skipping one counts as a miss.
+
+#include "change_detect.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_THRESHOLDS 16
+
+typedef struct {
+    char *name;
+    uint8_t *data;
+    size_t len;
+} frame_t;
+
+static change_detect_t s_cd;
+static jpeg_dc_decoder_t s_dec;
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int load(const char *path, frame_t *f)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    f->data = malloc((size_t)n);
+    f->len = f->data ? fread(f->data, 1, (size_t)n, fp) : 0;
+    fclose(fp);
+    f->name = strdup(path);
+    return f->len == (size_t)n ? 0 : -1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: change_bench [-t permille[,permille...]] [-b heartbeat] [-v] frame.jpg...\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int thresholds[MAX_THRESHOLDS] = {2, 5, 10, 20, 50};
+    int nthresholds = 5;
+    int heartbeat = 10;
+    int verbose = 0;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-t") == 0 && argi + 1 < argc) {
+            nthresholds = 0;
+            for (char *tok = strtok(argv[++argi], ","); tok && nthresholds < MAX_THRESHOLDS; tok = strtok(NULL, ",")) {
+                thresholds[nthresholds++] = atoi(tok);
+            }
+        } else if (strcmp(argv[argi], "-b") == 0 && argi + 1 < argc) {
+            heartbeat = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-v") == 0) {
+            verbose = 1;
+        } else {
+            usage();
+        }
+    }
+    int nframes = argc - argi;
+    if (nframes <= 0) {
+        usage();
+    }
+
+    frame_t *frames = calloc((size_t)nframes, sizeof(frame_t));
+    size_t total_bytes = 0;
+    int total_events = 0;
+    for (int i = 0; i < nframes; i++) {
+        if (load(argv[argi + i], &frames[i]) != 0) {
+            fprintf(stderr, "cannot read %s\n", argv[argi + i]);
+            return 1;
+        }
+        total_bytes += frames[i].len;
+        total_events += strstr(frames[i].name, "event") != NULL;
+    }
+    printf("%d frames, %zu bytes, %d with events, heartbeat every %d\n", nframes, total_bytes, total_events,
+           heartbeat);
+    printf("%9s %6s %7s %10s %11s %8s %7s %13s %12s\n", "threshold", "sent", "skipped", "heartbeats", "bytes sent",
+           "saved", "missed", "mean us/frame", "max us/frame");
+
+    static const char *const verdicts[] = {"changed", "unchanged", "heartbeat", "undecodable"};
+    for (int t = 0; t < nthresholds; t++) {
+        change_detect_init(&s_cd, &s_dec);
+        change_detect_configure(&s_cd, thresholds[t], heartbeat);
+        size_t sent_bytes = 0;
+        int missed = 0;
+        double total_us = 0;
+        double max_us = 0;
+        for (int i = 0; i < nframes; i++) {
+            double t0 = now_us();
+            change_detect_verdict_t v = change_detect_check(&s_cd, frames[i].data, frames[i].len);
+            double dt = now_us() - t0;
+            total_us += dt;
+            max_us = dt > max_us ? dt : max_us;
+            if (v == CHANGE_DETECT_UNCHANGED) {
+                missed += strstr(frames[i].name, "event") != NULL;
+            } else {
+                sent_bytes += frames[i].len;
+            }
+            if (verbose) {
+                printf("  %4d  %-40s %-11s %4d/1000 changed\n", thresholds[t], frames[i].name, verdicts[v],
+                       s_cd.stats.last_changed_permille);
+            }
+        }
+        printf("%9d %6u %7u %10u %11zu %7.1f%% %7d %13.0f %12.0f\n", thresholds[t],
+               (unsigned)(s_cd.stats.changed + s_cd.stats.heartbeats + s_cd.stats.undecodable),
+               (unsigned)s_cd.stats.skipped, (unsigned)s_cd.stats.heartbeats, sent_bytes,
+               100.0 * (double)(total_bytes - sent_bytes) / (double)total_bytes, missed, total_us / nframes, max_us);
+    }
+
+    for (int i = 0; i < nframes; i++) {
+        free(frames[i].name);
+        free(frames[i].data);
+    }
+    free(frames);
+    return 0;
+}
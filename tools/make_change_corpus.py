@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""Write a replayable corpus of camera frames for tools/change_bench.c and tools/quality_bench.c.
+
+The frames model a fixed camera over a field: a static textured scene, per-pixel sensor noise,
+slow lighting drift over the day and a few short events (an animal crossing, a vehicle parking).
+Frames where something appears, moves or leaves are named *_event.jpg, so the benchmark can count
+missed events (a parked vehicle only counts on arrival and departure).
+
+With --defects N, every N-th frame is spoiled in turn by dusk (*_dark.jpg), a blown-out exposure
+(*_bright.jpg) or fog on the lens (*_blurred.jpg), for the quality gate to reject.
+
+With --restart-rows N the entropy-coded data gets a restart marker every N rows of MCUs, the strips
+tools/tile_bench.c splits frames into for differential uploads.
+
+Output is baseline JPEG with 4:2:2 chroma, like the OV2640 produces. The same seed always gives
+the same corpus. Only the standard library is used:
+
+    python3 tools/make_change_corpus.py corpus/ --frames 96
+"""
+
+import argparse
+import math
+import os
+import random
+import struct
+
+ZIGZAG = [
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21,
+    28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61,
+    54, 47, 55, 62, 63,
+]
+
+# ITU T.81 Annex K tables.
+LUMA_Q = [
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51,
+    87, 80, 62, 18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78, 87, 103, 121, 120, 101,
+    72, 92, 95, 98, 112, 100, 103, 99,
+]
+CHROMA_Q = [
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99,
+    99, 99, 99,
+] + [99] * 32
+DC_LUMA = ([0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0], list(range(12)))
+DC_CHROMA = ([0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0], list(range(12)))
+AC_LUMA = ([0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D], bytes.fromhex(
+    '01020300041105122131410613516107227114328191a1082342b1c11552d1f02433627282090a161718191a25262728292a3435363738'
+    '393a434445464748494a535455565758595a636465666768696a737475767778797a838485868788898a92939495969798999aa2a3a4a5'
+    'a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae1e2e3e4e5e6e7e8e9eaf1f2f3f4f5f6f7f8f9fa'))
+AC_CHROMA = ([0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77], bytes.fromhex(
+    '000102031104052131061241510761711322328108144291a1b1c109233352f0156272d10a162434e125f11718191a262728292a3536'
+    '3738393a434445464748494a535455565758595a636465666768696a737475767778797a82838485868788898a9293949596979899'
+    '9aa2a3a4a5a6a7a8a9aab2b3b4b5b6b7b8b9bac2c3c4c5c6c7c8c9cad2d3d4d5d6d7d8d9dae2e3e4e5e6e7e8e9eaf2f3f4f5f6f7f8f9fa'))
+
+COS = [[(math.sqrt(0.5) if u == 0 else 1.0) * math.cos((2 * x + 1) * u * math.pi / 16) / 2 for x in range(8)]
+       for u in range(8)]
+
+
+def scaled_table(base, quality):
+    scale = 5000 // quality if quality < 50 else 200 - 2 * quality
+    return [min(255, max(1, (q * scale + 50) // 100)) for q in base]
+
+
+def huff_codes(table):
+    bits, vals = table
+    codes = {}
+    code = 0
+    k = 0
+    for length in range(1, 17):
+        for _ in range(bits[length - 1]):
+            codes[vals[k]] = (code, length)
+            code += 1
+            k += 1
+        code <<= 1
+    return codes
+
+
+class BitWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.n = 0
+
+    def put(self, value, length):
+        self.acc = (self.acc << length) | (value & ((1 << length) - 1))
+        self.n += length
+        while self.n >= 8:
+            self.n -= 8
+            byte = (self.acc >> self.n) & 0xFF
+            self.out.append(byte)
+            if byte == 0xFF:
+                self.out.append(0)
+        self.acc &= (1 << self.n) - 1
+
+    def flush(self):
+        if self.n:
+            self.put((1 << (8 - self.n)) - 1, 8 - self.n)
+
+
+def magnitude(v):
+    a = abs(v)
+    size = a.bit_length()
+    return size, (v if v >= 0 else v + (1 << size) - 1)
+
+
+def encode_block(bw, block, qtable, dc_codes, ac_codes, pred):
+    tmp = [[sum(COS[u][x] * row[x] for x in range(8)) for u in range(8)] for row in block]
+    coef = [0] * 64
+    for v in range(8):
+        cv = COS[v]
+        for u in range(8):
+            coef[v * 8 + u] = sum(cv[y] * tmp[y][u] for y in range(8))
+    q = [int(round(coef[ZIGZAG[i]] / qtable[i])) for i in range(64)]
+
+    size, bits = magnitude(q[0] - pred)
+    bw.put(*dc_codes[size])
+    if size:
+        bw.put(bits, size)
+    run = 0
+    for i in range(1, 64):
+        if q[i] == 0:
+            run += 1
+            continue
+        while run > 15:
+            bw.put(*ac_codes[0xF0])
+            run -= 16
+        size, bits = magnitude(q[i])
+        bw.put(*ac_codes[(run << 4) | size])
+        bw.put(bits, size)
+        run = 0
+    if run:
+        bw.put(*ac_codes[0x00])
+    return q[0]
+
+
+def encode_jpeg(y_plane, cb_plane, cr_plane, width, height, quality, restart_rows=0):
+    qy = scaled_table(LUMA_Q, quality)
+    qc = scaled_table(CHROMA_Q, quality)
+    # Tables are given in natural order above; store and apply them in zigzag order.
+    qy_zz = [qy[ZIGZAG[i]] for i in range(64)]
+    qc_zz = [qc[ZIGZAG[i]] for i in range(64)]
+    codes = [huff_codes(t) for t in (DC_LUMA, AC_LUMA, DC_CHROMA, AC_CHROMA)]
+
+    def block_at(plane, pw, ph, bx, by):
+        return [[plane[min(by + j, ph - 1)][min(bx + i, pw - 1)] - 128 for i in range(8)] for j in range(8)]
+
+    bw = BitWriter()
+    preds = [0, 0, 0]
+    cw = (width + 1) // 2
+    for row, my in enumerate(range(0, height, 8)):
+        if restart_rows and row and row % restart_rows == 0:
+            bw.flush()
+            bw.out += bytes([0xFF, 0xD0 + (row // restart_rows - 1) % 8])
+            preds = [0, 0, 0]
+        for mx in range(0, width, 16):
+            for dx in (0, 8):
+                preds[0] = encode_block(bw, block_at(y_plane, width, height, mx + dx, my), qy_zz, codes[0], codes[1],
+                                        preds[0])
+            for c, plane in ((1, cb_plane), (2, cr_plane)):
+                preds[c] = encode_block(bw, block_at(plane, cw, height, mx // 2, my), qc_zz, codes[2], codes[3],
+                                        preds[c])
+    bw.flush()
+
+    def segment(marker, payload):
+        return struct.pack('>BBH', 0xFF, marker, len(payload) + 2) + payload
+
+    out = bytearray(b'\xff\xd8')
+    out += segment(0xE0, b'JFIF\x00\x01\x01\x00\x00\x01\x00\x01\x00\x00')
+    out += segment(0xDB, bytes([0]) + bytes(qy_zz) + bytes([1]) + bytes(qc_zz))
+    out += segment(0xC0, struct.pack('>BHHB', 8, height, width, 3) + bytes([1, 0x21, 0, 2, 0x11, 1, 3, 0x11, 1]))
+    for cls_id, (bits, vals) in ((0x00, DC_LUMA), (0x10, AC_LUMA), (0x01, DC_CHROMA), (0x11, AC_CHROMA)):
+        out += segment(0xC4, bytes([cls_id]) + bytes(bits) + bytes(vals))
+    if restart_rows:
+        out += segment(0xDD, struct.pack('>H', restart_rows * ((width + 15) // 16)))
+    out += segment(0xDA, bytes([3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0]))
+    out += bw.out
+    out += b'\xff\xd9'
+    return bytes(out)
+
+
+def base_scene(width, height, rng):
+    """Luma of the empty scene: sky above a horizon, crop rows with some texture below."""
+    horizon = height // 3
+    blobs = [(rng.uniform(0, width), rng.uniform(horizon, height), rng.uniform(4, 14), rng.uniform(-25, 25))
+             for _ in range(60)]
+    scene = []
+    for y in range(height):
+        row = []
+        for x in range(width):
+            if y < horizon:
+                v = 200 - 40 * y / horizon
+            else:
+                depth = (y - horizon) / (height - horizon)
+                v = 90 + 30 * math.sin(x / (3 + 10 * depth) + 8 * depth) * depth + 20 * math.sin(y / 2.5)
+            row.append(v)
+        scene.append(row)
+    for bx, by, r, dv in blobs:
+        for y in range(max(horizon, int(by - r)), min(height, int(by + r) + 1)):
+            for x in range(max(0, int(bx - r)), min(width, int(bx + r) + 1)):
+                if (x - bx) ** 2 + (y - by) ** 2 <= r * r:
+                    scene[y][x] += dv
+    return scene
+
+
+def events(frames):
+    """(first frame, last frame, kind) of what crosses the view."""
+    return [(frames * 20 // 96, frames * 24 // 96, 'animal'), (frames * 55 // 96, frames * 66 // 96, 'vehicle'),
+            (frames * 80 // 96, frames * 81 // 96, 'animal')]
+
+
+def draw_event(y_plane, width, height, kind, progress):
+    if kind == 'animal':
+        cx, cy, rx, ry, v = width * (0.1 + 0.8 * progress), height * 0.7, width / 14, height / 18, 40
+    else:
+        cx, cy, rx, ry, v = width * 0.65, height * 0.55, width / 6, height / 10, 230
+    for y in range(max(0, int(cy - ry)), min(height, int(cy + ry) + 1)):
+        for x in range(max(0, int(cx - rx)), min(width, int(cx + rx) + 1)):
+            if ((x - cx) / rx) ** 2 + ((y - cy) / ry) ** 2 <= 1:
+                y_plane[y][x] = v
+
+
+def box_blur(y_plane, width, height, radius):
+    """Separable box blur, roughly what fog or a lost focus does to the scene."""
+    def blur_line(line, n):
+        out = []
+        for i in range(n):
+            lo, hi = max(0, i - radius), min(n, i + radius + 1)
+            out.append(sum(line[lo:hi]) / (hi - lo))
+        return out
+    rows = [blur_line(row, width) for row in y_plane]
+    cols = [blur_line([rows[y][x] for y in range(height)], height) for x in range(width)]
+    return [[int(cols[x][y]) for x in range(width)] for y in range(height)]
+
+
+def spoil(y_plane, width, height, kind):
+    if kind == 'dark':
+        return [[int(v * 0.15) for v in row] for row in y_plane]
+    if kind == 'bright':
+        return [[min(255, int(v * 2.2 + 40)) for v in row] for row in y_plane]
+    return box_blur(y_plane, width, height, max(2, width // 40))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('out_dir')
+    parser.add_argument('--frames', type=int, default=96, help='frames, one per capture interval')
+    parser.add_argument('--width', type=int, default=320)
+    parser.add_argument('--height', type=int, default=240)
+    parser.add_argument('--quality', type=int, default=80, help='IJG quality (camera jpeg_quality 12 is about 80)')
+    parser.add_argument('--noise', type=float, default=3.0, help='sensor noise, luma levels (std dev)')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--defects', type=int, default=0, help='spoil every N-th frame (dark, bright, blurred); 0 = none')
+    parser.add_argument('--restart-rows', type=int, default=0, help='restart marker every N MCU rows; 0 = none')
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    os.makedirs(args.out_dir, exist_ok=True)
+    scene = base_scene(args.width, args.height, rng)
+    cw = (args.width + 1) // 2
+    cb = [[110] * cw for _ in range(args.height)]
+    cr = [[120] * cw for _ in range(args.height)]
+    spans = events(args.frames)
+
+    for n in range(args.frames):
+        # A day: light ramps up and back down; slow enough that only the drift adds up.
+        light = 0.75 + 0.25 * math.sin(math.pi * n / max(1, args.frames - 1))
+        y_plane = [[min(255, max(0, int(v * light + rng.gauss(0, args.noise)))) for v in row] for row in scene]
+        tag = ''
+        for first, last, kind in spans:
+            if first <= n <= last:
+                draw_event(y_plane, args.width, args.height, kind, (n - first) / max(1, last - first))
+            # Something moving is news on every frame; something parked only when it comes and goes.
+            if (kind == 'animal' and first <= n <= last) or n in (first, last + 1):
+                tag = '_event'
+        if args.defects > 0 and n % args.defects == args.defects - 1:
+            kind = ('dark', 'bright', 'blurred')[(n // args.defects) % 3]
+            y_plane = spoil(y_plane, args.width, args.height, kind)
+            tag += '_' + kind
+        data = encode_jpeg(y_plane, cb, cr, args.width, args.height, args.quality, args.restart_rows)
+        with open(os.path.join(args.out_dir, f'frame_{n:04d}{tag}.jpg'), 'wb') as f:
+            f.write(data)
+        print(f'\r{n + 1}/{args.frames}', end='', flush=True)
+    print()
+
+
+if __name__ == '__main__':
+    main()
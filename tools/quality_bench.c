@@ -0,0 +1,151 @@
+// Run a set of frames through the firmware's quality gate and report what it rejects and what the
+// scoring costs per frame.
+//
+//   cc -O2 -Imain -o quality_bench tools/quality_bench.c main/frame_quality.c main/jpeg_dc.c
+//   ./quality_bench [-l min_luma] [-c max_clip_permille] [-s min_sharpness] [-r rounds] [-v] frame.jpg...
+//
+// Thresholds default to the firmware's suggested values (see the web UI). Any baseline JPEG works,
+// e.g. frames written by `tools/make_change_corpus.py --defects 4`, whose spoiled frames are named
+// *_dark.jpg, *_bright.jpg and *_blurred.jpg: rejecting one of those counts as a hit, passing it as
+// a miss, and rejecting any other frame as a false reject. Compare the time per frame with the
+// sensor frame time (tens of ms at QVGA/VGA) after allowing for the slower target CPU.
+
+#include "frame_quality.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    char *name;
+    uint8_t *data;
+    size_t len;
+} frame_t;
+
+static frame_quality_t s_fq;
+static jpeg_dc_decoder_t s_dec;
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int load(const char *path, frame_t *f)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    f->data = malloc((size_t)n);
+    f->len = f->data ? fread(f->data, 1, (size_t)n, fp) : 0;
+    fclose(fp);
+    f->name = strdup(path);
+    return f->len == (size_t)n ? 0 : -1;
+}
+
+static int spoiled(const char *name)
+{
+    return strstr(name, "_dark") || strstr(name, "_bright") || strstr(name, "_blurred");
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: quality_bench [-l min_luma] [-c max_clip_permille] [-s min_sharpness] [-r rounds] [-v] "
+                    "frame.jpg...\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int min_luma = 40;
+    int max_clip = 250;
+    int min_sharpness = 150;
+    int rounds = 20;
+    int verbose = 0;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-l") == 0 && argi + 1 < argc) {
+            min_luma = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-c") == 0 && argi + 1 < argc) {
+            max_clip = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-s") == 0 && argi + 1 < argc) {
+            min_sharpness = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-r") == 0 && argi + 1 < argc) {
+            rounds = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-v") == 0) {
+            verbose = 1;
+        } else {
+            usage();
+        }
+    }
+    int nframes = argc - argi;
+    if (nframes <= 0 || rounds < 1) {
+        usage();
+    }
+
+    frame_t *frames = calloc((size_t)nframes, sizeof(frame_t));
+    int total_spoiled = 0;
+    for (int i = 0; i < nframes; i++) {
+        if (load(argv[argi + i], &frames[i]) != 0) {
+            fprintf(stderr, "cannot read %s\n", argv[argi + i]);
+            return 1;
+        }
+        total_spoiled += spoiled(frames[i].name);
+    }
+    printf("%d frames, %d spoiled; min luma %d, max clipped %d/1000, min sharpness %d\n", nframes, total_spoiled,
+           min_luma, max_clip, min_sharpness);
+
+    frame_quality_init(&s_fq, &s_dec);
+    frame_quality_configure(&s_fq, min_luma, max_clip, min_sharpness);
+    int hits = 0;
+    int misses = 0;
+    int false_rejects = 0;
+    for (int i = 0; i < nframes; i++) {
+        frame_quality_result_t r;
+        frame_quality_verdict_t v = frame_quality_check(&s_fq, frames[i].data, frames[i].len, &r);
+        int rejected = v != FRAME_QUALITY_OK && v != FRAME_QUALITY_UNDECODABLE;
+        if (spoiled(frames[i].name)) {
+            hits += rejected;
+            misses += !rejected;
+        } else {
+            false_rejects += rejected;
+        }
+        if (verbose) {
+            char text[FRAME_QUALITY_TEXT_MAX];
+            frame_quality_format(&r, text, sizeof(text));
+            printf("  %-40s %-11s %s\n", frames[i].name, frame_quality_verdict_name(v), text);
+        }
+    }
+    printf("rejected: %u dark, %u overexposed, %u blurred, %u undecodable\n", (unsigned)s_fq.stats.dark,
+           (unsigned)s_fq.stats.overexposed, (unsigned)s_fq.stats.blurred, (unsigned)s_fq.stats.undecodable);
+    printf("spoiled frames caught %d, missed %d; good frames rejected %d\n", hits, misses, false_rejects);
+
+    // Timing over repeated passes, so short corpora still give stable numbers.
+    double total_us = 0;
+    double max_us = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < nframes; i++) {
+            double t0 = now_us();
+            (void)frame_quality_check(&s_fq, frames[i].data, frames[i].len, NULL);
+            double dt = now_us() - t0;
+            total_us += dt;
+            max_us = dt > max_us ? dt : max_us;
+        }
+    }
+    printf("%ux%u analysed per frame, mean %.0f us, max %.0f us\n", (unsigned)s_fq.last.width,
+           (unsigned)s_fq.last.height, total_us / ((double)nframes * rounds), max_us);
+
+    frame_quality_free(&s_fq);
+    for (int i = 0; i < nframes; i++) {
+        free(frames[i].name);
+        free(frames[i].data);
+    }
+    free(frames);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+"""Collector load for a fleet of uploaders that all boot at the same moment.
+
+Models devices that power up together (e.g. after a power cut), join WiFi within a few seconds of
+each other and then capture + upload every `--interval` seconds. Prints the peak and p99 number of
+uploads in flight at the collector for:
+
+  lockstep   every device starts its grid on boot (phase 0, no jitter): the old behaviour
+  mac        phase derived from the station MAC, as capture_phase_us() in main/cam_uploader.c
+  mac+jitter the same plus a random per-capture delay of up to --jitter-ms
+  assigned   phases handed out evenly by the collector (X-Capture-Phase-Ms)
+
+Only the standard library is used:  python3 tools/stagger_sim.py --devices 500
+"""
+
+import argparse
+import heapq
+import random
+
+
+def fnv1a_fmix32(data):
+    """Same hash as capture_phase_us(): FNV-1a followed by the murmur3 finalizer."""
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & 0xFFFFFFFF
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & 0xFFFFFFFF
+    h ^= h >> 16
+    return h
+
+
+def mac_phase_us(mac, period_us):
+    return (fnv1a_fmix32(mac) * period_us) >> 32
+
+
+def fleet_macs(count, rng):
+    # One production batch: shared OUI, mostly consecutive NIC parts.
+    base = rng.randrange(0, 1 << 24)
+    return [bytes([0x24, 0x0A, 0xC4]) + ((base + i) & 0xFFFFFF).to_bytes(3, 'big') for i in range(count)]
+
+
+def upload_intervals(starts_us, rng, median_ms, sigma):
+    for start in starts_us:
+        duration = int(rng.lognormvariate(0.0, sigma) * median_ms * 1000)
+        yield start, start + duration
+
+
+def concurrency(intervals):
+    """Peak and p99 of uploads in flight, sampled at every upload start."""
+    events = []
+    for start, end in intervals:
+        events.append((start, 1))
+        events.append((end, -1))
+    events.sort(key=lambda e: (e[0], e[1]))  # ends before starts at the same instant
+    level = 0
+    samples = []
+    for _, delta in events:
+        level += delta
+        if delta > 0:
+            samples.append(level)
+    samples.sort()
+    peak = samples[-1] if samples else 0
+    p99 = samples[int(len(samples) * 0.99)] if samples else 0
+    return peak, p99
+
+
+def simulate(mode, args, rng):
+    period_us = args.interval * 1000000
+    jitter_us = min(args.jitter_ms * 1000, period_us // 2) if mode == 'mac+jitter' else 0
+    macs = fleet_macs(args.devices, rng)
+    starts = []
+    for i, mac in enumerate(macs):
+        boot_us = int(rng.uniform(0, args.boot_spread_ms * 1000))
+        if mode == 'lockstep':
+            phase_us = 0
+        elif mode == 'assigned':
+            phase_us = i * period_us // args.devices
+        else:
+            phase_us = mac_phase_us(mac, period_us)
+        # Same as capture_sched_start() without wall-clock alignment: slot 0 at boot + phase.
+        t0 = boot_us + phase_us
+        for k in range(args.cycles):
+            starts.append(t0 + k * period_us + (rng.randint(0, jitter_us) if jitter_us else 0))
+    return concurrency(upload_intervals(starts, rng, args.upload_ms, args.upload_sigma))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--devices', type=int, default=500)
+    parser.add_argument('--interval', type=int, default=60, help='capture interval (s)')
+    parser.add_argument('--cycles', type=int, default=60, help='capture cycles per device')
+    parser.add_argument('--boot-spread-ms', type=int, default=3000, help='spread of WiFi join times after boot')
+    parser.add_argument('--upload-ms', type=float, default=800.0, help='median upload duration')
+    parser.add_argument('--upload-sigma', type=float, default=0.5, help='log-normal shape of upload durations')
+    parser.add_argument('--jitter-ms', type=int, default=2000, help='random per-capture delay bound')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    print(f'{args.devices} devices, {args.interval} s interval, {args.cycles} cycles, '
+          f'median upload {args.upload_ms:.0f} ms')
+    print(f'{"mode":<12}{"peak":>8}{"p99":>8}')
+    for mode in ('lockstep', 'mac', 'mac+jitter', 'assigned'):
+        peak, p99 = simulate(mode, args, random.Random(args.seed))
+        print(f'{mode:<12}{peak:>8}{p99:>8}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,415 @@
+// Run a recorded sequence of frames through the firmware's tile-level differential encoder, rebuild
+// every delta the way the collector does and report the bytes saved.
+//
+//   cc -O2 -Imain -o tile_bench tools/tile_bench.c main/tile_diff.c main/jpeg_dc.c
+//   ./tile_bench [-k keyframe_every] [-o out_dir] [-v] frame.jpg...
+//
+// Frames need restart markers to split, e.g. `tools/make_change_corpus.py --restart-rows 1`; others
+// are counted as unsplittable and sent whole. Each delta is rebuilt from its keyframe (looked up by
+// SHA-256, as the collector indexes uploads by X-Frame-SHA256) with a reassembler written
+// independently of main/tile_diff.c, checked against the digest it carries and against the JPEG the
+// encoder meant (keyframe header and strips with the changed ones replaced), byte for byte, and
+// decoded. Strips judged unchanged stay as they were in the keyframe, so the rebuilt frame differs
+// from the captured one there; the mean and worst luma error (1/8 scale, DC terms) measure by how much.
+//
+// With -o the uploads are written to out_dir in order, keyframes as NNNN.jpg and deltas as NNNN.jtd,
+// for tools/tile_reassemble.py.
+
+#include "tile_diff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    char *name;
+    uint8_t *data;
+    size_t len;
+    uint8_t sha[32];
+} frame_t;
+
+static tile_diff_t s_td;
+static jpeg_dc_decoder_t s_dec;
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int load(const char *path, frame_t *f)
+{
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    f->data = malloc((size_t)n);
+    f->len = f->data ? fread(f->data, 1, (size_t)n, fp) : 0;
+    fclose(fp);
+    f->name = strdup(path);
+    return f->len == (size_t)n ? 0 : -1;
+}
+
+// SHA-256 (FIPS 180-4), the firmware's keyframe key; mbedtls is not needed for one hash per frame.
+static uint32_t ror(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256(const uint8_t *data, size_t len, uint8_t out[32])
+{
+    static const uint32_t k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    size_t blocks = (len + 9 + 63) / 64;
+    for (size_t b = 0; b < blocks; b++) {
+        uint8_t chunk[64];
+        for (int i = 0; i < 64; i++) {
+            size_t pos = b * 64 + (size_t)i;
+            if (pos < len) {
+                chunk[i] = data[pos];
+            } else if (pos == len) {
+                chunk[i] = 0x80;
+            } else if (b == blocks - 1 && i >= 56) {
+                chunk[i] = (uint8_t)(((uint64_t)len * 8) >> (8 * (63 - i)));
+            } else {
+                chunk[i] = 0;
+            }
+        }
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)chunk[4 * i] << 24 | (uint32_t)chunk[4 * i + 1] << 16 | (uint32_t)chunk[4 * i + 2] << 8 |
+                   chunk[4 * i + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a[8];
+        memcpy(a, h, sizeof(a));
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = a[7] + (ror(a[4], 6) ^ ror(a[4], 11) ^ ror(a[4], 25)) + ((a[4] & a[5]) ^ (~a[4] & a[6])) +
+                          k[i] + w[i];
+            uint32_t t2 = (ror(a[0], 2) ^ ror(a[0], 13) ^ ror(a[0], 22)) + ((a[0] & a[1]) ^ (a[0] & a[2]) ^ (a[1] & a[2]));
+            memmove(a + 1, a, 7 * sizeof(a[0]));
+            a[4] += t1;
+            a[0] = t1 + t2;
+        }
+        for (int i = 0; i < 8; i++) {
+            h[i] += a[i];
+        }
+    }
+    for (int i = 0; i < 8; i++) {
+        out[4 * i] = (uint8_t)(h[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(h[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(h[i] >> 8);
+        out[4 * i + 3] = (uint8_t)h[i];
+    }
+}
+
+// The collector's view of a JPEG: bytes through the SOS segment, then strips between RSTn markers.
+typedef struct {
+    size_t header_len;
+    int strips;
+    size_t off[TILE_DIFF_MAX_STRIPS];
+    size_t len[TILE_DIFF_MAX_STRIPS];
+} split_t;
+
+static int split(const uint8_t *jpg, size_t len, split_t *s)
+{
+    size_t pos = 2;
+    s->header_len = 0;
+    while (pos + 4 <= len && jpg[pos] == 0xFF) {
+        size_t seglen = (size_t)(jpg[pos + 2] << 8 | jpg[pos + 3]);
+        pos += 2 + seglen;
+        if (jpg[pos - seglen - 1] == 0xDA) {
+            s->header_len = pos;
+            break;
+        }
+    }
+    if (s->header_len == 0) {
+        return -1;
+    }
+    s->strips = 0;
+    size_t start = pos;
+    for (; pos + 1 < len; pos++) {
+        if (jpg[pos] == 0xFF && jpg[pos + 1] != 0x00) {
+            if (s->strips == TILE_DIFF_MAX_STRIPS) {
+                return -1;
+            }
+            s->off[s->strips] = start;
+            s->len[s->strips] = pos - start;
+            s->strips++;
+            if (jpg[pos + 1] == 0xD9) {
+                return 0;
+            }
+            start = pos + 2;
+            pos++;
+        } else if (jpg[pos] == 0xFF) {
+            pos++;
+        }
+    }
+    return -1;
+}
+
+static uint32_t get_le(const uint8_t *p, int bytes)
+{
+    uint32_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+static uint64_t fnv(uint64_t h, const uint8_t *p, size_t n)
+{
+    while (n--) {
+        h = (h ^ *p++) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Append a strip and its RST marker (EOI after the last), keeping the digest of the strip hashes.
+static size_t put_strip(uint8_t *out, size_t n, const uint8_t *strip, size_t len, int i, int strips, uint64_t *digest)
+{
+    memcpy(out + n, strip, len);
+    uint64_t h = fnv(0xcbf29ce484222325ULL, strip, len);
+    uint8_t le[8];
+    for (int b = 0; b < 8; b++) {
+        le[b] = (uint8_t)(h >> (8 * b));
+    }
+    *digest = fnv(*digest, le, 8);
+    n += len;
+    out[n++] = 0xFF;
+    out[n++] = i + 1 < strips ? (uint8_t)(0xD0 + i % 8) : 0xD9;
+    return n;
+}
+
+// Rebuild a delta against `key`. Returns the JPEG length, 0 on a malformed delta or digest mismatch.
+static size_t reassemble(const uint8_t *delta, size_t len, const frame_t *key, uint8_t *out)
+{
+    split_t ks;
+    if (len < TILE_DIFF_HEADER_LEN || memcmp(delta, TILE_DIFF_MAGIC, 4) != 0 || split(key->data, key->len, &ks) != 0) {
+        return 0;
+    }
+    int strips = (int)get_le(delta + 4, 2);
+    int changed = (int)get_le(delta + 6, 2);
+    uint64_t digest = (uint64_t)get_le(delta + 44, 4) << 32 | get_le(delta + 40, 4);
+    const uint8_t *map = delta + TILE_DIFF_HEADER_LEN;
+    const uint8_t *lens = map + (strips + 7) / 8;
+    const uint8_t *data = lens + 4 * changed;
+    if (strips != ks.strips || data > delta + len) {
+        return 0;
+    }
+    memcpy(out, key->data, ks.header_len);
+    size_t n = ks.header_len;
+    uint64_t got = 0xcbf29ce484222325ULL;
+    int c = 0;
+    for (int i = 0; i < strips; i++) {
+        if (map[i / 8] >> (i % 8) & 1) {
+            if (c == changed) {
+                return 0;
+            }
+            size_t sl = get_le(lens + 4 * c++, 4);
+            if (data + sl > delta + len) {
+                return 0;
+            }
+            n = put_strip(out, n, data, sl, i, strips, &got);
+            data += sl;
+        } else {
+            n = put_strip(out, n, key->data + ks.off[i], ks.len[i], i, strips, &got);
+        }
+    }
+    return c == changed && data == delta + len && got == digest ? n : 0;
+}
+
+static void write_file(const char *dir, int seq, const char *ext, const uint8_t *data, size_t len)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%04d.%s", dir, seq, ext);
+    FILE *fp = fopen(path, "wb");
+    if (!fp || fwrite(data, 1, len, fp) != len) {
+        fprintf(stderr, "cannot write %s\n", path);
+        exit(1);
+    }
+    fclose(fp);
+}
+
+static int luma(const uint8_t *jpg, size_t len, uint8_t **img, uint16_t *w, uint16_t *h)
+{
+    jpeg_dc_luma_image(&s_dec, jpg, len, NULL, 0, w, h);
+    *img = malloc((size_t)*w * *h);
+    return *img && jpeg_dc_luma_image(&s_dec, jpg, len, *img, (size_t)*w * *h, w, h) ? 0 : -1;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: tile_bench [-k keyframe_every] [-o out_dir] [-v] frame.jpg...\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int every = 10;
+    const char *out_dir = NULL;
+    int verbose = 0;
+    int argi = 1;
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (strcmp(argv[argi], "-k") == 0 && argi + 1 < argc) {
+            every = atoi(argv[++argi]);
+        } else if (strcmp(argv[argi], "-o") == 0 && argi + 1 < argc) {
+            out_dir = argv[++argi];
+        } else if (strcmp(argv[argi], "-v") == 0) {
+            verbose = 1;
+        } else {
+            usage();
+        }
+    }
+    int nframes = argc - argi;
+    if (nframes <= 0 || every < 1) {
+        usage();
+    }
+
+    frame_t *frames = calloc((size_t)nframes, sizeof(frame_t));
+    size_t max_len = 0;
+    for (int i = 0; i < nframes; i++) {
+        if (load(argv[argi + i], &frames[i]) != 0) {
+            fprintf(stderr, "cannot read %s\n", argv[argi + i]);
+            return 1;
+        }
+        sha256(frames[i].data, frames[i].len, frames[i].sha);
+        max_len = frames[i].len > max_len ? frames[i].len : max_len;
+    }
+    printf("%d frames, keyframe every %d\n", nframes, every);
+
+    tile_diff_init(&s_td, &s_dec); // the reference decode below shares the scratch
+    tile_diff_configure(&s_td, every);
+    // A rebuilt frame is at most the keyframe's header plus every strip of the delta and the keyframe.
+    uint8_t *delta = malloc(2 * max_len + TILE_DIFF_HEADER_LEN + 4 * TILE_DIFF_MAX_STRIPS);
+    uint8_t *rebuilt = malloc(2 * max_len + 4 * TILE_DIFF_MAX_STRIPS);
+    uint8_t *expected = malloc(2 * max_len + 4 * TILE_DIFF_MAX_STRIPS);
+    int *keyframes = calloc((size_t)nframes, sizeof(int)); // collector's store: frame indexes by arrival
+    int nkeys = 0;
+    int failures = 0;
+    double encode_us = 0;
+    double err_sum = 0;
+    int err_max = 0;
+    long err_pixels = 0;
+    uint64_t changed_strips = 0;
+    for (int i = 0; i < nframes; i++) {
+        const frame_t *f = &frames[i];
+        double t0 = now_us();
+        tile_diff_kind_t kind = tile_diff_classify(&s_td, f->data, f->len, f->sha);
+        size_t dlen = 0;
+        if (kind == TILE_DIFF_DELTA) {
+            dlen = tile_diff_delta_len(&s_td);
+            tile_diff_write_delta(&s_td, f->data, f->len, delta);
+        }
+        encode_us += now_us() - t0;
+
+        if (kind != TILE_DIFF_DELTA) {
+            if (kind == TILE_DIFF_KEYFRAME) {
+                keyframes[nkeys++] = i;
+            }
+            if (out_dir) {
+                write_file(out_dir, i, "jpg", f->data, f->len);
+            }
+            if (verbose) {
+                printf("  %-40s %s %zu bytes\n", f->name, kind == TILE_DIFF_KEYFRAME ? "keyframe    " : "unsplittable",
+                       f->len);
+            }
+            continue;
+        }
+        if (out_dir) {
+            write_file(out_dir, i, "jtd", delta, dlen);
+        }
+        changed_strips += s_td.stats.changed_last;
+
+        // Look the keyframe up by the key the delta names, then rebuild.
+        const frame_t *key = NULL;
+        for (int k = nkeys - 1; k >= 0 && !key; k--) {
+            if (memcmp(frames[keyframes[k]].sha, delta + 8, 32) == 0) {
+                key = &frames[keyframes[k]];
+            }
+        }
+        size_t n = key ? reassemble(delta, dlen, key, rebuilt) : 0;
+
+        // What the encoder meant: keyframe header and strips, the changed ones taken from this frame.
+        split_t ks;
+        split_t fs;
+        int ok = n > 0 && split(key->data, key->len, &ks) == 0 && split(f->data, f->len, &fs) == 0 &&
+                 ks.strips == fs.strips;
+        size_t m = 0;
+        if (ok) {
+            uint64_t unused = 0;
+            memcpy(expected, key->data, ks.header_len);
+            m = ks.header_len;
+            for (int s = 0; s < fs.strips; s++) {
+                int c = delta[TILE_DIFF_HEADER_LEN + s / 8] >> (s % 8) & 1;
+                m = c ? put_strip(expected, m, f->data + fs.off[s], fs.len[s], s, fs.strips, &unused)
+                      : put_strip(expected, m, key->data + ks.off[s], ks.len[s], s, ks.strips, &unused);
+            }
+            ok = m == n && memcmp(expected, rebuilt, n) == 0;
+        }
+        uint8_t *got_img = NULL;
+        uint8_t *true_img = NULL;
+        uint16_t gw = 0, gh = 0, tw = 0, th = 0;
+        ok = ok && luma(rebuilt, n, &got_img, &gw, &gh) == 0 && luma(f->data, f->len, &true_img, &tw, &th) == 0 &&
+             gw == tw && gh == th;
+        int frame_max = 0;
+        if (ok) {
+            for (long p = 0; p < (long)gw * gh; p++) {
+                int d = abs((int)got_img[p] - (int)true_img[p]);
+                err_sum += d;
+                frame_max = d > frame_max ? d : frame_max;
+            }
+            err_pixels += (long)gw * gh;
+            err_max = frame_max > err_max ? frame_max : err_max;
+        } else {
+            failures++;
+        }
+        free(got_img);
+        free(true_img);
+        if (verbose) {
+            printf("  %-40s delta        %zu of %zu bytes, %u/%u strips, max luma error %d%s\n", f->name, dlen, f->len,
+                   (unsigned)s_td.stats.changed_last, (unsigned)s_td.stats.strips_last, frame_max,
+                   ok ? "" : "  REBUILD FAILED");
+        }
+    }
+
+    const tile_diff_stats_t *st = &s_td.stats;
+    printf("%u keyframes, %u deltas, %u unsplittable; %.1f of %u strips changed per delta\n", (unsigned)st->keyframes,
+           (unsigned)st->deltas, (unsigned)st->unsplittable,
+           st->deltas ? (double)changed_strips / st->deltas : 0.0, (unsigned)st->strips_last);
+    printf("bytes: %llu captured, %llu sent, %.1f%% saved\n", (unsigned long long)st->bytes_full,
+           (unsigned long long)st->bytes_sent,
+           st->bytes_full ? 100.0 * (double)(st->bytes_full - st->bytes_sent) / (double)st->bytes_full : 0.0);
+    printf("rebuilt %u deltas bit-exact, %d failed; luma error vs captured frame mean %.2f, max %d\n",
+           (unsigned)st->deltas - (unsigned)failures, failures, err_pixels ? err_sum / (double)err_pixels : 0.0, err_max);
+    printf("encode per frame mean %.0f us\n", encode_us / nframes);
+
+    tile_diff_free(&s_td);
+    free(delta);
+    free(rebuilt);
+    free(expected);
+    free(keyframes);
+    for (int i = 0; i < nframes; i++) {
+        free(frames[i].name);
+        free(frames[i].data);
+    }
+    free(frames);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Rebuild JPEGs from tile-level differential uploads, as a collector would.
+
+A device with tile_keyframe_every set uploads a keyframe (an ordinary JPEG, with X-Frame-SHA256)
+and then deltas (Content-Type application/x-jpeg-tile-delta) that name their keyframe by that
+SHA-256 and carry only the restart-interval strips that changed. The format is documented in
+main/tile_diff.h. This reads uploads in name order from a directory, e.g. the output of
+`tile_bench -o`, keeps every *.jpg as a possible keyframe, rebuilds each *.jtd into a .jpg in the
+output directory and checks the digest the device computed over the frame it meant.
+
+Only the standard library is used:
+
+    python3 tools/tile_reassemble.py uploads/ rebuilt/
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+MAGIC = b'JTD1'
+HEADER = struct.Struct('<4sHH32sQ')
+FNV_INIT = 0xcbf29ce484222325
+FNV_PRIME = 0x100000001b3
+
+
+def fnv64(data, h=FNV_INIT):
+    for b in data:
+        h = ((h ^ b) * FNV_PRIME) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def split(jpg):
+    """Header bytes through the SOS segment and the entropy-coded strips between RSTn markers."""
+    pos = 2
+    while pos + 4 <= len(jpg) and jpg[pos] == 0xFF:
+        marker = jpg[pos + 1]
+        pos += 2 + struct.unpack('>H', jpg[pos + 2:pos + 4])[0]
+        if marker == 0xDA:
+            break
+    else:
+        raise ValueError('no scan')
+    header, strips, start = jpg[:pos], [], pos
+    while pos + 1 < len(jpg):
+        if jpg[pos] == 0xFF and jpg[pos + 1] != 0x00:
+            strips.append(jpg[start:pos])
+            if jpg[pos + 1] == 0xD9:
+                return header, strips
+            start = pos + 2
+        pos += 2 if jpg[pos] == 0xFF else 1
+    raise ValueError('no EOI')
+
+
+def rebuild(delta, keyframes):
+    magic, count, changed, key, digest = HEADER.unpack_from(delta)
+    if magic != MAGIC:
+        raise ValueError('not a tile delta')
+    if key not in keyframes:
+        raise ValueError('keyframe %s not received' % key.hex()[:16])
+    header, strips = split(keyframes[key])
+    if len(strips) != count:
+        raise ValueError('keyframe has %d strips, delta %d' % (len(strips), count))
+    pos = HEADER.size
+    tile_map = delta[pos:pos + (count + 7) // 8]
+    pos += len(tile_map)
+    lengths = struct.unpack_from('<%dI' % changed, delta, pos)
+    pos += 4 * changed
+    replaced = iter(lengths)
+    for i in range(count):
+        if tile_map[i // 8] >> (i % 8) & 1:
+            n = next(replaced)
+            strips[i] = delta[pos:pos + n]
+            pos += n
+    if pos != len(delta) or next(replaced, None) is not None:
+        raise ValueError('delta length does not match its tile map')
+    h = FNV_INIT
+    for s in strips:
+        h = fnv64(struct.pack('<Q', fnv64(s)), h)
+    if h != digest:
+        raise ValueError('digest mismatch')
+    out = bytearray(header)
+    for i, s in enumerate(strips):
+        out += s
+        out += bytes([0xFF, 0xD0 + i % 8 if i + 1 < count else 0xD9])
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('in_dir')
+    parser.add_argument('out_dir')
+    args = parser.parse_args()
+
+    os.makedirs(args.out_dir, exist_ok=True)
+    keyframes = {}
+    failed = rebuilt = 0
+    for name in sorted(os.listdir(args.in_dir)):
+        with open(os.path.join(args.in_dir, name), 'rb') as f:
+            data = f.read()
+        base, ext = os.path.splitext(name)
+        if ext == '.jpg':
+            keyframes[hashlib.sha256(data).digest()] = data
+        elif ext == '.jtd':
+            try:
+                data = rebuild(data, keyframes)
+                rebuilt += 1
+            except ValueError as e:
+                print('%s: %s' % (name, e), file=sys.stderr)
+                failed += 1
+                continue
+        else:
+            continue
+        with open(os.path.join(args.out_dir, base + '.jpg'), 'wb') as f:
+            f.write(data)
+    print('%d keyframes, %d deltas rebuilt, %d failed' % (len(keyframes), rebuilt, failed))
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())